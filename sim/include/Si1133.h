@@ -0,0 +1,6 @@
+/**
+ * @file Si1133.h
+ * @brief The sources include "Si1133.h", the header on disk is SI1133.h
+ */
+
+#include "SI1133.h"
@@ -0,0 +1,13 @@
+/**
+ * @file em_assert.h
+ * @brief Host stand-in for emlib's assert, a failed assert ends the simulated run
+ */
+
+#ifndef EM_ASSERT_H
+#define EM_ASSERT_H
+
+void assertEFM(const char *file, int line);
+
+#define EFM_ASSERT(expr)    ((expr) ? ((void)0) : assertEFM(__FILE__, __LINE__))
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file em_cmu.h
+ * @brief Host stand-in for emlib's clock management unit, modelled in sim_misc.c
+ */
+
+#ifndef EM_CMU_H
+#define EM_CMU_H
+
+#include "em_device.h"
+
+typedef enum {
+  cmuClock_HF,
+  cmuClock_CORE,
+  cmuClock_HFPER,
+  cmuClock_CORELE,
+  cmuClock_LFA,
+  cmuClock_LFB,
+  cmuClock_LFE,
+  cmuClock_GPIO,
+  cmuClock_LDMA,
+  cmuClock_GPCRC,
+  cmuClock_TIMER0,
+  cmuClock_TIMER1,
+  cmuClock_USART0,
+  cmuClock_I2C0,
+  cmuClock_I2C1,
+  cmuClock_LEUART0,
+  cmuClock_LETIMER0,
+  cmuClock_RTCC,
+  SIM_CMU_CLOCKS
+} CMU_Clock_TypeDef;
+
+typedef enum {
+  cmuOsc_LFXO,
+  cmuOsc_LFRCO,
+  cmuOsc_HFXO,
+  cmuOsc_HFRCO,
+  cmuOsc_AUXHFRCO,
+  cmuOsc_ULFRCO,
+  SIM_CMU_OSCS
+} CMU_Osc_TypeDef;
+
+typedef enum {
+  cmuSelect_Disabled,
+  cmuSelect_LFXO,
+  cmuSelect_LFRCO,
+  cmuSelect_HFXO,
+  cmuSelect_HFRCO,
+  cmuSelect_ULFRCO,
+  cmuSelect_HFCLKLE
+} CMU_Select_TypeDef;
+
+/* The bands in Hz, as in emlib, so a higher band compares greater */
+typedef enum {
+  cmuHFRCOFreq_1M0Hz  = 1000000U,
+  cmuHFRCOFreq_2M0Hz  = 2000000U,
+  cmuHFRCOFreq_4M0Hz  = 4000000U,
+  cmuHFRCOFreq_7M0Hz  = 7000000U,
+  cmuHFRCOFreq_13M0Hz = 13000000U,
+  cmuHFRCOFreq_16M0Hz = 16000000U,
+  cmuHFRCOFreq_19M0Hz = 19000000U,
+  cmuHFRCOFreq_26M0Hz = 26000000U,
+  cmuHFRCOFreq_32M0Hz = 32000000U,
+  cmuHFRCOFreq_38M0Hz = 38000000U
+} CMU_HFRCOFreq_TypeDef;
+
+typedef struct {
+  uint16_t  ctuneSteadyState;
+  uint8_t   timeoutSteady;
+} CMU_HFXOInit_TypeDef;
+
+#define CMU_HFXOINIT_DEFAULT            { 0x142, 0x9 }
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+CMU_Select_TypeDef CMU_ClockSelectGet(CMU_Clock_TypeDef clock);
+void CMU_HFRCOBandSet(CMU_HFRCOFreq_TypeDef setFreq);
+CMU_HFRCOFreq_TypeDef CMU_HFRCOBandGet(void);
+void CMU_HFXOInit(const CMU_HFXOInit_TypeDef *hfxoInit);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait);
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * @file em_core.h
+ * @brief Host stand-in for emlib's interrupt masking, served by sim_core.c
+ */
+
+#ifndef EM_CORE_H
+#define EM_CORE_H
+
+#include "em_device.h"
+
+typedef uint32_t CORE_irqState_t;
+
+#define CORE_DECLARE_IRQ_STATE          CORE_irqState_t irqState
+#define CORE_ENTER_CRITICAL()           irqState = CORE_EnterCritical()
+#define CORE_EXIT_CRITICAL()            CORE_ExitCritical(irqState)
+#define CORE_ENTER_ATOMIC()             irqState = CORE_EnterAtomic()
+#define CORE_EXIT_ATOMIC()              CORE_ExitAtomic(irqState)
+#define CORE_CRITICAL_SECTION(yourcode) { CORE_DECLARE_IRQ_STATE; CORE_ENTER_CRITICAL(); { yourcode } CORE_EXIT_CRITICAL(); }
+#define CORE_ATOMIC_SECTION(yourcode)   { CORE_DECLARE_IRQ_STATE; CORE_ENTER_ATOMIC(); { yourcode } CORE_EXIT_ATOMIC(); }
+
+CORE_irqState_t CORE_EnterCritical(void);
+void CORE_ExitCritical(CORE_irqState_t irqState);
+CORE_irqState_t CORE_EnterAtomic(void);
+void CORE_ExitAtomic(CORE_irqState_t irqState);
+bool CORE_InIrqContext(void);
+
+#endif
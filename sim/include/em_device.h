@@ -0,0 +1,468 @@
+/**
+ * @file em_device.h
+ * @brief Host stand-in for the EFR32MG12 device header
+ *Register blocks of the peripherals the firmware touches, backed by the models in sim/src.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_DEVICE_H
+#define EM_DEVICE_H
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define __IOM               volatile
+#define __IM                volatile const
+
+/* A register whose access has a side effect (command, flag, FIFO and counter registers)
+ * is an accessor in the block instead of a word. The firmware's name for it is a macro,
+ * so "leuart->CMD = x" becomes "leuart->CMD_io()[0] = x": the accessor lets the model see
+ * the access and hands back a slot the statement reads or writes. sim_io() in sim_core.c
+ * delivers writes to the model before the next register access. */
+#define SIM_REG(name)       volatile uint32_t *(*name##_io)(void)
+
+#ifndef SIM_INTERNAL
+#define CMD                 CMD_io()[0]
+#define STATUS              STATUS_io()[0]
+#define STATE               STATE_io()[0]
+#define IF                  IF_io()[0]
+#define IFS                 IFS_io()[0]
+#define IFC                 IFC_io()[0]
+#define RXDATA              RXDATA_io()[0]
+#define TXDATA              TXDATA_io()[0]
+#define CNT                 CNT_io()[0]
+#define CYCCNT              CYCCNT_io()[0]
+#endif
+
+#define LEUART_COUNT        1
+#define I2C_COUNT           2
+
+/* Flash is a mapping made by the harness so the log survives a simulated reset */
+extern uint8_t *sim_flash;
+#define FLASH_BASE          ((uint32_t)(uintptr_t)sim_flash)
+#define FLASH_SIZE          0x100000UL
+#define FLASH_PAGE_SIZE     2048UL
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// EFR32MG12 interrupt numbers of the handlers the firmware defines
+typedef enum {
+  LDMA_IRQn           = 9,
+  TIMER0_IRQn         = 11,
+  USART0_RX_IRQn      = 12,
+  USART0_TX_IRQn      = 13,
+  I2C0_IRQn           = 17,
+  TIMER1_IRQn         = 19,
+  LEUART0_IRQn        = 22,
+  LETIMER0_IRQn       = 27,
+  RTCC_IRQn           = 30,
+  I2C1_IRQn           = 39,
+  SIM_IRQ_COUNT       = 40
+} IRQn_Type;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  SIM_REG(CMD);
+  SIM_REG(STATUS);
+  __IOM uint32_t CLKDIV;
+  __IOM uint32_t STARTFRAME;
+  __IOM uint32_t SIGFRAME;
+  SIM_REG(IF);
+  SIM_REG(IFS);
+  SIM_REG(IFC);
+  __IOM uint32_t IEN;
+  __IOM uint32_t PULSECTRL;
+  __IOM uint32_t FREEZE;
+  __IOM uint32_t SYNCBUSY;
+  SIM_REG(RXDATA);
+  SIM_REG(TXDATA);
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+  __IOM uint32_t INPUT;
+} LEUART_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  SIM_REG(CMD);
+  SIM_REG(STATUS);
+  SIM_REG(CNT);
+  __IOM uint32_t COMP0;
+  __IOM uint32_t COMP1;
+  __IOM uint32_t REP0;
+  __IOM uint32_t REP1;
+  SIM_REG(IF);
+  SIM_REG(IFS);
+  SIM_REG(IFC);
+  __IOM uint32_t IEN;
+  __IOM uint32_t SYNCBUSY;
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+} LETIMER_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  SIM_REG(CMD);
+  SIM_REG(STATE);
+  SIM_REG(STATUS);
+  __IOM uint32_t CLKDIV;
+  __IOM uint32_t SADDR;
+  __IOM uint32_t SADDRMASK;
+  SIM_REG(RXDATA);
+  SIM_REG(TXDATA);
+  SIM_REG(IF);
+  SIM_REG(IFS);
+  SIM_REG(IFC);
+  __IOM uint32_t IEN;
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+} I2C_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  __IOM uint32_t CCV;
+  __IOM uint32_t CCVP;
+  __IOM uint32_t CCVB;
+} TIMER_CC_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  SIM_REG(CMD);
+  SIM_REG(STATUS);
+  SIM_REG(IF);
+  SIM_REG(IFS);
+  SIM_REG(IFC);
+  __IOM uint32_t IEN;
+  __IOM uint32_t TOP;
+  __IOM uint32_t TOPB;
+  SIM_REG(CNT);
+  __IOM uint32_t LOCK;
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+  __IOM uint32_t ROUTELOC2;
+  TIMER_CC_TypeDef CC[4];
+} TIMER_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  __IOM uint32_t FRAME;
+  __IOM uint32_t TRIGCTRL;
+  SIM_REG(CMD);
+  SIM_REG(STATUS);
+  __IOM uint32_t CLKDIV;
+  SIM_REG(RXDATA);
+  SIM_REG(TXDATA);
+  SIM_REG(IF);
+  SIM_REG(IFS);
+  SIM_REG(IFC);
+  __IOM uint32_t IEN;
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+} USART_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  SIM_REG(STATUS);
+  __IOM uint32_t CHEN;
+  __IOM uint32_t CHBUSY;
+  __IOM uint32_t CHDONE;
+  SIM_REG(IF);
+  SIM_REG(IFS);
+  SIM_REG(IFC);
+  __IOM uint32_t IEN;
+} LDMA_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  __IOM uint32_t MODEL;
+  __IOM uint32_t MODEH;
+  __IOM uint32_t DOUT;
+  __IOM uint32_t DOUTTGL;
+  __IOM uint32_t DIN;
+  __IOM uint32_t PINLOCKN;
+} GPIO_P_TypeDef;
+
+typedef struct {
+  GPIO_P_TypeDef P[12];
+  __IOM uint32_t ROUTEPEN;
+  __IOM uint32_t ROUTELOC0;
+} GPIO_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  __IOM uint32_t INIT;
+  __IOM uint32_t POLY;
+  __IOM uint32_t DATA;
+} GPCRC_TypeDef;
+
+typedef struct {
+  __IOM uint32_t CTRL;
+  SIM_REG(CYCCNT);
+  __IOM uint32_t CPICNT;
+  __IOM uint32_t EXCCNT;
+  __IOM uint32_t SLEEPCNT;
+  __IOM uint32_t LSUCNT;
+  __IOM uint32_t FOLDCNT;
+  __IOM uint32_t PCSR;
+} DWT_Type;
+
+typedef struct {
+  __IOM uint32_t DHCSR;
+  __IOM uint32_t DCRSR;
+  __IOM uint32_t DCRDR;
+  __IOM uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+  __IOM union {
+    uint8_t   u8;
+    uint16_t  u16;
+    uint32_t  u32;
+  } PORT[32];
+  __IOM uint32_t TER;
+  __IOM uint32_t TPR;
+  __IOM uint32_t TCR;
+  __IOM uint32_t LAR;
+} ITM_Type;
+
+typedef struct {
+  __IOM uint32_t SSPSR;
+  __IOM uint32_t CSPSR;
+  __IOM uint32_t ACPR;
+  __IOM uint32_t SPPR;
+  __IOM uint32_t FFCR;
+} TPI_Type;
+
+extern LEUART_TypeDef sim_leuart0;
+extern LETIMER_TypeDef sim_letimer0;
+extern I2C_TypeDef sim_i2c0, sim_i2c1;
+extern TIMER_TypeDef sim_timer0, sim_timer1;
+extern USART_TypeDef sim_usart0;
+extern LDMA_TypeDef sim_ldma;
+extern GPIO_TypeDef sim_gpio;
+extern GPCRC_TypeDef sim_gpcrc;
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+extern ITM_Type sim_itm;
+extern TPI_Type sim_tpi;
+
+#define LEUART0             (&sim_leuart0)
+#define LETIMER0            (&sim_letimer0)
+#define I2C0                (&sim_i2c0)
+#define I2C1                (&sim_i2c1)
+#define TIMER0              (&sim_timer0)
+#define TIMER1              (&sim_timer1)
+#define USART0              (&sim_usart0)
+#define LDMA                (&sim_ldma)
+#define GPIO                (&sim_gpio)
+#define GPCRC               (&sim_gpcrc)
+#define DWT                 (&sim_dwt)
+#define CoreDebug           (&sim_core_debug)
+#define ITM                 (&sim_itm)
+#define TPI                 (&sim_tpi)
+
+//***********************************************************************************
+// register fields, EFR32MG12 values
+//***********************************************************************************
+#define LEUART_CTRL_LOOPBK              0x80UL
+#define LEUART_CTRL_SFUBRX              0x100UL
+#define LEUART_CMD_RXEN                 0x1UL
+#define LEUART_CMD_RXDIS                0x2UL
+#define LEUART_CMD_TXEN                 0x4UL
+#define LEUART_CMD_TXDIS                0x8UL
+#define LEUART_CMD_RXBLOCKEN            0x10UL
+#define LEUART_CMD_RXBLOCKDIS           0x20UL
+#define LEUART_CMD_CLEARTX              0x40UL
+#define LEUART_CMD_CLEARRX              0x80UL
+#define LEUART_STATUS_RXENS             0x1UL
+#define LEUART_STATUS_TXENS             0x2UL
+#define LEUART_STATUS_RXBLOCK           0x4UL
+#define LEUART_STATUS_TXC               0x8UL
+#define LEUART_STATUS_TXBL              0x10UL
+#define LEUART_STATUS_RXDATAV           0x20UL
+#define LEUART_IF_TXC                   0x1UL
+#define LEUART_IF_TXBL                  0x2UL
+#define LEUART_IF_RXDATAV               0x4UL
+#define LEUART_IF_RXOF                  0x8UL
+#define LEUART_IF_RXUF                  0x10UL
+#define LEUART_IF_TXOF                  0x20UL
+#define LEUART_IF_PERR                  0x40UL
+#define LEUART_IF_FERR                  0x80UL
+#define LEUART_IF_MPAF                  0x100UL
+#define LEUART_IF_STARTF                0x200UL
+#define LEUART_IF_SIGF                  0x400UL
+#define LEUART_IEN_TXC                  LEUART_IF_TXC
+#define LEUART_IEN_TXBL                 LEUART_IF_TXBL
+#define LEUART_IEN_RXDATAV              LEUART_IF_RXDATAV
+#define LEUART_IEN_RXOF                 LEUART_IF_RXOF
+#define LEUART_IEN_STARTF               LEUART_IF_STARTF
+#define LEUART_IEN_SIGF                 LEUART_IF_SIGF
+#define LEUART_IFC_TXC                  LEUART_IF_TXC
+#define LEUART_IFC_RXOF                 LEUART_IF_RXOF
+#define LEUART_IFC_STARTF               LEUART_IF_STARTF
+#define LEUART_IFC_SIGF                 LEUART_IF_SIGF
+#define LEUART_ROUTEPEN_RXPEN           0x1UL
+#define LEUART_ROUTEPEN_TXPEN           0x2UL
+#define LEUART_ROUTELOC0_RXLOC_LOC27    27UL
+#define LEUART_ROUTELOC0_TXLOC_LOC27    (27UL << 8)
+
+#define LETIMER_CMD_START               0x1UL
+#define LETIMER_CMD_STOP                0x2UL
+#define LETIMER_CMD_CLEAR               0x4UL
+#define LETIMER_STATUS_RUNNING          0x1UL
+#define LETIMER_IF_COMP0                0x1UL
+#define LETIMER_IF_COMP1                0x2UL
+#define LETIMER_IF_UF                   0x4UL
+#define LETIMER_IFC_COMP0               LETIMER_IF_COMP0
+#define LETIMER_IFC_COMP1               LETIMER_IF_COMP1
+#define LETIMER_IFC_UF                  LETIMER_IF_UF
+#define LETIMER_IEN_COMP0               LETIMER_IF_COMP0
+#define LETIMER_IEN_COMP1               LETIMER_IF_COMP1
+#define LETIMER_IEN_UF                  LETIMER_IF_UF
+#define LETIMER_ROUTEPEN_OUT0PEN        0x1UL
+#define LETIMER_ROUTEPEN_OUT1PEN        0x2UL
+#define LETIMER_ROUTELOC0_OUT0LOC_LOC17 17UL
+#define LETIMER_ROUTELOC0_OUT1LOC_LOC16 (16UL << 8)
+
+#define I2C_CMD_START                   0x1UL
+#define I2C_CMD_STOP                    0x2UL
+#define I2C_CMD_ACK                     0x4UL
+#define I2C_CMD_NACK                    0x8UL
+#define I2C_CMD_CONT                    0x10UL
+#define I2C_CMD_ABORT                   0x20UL
+#define I2C_CMD_CLEARTX                 0x40UL
+#define I2C_CMD_CLEARPC                 0x80UL
+#define I2C_STATE_BUSY                  0x1UL
+#define I2C_STATE_MASTER                0x2UL
+#define I2C_STATE_TRANSMITTER           0x4UL
+#define I2C_STATE_NACKED                0x8UL
+#define _I2C_STATE_STATE_MASK           0xE0UL
+#define I2C_STATE_STATE_IDLE            0x0UL
+#define I2C_STATE_STATE_WAIT            0x20UL
+#define I2C_STATE_STATE_DATA            0xA0UL
+#define I2C_IF_START                    0x1UL
+#define I2C_IF_RSTART                   0x2UL
+#define I2C_IF_ADDR                     0x4UL
+#define I2C_IF_TXC                      0x8UL
+#define I2C_IF_TXBL                     0x10UL
+#define I2C_IF_RXDATAV                  0x20UL
+#define I2C_IF_ACK                      0x40UL
+#define I2C_IF_NACK                     0x80UL
+#define I2C_IF_MSTOP                    0x100UL
+#define I2C_IF_ARBLOST                  0x200UL
+#define I2C_IF_BUSERR                   0x400UL
+#define I2C_IF_BUSHOLD                  0x800UL
+#define I2C_IF_TXOF                     0x1000UL
+#define I2C_IF_RXUF                     0x2000UL
+#define I2C_IF_BITO                     0x4000UL
+#define I2C_IF_CLTO                     0x8000UL
+#define I2C_IEN_ACK                     I2C_IF_ACK
+#define I2C_IEN_NACK                    I2C_IF_NACK
+#define I2C_IEN_RXDATAV                 I2C_IF_RXDATAV
+#define I2C_IEN_MSTOP                   I2C_IF_MSTOP
+#define I2C_IEN_ARBLOST                 I2C_IF_ARBLOST
+#define I2C_IEN_BUSERR                  I2C_IF_BUSERR
+#define I2C_IEN_CLTO                    I2C_IF_CLTO
+#define _I2C_CTRL_CLTO_MASK             0x70000UL
+#define I2C_CTRL_CLTO_1024PCC           (5UL << 16)
+#define I2C_ROUTEPEN_SDAPEN             0x1UL
+#define I2C_ROUTEPEN_SCLPEN             0x2UL
+#define I2C_ROUTELOC0_SDALOC_LOC17      17UL
+#define I2C_ROUTELOC0_SCLLOC_LOC17      (17UL << 8)
+
+#define TIMER_CMD_START                 0x1UL
+#define TIMER_CMD_STOP                  0x2UL
+#define TIMER_STATUS_RUNNING            0x1UL
+#define TIMER_IF_OF                     0x1UL
+#define TIMER_IF_UF                     0x2UL
+#define TIMER_IEN_OF                    TIMER_IF_OF
+#define TIMER_ROUTEPEN_CC0PEN           0x1UL
+#define TIMER_ROUTEPEN_CC1PEN           0x2UL
+#define TIMER_ROUTEPEN_CC2PEN           0x4UL
+#define TIMER_ROUTELOC0_CC0LOC_LOC19    19UL
+#define TIMER_ROUTELOC0_CC1LOC_LOC19    (19UL << 8)
+#define TIMER_ROUTELOC0_CC2LOC_LOC19    (19UL << 16)
+
+#define USART_CMD_RXEN                  0x1UL
+#define USART_CMD_RXDIS                 0x2UL
+#define USART_CMD_TXEN                  0x4UL
+#define USART_CMD_TXDIS                 0x8UL
+#define USART_CMD_CLEARTX               0x400UL
+#define USART_CMD_CLEARRX               0x800UL
+#define USART_STATUS_RXENS              0x1UL
+#define USART_STATUS_TXENS              0x2UL
+#define USART_STATUS_TXC                0x20UL
+#define USART_STATUS_TXBL               0x40UL
+#define USART_STATUS_RXDATAV            0x80UL
+#define USART_STATUS_RXFULL             0x100UL
+#define USART_IF_TXC                    0x1UL
+#define USART_IF_TXBL                   0x2UL
+#define USART_IF_RXDATAV                0x4UL
+#define USART_IF_RXFULL                 0x8UL
+#define USART_IF_RXOF                   0x10UL
+#define USART_IEN_TXC                   USART_IF_TXC
+#define USART_IEN_TXBL                  USART_IF_TXBL
+#define USART_IEN_RXDATAV               USART_IF_RXDATAV
+#define USART_IFC_TXC                   USART_IF_TXC
+#define USART_IFC_RXOF                  USART_IF_RXOF
+#define USART_ROUTEPEN_RXPEN            0x1UL
+#define USART_ROUTEPEN_TXPEN            0x2UL
+#define USART_ROUTELOC0_RXLOC_LOC27     27UL
+#define USART_ROUTELOC0_TXLOC_LOC27     (27UL << 8)
+
+#define LDMA_IF_ERROR                   0x80000000UL
+#define _LDMA_CH_CTRL_XFERCNT_SHIFT     4
+#define _LDMA_CH_CTRL_XFERCNT_MASK      0x7FF0UL
+
+#define GPIO_ROUTEPEN_SWVPEN            0x10UL
+#define _GPIO_ROUTELOC0_SWVLOC_MASK     0x3UL
+#define GPIO_ROUTELOC0_SWVLOC_LOC0      0x0UL
+
+#define CoreDebug_DHCSR_C_DEBUGEN_Msk   (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk      (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk          (1UL << 0)
+#define DWT_CTRL_POSTPRESET_Pos         1
+#define DWT_CTRL_POSTINIT_Pos           5
+#define DWT_CTRL_CYCTAP_Msk             (1UL << 9)
+#define DWT_CTRL_SYNCTAP_Pos            10
+#define DWT_CTRL_PCSAMPLENA_Msk         (1UL << 12)
+#define DWT_CTRL_EXCTRCENA_Msk          (1UL << 16)
+#define DWT_CTRL_CPIEVTENA_Msk          (1UL << 17)
+#define DWT_CTRL_EXCEVTENA_Msk          (1UL << 18)
+#define DWT_CTRL_SLEEPEVTENA_Msk        (1UL << 19)
+#define DWT_CTRL_LSUEVTENA_Msk          (1UL << 20)
+#define DWT_CTRL_FOLDEVTENA_Msk         (1UL << 21)
+#define ITM_TCR_ITMENA_Msk              (1UL << 0)
+#define ITM_TCR_TSENA_Msk               (1UL << 1)
+#define ITM_TCR_SYNCENA_Msk             (1UL << 2)
+#define ITM_TCR_DWTENA_Msk              (1UL << 3)
+#define ITM_TCR_SWOENA_Msk              (1UL << 4)
+#define ITM_TCR_TSPrescale_Pos          8
+#define ITM_TCR_TraceBusID_Pos          16
+#define ITM_TCR_BUSY_Msk                (1UL << 23)
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+
+void __NOP(void);
+void __DSB(void);
+void __ISB(void);
+void __WFI(void);
+uint32_t __LDREXW(volatile uint32_t *addr);
+uint32_t __STREXW(uint32_t value, volatile uint32_t *addr);
+void __CLREX(void);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file em_emu.h
+ * @brief Host stand-in for emlib's energy management unit, sleep is served by sim_core.c
+ */
+
+#ifndef EM_EMU_H
+#define EM_EMU_H
+
+#include "em_device.h"
+
+#define _EMU_CTRL_EM01VSCALE_MASK       0x30000UL
+
+typedef enum {
+  emuVScaleEM01_HighPerformance = 0,
+  emuVScaleEM01_LowPower        = 2
+} EMU_VScaleEM01_TypeDef;
+
+typedef enum {
+  emuVScaleEM23_FastWakeup      = 0,
+  emuVScaleEM23_LowPower        = 1
+} EMU_VScaleEM23_TypeDef;
+
+typedef struct {
+  uint16_t  maxCurrent_mA;
+  uint16_t  em01LoadCurrent_mA;
+  uint16_t  em234LoadCurrent_uA;
+} EMU_DCDCInit_TypeDef;
+
+typedef struct {
+  bool                    em23VregFullEn;
+  EMU_VScaleEM23_TypeDef  vScaleEM23Voltage;
+} EMU_EM23Init_TypeDef;
+
+#define EMU_DCDCINIT_DEFAULT            { 200, 15, 10 }
+#define EMU_EM23INIT_DEFAULT            { false, emuVScaleEM23_FastWakeup }
+
+bool EMU_DCDCInit(const EMU_DCDCInit_TypeDef *dcdcInit);
+void EMU_EM23Init(const EMU_EM23Init_TypeDef *em23Init);
+void EMU_VScaleEM01(EMU_VScaleEM01_TypeDef voltage, bool wait);
+void EMU_EnterEM1(void);
+void EMU_EnterEM2(bool restore);
+void EMU_EnterEM3(bool restore);
+
+#endif
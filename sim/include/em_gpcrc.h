@@ -0,0 +1,33 @@
+/**
+ * @file em_gpcrc.h
+ * @brief Host stand-in for emlib's GPCRC driver, modelled in sim_gpcrc.c
+ */
+
+#ifndef EM_GPCRC_H
+#define EM_GPCRC_H
+
+#include "em_device.h"
+
+typedef struct {
+  uint32_t  crcPoly;
+  uint32_t  initValue;
+  bool      reverseByteOrder;
+  bool      reverseBits;
+  bool      enableByteMode;
+  bool      autoInit;
+  bool      enable;
+} GPCRC_Init_TypeDef;
+
+#define GPCRC_INIT_DEFAULT { 0x04C11DB7UL, 0x0UL, false, false, false, false, true }
+
+void GPCRC_Init(GPCRC_TypeDef *gpcrc, const GPCRC_Init_TypeDef *init);
+void GPCRC_Reset(GPCRC_TypeDef *gpcrc);
+void GPCRC_Start(GPCRC_TypeDef *gpcrc);
+void GPCRC_InputU8(GPCRC_TypeDef *gpcrc, uint8_t data);
+void GPCRC_InputU16(GPCRC_TypeDef *gpcrc, uint16_t data);
+void GPCRC_InputU32(GPCRC_TypeDef *gpcrc, uint32_t data);
+uint32_t GPCRC_DataRead(GPCRC_TypeDef *gpcrc);
+uint32_t GPCRC_DataReadBitReversed(GPCRC_TypeDef *gpcrc);
+uint32_t GPCRC_DataReadByteReversed(GPCRC_TypeDef *gpcrc);
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * @file em_gpio.h
+ * @brief Host stand-in for emlib's GPIO, modelled in sim_misc.c
+ */
+
+#ifndef EM_GPIO_H
+#define EM_GPIO_H
+
+#include "em_device.h"
+
+typedef enum {
+  gpioPortA, gpioPortB, gpioPortC, gpioPortD, gpioPortE, gpioPortF,
+  gpioPortG, gpioPortH, gpioPortI, gpioPortJ, gpioPortK
+} GPIO_Port_TypeDef;
+
+typedef enum {
+  gpioModeDisabled          = 0,
+  gpioModeInput             = 1,
+  gpioModeInputPull         = 2,
+  gpioModeInputPullFilter   = 3,
+  gpioModePushPull          = 4,
+  gpioModePushPullAlternate = 5,
+  gpioModeWiredOr           = 6,
+  gpioModeWiredOrPullDown   = 7,
+  gpioModeWiredAnd          = 8,
+  gpioModeWiredAndFilter    = 9,
+  gpioModeWiredAndPullUp    = 10
+} GPIO_Mode_TypeDef;
+
+typedef enum {
+  gpioDriveStrengthStrongAlternateStrong  = 0x0,
+  gpioDriveStrengthWeakAlternateStrong    = 0x1,
+  gpioDriveStrengthStrongAlternateWeak    = 0x10000,
+  gpioDriveStrengthWeakAlternateWeak      = 0x10001
+} GPIO_DriveStrength_TypeDef;
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength);
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutToggle(GPIO_Port_TypeDef port, unsigned int pin);
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin);
+unsigned int GPIO_PinOutGet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PortOutSet(GPIO_Port_TypeDef port, uint32_t pins);
+void GPIO_PortOutClear(GPIO_Port_TypeDef port, uint32_t pins);
+void GPIO_PortOutToggle(GPIO_Port_TypeDef port, uint32_t pins);
+void GPIO_PortOutSetVal(GPIO_Port_TypeDef port, uint32_t val, uint32_t mask);
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * @file em_i2c.h
+ * @brief Host stand-in for emlib's I2C driver, modelled in sim_i2c.c
+ */
+
+#ifndef EM_I2C_H
+#define EM_I2C_H
+
+#include "em_device.h"
+
+#define I2C_FREQ_STANDARD_MAX   92000
+#define I2C_FREQ_FAST_MAX       392157
+#define I2C_FREQ_FASTPLUS_MAX   987167
+
+typedef enum {
+  i2cClockHLRStandard,
+  i2cClockHLRAsymetric,
+  i2cClockHLRFast
+} I2C_ClockHLR_TypeDef;
+
+typedef struct {
+  bool                  enable;
+  bool                  master;
+  uint32_t              refFreq;
+  uint32_t              freq;
+  I2C_ClockHLR_TypeDef  clhr;
+} I2C_Init_TypeDef;
+
+#define I2C_INIT_DEFAULT { true, true, 0, I2C_FREQ_STANDARD_MAX, i2cClockHLRStandard }
+
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init);
+void I2C_Enable(I2C_TypeDef *i2c, bool enable);
+void I2C_Reset(I2C_TypeDef *i2c);
+void I2C_BusFreqSet(I2C_TypeDef *i2c, uint32_t freqRef, uint32_t freqScl, I2C_ClockHLR_TypeDef i2cMode);
+uint32_t I2C_BusFreqGet(I2C_TypeDef *i2c);
+
+#endif
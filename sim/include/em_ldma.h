@@ -0,0 +1,106 @@
+/**
+ * @file em_ldma.h
+ * @brief Host stand-in for emlib's LDMA driver, modelled in sim_misc.c
+ */
+
+#ifndef EM_LDMA_H
+#define EM_LDMA_H
+
+#include "em_device.h"
+
+#define DMA_CHAN_COUNT      8
+
+typedef enum { ldmaCtrlStructTypeXfer, ldmaCtrlStructTypeSync, ldmaCtrlStructTypeWrite } LDMA_CtrlStructType_t;
+typedef enum { ldmaCtrlBlockSizeUnit1 } LDMA_CtrlBlockSize_t;
+typedef enum { ldmaCtrlReqModeBlock, ldmaCtrlReqModeAll } LDMA_CtrlReqMode_t;
+typedef enum { ldmaCtrlSrcIncOne, ldmaCtrlSrcIncTwo, ldmaCtrlSrcIncFour, ldmaCtrlSrcIncNone } LDMA_CtrlSrcInc_t;
+typedef enum { ldmaCtrlSizeByte, ldmaCtrlSizeHalf, ldmaCtrlSizeWord } LDMA_CtrlSize_t;
+typedef enum { ldmaCtrlDstIncOne, ldmaCtrlDstIncTwo, ldmaCtrlDstIncFour, ldmaCtrlDstIncNone } LDMA_CtrlDstInc_t;
+typedef enum { ldmaCtrlSrcAddrModeAbs, ldmaCtrlSrcAddrModeRel } LDMA_CtrlSrcAddrMode_t;
+typedef enum { ldmaCtrlDstAddrModeAbs, ldmaCtrlDstAddrModeRel } LDMA_CtrlDstAddrMode_t;
+typedef enum { ldmaLinkModeAbs, ldmaLinkModeRel } LDMA_LinkMode_t;
+
+typedef enum {
+  ldmaPeripheralSignal_NONE,
+  ldmaPeripheralSignal_USART0_TXBL,
+  ldmaPeripheralSignal_USART0_RXDATAV,
+  ldmaPeripheralSignal_TIMER1_UFOF,
+  ldmaPeripheralSignal_TIMER1_CC0,
+  ldmaPeripheralSignal_TIMER1_CC1,
+  ldmaPeripheralSignal_TIMER1_CC2
+} LDMA_PeripheralSignal_t;
+
+/* The transfer layout of a descriptor, the only one the firmware builds. Addresses are
+ * 32 bits as on the target, so the host build links without PIE. */
+typedef union {
+  struct {
+    uint32_t  structType   : 2;
+    uint32_t  reserved0    : 1;
+    uint32_t  structReq    : 1;
+    uint32_t  xferCnt      : 11;
+    uint32_t  byteSwap     : 1;
+    uint32_t  blockSize    : 4;
+    uint32_t  doneIfs      : 1;
+    uint32_t  reqMode      : 1;
+    uint32_t  decLoopCnt   : 1;
+    uint32_t  ignoreSrec   : 1;
+    uint32_t  srcInc       : 2;
+    uint32_t  size         : 2;
+    uint32_t  dstInc       : 2;
+    uint32_t  srcAddrMode  : 1;
+    uint32_t  dstAddrMode  : 1;
+    uint32_t  srcAddr;
+    uint32_t  dstAddr;
+    uint32_t  linkMode     : 1;
+    uint32_t  link         : 1;
+    int32_t   linkAddr     : 30;
+  } xfer;
+} LDMA_Descriptor_t;
+
+typedef struct {
+  uint32_t  ldmaReqSel;
+  uint8_t   ldmaCtrlSyncPrsClrOff;
+  uint8_t   ldmaCtrlSyncPrsClrOn;
+  uint8_t   ldmaCtrlSyncPrsSetOff;
+  uint8_t   ldmaCtrlSyncPrsSetOn;
+  bool      ldmaReqDis;
+  bool      ldmaDbgHalt;
+  uint8_t   ldmaCfgArbSlots;
+  uint8_t   ldmaCfgSrcIncSign;
+  uint8_t   ldmaCfgDstIncSign;
+  uint8_t   ldmaLoopCnt;
+} LDMA_TransferCfg_t;
+
+typedef struct {
+  uint8_t   ldmaInitCtrlNumFixed;
+  uint8_t   ldmaInitCtrlSyncPrsClrEn;
+  uint8_t   ldmaInitCtrlSyncPrsSetEn;
+  uint8_t   ldmaInitIrqPriority;
+} LDMA_Init_t;
+
+#define LDMA_INIT_DEFAULT { 0, 0, 0, 3 }
+
+#define LDMA_TRANSFER_CFG_PERIPHERAL(signal) { (signal), 0, 0, 0, 0, false, false, 0, 0, 0, 0 }
+
+#define LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src, dest, count) \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .structReq = 0, .xferCnt = (count) - 1,       \
+              .blockSize = ldmaCtrlBlockSizeUnit1, .doneIfs = 1, .reqMode = ldmaCtrlReqModeBlock, \
+              .srcInc = ldmaCtrlSrcIncOne, .size = ldmaCtrlSizeByte, .dstInc = ldmaCtrlDstIncNone, \
+              .srcAddr = (uint32_t)(uintptr_t)(src), .dstAddr = (uint32_t)(uintptr_t)(dest),      \
+              .linkMode = 0, .link = 0, .linkAddr = 0 } }
+
+#define LDMA_DESCRIPTOR_LINKREL_M2P_BYTE(src, dest, count, linkjmp) \
+  { .xfer = { .structType = ldmaCtrlStructTypeXfer, .structReq = 0, .xferCnt = (count) - 1,       \
+              .blockSize = ldmaCtrlBlockSizeUnit1, .doneIfs = 0, .reqMode = ldmaCtrlReqModeBlock, \
+              .srcInc = ldmaCtrlSrcIncOne, .size = ldmaCtrlSizeByte, .dstInc = ldmaCtrlDstIncNone, \
+              .srcAddr = (uint32_t)(uintptr_t)(src), .dstAddr = (uint32_t)(uintptr_t)(dest),      \
+              .linkMode = ldmaLinkModeRel, .link = 1, .linkAddr = (linkjmp) * 4 } }
+
+void LDMA_Init(const LDMA_Init_t *init);
+void LDMA_DeInit(void);
+void LDMA_StartTransfer(int ch, const LDMA_TransferCfg_t *transfer, const LDMA_Descriptor_t *descriptor);
+void LDMA_StopTransfer(int ch);
+bool LDMA_TransferDone(int ch);
+uint32_t LDMA_TransferRemainingCount(int ch);
+
+#endif
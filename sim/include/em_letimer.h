@@ -0,0 +1,48 @@
+/**
+ * @file em_letimer.h
+ * @brief Host stand-in for emlib's LETIMER driver, modelled in sim_timers.c
+ */
+
+#ifndef EM_LETIMER_H
+#define EM_LETIMER_H
+
+#include "em_device.h"
+
+typedef enum {
+  letimerRepeatFree,
+  letimerRepeatOneshot,
+  letimerRepeatBuffered,
+  letimerRepeatDouble
+} LETIMER_RepeatMode_TypeDef;
+
+typedef enum {
+  letimerUFOANone,
+  letimerUFOAToggle,
+  letimerUFOAPulse,
+  letimerUFOAPwm
+} LETIMER_UFOA_TypeDef;
+
+typedef struct {
+  bool                        enable;
+  bool                        debugRun;
+  bool                        comp0Top;
+  bool                        bufTop;
+  uint8_t                     out0Pol;
+  uint8_t                     out1Pol;
+  LETIMER_UFOA_TypeDef        ufoa0;
+  LETIMER_UFOA_TypeDef        ufoa1;
+  LETIMER_RepeatMode_TypeDef  repMode;
+} LETIMER_Init_TypeDef;
+
+#define LETIMER_INIT_DEFAULT { true, false, false, false, 0, 0, letimerUFOANone, letimerUFOANone, letimerRepeatFree }
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init);
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable);
+void LETIMER_Reset(LETIMER_TypeDef *letimer);
+uint32_t LETIMER_CompareGet(LETIMER_TypeDef *letimer, unsigned int comp);
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value);
+uint32_t LETIMER_RepeatGet(LETIMER_TypeDef *letimer, unsigned int rep);
+void LETIMER_RepeatSet(LETIMER_TypeDef *letimer, unsigned int rep, uint32_t value);
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file em_timer.h
+ * @brief Host stand-in for emlib's TIMER driver, modelled in sim_timers.c
+ */
+
+#ifndef EM_TIMER_H
+#define EM_TIMER_H
+
+#include "em_device.h"
+
+typedef enum { timerModeUp, timerModeDown, timerModeUpDown, timerModeQDec } TIMER_Mode_TypeDef;
+
+/* Prescale values are shifts, as in emlib */
+typedef enum {
+  timerPrescale1, timerPrescale2, timerPrescale4, timerPrescale8, timerPrescale16, timerPrescale32,
+  timerPrescale64, timerPrescale128, timerPrescale256, timerPrescale512, timerPrescale1024
+} TIMER_Prescale_TypeDef;
+
+typedef enum { timerClkSelHFPerClk, timerClkSelCC1, timerClkSelCascade } TIMER_ClkSel_TypeDef;
+typedef enum { timerInputActionNone, timerInputActionStart, timerInputActionStop, timerInputActionReloadStart } TIMER_InputAction_TypeDef;
+typedef enum { timerCCModeOff, timerCCModeCapture, timerCCModeCompare, timerCCModePWM } TIMER_CCMode_TypeDef;
+typedef enum { timerOutputActionNone, timerOutputActionToggle, timerOutputActionClear, timerOutputActionSet } TIMER_OutputAction_TypeDef;
+
+typedef struct {
+  bool                      enable;
+  bool                      debugRun;
+  TIMER_Prescale_TypeDef    prescale;
+  TIMER_ClkSel_TypeDef      clkSel;
+  bool                      count2x;
+  bool                      ati;
+  TIMER_InputAction_TypeDef fallAction;
+  TIMER_InputAction_TypeDef riseAction;
+  TIMER_Mode_TypeDef        mode;
+  bool                      dmaClrAct;
+  bool                      quadModeX4;
+  bool                      oneShot;
+  bool                      sync;
+} TIMER_Init_TypeDef;
+
+typedef struct {
+  TIMER_OutputAction_TypeDef  cufoa;
+  TIMER_OutputAction_TypeDef  cofoa;
+  TIMER_OutputAction_TypeDef  cmoa;
+  TIMER_CCMode_TypeDef        mode;
+  bool                        filter;
+  bool                        coist;
+  bool                        outInvert;
+} TIMER_InitCC_TypeDef;
+
+#define TIMER_INIT_DEFAULT   { true, false, timerPrescale1, timerClkSelHFPerClk, false, false, \
+                               timerInputActionNone, timerInputActionNone, timerModeUp, \
+                               false, false, false, false }
+#define TIMER_INITCC_DEFAULT { timerOutputActionNone, timerOutputActionNone, timerOutputActionNone, \
+                               timerCCModeOff, false, false, false }
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init);
+void TIMER_InitCC(TIMER_TypeDef *timer, unsigned int ch, const TIMER_InitCC_TypeDef *init);
+void TIMER_Enable(TIMER_TypeDef *timer, bool enable);
+void TIMER_Reset(TIMER_TypeDef *timer);
+void TIMER_TopSet(TIMER_TypeDef *timer, uint32_t val);
+void TIMER_TopBufSet(TIMER_TypeDef *timer, uint32_t val);
+uint32_t TIMER_TopGet(TIMER_TypeDef *timer);
+void TIMER_CompareSet(TIMER_TypeDef *timer, unsigned int ch, uint32_t val);
+void TIMER_CompareBufSet(TIMER_TypeDef *timer, unsigned int ch, uint32_t val);
+uint32_t TIMER_CounterGet(TIMER_TypeDef *timer);
+void TIMER_CounterSet(TIMER_TypeDef *timer, uint32_t val);
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @file em_usart.h
+ * @brief Host stand-in for emlib's USART driver, modelled in sim_uart.c
+ */
+
+#ifndef EM_USART_H
+#define EM_USART_H
+
+#include "em_device.h"
+
+typedef enum {
+  usartDisable    = 0x0,
+  usartEnableRx   = USART_CMD_RXEN,
+  usartEnableTx   = USART_CMD_TXEN,
+  usartEnable     = (USART_CMD_RXEN | USART_CMD_TXEN)
+} USART_Enable_TypeDef;
+
+typedef enum { usartOVS16, usartOVS8, usartOVS6, usartOVS4 } USART_OVS_TypeDef;
+typedef enum { usartDatabits8 = 5, usartDatabits9 = 6 } USART_Databits_TypeDef;
+typedef enum { usartNoParity = 0, usartEvenParity = 2, usartOddParity = 3 } USART_Parity_TypeDef;
+typedef enum { usartStopbits1 = 1, usartStopbits2 = 3 } USART_Stopbits_TypeDef;
+
+typedef struct {
+  USART_Enable_TypeDef    enable;
+  uint32_t                refFreq;
+  uint32_t                baudrate;
+  USART_OVS_TypeDef       oversampling;
+  USART_Databits_TypeDef  databits;
+  USART_Parity_TypeDef    parity;
+  USART_Stopbits_TypeDef  stopbits;
+  bool                    mvdis;
+  bool                    prsRxEnable;
+  uint32_t                prsRxCh;
+  bool                    autoCsEnable;
+} USART_InitAsync_TypeDef;
+
+#define USART_INITASYNC_DEFAULT { usartEnable, 0, 115200, usartOVS16, usartDatabits8, \
+                                  usartNoParity, usartStopbits1, false, false, 0, false }
+
+void USART_InitAsync(USART_TypeDef *usart, const USART_InitAsync_TypeDef *init);
+void USART_Enable(USART_TypeDef *usart, USART_Enable_TypeDef enable);
+void USART_Reset(USART_TypeDef *usart);
+void USART_BaudrateAsyncSet(USART_TypeDef *usart, uint32_t refFreq, uint32_t baudrate, USART_OVS_TypeDef ovs);
+
+#endif
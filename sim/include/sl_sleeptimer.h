@@ -0,0 +1,63 @@
+/**
+ * @file sl_sleeptimer.h
+ * @brief Host stand-in for the SDK sleeptimer on RTCC, modelled in sim_timers.c
+ */
+
+#ifndef SL_SLEEPTIMER_H
+#define SL_SLEEPTIMER_H
+
+#include "em_device.h"
+
+typedef uint32_t sl_status_t;
+
+#define SL_STATUS_OK                  ((sl_status_t)0x0000)
+#define SL_STATUS_FAIL                ((sl_status_t)0x0001)
+#define SL_STATUS_INVALID_STATE       ((sl_status_t)0x0002)
+#define SL_STATUS_NOT_READY           ((sl_status_t)0x0003)
+#define SL_STATUS_EMPTY               ((sl_status_t)0x0007)
+#define SL_STATUS_NULL_POINTER        ((sl_status_t)0x0022)
+#define SL_STATUS_INVALID_PARAMETER   ((sl_status_t)0x0021)
+
+#define SL_SLEEPTIMER_NO_HIGH_PRECISION_HF_CLOCKS_REQUIRED_FLAG 0x01
+
+typedef struct sl_sleeptimer_timer_handle sl_sleeptimer_timer_handle_t;
+typedef void (*sl_sleeptimer_timer_callback_t)(sl_sleeptimer_timer_handle_t *handle, void *data);
+
+struct sl_sleeptimer_timer_handle {
+  void                            *callback_data;
+  uint8_t                         priority;
+  uint16_t                        option_flags;
+  sl_sleeptimer_timer_handle_t    *next;
+  sl_sleeptimer_timer_callback_t  callback;
+  uint32_t                        timeout_periodic;
+  uint32_t                        delta;
+};
+
+sl_status_t sl_sleeptimer_init(void);
+sl_status_t sl_sleeptimer_start_timer(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout,
+                                      sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                      uint8_t priority, uint16_t option_flags);
+sl_status_t sl_sleeptimer_start_timer_ms(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout_ms,
+                                         sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                         uint8_t priority, uint16_t option_flags);
+sl_status_t sl_sleeptimer_start_periodic_timer(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout,
+                                               sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                               uint8_t priority, uint16_t option_flags);
+sl_status_t sl_sleeptimer_start_periodic_timer_ms(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout_ms,
+                                                  sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                                  uint8_t priority, uint16_t option_flags);
+sl_status_t sl_sleeptimer_restart_timer(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout,
+                                        sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                        uint8_t priority, uint16_t option_flags);
+sl_status_t sl_sleeptimer_stop_timer(sl_sleeptimer_timer_handle_t *handle);
+sl_status_t sl_sleeptimer_is_timer_running(sl_sleeptimer_timer_handle_t *handle, bool *running);
+sl_status_t sl_sleeptimer_get_timer_time_remaining(sl_sleeptimer_timer_handle_t *handle, uint32_t *time);
+sl_status_t sl_sleeptimer_get_remaining_time_of_first_timer(uint16_t option_flags, uint32_t *time_remaining);
+uint32_t sl_sleeptimer_get_tick_count(void);
+uint64_t sl_sleeptimer_get_tick_count64(void);
+uint32_t sl_sleeptimer_get_timer_frequency(void);
+uint32_t sl_sleeptimer_ms_to_tick(uint16_t time_ms);
+sl_status_t sl_sleeptimer_ms32_to_tick(uint32_t time_ms, uint32_t *tick);
+uint32_t sl_sleeptimer_tick_to_ms(uint32_t tick);
+
+#endif
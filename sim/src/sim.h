@@ -0,0 +1,245 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SIM_HG
+#define SIM_HG
+
+/* The models see the register blocks as they are, not through the firmware's names */
+#define SIM_INTERNAL
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_assert.h"
+#include "em_chip.h"
+#include "em_cmu.h"
+#include "em_core.h"
+#include "em_emu.h"
+#include "em_gpcrc.h"
+#include "em_gpio.h"
+#include "em_i2c.h"
+#include "em_ldma.h"
+#include "em_letimer.h"
+#include "em_leuart.h"
+#include "em_msc.h"
+#include "em_timer.h"
+#include "em_usart.h"
+#include "sl_sleeptimer.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_NS_PER_S        1000000000ULL
+#define SIM_NS_PER_MS       1000000ULL
+#define SIM_NS_PER_US       1000ULL
+
+#define SIM_EM0             0         // energy modes, as EM0 to EM3 of sleep_routines.h
+#define SIM_EM1             1
+#define SIM_EM2             2
+#define SIM_EM3             3
+
+#define SIM_LFXO_HZ         32768
+#define SIM_ULFRCO_HZ       1000
+
+#define SIM_IO_CYCLES       4         // core cycles of a peripheral register access
+#define SIM_IRQ_CYCLES      24        // exception entry and return
+#define SIM_CALL_CYCLES     40        // an emlib call
+#define SIM_INSN_CYCLES     1         // a firmware instruction, timed only with count_insns
+#define SIM_QUIET_ACCESSES  16        // accesses without a state change that count as polling
+#define SIM_IDLE_DATA       0xFFFFFFFFUL  // idle slot of a data register, no byte written equals it
+
+#define SIM_EXIT_ASSERT     2         // exit status of a run ended by a failed EFM_ASSERT
+#define SIM_EXIT_STALL      3         // spinning with nothing left that could end the spin
+#define SIM_EXIT_STORM      4         // an interrupt that is never cleared
+
+#define SIM_AT_FAULTS       8         // --at-fault options kept
+
+/* A static accessor for one hooked register, stored in the member of the block */
+#define SIM_IO_FN(fn, reg)  static volatile uint32_t *fn(void){ return sim_io(&(reg)); }
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Clock domain an event belongs to, checked against the energy mode it fires in
+typedef enum {
+  SIM_DOMAIN_EXT,       // outside the MCU, sensors, the HM-10 and the phone
+  SIM_DOMAIN_HF,        // HFPER peripherals, stopped in EM2 and EM3
+  SIM_DOMAIN_LFXO,      // LFA/LFB/LFE on LFXO, stopped in EM3
+  SIM_DOMAIN_ULFRCO     // runs in every mode used here
+} SIM_DOMAIN;
+
+typedef struct sim_event SIM_EVENT;
+struct sim_event {
+  uint64_t    at;       // ns
+  uint64_t    seq;      // arming order, events due together fire first armed first
+  bool        armed;
+  SIM_DOMAIN  domain;
+  const char  *name;
+  void        (*fire)(SIM_EVENT *ev);
+  void        *ctx;
+  SIM_EVENT   *next;    // armed events, earliest first
+};
+
+typedef struct sim_ioreg SIM_IOREG;
+struct sim_ioreg {
+  volatile uint32_t   slot;       // what the firmware statement reads or writes
+  uint32_t            shadow;     // slot as handed out or last delivered
+  uint32_t            (*read)(SIM_IOREG *reg);              // NULL for write only registers
+  void                (*write)(SIM_IOREG *reg, uint32_t value); // NULL for read only registers
+  void                *ctx;
+  uint32_t            idle;       // slot of a write only register
+  int                 clock;      // CMU clock the access needs, -1 for none
+  const char          *name;
+  SIM_IOREG           *next;
+};
+
+// What the HM-10 does with the reply of an AT command, see --at-fault
+typedef enum {
+  SIM_AT_DROP,          // never sent
+  SIM_AT_DELAY,         // sent delay_ms later
+  SIM_AT_GARBLE         // sent with its first byte changed
+} SIM_AT_FAULT_KIND;
+
+typedef struct {
+  uint32_t          reply;      // counts the AT replies of a boot from 1
+  SIM_AT_FAULT_KIND kind;
+  uint32_t          delay_ms;
+} SIM_AT_FAULT;
+
+typedef struct {
+  uint32_t  power_uw;
+  uint32_t  wakeup_us;
+  uint32_t  switch_nj;
+} SIM_EM_COST;
+
+typedef struct {
+  uint64_t  end_ns;
+  uint32_t  seed;
+  bool      quiet;
+  bool      phone;            // a phone connects at phone_ms
+  uint32_t  phone_ms;
+  FILE      *phone_log;
+  FILE      *capture;         // raw bytes received by the phone
+  FILE      *report;
+  double    i2c_nack_rate;    // NACKs injected per address phase
+  double    flash_fail_rate;  // failed erases and writes per operation
+  int32_t   bad_page;         // flash page that fails every erase, -1 for none
+  uint32_t  cut_write;        // flash word write the power is cut in, 0 for none
+  uint32_t  cut_erase;        // page erase the power is cut in, 0 for none
+  bool      sda_stuck;        // SDA reads low at boot
+  double    hm_garble_rate;   // bytes corrupted by the HM-10 per byte
+  SIM_AT_FAULT at_faults[SIM_AT_FAULTS];
+  uint32_t  at_fault_count;
+  uint32_t  light_period_ms;  // dark and light halves of the Si1133 profile
+  SIM_EM_COST em_costs[4];    // physical energy modes
+  double    em0_uw_per_mhz;   // EM0 power scales with the core clock
+  bool      count_insns;      // DWT_CYCCNT counts firmware instructions instead of cycles
+} SIM_OPTS;
+
+typedef struct {
+  uint64_t  em_ns[4];
+  double    em_nj[4];
+  double    switch_nj;
+  uint32_t  wakes[4];
+  uint32_t  irqs[SIM_IRQ_COUNT];
+  uint32_t  hf_in_sleep;      // HF domain events while the HF clocks are stopped
+  uint32_t  lf_in_em3;        // LFXO domain events in EM3
+  uint32_t  no_clock;         // register accesses with the peripheral clock off
+  uint32_t  asserts;
+  uint32_t  polls;            // time skipped for a polling loop
+  uint64_t  cycles;           // EM0 core cycles
+  uint64_t  insns;            // firmware instructions executed, with count_insns
+} SIM_STATS;
+
+extern uint64_t sim_now;
+extern SIM_OPTS sim_opts;
+extern SIM_STATS sim_stats;
+extern int sim_em;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+/* sim_core.c */
+void sim_event_init(SIM_EVENT *ev, const char *name, SIM_DOMAIN domain, void (*fire)(SIM_EVENT *ev), void *ctx);
+void sim_event_at(SIM_EVENT *ev, uint64_t at);
+void sim_event_in(SIM_EVENT *ev, uint64_t delay);
+void sim_event_cancel(SIM_EVENT *ev);
+void sim_advance(uint64_t delay);
+bool sim_step(void);
+void sim_cycles(uint32_t cycles);
+void sim_progress(void);
+
+void sim_reg_init(SIM_IOREG *reg, const char *name, int clock, uint32_t (*read)(SIM_IOREG *reg),
+                  void (*write)(SIM_IOREG *reg, uint32_t value), void *ctx, uint32_t idle);
+volatile uint32_t *sim_io(SIM_IOREG *reg);
+void sim_call(void);
+
+void sim_irq_level(IRQn_Type irq, bool (*level)(void));
+bool sim_irq_pending(void);
+void sim_dispatch(void);
+
+double sim_rand(void);
+void sim_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void sim_fail(int status, const char *fmt, ...) __attribute__((format(printf, 2, 3), noreturn));
+void sim_core_reset(void);
+void sim_watchdog_start(void);
+void sim_count_start(void);
+void sim_count_resume(void);
+void sim_report_core(FILE *out);
+
+/* sim_main.c */
+void sim_finish(int status) __attribute__((noreturn));
+
+/* sim_misc.c */
+void sim_misc_reset(void);
+bool sim_clock_on(int clock);
+uint32_t sim_hf_hz(void);
+bool sim_pin_out(GPIO_Port_TypeDef port, unsigned int pin);
+void sim_ldma_signal(LDMA_PeripheralSignal_t signal);
+void sim_ldma_pace(bool run);
+void sim_report_misc(FILE *out);
+
+/* sim_gpcrc.c */
+void sim_gpcrc_reset(void);
+
+/* sim_timers.c */
+void sim_timers_reset(void);
+uint64_t sim_timer1_period_ns(void);
+bool sim_timer1_running(void);
+void sim_report_timers(FILE *out);
+
+/* sim_uart.c */
+void sim_uart_reset(void);
+void sim_uart_pin_rx(uint8_t byte, uint32_t baud);
+bool sim_usart_tx_ready(void);
+void sim_usart_tx_dma(uint8_t byte);
+void sim_report_uart(FILE *out);
+
+/* sim_i2c.c */
+typedef struct sim_i2c_dev SIM_I2C_DEV;
+struct sim_i2c_dev {
+  uint8_t   addr;
+  bool      (*start)(SIM_I2C_DEV *dev, bool read);  // address phase, true for ACK
+  bool      (*write)(SIM_I2C_DEV *dev, uint8_t byte);
+  uint8_t   (*read)(SIM_I2C_DEV *dev);
+  void      (*stop)(SIM_I2C_DEV *dev);
+  SIM_I2C_DEV *next;
+};
+void sim_i2c_reset(void);
+void sim_i2c_attach(I2C_TypeDef *i2c, SIM_I2C_DEV *dev);
+void sim_report_i2c(FILE *out);
+
+/* sim_devices.c */
+void sim_devices_reset(void);
+void sim_hm10_rx(uint8_t byte, uint32_t baud);
+void sim_phone_cmd(uint32_t at_ms, const char *text, bool raw);
+void sim_pin_changed(GPIO_Port_TypeDef port, uint32_t pins);
+unsigned int sim_pin_in(GPIO_Port_TypeDef port, unsigned int pin);
+void sim_report_devices(FILE *out);
+
+#endif
@@ -0,0 +1,894 @@
+/**
+ * @file sim_core.c
+ * @brief Event clock, register hooks, NVIC, sleep and energy of the host simulation
+ *Responsible for simulated time, delivering register accesses to the models, running the firmware's IRQ handlers and the EM residency and energy totals.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_POLL_READS      3         // reads of one register in a row that make a polling loop
+#define SIM_POLL_STEP_NS    20000     // time a polling loop skips ahead if no event is sooner
+#define SIM_STORM_LIMIT     10000     // handlers run in one dispatch before it counts as a storm
+#define SIM_WD_PERIOD_US    100       // host time between watchdog checks
+#define SIM_WD_QUIET_TICKS  2         // checks without activity before a RAM spin is assumed
+#define SIM_SPIN_INSNS      1000      // firmware instructions without activity that make a RAM spin
+#define SIM_WARN_MAX        5         // violations printed of each kind, the rest only counted
+#define SIM_TRAP_FLAG       0x100     // EFLAGS.TF, a debug trap after every instruction
+#define SIM_STEP_DEPTH      64        // firmware frames waiting on a model call, while stepping
+#define SIM_IN_FW(pc)       (((uintptr_t)(pc) >= (uintptr_t)sim_fw_text_begin) && ((uintptr_t)(pc) < (uintptr_t)sim_fw_text_end))
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+uint64_t sim_now;
+SIM_OPTS sim_opts;
+SIM_STATS sim_stats;
+int sim_em;
+
+static SIM_EVENT *sim_armed;
+static uint64_t sim_seq;
+static uint64_t sim_cycle_rem;      // ns times HF Hz not yet a whole cycle
+static uint64_t sim_ns_rem;         // cycles times 1e9 not yet a whole ns
+
+static SIM_IOREG *sim_regs;
+static bool sim_flushing;
+static SIM_IOREG *sim_poll_reg;
+static uint32_t sim_poll_count;
+
+static void (*sim_handlers[SIM_IRQ_COUNT])(void);
+static bool (*sim_levels[SIM_IRQ_COUNT])(void);
+static bool sim_nvic_en[SIM_IRQ_COUNT];
+static bool sim_nvic_pend[SIM_IRQ_COUNT];
+static bool sim_masked;
+static bool sim_in_handler;
+static bool sim_exclusive;
+
+static volatile sig_atomic_t sim_busy;  // inside the simulation, the watchdog keeps out
+static volatile uint32_t sim_activity;
+static uint32_t sim_wd_seen;
+static uint32_t sim_wd_quiet;
+static uint32_t sim_spin_insns;         // firmware instructions since the last activity, stepping
+static uint64_t sim_insns_timed;        // firmware instructions whose cycles were spent
+static uint64_t sim_rng;
+static bool sim_step_armed;             // stepping was set by the simulation, the firmware is not entered yet
+static uintptr_t sim_last_pc;           // the firmware instruction stepped last
+
+/* Return addresses into the firmware that sim_step_resume restores, used from its asm */
+__attribute__((used)) static uintptr_t sim_step_stack[SIM_STEP_DEPTH];
+__attribute__((used)) static uint32_t sim_step_depth;
+
+static SIM_IOREG sim_dwt_cyccnt;
+static uint32_t sim_cyccnt_base;
+
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+ITM_Type sim_itm;
+TPI_Type sim_tpi;
+
+/* The firmware's handlers, missing ones stay NULL */
+void LDMA_IRQHandler(void) __attribute__((weak));
+void TIMER0_IRQHandler(void) __attribute__((weak));
+void USART0_RX_IRQHandler(void) __attribute__((weak));
+void USART0_TX_IRQHandler(void) __attribute__((weak));
+void I2C0_IRQHandler(void) __attribute__((weak));
+void TIMER1_IRQHandler(void) __attribute__((weak));
+void LEUART0_IRQHandler(void) __attribute__((weak));
+void LETIMER0_IRQHandler(void) __attribute__((weak));
+void RTCC_IRQHandler(void) __attribute__((weak));
+void I2C1_IRQHandler(void) __attribute__((weak));
+
+/* Bounds of the firmware's code, sim_fw_begin.c and sim_fw_end.c are linked around it */
+void sim_fw_text_begin(void);
+void sim_fw_text_end(void);
+
+/* Returns into the firmware with the trap flag set, see sim_count_trap() */
+void sim_step_resume(void);
+
+#if defined(__x86_64__)
+__asm__(".text\n"
+        "sim_step_resume:\n\t"
+        "sub $8, %rsp\n\t"                       // the slot of the return address
+        "push %rax\n\t"
+        "push %rcx\n\t"
+        "movl sim_step_depth(%rip), %eax\n\t"
+        "decl %eax\n\t"
+        "movl %eax, sim_step_depth(%rip)\n\t"
+        "leaq sim_step_stack(%rip), %rcx\n\t"
+        "movq (%rcx,%rax,8), %rax\n\t"
+        "movq %rax, 16(%rsp)\n\t"
+        "pop %rcx\n\t"
+        "pop %rax\n\t"
+        "pushfq\n\t"
+        "orq $0x100, (%rsp)\n\t"                // SIM_TRAP_FLAG
+        "popfq\n\t"
+        "ret\n");
+#endif
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static double sim_em_uw(int em);
+static void sim_move_to(uint64_t t);
+static void sim_advance_to(uint64_t t);
+static void sim_flush(void);
+static bool sim_irq_active(int irq);
+static void sim_sleep(int em);
+static uint32_t sim_cyccnt_read(SIM_IOREG *reg);
+static void sim_cyccnt_write(SIM_IOREG *reg, uint32_t value);
+static void sim_spin_step(uintptr_t pc);
+static void sim_watchdog(int sig, siginfo_t *info, void *uc);
+static void sim_stepping(void);
+static void sim_count_trap(int sig, siginfo_t *info, void *uc);
+
+SIM_IO_FN(sim_dwt_cyccnt_io, sim_dwt_cyccnt)
+
+/***************************************************************************//**
+ * @brief
+ * Returns the power drawn in an energy mode, EM0 at the current core clock.
+ ******************************************************************************/
+static double sim_em_uw(int em){
+  if(em == SIM_EM0) return sim_opts.em0_uw_per_mhz * (double)sim_hf_hz() / 1e6;
+  return sim_opts.em_costs[em].power_uw;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Moves the clock to t, adding residency, energy and EM0 core cycles on the way.
+ ******************************************************************************/
+static void sim_move_to(uint64_t t){
+  uint64_t dt = t - sim_now;
+
+  if(t <= sim_now) return;
+  sim_stats.em_ns[sim_em] += dt;
+  sim_stats.em_nj[sim_em] += sim_em_uw(sim_em) * (double)dt / 1e6;
+  if(sim_em == SIM_EM0){
+      uint64_t total = dt * sim_hf_hz() + sim_cycle_rem;
+      sim_stats.cycles += total / SIM_NS_PER_S;
+      sim_cycle_rem = total % SIM_NS_PER_S;
+  }
+  sim_now = t;
+  sim_activity++;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Fires every event due up to t in order and leaves the clock at t.
+ *
+ * @details
+ * An event of a clock that is stopped in the current energy mode is fired anyway and
+ * counted, it means the firmware slept while a peripheral still needed its clock.
+ ******************************************************************************/
+static void sim_advance_to(uint64_t t){
+  bool end = t >= sim_opts.end_ns;
+
+  if(end) t = sim_opts.end_ns;
+  while(sim_armed && (sim_armed->at <= t)){
+      SIM_EVENT *ev = sim_armed;
+
+      sim_armed = ev->next;
+      ev->armed = false;
+      sim_move_to(ev->at);
+      if((ev->domain == SIM_DOMAIN_HF) && (sim_em >= SIM_EM2)){
+          if(sim_stats.hf_in_sleep++ < SIM_WARN_MAX) sim_log("%s fired in EM%d, its HF clock is stopped", ev->name, sim_em);
+      }
+      if((ev->domain == SIM_DOMAIN_LFXO) && (sim_em >= SIM_EM3)){
+          if(sim_stats.lf_in_em3++ < SIM_WARN_MAX) sim_log("%s fired in EM3, LFXO is stopped", ev->name);
+      }
+      ev->fire(ev);
+      sim_progress();
+  }
+  sim_move_to(t);
+  if(end) sim_finish(0);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Delivers register writes whose statements have finished to the models.
+ *
+ * @details
+ * The firmware writes a slot after its accessor returned, so a write is seen at the next
+ * access or sync point. Every register is checked rather than a list of the recent ones,
+ * as in "IFC = IF" the slot of IFC is written after the access to IF.
+ ******************************************************************************/
+static void sim_flush(void){
+  if(sim_flushing) return;
+  sim_flushing = true;
+  for(SIM_IOREG *reg = sim_regs; reg; reg = reg->next){
+      uint32_t value = reg->slot;
+
+      if(value == reg->shadow) continue;
+      reg->shadow = value;
+      if(reg->write) reg->write(reg, value);
+      sim_poll_reg = NULL;
+      sim_progress();
+  }
+  sim_flushing = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether an interrupt is enabled and asserted, by its peripheral or pended.
+ ******************************************************************************/
+static bool sim_irq_active(int irq){
+  if(!sim_nvic_en[irq]) return false;
+  return sim_nvic_pend[irq] || (sim_levels[irq] && sim_levels[irq]());
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sleeps in an energy mode until an interrupt is pending, WFI with PRIMASK set.
+ *
+ * @details
+ * Time advances event by event. The wake-up latency of the physical table is spent in
+ * EM0 after the wake-up source fired, the transition energy is added once per sleep.
+ ******************************************************************************/
+static void sim_sleep(int em){
+  sim_busy++;
+  sim_flush();
+  sim_cycles(SIM_CALL_CYCLES);
+  if(!sim_irq_pending()){
+      sim_em = em;
+      sim_stats.wakes[em]++;
+      sim_stats.switch_nj += sim_opts.em_costs[em].switch_nj;
+      while(!sim_irq_pending()){
+          if(!sim_step()) sim_fail(SIM_EXIT_STALL, "EM%d with nothing armed that could wake the core", em);
+      }
+      sim_em = SIM_EM0;
+      sim_advance(sim_opts.em_costs[em].wakeup_us * SIM_NS_PER_US);
+  }
+  sim_busy--;
+}
+
+/***************************************************************************//**
+ * @brief
+ * DWT cycle counter, counts EM0 core cycles or with count_insns firmware instructions.
+ ******************************************************************************/
+static uint32_t sim_cyccnt_read(SIM_IOREG *reg){
+  (void)reg;
+  return (uint32_t)(sim_opts.count_insns ? sim_stats.insns : sim_stats.cycles) - sim_cyccnt_base;
+}
+
+static void sim_cyccnt_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  sim_cyccnt_base = (uint32_t)(sim_opts.count_insns ? sim_stats.insns : sim_stats.cycles) - value;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sets the trap flag, the 128 bytes skipped keep the red zone of the caller.
+ ******************************************************************************/
+static void sim_stepping(void){
+#if defined(__x86_64__)
+  __asm__ volatile("sub $128, %%rsp\n\tpushfq\n\torq %0, (%%rsp)\n\tpopfq\n\tadd $128, %%rsp"
+                   : : "i"(SIM_TRAP_FLAG) : "memory", "cc");
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ * Runs after every instruction while stepping and counts the ones in the firmware's code.
+ *
+ * @details
+ * Only the firmware is stepped. When it calls or jumps out of its code, into a model or
+ * libc, the return address into the firmware is swapped for sim_step_resume and the trap
+ * flag cleared, and when it returns to the simulation the flag is just cleared. So a
+ * handler's count is what its own code executes, without the models or memcpy(). RAM
+ * spins are found here by their instruction count instead of by the watchdog, so the
+ * counts of a run do not depend on the speed of the host.
+ ******************************************************************************/
+static void sim_count_trap(int sig, siginfo_t *info, void *uc){
+#if defined(__x86_64__)
+  greg_t *regs = ((ucontext_t *)uc)->uc_mcontext.gregs;
+  uintptr_t pc = (uintptr_t)regs[REG_RIP];
+  const uint8_t *last = (const uint8_t *)sim_last_pc;
+
+  (void)sig;
+  (void)info;
+  if(SIM_IN_FW(pc)){
+      sim_step_armed = false;
+      sim_last_pc = pc;
+      sim_stats.insns++;
+      if(sim_activity != sim_wd_seen){
+          sim_wd_seen = sim_activity;
+          sim_spin_insns = 0;
+      }else if(++sim_spin_insns >= SIM_SPIN_INSNS){
+          sim_spin_insns = 0;
+          sim_insns_timed = sim_stats.insns;   // the spin waits for the event sim_spin_step() skips to
+          sim_spin_step(pc);
+          sim_last_pc = pc;           // handlers may have run and stepped meanwhile
+      }
+      return;
+  }
+  if(sim_step_armed) return;          // on the way from sim_count_resume() into the firmware
+  regs[REG_EFL] &= ~SIM_TRAP_FLAG;
+  if((last[0] == 0xC3) || (last[0] == 0xC2) || (((last[0] == 0xF3) || (last[0] == 0xF2)) && (last[1] == 0xC3))){
+      return;                         // back in the simulation
+  }
+  {
+    uintptr_t *ret = (uintptr_t *)regs[REG_RSP];
+
+    if(!SIM_IN_FW(*ret)) return;      // a tail call from a handler into the simulation
+    if(sim_step_depth >= SIM_STEP_DEPTH) sim_fail(SIM_EXIT_STALL, "model calls nested too deep");
+    sim_step_stack[sim_step_depth++] = *ret;
+    *ret = (uintptr_t)sim_step_resume;
+  }
+#else
+  (void)sig;
+  (void)info;
+  (void)uc;
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ * Moves time on for a firmware loop that spins on RAM, waiting for an interrupt.
+ *
+ * @details
+ * Only acts when the firmware was stopped in its own code, unmasked and not in a handler,
+ * the state in which an interrupt may run on the target too.
+ ******************************************************************************/
+static void sim_spin_step(uintptr_t pc){
+  if(sim_busy || sim_masked || sim_in_handler) return;
+  if(!SIM_IN_FW(pc)) return;
+
+  sim_busy++;
+  sim_stats.polls++;
+  if(!sim_step()) sim_fail(SIM_EXIT_STALL, "firmware spins on RAM with nothing armed");
+  sim_dispatch();
+  sim_busy--;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Runs from SIGALRM and steps a RAM spin once the simulation saw no activity for a few
+ * periods.
+ ******************************************************************************/
+static void sim_watchdog(int sig, siginfo_t *info, void *uc){
+  uintptr_t pc = 0;
+
+  (void)sig;
+  (void)info;
+  if(sim_activity != sim_wd_seen){
+      sim_wd_seen = sim_activity;
+      sim_wd_quiet = 0;
+      return;
+  }
+  if(++sim_wd_quiet < SIM_WD_QUIET_TICKS) return;
+#if defined(__x86_64__)
+  pc = (uintptr_t)((ucontext_t *)uc)->uc_mcontext.gregs[REG_RIP];
+#elif defined(__aarch64__)
+  pc = (uintptr_t)((ucontext_t *)uc)->uc_mcontext.pc;
+#endif
+  sim_spin_step(pc);
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Sets up an event, not armed.
+ ******************************************************************************/
+void sim_event_init(SIM_EVENT *ev, const char *name, SIM_DOMAIN domain, void (*fire)(SIM_EVENT *ev), void *ctx){
+  memset(ev, 0, sizeof(*ev));
+  ev->name = name;
+  ev->domain = domain;
+  ev->fire = fire;
+  ev->ctx = ctx;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Arms an event for an absolute time, rearming it if it was armed.
+ ******************************************************************************/
+void sim_event_at(SIM_EVENT *ev, uint64_t at){
+  SIM_EVENT **pos = &sim_armed;
+
+  sim_event_cancel(ev);
+  if(at < sim_now) at = sim_now;
+  ev->at = at;
+  ev->seq = sim_seq++;
+  ev->armed = true;
+  while(*pos && ((*pos)->at <= at)) pos = &(*pos)->next;
+  ev->next = *pos;
+  *pos = ev;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Arms an event a delay from now.
+ ******************************************************************************/
+void sim_event_in(SIM_EVENT *ev, uint64_t delay){
+  sim_event_at(ev, sim_now + delay);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Disarms an event, nothing happens if it is not armed.
+ ******************************************************************************/
+void sim_event_cancel(SIM_EVENT *ev){
+  if(!ev->armed) return;
+  for(SIM_EVENT **pos = &sim_armed; *pos; pos = &(*pos)->next){
+      if(*pos == ev){
+          *pos = ev->next;
+          break;
+      }
+  }
+  ev->armed = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Advances time by a delay in the current energy mode, firing the events on the way.
+ ******************************************************************************/
+void sim_advance(uint64_t delay){
+  sim_advance_to(sim_now + delay);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Advances time to the next event and fires it.
+ *
+ * @return
+ * false if no event is armed
+ ******************************************************************************/
+bool sim_step(void){
+  if(!sim_armed) return false;
+  sim_advance_to(sim_armed->at);
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Spends core cycles at the current HF clock.
+ *
+ * @details
+ * With count_insns the firmware instructions stepped since the last call are spent here
+ * too, SIM_INSN_CYCLES each, so the code between two model calls takes longer on a slower
+ * core clock. Without it only the model calls take time.
+ ******************************************************************************/
+void sim_cycles(uint32_t cycles){
+  uint64_t total;
+  uint32_t hz = sim_hf_hz();
+
+  if(sim_opts.count_insns){
+      cycles += (uint32_t)(sim_stats.insns - sim_insns_timed) * SIM_INSN_CYCLES;
+      sim_insns_timed = sim_stats.insns;
+  }
+  total = (uint64_t)cycles * SIM_NS_PER_S + sim_ns_rem;
+
+  sim_ns_rem = total % hz;
+  sim_advance(total / hz);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Notes a change of state, a polling loop that sees one is not skipped ahead.
+ ******************************************************************************/
+void sim_progress(void){
+  sim_poll_count = 0;
+  sim_activity++;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sets up a hooked register and adds it to the ones flushed.
+ ******************************************************************************/
+void sim_reg_init(SIM_IOREG *reg, const char *name, int clock, uint32_t (*read)(SIM_IOREG *reg),
+                  void (*write)(SIM_IOREG *reg, uint32_t value), void *ctx, uint32_t idle){
+  reg->name = name;
+  reg->clock = clock;
+  reg->read = read;
+  reg->write = write;
+  reg->ctx = ctx;
+  reg->idle = idle;
+  reg->slot = idle;
+  reg->shadow = idle;
+  reg->next = sim_regs;
+  sim_regs = reg;
+}
+
+/***************************************************************************//**
+ * @brief
+ * The access behind every hooked register, returns the slot the statement uses.
+ *
+ * @details
+ * Order: earlier writes are delivered, the access costs SIM_IO_CYCLES, an unmasked
+ * interrupt may run, then the slot is loaded with the value a read gets now. Reading the
+ * same register SIM_POLL_READS times in a row with nothing changed in between is taken as
+ * a polling loop and skips to the next event, at most SIM_POLL_STEP_NS ahead so a loop
+ * with an iteration limit still gives up in about the time it would on the target.
+ ******************************************************************************/
+volatile uint32_t *sim_io(SIM_IOREG *reg){
+  sim_busy++;
+  sim_flush();
+  if((reg->clock >= 0) && !sim_clock_on(reg->clock)){
+      if(sim_stats.no_clock++ < SIM_WARN_MAX) sim_log("%s accessed with its clock off", reg->name);
+  }
+  if(reg == sim_poll_reg){
+      if(++sim_poll_count >= SIM_POLL_READS){
+          uint64_t limit = sim_now + SIM_POLL_STEP_NS;
+
+          sim_stats.polls++;
+          sim_advance_to((sim_armed && (sim_armed->at < limit)) ? sim_armed->at : limit);
+          sim_poll_count = 0;
+      }
+  }else{
+      sim_poll_reg = reg;
+      sim_poll_count = 1;
+  }
+  sim_cycles(SIM_IO_CYCLES);
+  sim_dispatch();
+  reg->slot = reg->read ? reg->read(reg) : reg->idle;
+  reg->shadow = reg->slot;
+  sim_activity++;
+  sim_busy--;
+  return &reg->slot;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sync point at the start of an emlib call: earlier writes are delivered and the call
+ * costs SIM_CALL_CYCLES.
+ ******************************************************************************/
+void sim_call(void){
+  sim_busy++;
+  sim_flush();
+  sim_poll_reg = NULL;
+  sim_cycles(SIM_CALL_CYCLES);
+  sim_busy--;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sets the function that returns whether a peripheral asserts its interrupt.
+ ******************************************************************************/
+void sim_irq_level(IRQn_Type irq, bool (*level)(void)){
+  sim_levels[irq] = level;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether any enabled interrupt is asserted.
+ ******************************************************************************/
+bool sim_irq_pending(void){
+  for(int irq = 0; irq < SIM_IRQ_COUNT; irq++){
+      if(sim_irq_active(irq)) return true;
+  }
+  return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Runs the handlers of asserted interrupts while the core is unmasked.
+ *
+ * @details
+ * Handlers do not nest, the lowest interrupt number goes first as with equal priorities
+ * on the NVIC. An interrupt that stays asserted after SIM_STORM_LIMIT handler runs ends
+ * the simulation, a handler that does not clear its flag would hang the target the same
+ * way.
+ ******************************************************************************/
+void sim_dispatch(void){
+  uint32_t runs = 0;
+
+  if(sim_masked || sim_in_handler) return;
+  sim_busy++;
+  sim_flush();
+  while(true){
+      int irq;
+
+      for(irq = 0; irq < SIM_IRQ_COUNT; irq++){
+          if(sim_irq_active(irq)) break;
+      }
+      if(irq == SIM_IRQ_COUNT) break;
+      if(++runs > SIM_STORM_LIMIT) sim_fail(SIM_EXIT_STORM, "interrupt %d is never cleared", irq);
+      sim_nvic_pend[irq] = false;
+      sim_exclusive = false;
+      sim_stats.irqs[irq]++;
+      if(!sim_handlers[irq]) sim_fail(SIM_EXIT_STORM, "interrupt %d has no handler", irq);
+      sim_in_handler = true;
+      sim_cycles(SIM_IRQ_CYCLES);
+      sim_busy--;
+      sim_count_resume();
+      sim_handlers[irq]();
+      sim_busy++;
+      sim_flush();
+      sim_poll_reg = NULL;
+      sim_in_handler = false;
+      sim_progress();
+  }
+  sim_busy--;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns a uniform random number in [0, 1) from the seeded generator.
+ ******************************************************************************/
+double sim_rand(void){
+  sim_rng ^= sim_rng << 13;
+  sim_rng ^= sim_rng >> 7;
+  sim_rng ^= sim_rng << 17;
+  return (double)(sim_rng >> 11) / (double)(1ULL << 53);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Prints a line to stderr stamped with the simulated time, unless quiet.
+ ******************************************************************************/
+void sim_log(const char *fmt, ...){
+  va_list args;
+
+  if(sim_opts.quiet) return;
+  fprintf(stderr, "[%10.6f] ", (double)sim_now / SIM_NS_PER_S);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Ends the run with a failure status after printing why.
+ ******************************************************************************/
+void sim_fail(int status, const char *fmt, ...){
+  va_list args;
+
+  fprintf(stderr, "[%10.6f] fw_sim: ", (double)sim_now / SIM_NS_PER_S);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+  sim_finish(status);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Puts the core in its power-on state, before the models reset theirs.
+ ******************************************************************************/
+void sim_core_reset(void){
+  sim_now = 0;
+  sim_em = SIM_EM0;
+  sim_armed = NULL;
+  sim_regs = NULL;
+  memset(&sim_stats, 0, sizeof(sim_stats));
+  memset(sim_nvic_en, 0, sizeof(sim_nvic_en));
+  memset(sim_nvic_pend, 0, sizeof(sim_nvic_pend));
+  memset(sim_levels, 0, sizeof(sim_levels));
+  sim_masked = false;
+  sim_in_handler = false;
+  sim_rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)sim_opts.seed << 17) ^ sim_opts.seed;
+  if(!sim_rng) sim_rng = 1;
+
+  sim_handlers[LDMA_IRQn] = LDMA_IRQHandler;
+  sim_handlers[TIMER0_IRQn] = TIMER0_IRQHandler;
+  sim_handlers[USART0_RX_IRQn] = USART0_RX_IRQHandler;
+  sim_handlers[USART0_TX_IRQn] = USART0_TX_IRQHandler;
+  sim_handlers[I2C0_IRQn] = I2C0_IRQHandler;
+  sim_handlers[TIMER1_IRQn] = TIMER1_IRQHandler;
+  sim_handlers[LEUART0_IRQn] = LEUART0_IRQHandler;
+  sim_handlers[LETIMER0_IRQn] = LETIMER0_IRQHandler;
+  sim_handlers[RTCC_IRQn] = RTCC_IRQHandler;
+  sim_handlers[I2C1_IRQn] = I2C1_IRQHandler;
+
+  memset(&sim_dwt, 0, sizeof(sim_dwt));
+  memset(&sim_core_debug, 0, sizeof(sim_core_debug));   // no debugger, swo_open() stays off
+  memset(&sim_itm, 0, sizeof(sim_itm));
+  memset(&sim_tpi, 0, sizeof(sim_tpi));
+  sim_reg_init(&sim_dwt_cyccnt, "DWT_CYCCNT", -1, sim_cyccnt_read, sim_cyccnt_write, NULL, 0);
+  sim_dwt.CYCCNT_io = sim_dwt_cyccnt_io;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts the SIGALRM watchdog that moves time on for RAM spin loops, unless counting
+ * instructions.
+ ******************************************************************************/
+void sim_watchdog_start(void){
+  struct sigaction sa;
+  struct itimerval period;
+
+  if(sim_opts.count_insns) return;     // sim_count_trap() finds the spins
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = sim_watchdog;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGALRM, &sa, NULL);
+  period.it_interval.tv_sec = 0;
+  period.it_interval.tv_usec = SIM_WD_PERIOD_US;
+  period.it_value = period.it_interval;
+  setitimer(ITIMER_REAL, &period, NULL);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts counting the firmware's instructions with the trap flag, x86-64 hosts only.
+ *
+ * @details
+ * Every firmware instruction takes a trap, the models run at full speed. SA_NODEFER lets
+ * a handler that a spin dispatches from the trap be stepped in turn.
+ ******************************************************************************/
+void sim_count_start(void){
+  struct sigaction sa;
+
+#if !defined(__x86_64__)
+  sim_fail(1, "--count-insns needs an x86-64 host");
+#endif
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = sim_count_trap;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTRAP, &sa, NULL);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Steps the firmware again when counting, called right before the simulation calls it.
+ ******************************************************************************/
+void sim_count_resume(void){
+  if(!sim_opts.count_insns) return;
+  sim_step_armed = true;
+  sim_stepping();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the time, energy and interrupt totals as key=value lines.
+ ******************************************************************************/
+void sim_report_core(FILE *out){
+  double total_nj = sim_stats.switch_nj;
+
+  for(int em = 0; em < 4; em++) total_nj += sim_stats.em_nj[em];
+  fprintf(out, "time_s=%.6f\n", (double)sim_now / SIM_NS_PER_S);
+  fprintf(out, "energy_uj=%.3f\n", total_nj / 1000.0);
+  fprintf(out, "avg_uw=%.3f\n", sim_now ? total_nj * 1e6 / (double)sim_now : 0.0);
+  for(int em = 0; em < 4; em++){
+      fprintf(out, "em%d_ms=%.3f\n", em, (double)sim_stats.em_ns[em] / SIM_NS_PER_MS);
+      fprintf(out, "em%d_uj=%.3f\n", em, sim_stats.em_nj[em] / 1000.0);
+      if(em) fprintf(out, "em%d_sleeps=%u\n", em, sim_stats.wakes[em]);
+  }
+  fprintf(out, "switch_uj=%.3f\n", sim_stats.switch_nj / 1000.0);
+  fprintf(out, "cycles=%llu\n", (unsigned long long)sim_stats.cycles);
+  if(sim_opts.count_insns) fprintf(out, "insns=%llu\n", (unsigned long long)sim_stats.insns);
+  for(int irq = 0; irq < SIM_IRQ_COUNT; irq++){
+      if(sim_stats.irqs[irq]) fprintf(out, "irq%d=%u\n", irq, sim_stats.irqs[irq]);
+  }
+  fprintf(out, "polls=%u\n", sim_stats.polls);
+  fprintf(out, "hf_in_sleep=%u\n", sim_stats.hf_in_sleep);
+  fprintf(out, "lf_in_em3=%u\n", sim_stats.lf_in_em3);
+  fprintf(out, "no_clock=%u\n", sim_stats.no_clock);
+}
+
+//***********************************************************************************
+// CMSIS and emlib core
+//***********************************************************************************
+
+void NVIC_EnableIRQ(IRQn_Type irq){
+  sim_call();
+  sim_nvic_en[irq] = true;
+  sim_dispatch();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq){
+  sim_call();
+  sim_nvic_en[irq] = false;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq){
+  sim_call();
+  sim_nvic_pend[irq] = false;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq){
+  sim_call();
+  sim_nvic_pend[irq] = true;
+  sim_dispatch();
+}
+
+CORE_irqState_t CORE_EnterCritical(void){
+  CORE_irqState_t state = sim_masked;
+
+  sim_masked = true;
+  return state;
+}
+
+void CORE_ExitCritical(CORE_irqState_t irqState){
+  sim_masked = irqState;
+  if(!sim_masked) sim_dispatch();
+}
+
+CORE_irqState_t CORE_EnterAtomic(void){
+  return CORE_EnterCritical();
+}
+
+void CORE_ExitAtomic(CORE_irqState_t irqState){
+  CORE_ExitCritical(irqState);
+}
+
+bool CORE_InIrqContext(void){
+  return sim_in_handler;
+}
+
+void assertEFM(const char *file, int line){
+  sim_stats.asserts++;
+  sim_fail(SIM_EXIT_ASSERT, "EFM_ASSERT failed at %s:%d", file, line);
+}
+
+void CHIP_Init(void){
+  sim_call();
+}
+
+bool EMU_DCDCInit(const EMU_DCDCInit_TypeDef *dcdcInit){
+  (void)dcdcInit;
+  sim_call();
+  return true;
+}
+
+void EMU_EM23Init(const EMU_EM23Init_TypeDef *em23Init){
+  (void)em23Init;
+  sim_call();
+}
+
+void EMU_VScaleEM01(EMU_VScaleEM01_TypeDef voltage, bool wait){
+  (void)voltage;
+  (void)wait;
+  sim_call();
+}
+
+void EMU_EnterEM1(void){
+  sim_sleep(SIM_EM1);
+}
+
+void EMU_EnterEM2(bool restore){
+  (void)restore;
+  sim_sleep(SIM_EM2);
+}
+
+void EMU_EnterEM3(bool restore){
+  (void)restore;
+  sim_sleep(SIM_EM3);
+}
+
+void __NOP(void){
+}
+
+void __DSB(void){
+}
+
+void __ISB(void){
+}
+
+void __WFI(void){
+  sim_sleep(SIM_EM1);
+}
+
+uint32_t __LDREXW(volatile uint32_t *addr){
+  sim_exclusive = true;
+  return *addr;
+}
+
+uint32_t __STREXW(uint32_t value, volatile uint32_t *addr){
+  if(!sim_exclusive) return 1;
+  sim_exclusive = false;
+  *addr = value;
+  return 0;
+}
+
+void __CLREX(void){
+  sim_exclusive = false;
+}
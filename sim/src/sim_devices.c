@@ -0,0 +1,784 @@
+/**
+ * @file sim_devices.c
+ * @brief Models of the parts around the MCU in the host simulation
+ *Responsible for the Si1133 and Si7021 on I2C1, the sensor power and I2C pins, the HM-10 module on the LEUART0/USART0 pins and the phone connected to it.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_SENSOR_EN_PORT  gpioPortF
+#define SIM_SENSOR_EN_PIN   9
+#define SIM_SCL_PORT        gpioPortC
+#define SIM_SCL_PIN         5
+#define SIM_SDA_PORT        gpioPortC
+#define SIM_SDA_PIN         4
+#define SIM_RED_PORT        gpioPortD // RGB_RED_PIN, the firmware's error light
+#define SIM_RED_PIN         11
+#define SIM_SDA_STUCK_EDGES 5         // SCL falling edges before a stuck slave lets SDA go
+
+#define SIM_SI1133_ADDR     0x55
+#define SIM_SI1133_BOOT_NS  (20 * SIM_NS_PER_MS)
+#define SIM_SI1133_CONV_NS  (2 * SIM_NS_PER_MS)
+#define SIM_SI1133_DARK     20
+#define SIM_SI1133_LIGHT    200
+#define SIM_SI1133_REGS     0x30
+
+#define SIM_SI7021_ADDR     0x40
+#define SIM_SI7021_BOOT_NS  (50 * SIM_NS_PER_MS)
+#define SIM_SI7021_RESET_NS (10 * SIM_NS_PER_MS)
+#define SIM_SI7021_CONV_NS  (20 * SIM_NS_PER_MS)
+#define SIM_SI7021_RH_X10   450       // 45.0 %RH
+#define SIM_SI7021_T_X100   2250      // 22.50 C
+
+#define SIM_HM10_BAUD       9600
+#define SIM_HM10_GAP_NS     (5 * SIM_NS_PER_MS)   // silence that ends an AT command
+#define SIM_HM10_RESET_NS   (500 * SIM_NS_PER_MS) // deaf after AT+RESET
+#define SIM_HM10_BUF        1024
+#define SIM_HM10_LINE       128
+
+#define SIM_PHONE_CMDS      64
+#define SIM_PHONE_FRAME     256
+
+#define SIM_CRC16_POLY_REV  0x8408
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef struct {
+  SIM_I2C_DEV dev;
+  bool        wrote_reg;    // first byte of a write, the register pointer, is in
+  uint8_t     ptr;
+  uint8_t     regs[SIM_SI1133_REGS];
+  uint8_t     params[0x40];
+  uint8_t     counter;
+  uint64_t    conv_at;      // end of the FORCE conversion
+  uint32_t    forces;
+} SIM_SI1133;
+
+typedef struct {
+  SIM_I2C_DEV dev;
+  uint8_t     out[3];       // result of the last command, MSB, LSB, CRC-8
+  uint8_t     out_len, out_pos;
+  uint64_t    busy_until;
+  uint32_t    measures;
+  uint32_t    busy_nacks;
+} SIM_SI7021;
+
+typedef struct {
+  bool      online;
+  uint32_t  baud;
+  uint32_t  baud_next;      // taken over at the next AT+RESET
+  char      line[SIM_HM10_LINE];
+  uint32_t  line_len;
+  uint8_t   tx[SIM_HM10_BUF]; // bytes on their way to the MCU
+  uint32_t  tx_head, tx_count;
+  SIM_EVENT gap, tx_byte, boot, late;
+  char      late_reply[SIM_HM10_LINE + 16]; // reply held back by a delay fault
+  uint32_t  late_len;
+  uint32_t  at_cmds, at_replies, at_faults, resets, garbled, overflows, dropped;
+} SIM_HM10;
+
+typedef struct {
+  uint32_t  at_ms;
+  bool      raw;
+  char      text[SIM_PHONE_FRAME];
+  SIM_EVENT send;
+} SIM_PHONE_CMD;
+
+typedef struct {
+  bool          connected;
+  bool          synced;       // a gap was seen since connecting, frames start at the next byte
+  bool          text_end;     // the frame has its check, a line end may follow
+  SIM_EVENT     connect;
+  SIM_PHONE_CMD cmds[SIM_PHONE_CMDS];
+  uint32_t      cmd_count;
+  uint8_t       frame[SIM_PHONE_FRAME];
+  uint32_t      frame_len;
+  uint32_t      text_ok, text_bad, bin_ok, bin_bad, cut, sent;
+} SIM_PHONE;
+
+static bool sim_sensor_power;
+static uint64_t sim_sensor_power_at;
+static uint32_t sim_scl_falls;
+static uint32_t sim_red_on;
+static SIM_SI1133 sim_si1133;
+static SIM_SI7021 sim_si7021;
+static SIM_HM10 sim_hm10;
+static SIM_PHONE sim_phone;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint16_t sim_crc16(const void *data, uint32_t length);
+static bool sim_sensor_up(uint64_t boot_ns);
+static bool sim_si1133_start(SIM_I2C_DEV *dev, bool read);
+static bool sim_si1133_write(SIM_I2C_DEV *dev, uint8_t byte);
+static uint8_t sim_si1133_read(SIM_I2C_DEV *dev);
+static void sim_si1133_stop(SIM_I2C_DEV *dev);
+static void sim_si1133_command(SIM_SI1133 *si, uint8_t cmd);
+static bool sim_si7021_start(SIM_I2C_DEV *dev, bool read);
+static bool sim_si7021_write(SIM_I2C_DEV *dev, uint8_t byte);
+static uint8_t sim_si7021_read(SIM_I2C_DEV *dev);
+static void sim_si7021_stop(SIM_I2C_DEV *dev);
+static void sim_si7021_word(SIM_SI7021 *si, uint16_t code);
+static void sim_hm10_send(const void *data, uint32_t length, bool from_phone);
+static void sim_hm10_tx_byte(SIM_EVENT *ev);
+static void sim_hm10_gap(SIM_EVENT *ev);
+static void sim_hm10_forward(void);
+static void sim_hm10_boot(SIM_EVENT *ev);
+static void sim_hm10_late(SIM_EVENT *ev);
+static void sim_hm10_reply(const char *reply, uint32_t length);
+static bool sim_hm10_at(const char *line, uint32_t length);
+static void sim_phone_connect(SIM_EVENT *ev);
+static void sim_phone_send(SIM_EVENT *ev);
+static void sim_phone_rx(const uint8_t *data, uint32_t length);
+static uint32_t sim_phone_frame_len(const uint8_t *frame, uint32_t length);
+static void sim_phone_idle(void);
+static bool sim_phone_text_checked(const uint8_t *frame, uint32_t length);
+static void sim_phone_frame(const uint8_t *frame, uint32_t length, bool binary);
+
+/***************************************************************************//**
+ * @brief
+ * CRC-16/X-25 as crc16() of crc.c computes it, the phone's side of the check.
+ ******************************************************************************/
+static uint16_t sim_crc16(const void *data, uint32_t length){
+  const uint8_t *bytes = data;
+  uint16_t crc = 0xFFFF;
+
+  while(length--){
+      crc ^= *bytes++;
+      for(int i = 0; i < 8; i++) crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ SIM_CRC16_POLY_REV) : (uint16_t)(crc >> 1);
+  }
+  return (uint16_t)~crc;
+}
+
+/***************************************************************************//**
+ * @brief
+ * True once the sensor supply has been on for the part's power up time.
+ ******************************************************************************/
+static bool sim_sensor_up(uint64_t boot_ns){
+  return sim_sensor_power && (sim_now >= sim_sensor_power_at + boot_ns);
+}
+
+//***********************************************************************************
+// Si1133
+//***********************************************************************************
+
+static bool sim_si1133_start(SIM_I2C_DEV *dev, bool read){
+  SIM_SI1133 *si = (SIM_SI1133 *)dev;
+
+  if(!sim_sensor_up(SIM_SI1133_BOOT_NS)) return false;
+  if(!read) si->wrote_reg = false;
+  return true;
+}
+
+static bool sim_si1133_write(SIM_I2C_DEV *dev, uint8_t byte){
+  SIM_SI1133 *si = (SIM_SI1133 *)dev;
+
+  if(!si->wrote_reg){
+      si->wrote_reg = true;
+      si->ptr = byte % SIM_SI1133_REGS;
+      return true;
+  }
+  si->regs[si->ptr] = byte;
+  if(si->ptr == 0x0B) sim_si1133_command(si, byte);
+  si->ptr = (si->ptr + 1) % SIM_SI1133_REGS;
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Register read, HOSTOUT0/1 hold the white channel once the forced conversion ended.
+ *
+ * @details
+ * The light level follows sim_opts.light_period_ms, dark for the first half of each
+ * period and bright for the second, so the LED threshold of the app is crossed both ways.
+ ******************************************************************************/
+static uint8_t sim_si1133_read(SIM_I2C_DEV *dev){
+  SIM_SI1133 *si = (SIM_SI1133 *)dev;
+  uint8_t value;
+
+  if(si->conv_at && (sim_now >= si->conv_at)){
+      uint32_t light = SIM_SI1133_LIGHT;
+
+      if(sim_opts.light_period_ms){
+          uint64_t phase = (si->conv_at / SIM_NS_PER_MS) % sim_opts.light_period_ms;
+          light = (phase < sim_opts.light_period_ms / 2) ? SIM_SI1133_DARK : SIM_SI1133_LIGHT;
+      }
+      si->regs[0x13] = (uint8_t)(light >> 8);
+      si->regs[0x14] = (uint8_t)light;
+      si->conv_at = 0;
+  }
+  value = si->regs[si->ptr];
+  si->ptr = (si->ptr + 1) % SIM_SI1133_REGS;
+  return value;
+}
+
+static void sim_si1133_stop(SIM_I2C_DEV *dev){
+  ((SIM_SI1133 *)dev)->wrote_reg = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * COMMAND register: counter reset, parameter set and query, FORCE.
+ ******************************************************************************/
+static void sim_si1133_command(SIM_SI1133 *si, uint8_t cmd){
+  if(cmd == 0x00){
+      si->counter = 0;
+  }else if((cmd & 0xC0) == 0x80){
+      si->params[cmd & 0x3F] = si->regs[0x0A];
+      si->regs[0x10] = si->regs[0x0A];
+      si->counter = (si->counter + 1) & 0x0F;
+  }else if((cmd & 0xC0) == 0x40){
+      si->regs[0x10] = si->params[cmd & 0x3F];
+      si->counter = (si->counter + 1) & 0x0F;
+  }else if(cmd == 0x11){
+      si->conv_at = sim_now + SIM_SI1133_CONV_NS;
+      si->forces++;
+      si->counter = (si->counter + 1) & 0x0F;
+  }
+  si->regs[0x11] = (si->regs[0x11] & 0xF0) | si->counter;
+}
+
+//***********************************************************************************
+// Si7021
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Address phase, NACKed while the part boots, resets or converts. A read starts at the
+ * first byte of the last result.
+ ******************************************************************************/
+static bool sim_si7021_start(SIM_I2C_DEV *dev, bool read){
+  SIM_SI7021 *si = (SIM_SI7021 *)dev;
+
+  if(!sim_sensor_up(SIM_SI7021_BOOT_NS)) return false;
+  if(sim_now < si->busy_until){
+      si->busy_nacks++;
+      return false;
+  }
+  si->out_pos = 0;
+  return true;
+}
+
+static bool sim_si7021_write(SIM_I2C_DEV *dev, uint8_t byte){
+  SIM_SI7021 *si = (SIM_SI7021 *)dev;
+
+  if(byte == 0xFE){
+      si->busy_until = sim_now + SIM_SI7021_RESET_NS;
+      si->out_len = 0;
+  }else if(byte == 0xF5){
+      si->busy_until = sim_now + SIM_SI7021_CONV_NS;
+      si->measures++;
+      sim_si7021_word(si, (uint16_t)((((int32_t)SIM_SI7021_RH_X10 + 60) * 65536) / 1250));
+  }else if(byte == 0xE0){
+      sim_si7021_word(si, (uint16_t)((((int32_t)SIM_SI7021_T_X100 + 4685) * 65536) / 17572));
+  }
+  return true;
+}
+
+static uint8_t sim_si7021_read(SIM_I2C_DEV *dev){
+  SIM_SI7021 *si = (SIM_SI7021 *)dev;
+
+  if(si->out_pos >= si->out_len) return 0xFF;
+  return si->out[si->out_pos++];
+}
+
+static void sim_si7021_stop(SIM_I2C_DEV *dev){
+  (void)dev;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Loads a result, MSB first with the status bits clear, then its CRC-8 byte.
+ ******************************************************************************/
+static void sim_si7021_word(SIM_SI7021 *si, uint16_t code){
+  uint8_t crc = 0;
+
+  code &= 0xFFFC;
+  si->out[0] = (uint8_t)(code >> 8);
+  si->out[1] = (uint8_t)code;
+  for(int i = 0; i < 2; i++){
+      crc ^= si->out[i];
+      for(int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+  }
+  si->out[2] = crc;
+  si->out_len = 3;
+}
+
+//***********************************************************************************
+// HM-10
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Queues bytes for the MCU's RX pin, phone data may be corrupted on the way.
+ ******************************************************************************/
+static void sim_hm10_send(const void *data, uint32_t length, bool from_phone){
+  const uint8_t *bytes = data;
+
+  for(uint32_t i = 0; i < length; i++){
+      uint8_t byte = bytes[i];
+
+      if(sim_hm10.tx_count == SIM_HM10_BUF){
+          sim_hm10.overflows++;
+          return;
+      }
+      if(from_phone && (sim_rand() < sim_opts.hm_garble_rate)){
+          byte ^= (uint8_t)(1U << (uint32_t)(sim_rand() * 8));
+          sim_hm10.garbled++;
+      }
+      sim_hm10.tx[(sim_hm10.tx_head + sim_hm10.tx_count++) % SIM_HM10_BUF] = byte;
+  }
+  if(!sim_hm10.tx_byte.armed && sim_hm10.tx_count){
+      sim_event_in(&sim_hm10.tx_byte, (10 * SIM_NS_PER_S) / sim_hm10.baud);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * A byte has been shifted out to the MCU at the module's current rate.
+ ******************************************************************************/
+static void sim_hm10_tx_byte(SIM_EVENT *ev){
+  uint8_t byte = sim_hm10.tx[sim_hm10.tx_head];
+
+  (void)ev;
+  sim_hm10.tx_head = (sim_hm10.tx_head + 1) % SIM_HM10_BUF;
+  sim_hm10.tx_count--;
+  sim_uart_pin_rx(byte, sim_hm10.baud);
+  if(sim_hm10.tx_count) sim_event_in(&sim_hm10.tx_byte, (10 * SIM_NS_PER_S) / sim_hm10.baud);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Silence on the RX line: a buffered AT command is run, anything else goes to the phone.
+ ******************************************************************************/
+static void sim_hm10_gap(SIM_EVENT *ev){
+  (void)ev;
+  if(sim_hm10.line_len >= 2 && !memcmp(sim_hm10.line, "AT", 2)){
+      sim_hm10_at(sim_hm10.line, sim_hm10.line_len);
+      sim_hm10.line_len = 0;
+  }else{
+      sim_hm10_forward();
+  }
+  sim_phone_idle();
+  sim_phone.synced = sim_phone.connected;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Passes the buffered bytes on to the phone. A phone that just connected joins in the
+ * middle of a frame, it drops what comes before the first gap.
+ ******************************************************************************/
+static void sim_hm10_forward(void){
+  if(sim_phone.synced){
+      sim_phone_rx((const uint8_t *)sim_hm10.line, sim_hm10.line_len);
+  }else{
+      sim_hm10.dropped += sim_hm10.line_len;
+  }
+  sim_hm10.line_len = 0;
+}
+
+static void sim_hm10_boot(SIM_EVENT *ev){
+  (void)ev;
+  sim_hm10.online = true;
+  sim_hm10.baud = sim_hm10.baud_next;
+}
+
+static void sim_hm10_late(SIM_EVENT *ev){
+  (void)ev;
+  sim_hm10_send(sim_hm10.late_reply, sim_hm10.late_len, false);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends the reply of an AT command, unless --at-fault has the module drop, delay or
+ * corrupt it.
+ *
+ * @details
+ * A delayed reply that is still pending when the next one is delayed is sent at once.
+ ******************************************************************************/
+static void sim_hm10_reply(const char *reply, uint32_t length){
+  char bytes[SIM_HM10_LINE + 16];
+
+  sim_hm10.at_replies++;
+  memcpy(bytes, reply, length);
+  for(uint32_t i = 0; i < sim_opts.at_fault_count; i++){
+      const SIM_AT_FAULT *fault = &sim_opts.at_faults[i];
+
+      if(fault->reply != sim_hm10.at_replies) continue;
+      sim_hm10.at_faults++;
+      sim_log("HM-10 AT reply %u %s", sim_hm10.at_replies,
+              (fault->kind == SIM_AT_DROP) ? "dropped" : (fault->kind == SIM_AT_DELAY) ? "delayed" : "garbled");
+      switch(fault->kind){
+        case SIM_AT_DROP:
+          return;
+        case SIM_AT_DELAY:
+          if(sim_hm10.late.armed){
+              sim_event_cancel(&sim_hm10.late);
+              sim_hm10_late(&sim_hm10.late);
+          }
+          memcpy(sim_hm10.late_reply, bytes, length);
+          sim_hm10.late_len = length;
+          sim_event_in(&sim_hm10.late, (uint64_t)fault->delay_ms * SIM_NS_PER_MS);
+          return;
+        case SIM_AT_GARBLE:
+          bytes[0] ^= 0x20;
+          break;
+      }
+  }
+  sim_hm10_send(bytes, length, false);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Runs the AT commands the firmware uses and answers as the HM-10 does, without a line end.
+ *
+ * @details
+ * The real module only takes commands while no central is connected. Here they are
+ * taken at any time, so the link switch asked for by the phone can be exercised.
+ ******************************************************************************/
+static bool sim_hm10_at(const char *line, uint32_t length){
+  static const uint32_t bauds[] = { 9600, 19200, 38400, 57600, 115200 };
+  char cmd[SIM_HM10_LINE + 1];
+  char reply[SIM_HM10_LINE + 16];
+
+  memcpy(cmd, line, length);
+  cmd[length] = 0;
+  sim_hm10.at_cmds++;
+  if(!strcmp(cmd, "AT")){
+      strcpy(reply, "OK");
+  }else if(!strncmp(cmd, "AT+NAME", 7)){
+      snprintf(reply, sizeof(reply), "OK+Set:%s", &cmd[7]);
+  }else if(!strncmp(cmd, "AT+BAUD", 7) && (cmd[7] >= '0') && (cmd[7] <= '4') && !cmd[8]){
+      sim_hm10.baud_next = bauds[cmd[7] - '0'];
+      snprintf(reply, sizeof(reply), "OK+Set:%c", cmd[7]);
+  }else if(!strcmp(cmd, "AT+RESET")){
+      sim_hm10_reply("OK+RESET", 8);
+      sim_hm10.resets++;
+      sim_hm10.online = false;
+      sim_event_in(&sim_hm10.boot, SIM_HM10_RESET_NS);
+      return true;
+  }else{
+      return false;
+  }
+  sim_hm10_reply(reply, (uint32_t)strlen(reply));
+  return true;
+}
+
+//***********************************************************************************
+// phone
+//***********************************************************************************
+
+static void sim_phone_connect(SIM_EVENT *ev){
+  (void)ev;
+  sim_phone.connected = true;
+  sim_log("phone connected");
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends a command as the phone app does, "#<body>*<CRC>!" unless it is raw.
+ ******************************************************************************/
+static void sim_phone_send(SIM_EVENT *ev){
+  SIM_PHONE_CMD *cmd = ev->ctx;
+  char frame[SIM_PHONE_FRAME + 8];
+  uint32_t length;
+
+  if(!sim_phone.connected){
+      sim_event_at(ev, sim_phone.connect.at + SIM_NS_PER_MS);
+      return;
+  }
+  if(cmd->raw){
+      length = (uint32_t)snprintf(frame, sizeof(frame), "%s", cmd->text);
+  }else{
+      length = (uint32_t)snprintf(frame, sizeof(frame), "#%s*%04X!", cmd->text,
+                                  sim_crc16(cmd->text, (uint32_t)strlen(cmd->text)));
+  }
+  if(sim_opts.phone_log) fprintf(sim_opts.phone_log, "%llu.%03llu > %s\n",
+                                 (unsigned long long)(sim_now / SIM_NS_PER_S),
+                                 (unsigned long long)((sim_now / SIM_NS_PER_MS) % 1000), frame);
+  sim_phone.sent++;
+  sim_hm10_send(frame, length, true);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Splits what the module forwards into the firmware's frames.
+ *
+ * @details
+ * A text frame ends with its "*HHHH" check, followed by a line end only when the string
+ * given to ble_write() had one, so the frame is closed by the byte after the check.
+ ******************************************************************************/
+static void sim_phone_rx(const uint8_t *data, uint32_t length){
+  if(sim_opts.capture) fwrite(data, 1, length, sim_opts.capture);
+  while(length--){
+      uint8_t byte = *data++;
+      uint32_t need;
+
+      if(sim_phone.text_end){
+          sim_phone.text_end = false;
+          if(byte == '\n'){
+              sim_phone.frame[sim_phone.frame_len++] = byte;
+              sim_phone_frame(sim_phone.frame, sim_phone.frame_len, false);
+              sim_phone.frame_len = 0;
+              continue;
+          }
+          sim_phone_frame(sim_phone.frame, sim_phone.frame_len, false);
+          sim_phone.frame_len = 0;
+      }
+      if(sim_phone.frame_len == SIM_PHONE_FRAME - 1){
+          sim_phone_frame(sim_phone.frame, sim_phone.frame_len, false);
+          sim_phone.frame_len = 0;
+      }
+      sim_phone.frame[sim_phone.frame_len++] = byte;
+      need = sim_phone_frame_len(sim_phone.frame, sim_phone.frame_len);
+      if(need){
+          if(sim_phone.frame_len == need){
+              sim_phone_frame(sim_phone.frame, sim_phone.frame_len, true);
+              sim_phone.frame_len = 0;
+          }
+      }else if(sim_phone_text_checked(sim_phone.frame, sim_phone.frame_len)){
+          sim_phone.text_end = true;
+      }else if(byte == '\n'){
+          sim_phone_frame(sim_phone.frame, sim_phone.frame_len, false);
+          sim_phone.frame_len = 0;
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * The line went quiet: a text frame with its check and no line end is complete, any
+ * other frame was cut short.
+ ******************************************************************************/
+static void sim_phone_idle(void){
+  if(sim_phone.text_end){
+      sim_phone.text_end = false;
+      sim_phone_frame(sim_phone.frame, sim_phone.frame_len, false);
+  }else if(sim_phone.frame_len){
+      sim_phone.cut++;
+      if(sim_opts.phone_log){
+          fprintf(sim_opts.phone_log, "%llu.%03llu < cut after %u bytes\n", (unsigned long long)(sim_now / SIM_NS_PER_S),
+                  (unsigned long long)((sim_now / SIM_NS_PER_MS) % 1000), sim_phone.frame_len);
+      }
+  }
+  sim_phone.frame_len = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ * True when a text frame ends in '*' and four hex digits.
+ ******************************************************************************/
+static bool sim_phone_text_checked(const uint8_t *frame, uint32_t length){
+  if((length < 5) || (frame[length - 5] != '*')) return false;
+  for(uint32_t i = length - 4; i < length; i++){
+      if(!isxdigit(frame[i])) return false;
+  }
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Length of a binary frame with its CRC, from its header, or 0 for a text line.
+ *
+ * @details
+ * 'G' log frames, 'Y' replay frames and 'Z' sample frames give their payload length in
+ * the header, 'X' trace frames a record count, 0 for the meta frame. Text lines starting
+ * with one of these letters have a space second.
+ ******************************************************************************/
+static uint32_t sim_phone_frame_len(const uint8_t *frame, uint32_t length){
+  if(length < 2 || frame[1] == ' ') return 0;
+  switch(frame[0]){
+    case 'G':
+      return 7 + frame[1] + 2;
+    case 'X':
+      return 2 + (frame[1] ? 8U * frame[1] : 16U) + 2;
+    case 'Y':
+    case 'Z':
+      return (length < 3) ? SIM_PHONE_FRAME : 3U + frame[2] + 2;
+    default:
+      return 0;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Checks the CRC of a received frame, text "<body>*HHHH" or binary with the CRC LSB first.
+ ******************************************************************************/
+static void sim_phone_frame(const uint8_t *frame, uint32_t length, bool binary){
+  bool ok;
+
+  if(binary){
+      ok = sim_crc16(frame, length - 2) == (uint16_t)(frame[length - 2] | (frame[length - 1] << 8));
+      if(ok) sim_phone.bin_ok++; else sim_phone.bin_bad++;
+      if(sim_opts.phone_log){
+          fprintf(sim_opts.phone_log, "%llu.%03llu < %c[%u]%s\n", (unsigned long long)(sim_now / SIM_NS_PER_S),
+                  (unsigned long long)((sim_now / SIM_NS_PER_MS) % 1000), frame[0], length, ok ? "" : " CRC");
+      }
+      return;
+  }
+  if(frame[length - 1] == '\n') length--;
+  ok = sim_phone_text_checked(frame, length);
+  if(ok){
+      char hex[5];
+
+      memcpy(hex, &frame[length - 4], 4);
+      hex[4] = 0;
+      ok = strtoul(hex, NULL, 16) == sim_crc16(frame, length - 5);
+  }
+  if(ok) sim_phone.text_ok++; else sim_phone.text_bad++;
+  if(sim_opts.phone_log){
+      fprintf(sim_opts.phone_log, "%llu.%03llu < %.*s%s\n", (unsigned long long)(sim_now / SIM_NS_PER_S),
+              (unsigned long long)((sim_now / SIM_NS_PER_MS) % 1000),
+              (int)length, (const char *)frame, ok ? "" : " CRC");
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Powers the parts down, attaches the sensors to I2C1 and arms the phone connection.
+ ******************************************************************************/
+void sim_devices_reset(void){
+  SIM_PHONE_CMD cmds[SIM_PHONE_CMDS];
+  uint32_t cmd_count = sim_phone.cmd_count;
+
+  memcpy(cmds, sim_phone.cmds, sizeof(cmds));
+  sim_sensor_power = false;
+  sim_scl_falls = 0;
+  sim_red_on = 0;
+  memset(&sim_si1133, 0, sizeof(sim_si1133));
+  sim_si1133.dev = (SIM_I2C_DEV){ SIM_SI1133_ADDR, sim_si1133_start, sim_si1133_write, sim_si1133_read, sim_si1133_stop, NULL };
+  sim_si1133.regs[0x00] = 0x33;
+  memset(&sim_si7021, 0, sizeof(sim_si7021));
+  sim_si7021.dev = (SIM_I2C_DEV){ SIM_SI7021_ADDR, sim_si7021_start, sim_si7021_write, sim_si7021_read, sim_si7021_stop, NULL };
+  sim_i2c_attach(I2C1, &sim_si1133.dev);
+  sim_i2c_attach(I2C1, &sim_si7021.dev);
+
+  memset(&sim_hm10, 0, sizeof(sim_hm10));
+  sim_hm10.online = true;
+  sim_hm10.baud = SIM_HM10_BAUD;
+  sim_hm10.baud_next = SIM_HM10_BAUD;
+  sim_event_init(&sim_hm10.gap, "HM10_GAP", SIM_DOMAIN_EXT, sim_hm10_gap, NULL);
+  sim_event_init(&sim_hm10.tx_byte, "HM10_TX", SIM_DOMAIN_EXT, sim_hm10_tx_byte, NULL);
+  sim_event_init(&sim_hm10.boot, "HM10_BOOT", SIM_DOMAIN_EXT, sim_hm10_boot, NULL);
+  sim_event_init(&sim_hm10.late, "HM10_LATE", SIM_DOMAIN_EXT, sim_hm10_late, NULL);
+
+  memset(&sim_phone, 0, sizeof(sim_phone));
+  sim_event_init(&sim_phone.connect, "PHONE", SIM_DOMAIN_EXT, sim_phone_connect, NULL);
+  if(sim_opts.phone) sim_event_at(&sim_phone.connect, (uint64_t)sim_opts.phone_ms * SIM_NS_PER_MS);
+  for(uint32_t i = 0; i < cmd_count; i++){
+      SIM_PHONE_CMD *cmd = &sim_phone.cmds[i];
+
+      *cmd = cmds[i];
+      sim_event_init(&cmd->send, "PHONE_CMD", SIM_DOMAIN_EXT, sim_phone_send, cmd);
+      // without a phone nothing ever connects to send them
+      if(sim_opts.phone) sim_event_at(&cmd->send, (uint64_t)cmd->at_ms * SIM_NS_PER_MS);
+  }
+  sim_phone.cmd_count = cmd_count;
+}
+
+/***************************************************************************//**
+ * @brief
+ * A byte from the MCU's TX pin reaches the module; a rate other than its own garbles it.
+ ******************************************************************************/
+void sim_hm10_rx(uint8_t byte, uint32_t baud){
+  if(!sim_hm10.online){
+      sim_hm10.dropped++;
+      return;
+  }
+  if((baud * 20 < sim_hm10.baud * 19) || (baud * 20 > sim_hm10.baud * 21)){
+      byte = (uint8_t)~byte;
+      sim_hm10.garbled++;
+  }
+  if(sim_hm10.line_len == SIM_HM10_LINE){
+      sim_hm10_forward();
+  }
+  sim_hm10.line[sim_hm10.line_len++] = (char)byte;
+  sim_event_in(&sim_hm10.gap, SIM_HM10_GAP_NS);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Queues a phone command for at_ms, to be set before the first boot.
+ ******************************************************************************/
+void sim_phone_cmd(uint32_t at_ms, const char *text, bool raw){
+  SIM_PHONE_CMD *cmd;
+
+  if(sim_phone.cmd_count == SIM_PHONE_CMDS) return;
+  cmd = &sim_phone.cmds[sim_phone.cmd_count++];
+  cmd->at_ms = at_ms;
+  cmd->raw = raw;
+  snprintf(cmd->text, sizeof(cmd->text), "%s", text);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Pin level change from the firmware: sensor supply, the red LED and SCL clocking a stuck
+ * slave.
+ ******************************************************************************/
+void sim_pin_changed(GPIO_Port_TypeDef port, uint32_t pins){
+  if((port == SIM_SENSOR_EN_PORT) && (pins & (1UL << SIM_SENSOR_EN_PIN))){
+      sim_sensor_power = sim_pin_out(port, SIM_SENSOR_EN_PIN);
+      sim_sensor_power_at = sim_now;
+  }
+  if((port == SIM_RED_PORT) && (pins & (1UL << SIM_RED_PIN)) && sim_pin_out(port, SIM_RED_PIN)){
+      sim_red_on++;
+  }
+  if((port == SIM_SCL_PORT) && (pins & (1UL << SIM_SCL_PIN)) && !sim_pin_out(port, SIM_SCL_PIN)){
+      sim_scl_falls++;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Input level of a pin: the I2C lines are pulled up, SDA may be held by a slave.
+ ******************************************************************************/
+unsigned int sim_pin_in(GPIO_Port_TypeDef port, unsigned int pin){
+  if((port == SIM_SDA_PORT) && (pin == SIM_SDA_PIN)){
+      return !(sim_opts.sda_stuck && (sim_scl_falls < SIM_SDA_STUCK_EDGES));
+  }
+  if((port == SIM_SCL_PORT) && (pin == SIM_SCL_PIN)) return 1;
+  return sim_pin_out(port, pin);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the device totals as key=value lines.
+ ******************************************************************************/
+void sim_report_devices(FILE *out){
+  sim_phone_idle();
+  fprintf(out, "red_led_on=%u\n", sim_red_on);
+  fprintf(out, "si1133_forces=%u\n", sim_si1133.forces);
+  fprintf(out, "si7021_measures=%u\n", sim_si7021.measures);
+  fprintf(out, "si7021_busy_nacks=%u\n", sim_si7021.busy_nacks);
+  fprintf(out, "hm10_baud=%u\n", sim_hm10.baud);
+  fprintf(out, "hm10_at_cmds=%u\n", sim_hm10.at_cmds);
+  fprintf(out, "hm10_at_replies=%u\n", sim_hm10.at_replies);
+  fprintf(out, "hm10_at_faults=%u\n", sim_hm10.at_faults);
+  fprintf(out, "hm10_resets=%u\n", sim_hm10.resets);
+  fprintf(out, "hm10_garbled=%u\n", sim_hm10.garbled);
+  fprintf(out, "hm10_dropped=%u\n", sim_hm10.dropped);
+  fprintf(out, "hm10_overflows=%u\n", sim_hm10.overflows);
+  fprintf(out, "phone_sent=%u\n", sim_phone.sent);
+  fprintf(out, "phone_text_ok=%u\n", sim_phone.text_ok);
+  fprintf(out, "phone_text_bad=%u\n", sim_phone.text_bad);
+  fprintf(out, "phone_bin_ok=%u\n", sim_phone.bin_ok);
+  fprintf(out, "phone_bin_bad=%u\n", sim_phone.bin_bad);
+  fprintf(out, "phone_cut=%u\n", sim_phone.cut);
+}
@@ -0,0 +1,10 @@
+/**
+ * @file sim_fw_begin.c
+ * @brief Start of the firmware code in the host simulation
+ *Responsible for marking where the firmware objects begin in .text, linked before them, so the watchdog can tell a firmware spin from the simulator's own code.
+ */
+
+void sim_fw_text_begin(void);
+
+void sim_fw_text_begin(void){
+}
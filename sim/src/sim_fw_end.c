@@ -0,0 +1,10 @@
+/**
+ * @file sim_fw_end.c
+ * @brief End of the firmware code in the host simulation
+ *Responsible for marking where the firmware objects end in .text, linked after them.
+ */
+
+void sim_fw_text_end(void);
+
+void sim_fw_text_end(void){
+}
@@ -0,0 +1,121 @@
+/**
+ * @file sim_gpcrc.c
+ * @brief GPCRC model of the host simulation
+ *Responsible for the CRC unit as crc.c uses it, reflected input and output, kept apart from the other models so the CRC unit tests can link it alone.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static uint32_t sim_crc;
+static uint32_t sim_crc_poly;         // reflected
+static uint32_t sim_crc_init;
+static uint32_t sim_crc_width;
+
+GPCRC_TypeDef sim_gpcrc;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t sim_reflect(uint32_t value, uint32_t bits);
+
+
+/***************************************************************************//**
+ * @brief
+ * Returns the low bits of a value in reverse order.
+ ******************************************************************************/
+static uint32_t sim_reflect(uint32_t value, uint32_t bits){
+  uint32_t out = 0;
+
+  for(uint32_t i = 0; i < bits; i++){
+      out = (out << 1) | (value & 1);
+      value >>= 1;
+  }
+  return out;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Puts the CRC unit in its reset state.
+ ******************************************************************************/
+void sim_gpcrc_reset(void){
+  memset(&sim_gpcrc, 0, sizeof(sim_gpcrc));
+  sim_crc = 0;
+  sim_crc_poly = 0;
+  sim_crc_init = 0;
+  sim_crc_width = 0;
+}
+
+//***********************************************************************************
+// emlib GPCRC, reflected input and output as the unit is used by crc.c
+//***********************************************************************************
+
+void GPCRC_Init(GPCRC_TypeDef *gpcrc, const GPCRC_Init_TypeDef *init){
+  sim_call();
+  EFM_ASSERT(sim_clock_on(cmuClock_GPCRC));
+  gpcrc->POLY = init->crcPoly;
+  gpcrc->INIT = init->initValue;
+  sim_crc_width = (init->crcPoly == 0x04C11DB7UL) ? 32 : 16;
+  sim_crc_poly = sim_reflect(init->crcPoly, sim_crc_width);
+  sim_crc_init = init->initValue;
+  sim_crc = sim_crc_init;
+}
+
+void GPCRC_Reset(GPCRC_TypeDef *gpcrc){
+  sim_call();
+  memset(gpcrc, 0, sizeof(*gpcrc));
+}
+
+void GPCRC_Start(GPCRC_TypeDef *gpcrc){
+  (void)gpcrc;
+  sim_call();
+  sim_crc = sim_crc_init;
+}
+
+void GPCRC_InputU8(GPCRC_TypeDef *gpcrc, uint8_t data){
+  (void)gpcrc;
+  sim_crc ^= data;
+  for(int i = 0; i < 8; i++) sim_crc = (sim_crc & 1) ? ((sim_crc >> 1) ^ sim_crc_poly) : (sim_crc >> 1);
+  if(sim_crc_width == 16) sim_crc &= 0xFFFF;
+}
+
+void GPCRC_InputU16(GPCRC_TypeDef *gpcrc, uint16_t data){
+  GPCRC_InputU8(gpcrc, (uint8_t)data);
+  GPCRC_InputU8(gpcrc, (uint8_t)(data >> 8));
+}
+
+void GPCRC_InputU32(GPCRC_TypeDef *gpcrc, uint32_t data){
+  GPCRC_InputU16(gpcrc, (uint16_t)data);
+  GPCRC_InputU16(gpcrc, (uint16_t)(data >> 16));
+}
+
+uint32_t GPCRC_DataRead(GPCRC_TypeDef *gpcrc){
+  (void)gpcrc;
+  return sim_crc;
+}
+
+uint32_t GPCRC_DataReadBitReversed(GPCRC_TypeDef *gpcrc){
+  (void)gpcrc;
+  return sim_reflect(sim_crc, sim_crc_width);
+}
+
+uint32_t GPCRC_DataReadByteReversed(GPCRC_TypeDef *gpcrc){
+  (void)gpcrc;
+  return __builtin_bswap32(sim_crc) >> (32 - sim_crc_width);
+}
@@ -0,0 +1,419 @@
+/**
+ * @file sim_i2c.c
+ * @brief I2C0 and I2C1 master models of the host simulation
+ *Responsible for the START, address, data, ACK and STOP phases at the bus rate and for handing the bytes to the devices attached with sim_i2c_attach().
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_I2C_FAST_LIMIT  412000    // Fm limit of the Si1133 and Si7021 with some margin
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef enum {
+  SIM_I2C_IDLE,
+  SIM_I2C_ADDR,         // START or repeated START and the address byte on the bus
+  SIM_I2C_TX,           // data byte and its ACK bit on the bus
+  SIM_I2C_RX,           // data byte from the slave on the bus
+  SIM_I2C_ACK,          // master ACK bit and the next byte from the slave on the bus
+  SIM_I2C_STOP          // STOP condition on the bus
+} SIM_I2C_PHASE;
+
+typedef struct {
+  I2C_TypeDef   *regs;
+  const char    *name;
+  int           clock;
+  uint32_t      freq_set;     // SCL rate as set
+  uint32_t      freq_hz;      // HFPER the divider was computed for
+  SIM_I2C_DEV   *devs;
+  SIM_I2C_DEV   *dev;         // slave that ACKed the address, NULL after a NACK
+  bool          owned;        // START sent and no STOP yet
+  bool          reading;
+  bool          rx_wait;      // byte received, waiting for the ACK or NACK command
+  bool          start_cmd, stop_cmd;
+  bool          tx_full, rx_full;
+  uint8_t       tx, rx;
+  SIM_I2C_PHASE phase;
+  uint32_t      flags;        // latched flags, RXDATAV and TXBL are levels
+  uint32_t      bytes, nacks, overclocked, stops;
+  SIM_EVENT     done;         // end of the phase on the bus
+  SIM_IOREG     cmd, state, status, rxdata, txdata, ifr, ifs, ifc;
+} SIM_I2C_BUS;
+
+static SIM_I2C_BUS sim_buses[I2C_COUNT];
+
+I2C_TypeDef sim_i2c0, sim_i2c1;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static SIM_I2C_BUS *sim_i2c_bus(I2C_TypeDef *i2c);
+static uint32_t sim_i2c_hz(SIM_I2C_BUS *bus);
+static void sim_i2c_phase(SIM_I2C_BUS *bus, SIM_I2C_PHASE phase, uint32_t bits);
+static void sim_i2c_kick(SIM_I2C_BUS *bus);
+static void sim_i2c_done(SIM_EVENT *ev);
+static void sim_i2c_release(SIM_I2C_BUS *bus);
+static uint32_t sim_i2c_if(SIM_I2C_BUS *bus);
+static bool sim_i2c0_level(void);
+static bool sim_i2c1_level(void);
+static void sim_i2c_cmd_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_i2c_state_read(SIM_IOREG *reg);
+static uint32_t sim_i2c_rxdata_read(SIM_IOREG *reg);
+static void sim_i2c_txdata_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_i2c_if_read(SIM_IOREG *reg);
+static void sim_i2c_ifs_write(SIM_IOREG *reg, uint32_t value);
+static void sim_i2c_ifc_write(SIM_IOREG *reg, uint32_t value);
+
+SIM_IO_FN(sim_i2c0_cmd_io, sim_buses[0].cmd)
+SIM_IO_FN(sim_i2c0_state_io, sim_buses[0].state)
+SIM_IO_FN(sim_i2c0_status_io, sim_buses[0].status)
+SIM_IO_FN(sim_i2c0_rxdata_io, sim_buses[0].rxdata)
+SIM_IO_FN(sim_i2c0_txdata_io, sim_buses[0].txdata)
+SIM_IO_FN(sim_i2c0_if_io, sim_buses[0].ifr)
+SIM_IO_FN(sim_i2c0_ifs_io, sim_buses[0].ifs)
+SIM_IO_FN(sim_i2c0_ifc_io, sim_buses[0].ifc)
+SIM_IO_FN(sim_i2c1_cmd_io, sim_buses[1].cmd)
+SIM_IO_FN(sim_i2c1_state_io, sim_buses[1].state)
+SIM_IO_FN(sim_i2c1_status_io, sim_buses[1].status)
+SIM_IO_FN(sim_i2c1_rxdata_io, sim_buses[1].rxdata)
+SIM_IO_FN(sim_i2c1_txdata_io, sim_buses[1].txdata)
+SIM_IO_FN(sim_i2c1_if_io, sim_buses[1].ifr)
+SIM_IO_FN(sim_i2c1_ifs_io, sim_buses[1].ifs)
+SIM_IO_FN(sim_i2c1_ifc_io, sim_buses[1].ifc)
+
+static SIM_I2C_BUS *sim_i2c_bus(I2C_TypeDef *i2c){
+  return (i2c == &sim_i2c1) ? &sim_buses[1] : &sim_buses[0];
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the SCL rate, which follows HFPER until the divider is set again.
+ ******************************************************************************/
+static uint32_t sim_i2c_hz(SIM_I2C_BUS *bus){
+  if(!bus->freq_hz) return bus->freq_set;
+  return (uint32_t)((uint64_t)bus->freq_set * sim_hf_hz() / bus->freq_hz);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Puts a phase on the bus for the given number of SCL periods.
+ ******************************************************************************/
+static void sim_i2c_phase(SIM_I2C_BUS *bus, SIM_I2C_PHASE phase, uint32_t bits){
+  uint32_t hz = sim_i2c_hz(bus);
+
+  if(!hz) hz = I2C_FREQ_STANDARD_MAX;
+  if(hz > SIM_I2C_FAST_LIMIT) bus->overclocked++;
+  bus->phase = phase;
+  sim_event_in(&bus->done, ((uint64_t)bits * SIM_NS_PER_S + hz - 1) / hz);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts the next phase the commands and TXDATA ask for, once the bus is free.
+ *
+ * @details
+ * A START waits for the address in TXDATA, a byte written before a STOP goes out first,
+ * and a STOP on a reading bus waits for the NACK command. START and STOP together on an
+ * idle bus put out a START and a STOP, as i2c_bus_reset() relies on.
+ ******************************************************************************/
+static void sim_i2c_kick(SIM_I2C_BUS *bus){
+  if(bus->phase != SIM_I2C_IDLE) return;
+  if(bus->start_cmd && bus->stop_cmd && !bus->tx_full && !bus->owned){
+      bus->start_cmd = false;
+      sim_i2c_phase(bus, SIM_I2C_STOP, 2);
+      return;
+  }
+  if(bus->start_cmd && bus->tx_full){
+      bus->start_cmd = false;
+      bus->tx_full = false;
+      bus->owned = true;
+      bus->reading = bus->tx & 1;
+      bus->rx_wait = false;
+      bus->flags |= I2C_IF_START;
+      sim_i2c_phase(bus, SIM_I2C_ADDR, 10);
+      return;
+  }
+  if(bus->owned && !bus->reading && bus->tx_full && bus->dev){
+      bus->tx_full = false;
+      sim_i2c_phase(bus, SIM_I2C_TX, 9);
+      return;
+  }
+  if(bus->stop_cmd && bus->owned && !(bus->reading && bus->rx_wait && bus->dev)){
+      sim_i2c_phase(bus, SIM_I2C_STOP, 1);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * End of a phase on the bus: the slave's ACK or data and the flags it raises.
+ ******************************************************************************/
+static void sim_i2c_done(SIM_EVENT *ev){
+  SIM_I2C_BUS *bus = ev->ctx;
+  SIM_I2C_PHASE phase = bus->phase;
+  bool ack;
+
+  bus->phase = SIM_I2C_IDLE;
+  switch(phase){
+    case SIM_I2C_ADDR:
+      bus->dev = NULL;
+      for(SIM_I2C_DEV *dev = bus->devs; dev; dev = dev->next){
+          if(dev->addr == (bus->tx >> 1)) bus->dev = dev;
+      }
+      ack = bus->dev && (sim_rand() >= sim_opts.i2c_nack_rate) && bus->dev->start(bus->dev, bus->reading);
+      if(!ack){
+          bus->dev = NULL;
+          bus->nacks++;
+          bus->flags |= I2C_IF_NACK;
+          break;
+      }
+      bus->flags |= I2C_IF_ACK;
+      if(bus->reading) sim_i2c_phase(bus, SIM_I2C_RX, 8);
+      break;
+    case SIM_I2C_TX:
+      bus->bytes++;
+      if(bus->dev->write(bus->dev, bus->tx)){
+          bus->flags |= I2C_IF_ACK;
+      }else{
+          bus->nacks++;
+          bus->flags |= I2C_IF_NACK;
+      }
+      break;
+    case SIM_I2C_ACK:
+    case SIM_I2C_RX:
+      bus->bytes++;
+      bus->rx = bus->dev->read(bus->dev);
+      bus->rx_full = true;
+      bus->rx_wait = true;
+      break;
+    case SIM_I2C_STOP:
+      sim_i2c_release(bus);
+      bus->stops++;
+      bus->flags |= I2C_IF_MSTOP;
+      break;
+    default:
+      break;
+  }
+  sim_i2c_kick(bus);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Leaves the bus, the addressed slave sees a STOP.
+ ******************************************************************************/
+static void sim_i2c_release(SIM_I2C_BUS *bus){
+  if(bus->owned && bus->dev && bus->dev->stop) bus->dev->stop(bus->dev);
+  bus->owned = false;
+  bus->dev = NULL;
+  bus->reading = false;
+  bus->rx_wait = false;
+  bus->stop_cmd = false;
+}
+
+static uint32_t sim_i2c_if(SIM_I2C_BUS *bus){
+  uint32_t flags = bus->flags;
+
+  if(bus->rx_full) flags |= I2C_IF_RXDATAV;
+  if(!bus->tx_full) flags |= I2C_IF_TXBL;
+  return flags;
+}
+
+static bool sim_i2c0_level(void){
+  return (sim_i2c_if(&sim_buses[0]) & sim_i2c0.IEN) != 0;
+}
+
+static bool sim_i2c1_level(void){
+  return (sim_i2c_if(&sim_buses[1]) & sim_i2c1.IEN) != 0;
+}
+
+static void sim_i2c_cmd_write(SIM_IOREG *reg, uint32_t value){
+  SIM_I2C_BUS *bus = reg->ctx;
+
+  if(value & I2C_CMD_ABORT){
+      sim_event_cancel(&bus->done);
+      bus->phase = SIM_I2C_IDLE;
+      sim_i2c_release(bus);
+      bus->start_cmd = false;
+  }
+  if(value & I2C_CMD_CLEARTX) bus->tx_full = false;
+  if(value & I2C_CMD_START) bus->start_cmd = true;
+  if(value & I2C_CMD_STOP) bus->stop_cmd = true;
+  if((value & I2C_CMD_ACK) && bus->rx_wait && (bus->phase == SIM_I2C_IDLE)){
+      bus->rx_wait = false;
+      sim_i2c_phase(bus, SIM_I2C_ACK, 9);
+  }
+  if((value & I2C_CMD_NACK) && bus->rx_wait){
+      bus->rx_wait = false;
+      bus->reading = false;
+  }
+  sim_i2c_kick(bus);
+}
+
+static uint32_t sim_i2c_state_read(SIM_IOREG *reg){
+  SIM_I2C_BUS *bus = reg->ctx;
+
+  if(!bus->owned && (bus->phase == SIM_I2C_IDLE)) return I2C_STATE_STATE_IDLE;
+  return I2C_STATE_BUSY | I2C_STATE_MASTER | I2C_STATE_STATE_DATA
+         | (bus->reading ? 0 : I2C_STATE_TRANSMITTER) | ((bus->owned && !bus->dev) ? I2C_STATE_NACKED : 0);
+}
+
+static uint32_t sim_i2c_rxdata_read(SIM_IOREG *reg){
+  SIM_I2C_BUS *bus = reg->ctx;
+
+  if(!bus->rx_full) bus->flags |= I2C_IF_RXUF;
+  bus->rx_full = false;
+  return bus->rx;
+}
+
+static void sim_i2c_txdata_write(SIM_IOREG *reg, uint32_t value){
+  SIM_I2C_BUS *bus = reg->ctx;
+
+  if(bus->tx_full) bus->flags |= I2C_IF_TXOF;
+  bus->tx = (uint8_t)value;
+  bus->tx_full = true;
+  sim_i2c_kick(bus);
+}
+
+static uint32_t sim_i2c_if_read(SIM_IOREG *reg){
+  return sim_i2c_if(reg->ctx);
+}
+
+static void sim_i2c_ifs_write(SIM_IOREG *reg, uint32_t value){
+  ((SIM_I2C_BUS *)reg->ctx)->flags |= value;
+}
+
+static void sim_i2c_ifc_write(SIM_IOREG *reg, uint32_t value){
+  ((SIM_I2C_BUS *)reg->ctx)->flags &= ~value;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Puts both I2C masters in their reset state with no devices attached.
+ ******************************************************************************/
+void sim_i2c_reset(void){
+  static const char *names[I2C_COUNT][9] = {
+    { "I2C0", "I2C0_CMD", "I2C0_STATE", "I2C0_STATUS", "I2C0_RXDATA", "I2C0_TXDATA", "I2C0_IF", "I2C0_IFS", "I2C0_IFC" },
+    { "I2C1", "I2C1_CMD", "I2C1_STATE", "I2C1_STATUS", "I2C1_RXDATA", "I2C1_TXDATA", "I2C1_IF", "I2C1_IFS", "I2C1_IFC" }
+  };
+
+  memset(sim_buses, 0, sizeof(sim_buses));
+  memset(&sim_i2c0, 0, sizeof(sim_i2c0));
+  memset(&sim_i2c1, 0, sizeof(sim_i2c1));
+  sim_buses[0].regs = &sim_i2c0;
+  sim_buses[0].clock = cmuClock_I2C0;
+  sim_buses[1].regs = &sim_i2c1;
+  sim_buses[1].clock = cmuClock_I2C1;
+  for(int i = 0; i < I2C_COUNT; i++){
+      SIM_I2C_BUS *bus = &sim_buses[i];
+
+      bus->name = names[i][0];
+      sim_event_init(&bus->done, names[i][0], SIM_DOMAIN_HF, sim_i2c_done, bus);
+      sim_reg_init(&bus->cmd, names[i][1], bus->clock, NULL, sim_i2c_cmd_write, bus, 0);
+      sim_reg_init(&bus->state, names[i][2], bus->clock, sim_i2c_state_read, NULL, bus, 0);
+      sim_reg_init(&bus->status, names[i][3], bus->clock, NULL, NULL, bus, 0);
+      sim_reg_init(&bus->rxdata, names[i][4], bus->clock, sim_i2c_rxdata_read, NULL, bus, 0);
+      sim_reg_init(&bus->txdata, names[i][5], bus->clock, NULL, sim_i2c_txdata_write, bus, SIM_IDLE_DATA);
+      sim_reg_init(&bus->ifr, names[i][6], bus->clock, sim_i2c_if_read, NULL, bus, 0);
+      sim_reg_init(&bus->ifs, names[i][7], bus->clock, NULL, sim_i2c_ifs_write, bus, 0);
+      sim_reg_init(&bus->ifc, names[i][8], bus->clock, NULL, sim_i2c_ifc_write, bus, 0);
+  }
+  sim_i2c0.CMD_io = sim_i2c0_cmd_io;
+  sim_i2c0.STATE_io = sim_i2c0_state_io;
+  sim_i2c0.STATUS_io = sim_i2c0_status_io;
+  sim_i2c0.RXDATA_io = sim_i2c0_rxdata_io;
+  sim_i2c0.TXDATA_io = sim_i2c0_txdata_io;
+  sim_i2c0.IF_io = sim_i2c0_if_io;
+  sim_i2c0.IFS_io = sim_i2c0_ifs_io;
+  sim_i2c0.IFC_io = sim_i2c0_ifc_io;
+  sim_i2c1.CMD_io = sim_i2c1_cmd_io;
+  sim_i2c1.STATE_io = sim_i2c1_state_io;
+  sim_i2c1.STATUS_io = sim_i2c1_status_io;
+  sim_i2c1.RXDATA_io = sim_i2c1_rxdata_io;
+  sim_i2c1.TXDATA_io = sim_i2c1_txdata_io;
+  sim_i2c1.IF_io = sim_i2c1_if_io;
+  sim_i2c1.IFS_io = sim_i2c1_ifs_io;
+  sim_i2c1.IFC_io = sim_i2c1_ifc_io;
+  sim_irq_level(I2C0_IRQn, sim_i2c0_level);
+  sim_irq_level(I2C1_IRQn, sim_i2c1_level);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Puts a device model on a bus.
+ ******************************************************************************/
+void sim_i2c_attach(I2C_TypeDef *i2c, SIM_I2C_DEV *dev){
+  SIM_I2C_BUS *bus = sim_i2c_bus(i2c);
+
+  dev->next = bus->devs;
+  bus->devs = dev;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the bus totals as key=value lines.
+ ******************************************************************************/
+void sim_report_i2c(FILE *out){
+  for(int i = 0; i < I2C_COUNT; i++){
+      fprintf(out, "i2c%d_bytes=%u\n", i, sim_buses[i].bytes);
+      fprintf(out, "i2c%d_nacks=%u\n", i, sim_buses[i].nacks);
+      fprintf(out, "i2c%d_stops=%u\n", i, sim_buses[i].stops);
+      fprintf(out, "i2c%d_overclocked=%u\n", i, sim_buses[i].overclocked);
+  }
+}
+
+//***********************************************************************************
+// emlib I2C
+//***********************************************************************************
+
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init){
+  sim_call();
+  EFM_ASSERT(sim_clock_on(sim_i2c_bus(i2c)->clock));
+  EFM_ASSERT(init->master);
+  I2C_BusFreqSet(i2c, init->refFreq, init->freq, init->clhr);
+  I2C_Enable(i2c, init->enable);
+}
+
+void I2C_Enable(I2C_TypeDef *i2c, bool enable){
+  sim_call();
+  i2c->CTRL = (i2c->CTRL & ~1UL) | (uint32_t)enable;
+}
+
+void I2C_Reset(I2C_TypeDef *i2c){
+  SIM_I2C_BUS *bus = sim_i2c_bus(i2c);
+
+  sim_call();
+  sim_i2c_cmd_write(&bus->cmd, I2C_CMD_ABORT | I2C_CMD_CLEARTX);
+  bus->flags = 0;
+  bus->rx_full = false;
+  i2c->CTRL = 0;
+  i2c->IEN = 0;
+  i2c->ROUTEPEN = 0;
+}
+
+void I2C_BusFreqSet(I2C_TypeDef *i2c, uint32_t freqRef, uint32_t freqScl, I2C_ClockHLR_TypeDef i2cMode){
+  SIM_I2C_BUS *bus = sim_i2c_bus(i2c);
+
+  (void)i2cMode;
+  sim_call();
+  bus->freq_set = freqScl;
+  bus->freq_hz = freqRef ? freqRef : sim_hf_hz();
+  i2c->CLKDIV = (bus->freq_hz / (8 * freqScl)) - 1;
+}
+
+uint32_t I2C_BusFreqGet(I2C_TypeDef *i2c){
+  sim_call();
+  return sim_i2c_hz(sim_i2c_bus(i2c));
+}
@@ -0,0 +1,428 @@
+/**
+ * @file sim_main.c
+ * @brief Command line harness of the host simulation
+ *Responsible for the options, the flash mapping kept across simulated resets and running each boot of the firmware in its own process.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "sleep_routines.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_DEFAULT_TIME_MS     60000
+#define SIM_DEFAULT_PHONE_MS    5000      // after the boot task named the module
+#define SIM_DEFAULT_LIGHT_MS    10000
+#define SIM_EM0_UW_PER_MHZ      228       // SLEEP_ACTIVE_UW at CMU_HFRCO_LOW, 1600 uW at 7 MHz
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+enum {
+  SIM_OPT_TIME = 't',
+  SIM_OPT_SEED = 's',
+  SIM_OPT_CMD = 'c',
+  SIM_OPT_QUIET = 'q',
+  SIM_OPT_RAW = 256,
+  SIM_OPT_CONNECT,
+  SIM_OPT_NO_PHONE,
+  SIM_OPT_PHONE_LOG,
+  SIM_OPT_CAPTURE,
+  SIM_OPT_FLASH,
+  SIM_OPT_BOOTS,
+  SIM_OPT_CUT_AT,
+  SIM_OPT_CUT_WRITE,
+  SIM_OPT_CUT_ERASE,
+  SIM_OPT_I2C_NACK,
+  SIM_OPT_FLASH_FAIL,
+  SIM_OPT_BAD_PAGE,
+  SIM_OPT_SDA_STUCK,
+  SIM_OPT_GARBLE,
+  SIM_OPT_AT_FAULT,
+  SIM_OPT_LIGHT,
+  SIM_OPT_EM_COST,
+  SIM_OPT_SLEEP_POLICY,
+  SIM_OPT_COUNT_INSNS,
+  SIM_OPT_REPORT
+};
+
+// Tables handed to sleep_em_costs_set(), the physical costs stay those of sim_opts
+typedef enum {
+  SIM_POLICY_PREDICTIVE,  // the firmware knows the board's costs
+  SIM_POLICY_DEEPEST,     // as without SLEEP_PREDICTIVE
+  SIM_POLICY_EM1,         // EM1 whenever a deadline is known
+  SIM_POLICIES
+} SIM_POLICY;
+
+static const struct option sim_long_opts[] = {
+  { "time",       required_argument, NULL, SIM_OPT_TIME },
+  { "seed",       required_argument, NULL, SIM_OPT_SEED },
+  { "cmd",        required_argument, NULL, SIM_OPT_CMD },
+  { "raw",        required_argument, NULL, SIM_OPT_RAW },
+  { "connect",    required_argument, NULL, SIM_OPT_CONNECT },
+  { "no-phone",   no_argument,       NULL, SIM_OPT_NO_PHONE },
+  { "phone-log",  required_argument, NULL, SIM_OPT_PHONE_LOG },
+  { "capture",    required_argument, NULL, SIM_OPT_CAPTURE },
+  { "flash",      required_argument, NULL, SIM_OPT_FLASH },
+  { "boots",      required_argument, NULL, SIM_OPT_BOOTS },
+  { "cut-at",     required_argument, NULL, SIM_OPT_CUT_AT },
+  { "cut-write",  required_argument, NULL, SIM_OPT_CUT_WRITE },
+  { "cut-erase",  required_argument, NULL, SIM_OPT_CUT_ERASE },
+  { "i2c-nack",   required_argument, NULL, SIM_OPT_I2C_NACK },
+  { "flash-fail", required_argument, NULL, SIM_OPT_FLASH_FAIL },
+  { "bad-page",   required_argument, NULL, SIM_OPT_BAD_PAGE },
+  { "sda-stuck",  no_argument,       NULL, SIM_OPT_SDA_STUCK },
+  { "garble",     required_argument, NULL, SIM_OPT_GARBLE },
+  { "at-fault",   required_argument, NULL, SIM_OPT_AT_FAULT },
+  { "light",      required_argument, NULL, SIM_OPT_LIGHT },
+  { "em-cost",    required_argument, NULL, SIM_OPT_EM_COST },
+  { "sleep-policy", required_argument, NULL, SIM_OPT_SLEEP_POLICY },
+  { "count-insns", no_argument,      NULL, SIM_OPT_COUNT_INSNS },
+  { "quiet",      no_argument,       NULL, SIM_OPT_QUIET },
+  { "report",     required_argument, NULL, SIM_OPT_REPORT },
+  { NULL, 0, NULL, 0 }
+};
+
+static const char sim_usage[] =
+  "usage: fw_sim [options]\n"
+  "  -t, --time MS         simulated time of the last boot (60000)\n"
+  "  -s, --seed N          seed of the injected faults and jitter\n"
+  "  -c, --cmd MS:TEXT     phone command framed as #TEXT*CRC! at MS, repeatable\n"
+  "      --raw MS:TEXT     phone bytes sent as they are at MS, repeatable\n"
+  "      --connect MS      time the phone connects (5000)\n"
+  "      --no-phone        no phone connects\n"
+  "      --phone-log FILE  frames to and from the phone\n"
+  "      --capture FILE    raw bytes the phone receives, as tools/logfmt.py reads them\n"
+  "      --flash FILE      flash image kept between runs\n"
+  "      --boots N         boots on the same flash (1)\n"
+  "      --cut-at MS       power cut of every boot but the last\n"
+  "      --cut-write N     power cut in the Nth flash word write of every boot but the last\n"
+  "      --cut-erase N     power cut in the Nth page erase of every boot but the last\n"
+  "      --i2c-nack P      NACKs per I2C address phase\n"
+  "      --flash-fail P    failed flash erases and writes per operation\n"
+  "      --bad-page N      flash page that never erases\n"
+  "      --sda-stuck       a slave holds SDA low at boot\n"
+  "      --garble P        bytes from the phone corrupted by the module\n"
+  "      --at-fault N:KIND the module's Nth AT reply of a boot is dropped (drop), sent\n"
+  "                        late (delay:MS) or with a wrong first byte (garble), repeatable\n"
+  "      --light MS        dark and light period of the Si1133 (10000), 0 for light\n"
+  "      --em-cost EM:UW,US,NJ  power, wake-up latency and switch energy of EM1 to EM3\n"
+  "      --sleep-policy P  predictive, deepest or em1 (predictive)\n"
+  "      --count-insns     DWT_CYCCNT counts firmware instructions and each takes a core\n"
+  "                        cycle at the HF clock, x86-64 only, slow\n"
+  "  -q, --quiet           no log lines on stderr\n"
+  "      --report FILE     key=value totals of each boot, stdout by default\n";
+
+static uint32_t sim_boot;
+static uint32_t sim_boots = 1;
+static uint64_t sim_cut_ns;
+static uint64_t sim_time_ns = (uint64_t)SIM_DEFAULT_TIME_MS * SIM_NS_PER_MS;
+static SIM_POLICY sim_policy = SIM_POLICY_PREDICTIVE;
+static const char *const sim_policy_names[SIM_POLICIES] = { "predictive", "deepest", "em1" };
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+int fw_main(void);
+
+static void sim_defaults(void);
+static void sim_add_cmd(const char *arg, bool raw);
+static void sim_add_at_fault(const char *arg);
+static void sim_map_flash(const char *path);
+static void sim_run_boot(void) __attribute__((noreturn));
+
+/***************************************************************************//**
+ * @brief
+ * Power and wake up costs of the board, the same figures as sleep_default_costs.
+ ******************************************************************************/
+static void sim_defaults(void){
+  static const SIM_EM_COST costs[4] = {
+    { 1600, 0,  0 },
+    { 700,  2,  0 },
+    { 8,    31, 40 },
+    { 7,    31, 40 }
+  };
+
+  memset(&sim_opts, 0, sizeof(sim_opts));
+  sim_opts.seed = 1;
+  sim_opts.phone = true;
+  sim_opts.phone_ms = SIM_DEFAULT_PHONE_MS;
+  sim_opts.report = stdout;
+  sim_opts.bad_page = -1;
+  sim_opts.light_period_ms = SIM_DEFAULT_LIGHT_MS;
+  memcpy(sim_opts.em_costs, costs, sizeof(costs));
+  sim_opts.em0_uw_per_mhz = SIM_EM0_UW_PER_MHZ;
+}
+
+static void sim_add_cmd(const char *arg, bool raw){
+  char *text;
+  unsigned long at_ms = strtoul(arg, &text, 10);
+
+  if(*text != ':'){
+      fprintf(stderr, "fw_sim: expected MS:TEXT, got %s\n", arg);
+      exit(1);
+  }
+  sim_phone_cmd((uint32_t)at_ms, text + 1, raw);
+}
+
+static void sim_add_at_fault(const char *arg){
+  SIM_AT_FAULT fault = { 0 };
+  char *kind;
+
+  fault.reply = (uint32_t)strtoul(arg, &kind, 10);
+  if(!strcmp(kind, ":drop")){
+      fault.kind = SIM_AT_DROP;
+  }else if(!strcmp(kind, ":garble")){
+      fault.kind = SIM_AT_GARBLE;
+  }else if(!strncmp(kind, ":delay:", 7)){
+      fault.kind = SIM_AT_DELAY;
+      fault.delay_ms = (uint32_t)strtoul(&kind[7], NULL, 10);
+  }else{
+      fault.reply = 0;
+  }
+  if(!fault.reply || (sim_opts.at_fault_count == SIM_AT_FAULTS)){
+      fprintf(stderr, "fw_sim: expected N:drop, N:delay:MS or N:garble, at most %d, got %s\n", SIM_AT_FAULTS, arg);
+      exit(1);
+  }
+  sim_opts.at_faults[sim_opts.at_fault_count++] = fault;
+}
+
+static void sim_set_em_cost(const char *arg){
+  unsigned em, uw, us, nj;
+
+  if((sscanf(arg, "%u:%u,%u,%u", &em, &uw, &us, &nj) != 4) || (em < SIM_EM1) || (em > SIM_EM3)){
+      fprintf(stderr, "fw_sim: expected EM:UW,US,NJ with EM 1 to 3, got %s\n", arg);
+      exit(1);
+  }
+  sim_opts.em_costs[em] = (SIM_EM_COST){ uw, us, nj };
+}
+
+static void sim_set_policy(const char *arg){
+  for(int i = 0; i < SIM_POLICIES; i++){
+      if(strcmp(arg, sim_policy_names[i]) == 0){
+          sim_policy = (SIM_POLICY)i;
+          return;
+      }
+  }
+  fprintf(stderr, "fw_sim: unknown sleep policy %s\n", arg);
+  exit(1);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Gives sleep_select_mode() the table of the chosen policy.
+ *
+ * @details
+ * The predictive policy sees the physical costs, so a board changed with --em-cost is one
+ * the firmware was tuned for. The deepest policy sees no wake-up or switch cost and picks
+ * the lowest sleep power, the em1 policy sees EM2 and EM3 as too slow for any deadline.
+ ******************************************************************************/
+static void sim_apply_policy(void){
+  static SLEEP_EM_COST costs[MAX_ENERGY_MODES];
+
+  for(int em = EM0; em <= EM3; em++){
+      costs[em] = (SLEEP_EM_COST){ sim_opts.em_costs[em].power_uw, sim_opts.em_costs[em].wakeup_us,
+                                   sim_opts.em_costs[em].switch_nj };
+      if(sim_policy == SIM_POLICY_DEEPEST){
+          costs[em].wakeup_us = 0;
+          costs[em].switch_nj = 0;
+      }
+      if((sim_policy == SIM_POLICY_EM1) && (em >= EM2)) costs[em].wakeup_us = UINT32_MAX;
+  }
+  costs[EM4] = (SLEEP_EM_COST){ 0, UINT32_MAX, 0 };
+  sleep_em_costs_set(costs);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Maps the flash below 4 GB, as FLASH_BASE is a 32 bit address, shared with every boot.
+ *
+ * @details
+ * The mapping is read only, MSC_WriteWord and MSC_ErasePage open it around their stores,
+ * so a firmware store to flash faults as it would on the part.
+ ******************************************************************************/
+static void sim_map_flash(const char *path){
+  int fd = -1;
+  int flags = MAP_SHARED | MAP_32BIT;
+  struct stat st;
+
+  if(path){
+      fd = open(path, O_RDWR | O_CREAT, 0644);
+      if((fd < 0) || fstat(fd, &st)){
+          perror(path);
+          exit(1);
+      }
+      if(st.st_size != (off_t)FLASH_SIZE){
+          uint8_t erased[FLASH_PAGE_SIZE];
+
+          memset(erased, 0xFF, sizeof(erased));
+          if(ftruncate(fd, 0)) perror(path);
+          for(uint32_t i = 0; i < FLASH_SIZE / FLASH_PAGE_SIZE; i++){
+              if(write(fd, erased, sizeof(erased)) != (ssize_t)sizeof(erased)){
+                  perror(path);
+                  exit(1);
+              }
+          }
+      }
+  }else{
+      flags |= MAP_ANONYMOUS;
+  }
+  sim_flash = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, flags, fd, 0);
+  if(sim_flash == MAP_FAILED){
+      perror("fw_sim: flash mapping");
+      exit(1);
+  }
+  if(!path) memset(sim_flash, 0xFF, FLASH_SIZE);
+  mprotect(sim_flash, FLASH_SIZE, PROT_READ);
+  if(fd >= 0) close(fd);
+}
+
+/***************************************************************************//**
+ * @brief
+ * One boot of the firmware from reset, in a child process so its globals start clean.
+ ******************************************************************************/
+static void sim_run_boot(void){
+  sim_opts.end_ns = (sim_cut_ns && (sim_boot + 1 < sim_boots)) ? sim_cut_ns : sim_time_ns;
+  if(sim_boot + 1 == sim_boots){
+      sim_opts.cut_write = 0;
+      sim_opts.cut_erase = 0;
+  }
+  sim_opts.seed += sim_boot;
+  sim_core_reset();
+  sim_misc_reset();
+  sim_timers_reset();
+  sim_uart_reset();
+  sim_i2c_reset();
+  sim_devices_reset();
+  sim_watchdog_start();
+  sim_apply_policy();
+  if(sim_opts.count_insns) sim_count_start();
+  sim_count_resume();
+  fw_main();
+  sim_finish(0);
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Ends a boot: prints the totals of every model and leaves the process.
+ ******************************************************************************/
+void sim_finish(int status){
+  FILE *out = sim_opts.report;
+
+  fprintf(out, "boot=%u\n", sim_boot);
+  fprintf(out, "status=%d\n", status);
+  sim_report_core(out);
+  sim_report_misc(out);
+  sim_report_timers(out);
+  sim_report_uart(out);
+  sim_report_i2c(out);
+  sim_report_devices(out);
+  fflush(out);
+  if(sim_opts.phone_log) fflush(sim_opts.phone_log);
+  if(sim_opts.capture) fflush(sim_opts.capture);
+  fflush(stderr);
+  _exit(status);
+}
+
+int main(int argc, char **argv){
+  const char *flash_path = NULL;
+  int opt;
+  int status = 0;
+
+  sim_defaults();
+  while((opt = getopt_long(argc, argv, "t:s:c:q", sim_long_opts, NULL)) != -1){
+      switch(opt){
+        case SIM_OPT_TIME:        sim_time_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+        case SIM_OPT_SEED:        sim_opts.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case SIM_OPT_CMD:         sim_add_cmd(optarg, false); break;
+        case SIM_OPT_RAW:         sim_add_cmd(optarg, true); break;
+        case SIM_OPT_CONNECT:     sim_opts.phone_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case SIM_OPT_NO_PHONE:    sim_opts.phone = false; break;
+        case SIM_OPT_FLASH:       flash_path = optarg; break;
+        case SIM_OPT_BOOTS:       sim_boots = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case SIM_OPT_CUT_AT:      sim_cut_ns = strtoull(optarg, NULL, 10) * SIM_NS_PER_MS; break;
+        case SIM_OPT_CUT_WRITE:   sim_opts.cut_write = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case SIM_OPT_CUT_ERASE:   sim_opts.cut_erase = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case SIM_OPT_I2C_NACK:    sim_opts.i2c_nack_rate = strtod(optarg, NULL); break;
+        case SIM_OPT_FLASH_FAIL:  sim_opts.flash_fail_rate = strtod(optarg, NULL); break;
+        case SIM_OPT_BAD_PAGE:    sim_opts.bad_page = (int32_t)strtol(optarg, NULL, 10); break;
+        case SIM_OPT_SDA_STUCK:   sim_opts.sda_stuck = true; break;
+        case SIM_OPT_GARBLE:      sim_opts.hm_garble_rate = strtod(optarg, NULL); break;
+        case SIM_OPT_AT_FAULT:    sim_add_at_fault(optarg); break;
+        case SIM_OPT_LIGHT:       sim_opts.light_period_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case SIM_OPT_EM_COST:     sim_set_em_cost(optarg); break;
+        case SIM_OPT_SLEEP_POLICY: sim_set_policy(optarg); break;
+        case SIM_OPT_COUNT_INSNS: sim_opts.count_insns = true; break;
+        case SIM_OPT_QUIET:       sim_opts.quiet = true; break;
+        case SIM_OPT_PHONE_LOG:
+          sim_opts.phone_log = fopen(optarg, "w");
+          if(!sim_opts.phone_log){
+              perror(optarg);
+              return 1;
+          }
+          break;
+        case SIM_OPT_CAPTURE:
+          sim_opts.capture = fopen(optarg, "wb");
+          if(!sim_opts.capture){
+              perror(optarg);
+              return 1;
+          }
+          break;
+        case SIM_OPT_REPORT:
+          sim_opts.report = fopen(optarg, "w");
+          if(!sim_opts.report){
+              perror(optarg);
+              return 1;
+          }
+          break;
+        default:
+          fputs(sim_usage, stderr);
+          return 1;
+      }
+  }
+  if(!sim_boots) sim_boots = 1;
+  sim_map_flash(flash_path);
+
+  for(sim_boot = 0; sim_boot < sim_boots; sim_boot++){
+      pid_t pid;
+      int wstatus;
+
+      fflush(NULL);
+      pid = fork();
+      if(pid < 0){
+          perror("fw_sim: fork");
+          return 1;
+      }
+      if(pid == 0) sim_run_boot();
+      if(waitpid(pid, &wstatus, 0) < 0){
+          perror("fw_sim: waitpid");
+          return 1;
+      }
+      if(WIFSIGNALED(wstatus)){
+          fprintf(stderr, "fw_sim: boot %u killed by signal %d\n", sim_boot, WTERMSIG(wstatus));
+          status = 128 + WTERMSIG(wstatus);
+          break;
+      }
+      status = WEXITSTATUS(wstatus);
+      if(status) break;
+  }
+  return status;
+}
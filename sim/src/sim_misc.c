@@ -0,0 +1,612 @@
+/**
+ * @file sim_misc.c
+ * @brief CMU, GPIO, LDMA and MSC models of the host simulation
+ *Responsible for the clock tree and core clock, pin levels, the DMA channels feeding USART0 and the LED PWM and the flash controller.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_HFRCO_RESET     cmuHFRCOFreq_19M0Hz
+#define SIM_HFXO_HZ         38400000
+#define SIM_GPIO_PORTS      12
+
+#define SIM_MSC_WORD_NS     24000     // word write, core stalled
+#define SIM_MSC_ERASE_NS    20000000  // page erase
+
+#define SIM_LDMA_CHANNELS   DMA_CHAN_COUNT
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef struct {
+  bool                    active;
+  LDMA_PeripheralSignal_t signal;
+  const LDMA_Descriptor_t *desc;
+  uint32_t                left;       // units left of the current descriptor
+  uint32_t                src;
+  SIM_EVENT               done;       // end of a descriptor paced by the PWM period
+  uint64_t                held;       // ns left of a paced descriptor while TIMER1 is stopped
+} SIM_LDMA_CH;
+
+static bool sim_clocks[SIM_CMU_CLOCKS];
+static bool sim_oscs[SIM_CMU_OSCS];
+static CMU_Select_TypeDef sim_selects[SIM_CMU_CLOCKS];
+static CMU_HFRCOFreq_TypeDef sim_hfrco;
+
+static uint32_t sim_gpio_mode[SIM_GPIO_PORTS][16];
+static uint32_t sim_gpio_changes;
+
+static SIM_LDMA_CH sim_ldma_ch[SIM_LDMA_CHANNELS];
+static uint32_t sim_ldma_if;
+static uint32_t sim_ldma_done;
+static SIM_IOREG sim_ldma_status, sim_ldma_if_reg, sim_ldma_ifs, sim_ldma_ifc;
+
+static bool sim_msc_unlocked;
+static uint32_t sim_msc_writes, sim_msc_erases, sim_msc_fails;
+static uint64_t sim_msc_busy_ns;      // core stalled by the MSC
+static uint32_t sim_msc_page_erases[FLASH_SIZE / FLASH_PAGE_SIZE];
+
+LDMA_TypeDef sim_ldma;
+GPIO_TypeDef sim_gpio;
+uint8_t *sim_flash;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void sim_ldma_load(int ch, const LDMA_Descriptor_t *desc);
+static void sim_ldma_finish(int ch);
+static void sim_ldma_paced(SIM_EVENT *ev);
+static bool sim_ldma_level(void);
+static uint32_t sim_ldma_if_read(SIM_IOREG *reg);
+static void sim_ldma_ifs_write(SIM_IOREG *reg, uint32_t value);
+static void sim_ldma_ifc_write(SIM_IOREG *reg, uint32_t value);
+static bool sim_flash_range(const void *addr, uint32_t bytes);
+static void sim_flash_store(uint32_t *word, uint32_t value);
+static void sim_msc_stall(uint64_t ns);
+
+SIM_IO_FN(sim_ldma_status_io, sim_ldma_status)
+SIM_IO_FN(sim_ldma_if_io, sim_ldma_if_reg)
+SIM_IO_FN(sim_ldma_ifs_io, sim_ldma_ifs)
+SIM_IO_FN(sim_ldma_ifc_io, sim_ldma_ifc)
+
+/***************************************************************************//**
+ * @brief
+ * Makes a descriptor current on a channel and moves what needs no pacing.
+ *
+ * @details
+ * USART0 TXBL requests come from the USART model whenever its transmit buffer is free.
+ * TIMER1 compare requests come once per PWM period, so a descriptor of n units takes n
+ * periods and writes the same value each time when the source does not increment.
+ ******************************************************************************/
+static void sim_ldma_load(int ch, const LDMA_Descriptor_t *desc){
+  SIM_LDMA_CH *chan = &sim_ldma_ch[ch];
+
+  chan->desc = desc;
+  chan->left = desc->xfer.xferCnt + 1;
+  chan->src = desc->xfer.srcAddr;
+  if(chan->signal == ldmaPeripheralSignal_USART0_TXBL){
+      while(chan->active && (chan->desc == desc) && chan->left && sim_usart_tx_ready()){
+          sim_ldma_signal(chan->signal);
+      }
+      return;
+  }
+  if(desc->xfer.size == ldmaCtrlSizeWord){
+      *(volatile uint32_t *)(uintptr_t)desc->xfer.dstAddr = *(const uint32_t *)(uintptr_t)chan->src;
+  }else{
+      *(volatile uint8_t *)(uintptr_t)desc->xfer.dstAddr = *(const uint8_t *)(uintptr_t)chan->src;
+  }
+  chan->held = chan->left * sim_timer1_period_ns();
+  if(sim_timer1_running()){
+      sim_event_in(&chan->done, chan->held);
+      chan->held = 0;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Ends the current descriptor: done flag, then the linked one or the end of the channel.
+ ******************************************************************************/
+static void sim_ldma_finish(int ch){
+  SIM_LDMA_CH *chan = &sim_ldma_ch[ch];
+  const LDMA_Descriptor_t *desc = chan->desc;
+
+  if(desc->xfer.doneIfs) sim_ldma_if |= 1UL << ch;
+  if(desc->xfer.link){
+      EFM_ASSERT(desc->xfer.linkMode == ldmaLinkModeRel);
+      sim_ldma_load(ch, (const LDMA_Descriptor_t *)((const uint8_t *)desc + ((int32_t)desc->xfer.linkAddr * 4)));
+      return;
+  }
+  chan->active = false;
+  sim_ldma_done |= 1UL << ch;
+  sim_progress();
+}
+
+static void sim_ldma_paced(SIM_EVENT *ev){
+  sim_ldma_finish((int)(uintptr_t)ev->ctx);
+}
+
+static bool sim_ldma_level(void){
+  return (sim_ldma_if & sim_ldma.IEN) != 0;
+}
+
+static uint32_t sim_ldma_if_read(SIM_IOREG *reg){
+  (void)reg;
+  return sim_ldma_if;
+}
+
+static void sim_ldma_ifs_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  sim_ldma_if |= value;
+}
+
+static void sim_ldma_ifc_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  sim_ldma_if &= ~value;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether a flash access lies in the mapped flash.
+ ******************************************************************************/
+static bool sim_flash_range(const void *addr, uint32_t bytes){
+  const uint8_t *p = addr;
+
+  return sim_flash && (p >= sim_flash) && (p + bytes <= sim_flash + FLASH_SIZE);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Stores a word in the read-only flash mapping, the way only the MSC can.
+ *
+ * @details
+ * mprotect() takes host pages, which may be larger than a flash page, so the host page
+ * that holds the word is opened.
+ ******************************************************************************/
+static void sim_flash_store(uint32_t *word, uint32_t value){
+  uintptr_t host_page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  void *page = (void *)((uintptr_t)word & ~(host_page - 1));
+
+  if(mprotect(page, host_page, PROT_READ | PROT_WRITE)) sim_fail(1, "flash mprotect failed");
+  *word = value;
+  mprotect(page, host_page, PROT_READ);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Stalls the core for an MSC operation, the power cut of cut_write or cut_erase lands in it.
+ ******************************************************************************/
+static void sim_msc_stall(uint64_t ns){
+  sim_advance(ns);
+  sim_msc_busy_ns += ns;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Holds or resumes the descriptors paced by TIMER1, its compare matches stop with it.
+ ******************************************************************************/
+void sim_ldma_pace(bool run){
+  for(int ch = 0; ch < SIM_LDMA_CHANNELS; ch++){
+      SIM_LDMA_CH *chan = &sim_ldma_ch[ch];
+
+      if(!run && chan->done.armed){
+          chan->held = chan->done.at - sim_now;
+          sim_event_cancel(&chan->done);
+      }else if(run && chan->active && chan->held){
+          sim_event_in(&chan->done, chan->held);
+          chan->held = 0;
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Puts the clock tree, pins, DMA, flash controller and CRC unit in their reset state.
+ ******************************************************************************/
+void sim_misc_reset(void){
+  memset(sim_clocks, 0, sizeof(sim_clocks));
+  memset(sim_oscs, 0, sizeof(sim_oscs));
+  memset(sim_selects, 0, sizeof(sim_selects));
+  sim_oscs[cmuOsc_HFRCO] = true;
+  sim_oscs[cmuOsc_ULFRCO] = true;
+  sim_selects[cmuClock_HF] = cmuSelect_HFRCO;
+  sim_clocks[cmuClock_HF] = true;
+  sim_clocks[cmuClock_CORE] = true;
+  sim_clocks[cmuClock_HFPER] = true;
+  sim_hfrco = SIM_HFRCO_RESET;
+
+  memset(&sim_gpio, 0, sizeof(sim_gpio));
+  memset(sim_gpio_mode, 0, sizeof(sim_gpio_mode));
+  sim_gpio_changes = 0;
+
+  memset(&sim_ldma, 0, sizeof(sim_ldma));
+  memset(sim_ldma_ch, 0, sizeof(sim_ldma_ch));
+  for(int ch = 0; ch < SIM_LDMA_CHANNELS; ch++){
+      sim_event_init(&sim_ldma_ch[ch].done, "LDMA paced descriptor", SIM_DOMAIN_HF, sim_ldma_paced, (void *)(uintptr_t)ch);
+  }
+  sim_ldma_if = 0;
+  sim_ldma_done = 0;
+  sim_reg_init(&sim_ldma_status, "LDMA_STATUS", cmuClock_LDMA, NULL, NULL, NULL, 0);
+  sim_reg_init(&sim_ldma_if_reg, "LDMA_IF", cmuClock_LDMA, sim_ldma_if_read, NULL, NULL, 0);
+  sim_reg_init(&sim_ldma_ifs, "LDMA_IFS", cmuClock_LDMA, NULL, sim_ldma_ifs_write, NULL, 0);
+  sim_reg_init(&sim_ldma_ifc, "LDMA_IFC", cmuClock_LDMA, NULL, sim_ldma_ifc_write, NULL, 0);
+  sim_ldma.STATUS_io = sim_ldma_status_io;
+  sim_ldma.IF_io = sim_ldma_if_io;
+  sim_ldma.IFS_io = sim_ldma_ifs_io;
+  sim_ldma.IFC_io = sim_ldma_ifc_io;
+  sim_irq_level(LDMA_IRQn, sim_ldma_level);
+
+  sim_msc_unlocked = false;
+  sim_msc_writes = 0;
+  sim_msc_erases = 0;
+  sim_msc_fails = 0;
+  sim_msc_busy_ns = 0;
+  memset(sim_msc_page_erases, 0, sizeof(sim_msc_page_erases));
+  sim_gpcrc_reset();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether a peripheral's clock runs.
+ ******************************************************************************/
+bool sim_clock_on(int clock){
+  switch(clock){
+    case cmuClock_LEUART0:
+      return sim_clocks[clock] && sim_clocks[cmuClock_CORELE] && (sim_selects[cmuClock_LFB] == cmuSelect_LFXO)
+             && sim_oscs[cmuOsc_LFXO];
+    case cmuClock_LETIMER0:
+      return sim_clocks[clock] && sim_clocks[cmuClock_CORELE] && (sim_selects[cmuClock_LFA] != cmuSelect_Disabled);
+    case cmuClock_RTCC:
+      return sim_clocks[clock] && sim_clocks[cmuClock_CORELE];
+    case cmuClock_GPIO:
+    case cmuClock_LDMA:
+    case cmuClock_GPCRC:
+      return sim_clocks[clock];
+    default:
+      return sim_clocks[clock] && sim_clocks[cmuClock_HFPER];
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the core and HFPER clock.
+ ******************************************************************************/
+uint32_t sim_hf_hz(void){
+  return (sim_selects[cmuClock_HF] == cmuSelect_HFXO) ? SIM_HFXO_HZ : (uint32_t)sim_hfrco;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the level a pin drives, its DOUT bit.
+ ******************************************************************************/
+bool sim_pin_out(GPIO_Port_TypeDef port, unsigned int pin){
+  return (sim_gpio.P[port].DOUT >> pin) & 1;
+}
+
+/***************************************************************************//**
+ * @brief
+ * A peripheral's DMA request, moves one unit on each active channel waiting for it.
+ ******************************************************************************/
+void sim_ldma_signal(LDMA_PeripheralSignal_t signal){
+  for(int ch = 0; ch < SIM_LDMA_CHANNELS; ch++){
+      SIM_LDMA_CH *chan = &sim_ldma_ch[ch];
+      const LDMA_Descriptor_t *desc = chan->desc;
+      uint8_t byte;
+      bool last;
+
+      if(!chan->active || !chan->left || (chan->signal != signal) || (signal != ldmaPeripheralSignal_USART0_TXBL)) continue;
+      /* The byte is taken before it reaches the USART, which may signal again at once */
+      byte = *(const uint8_t *)(uintptr_t)chan->src;
+      chan->src += (desc->xfer.srcInc == ldmaCtrlSrcIncNone) ? 0 : (1UL << desc->xfer.srcInc);
+      last = (--chan->left == 0);
+      sim_usart_tx_dma(byte);
+      if(last) sim_ldma_finish(ch);
+      return;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the clock totals as key=value lines.
+ ******************************************************************************/
+void sim_report_misc(FILE *out){
+  fprintf(out, "hf_hz=%u\n", sim_hf_hz());
+  fprintf(out, "flash_writes=%u\n", sim_msc_writes);
+  fprintf(out, "flash_erases=%u\n", sim_msc_erases);
+  fprintf(out, "flash_fails=%u\n", sim_msc_fails);
+  fprintf(out, "flash_busy_ms=%.3f\n", (double)sim_msc_busy_ns / SIM_NS_PER_MS);
+  {
+    uint32_t pages = 0, most = 0, least = UINT32_MAX;
+
+    for(uint32_t page = 0; page < FLASH_SIZE / FLASH_PAGE_SIZE; page++){
+        uint32_t n = sim_msc_page_erases[page];
+
+        if(!n) continue;
+        pages++;
+        if(n > most) most = n;
+        if(n < least) least = n;
+    }
+    fprintf(out, "flash_pages_erased=%u\n", pages);
+    fprintf(out, "flash_erases_max=%u\n", most);
+    fprintf(out, "flash_erases_min=%u\n", pages ? least : 0);
+  }
+  fprintf(out, "gpio_changes=%u\n", sim_gpio_changes);
+}
+
+//***********************************************************************************
+// emlib CMU
+//***********************************************************************************
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable){
+  sim_call();
+  sim_clocks[clock] = enable;
+}
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock){
+  CMU_Select_TypeDef sel;
+
+  sim_call();
+  switch(clock){
+    case cmuClock_LFA:
+    case cmuClock_LETIMER0:
+      sel = sim_selects[cmuClock_LFA];
+      break;
+    case cmuClock_LFB:
+    case cmuClock_LEUART0:
+      sel = sim_selects[cmuClock_LFB];
+      break;
+    case cmuClock_LFE:
+    case cmuClock_RTCC:
+      sel = sim_selects[cmuClock_LFE];
+      break;
+    default:
+      return sim_hf_hz();
+  }
+  if(sel == cmuSelect_LFXO) return SIM_LFXO_HZ;
+  if(sel == cmuSelect_ULFRCO) return SIM_ULFRCO_HZ;
+  if(sel == cmuSelect_LFRCO) return SIM_LFXO_HZ;
+  return 0;
+}
+
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref){
+  sim_call();
+  sim_selects[clock] = ref;
+}
+
+CMU_Select_TypeDef CMU_ClockSelectGet(CMU_Clock_TypeDef clock){
+  sim_call();
+  return sim_selects[clock];
+}
+
+void CMU_HFRCOBandSet(CMU_HFRCOFreq_TypeDef setFreq){
+  sim_call();
+  sim_hfrco = setFreq;
+}
+
+CMU_HFRCOFreq_TypeDef CMU_HFRCOBandGet(void){
+  sim_call();
+  return sim_hfrco;
+}
+
+void CMU_HFXOInit(const CMU_HFXOInit_TypeDef *hfxoInit){
+  (void)hfxoInit;
+  sim_call();
+}
+
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait){
+  (void)wait;
+  sim_call();
+  sim_oscs[osc] = enable;
+}
+
+//***********************************************************************************
+// emlib GPIO
+//***********************************************************************************
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength){
+  sim_call();
+  sim_gpio.P[port].CTRL = (uint32_t)strength;
+}
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out){
+  sim_call();
+  sim_gpio_mode[port][pin] = mode;
+  if(out){
+      GPIO_PinOutSet(port, pin);
+  }else{
+      GPIO_PinOutClear(port, pin);
+  }
+}
+
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin){
+  GPIO_PortOutSetVal(port, 1UL << pin, 1UL << pin);
+}
+
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin){
+  GPIO_PortOutSetVal(port, 0, 1UL << pin);
+}
+
+void GPIO_PinOutToggle(GPIO_Port_TypeDef port, unsigned int pin){
+  GPIO_PortOutToggle(port, 1UL << pin);
+}
+
+void GPIO_PortOutSet(GPIO_Port_TypeDef port, uint32_t pins){
+  GPIO_PortOutSetVal(port, pins, pins);
+}
+
+void GPIO_PortOutClear(GPIO_Port_TypeDef port, uint32_t pins){
+  GPIO_PortOutSetVal(port, 0, pins);
+}
+
+void GPIO_PortOutToggle(GPIO_Port_TypeDef port, uint32_t pins){
+  GPIO_PortOutSetVal(port, ~sim_gpio.P[port].DOUT, pins);
+}
+
+void GPIO_PortOutSetVal(GPIO_Port_TypeDef port, uint32_t val, uint32_t mask){
+  uint32_t old = sim_gpio.P[port].DOUT;
+
+  sim_call();
+  sim_gpio.P[port].DOUT = (old & ~mask) | (val & mask);
+  if(sim_gpio.P[port].DOUT != old){
+      sim_gpio_changes++;
+      sim_pin_changed(port, old ^ sim_gpio.P[port].DOUT);
+  }
+}
+
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef port, unsigned int pin){
+  sim_call();
+  return sim_pin_in(port, pin);
+}
+
+unsigned int GPIO_PinOutGet(GPIO_Port_TypeDef port, unsigned int pin){
+  sim_call();
+  return sim_pin_out(port, pin);
+}
+
+//***********************************************************************************
+// emlib LDMA
+//***********************************************************************************
+
+void LDMA_Init(const LDMA_Init_t *init){
+  (void)init;
+  sim_call();
+  memset(sim_ldma_ch, 0, offsetof(SIM_LDMA_CH, done));
+  for(int ch = 0; ch < SIM_LDMA_CHANNELS; ch++){
+      sim_event_cancel(&sim_ldma_ch[ch].done);
+      sim_ldma_ch[ch].active = false;
+      sim_ldma_ch[ch].desc = NULL;
+  }
+  sim_ldma_if = 0;
+  sim_ldma_done = 0;
+  sim_ldma.IEN = LDMA_IF_ERROR;
+}
+
+void LDMA_DeInit(void){
+  sim_call();
+  for(int ch = 0; ch < SIM_LDMA_CHANNELS; ch++) LDMA_StopTransfer(ch);
+}
+
+void LDMA_StartTransfer(int ch, const LDMA_TransferCfg_t *transfer, const LDMA_Descriptor_t *descriptor){
+  SIM_LDMA_CH *chan = &sim_ldma_ch[ch];
+
+  sim_call();
+  EFM_ASSERT(sim_clock_on(cmuClock_LDMA));
+  sim_event_cancel(&chan->done);
+  chan->active = true;
+  chan->signal = (LDMA_PeripheralSignal_t)transfer->ldmaReqSel;
+  sim_ldma_done &= ~(1UL << ch);
+  sim_ldma.IEN |= 1UL << ch;
+  sim_ldma_load(ch, descriptor);
+  sim_dispatch();
+}
+
+void LDMA_StopTransfer(int ch){
+  sim_call();
+  sim_event_cancel(&sim_ldma_ch[ch].done);
+  sim_ldma_ch[ch].active = false;
+  sim_ldma_ch[ch].held = 0;
+  sim_ldma.IEN &= ~(1UL << ch);
+}
+
+bool LDMA_TransferDone(int ch){
+  sim_call();
+  return (sim_ldma_done >> ch) & 1;
+}
+
+uint32_t LDMA_TransferRemainingCount(int ch){
+  sim_call();
+  return sim_ldma_ch[ch].active ? sim_ldma_ch[ch].left : 0;
+}
+
+//***********************************************************************************
+// emlib MSC
+//***********************************************************************************
+
+void MSC_Init(void){
+  sim_call();
+  sim_msc_unlocked = true;
+}
+
+void MSC_Deinit(void){
+  sim_call();
+  sim_msc_unlocked = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Programs words, flash bits only go from 1 to 0.
+ *
+ * @details
+ * Each word stalls the core for SIM_MSC_WORD_NS. Half programmed bits are in place
+ * before the time passes, so a run cut during the write leaves what a power loss would.
+ * The cut_write-th word of a boot is where its power fails.
+ ******************************************************************************/
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes){
+  const uint8_t *src = data;
+
+  sim_call();
+  if(!sim_msc_unlocked) return mscReturnLocked;
+  if(((uintptr_t)address & 3) || (numBytes & 3)) return mscReturnUnaligned;
+  if(!sim_flash_range(address, numBytes)) return mscReturnInvalidAddr;
+  for(uint32_t i = 0; i < numBytes / 4; i++){
+      uint32_t value, old = address[i];
+
+      memcpy(&value, &src[4 * i], sizeof(value));
+      if(sim_rand() < sim_opts.flash_fail_rate){
+          sim_msc_fails++;
+          return mscReturnTimeOut;
+      }
+      sim_flash_store(&address[i], old & (value | (uint32_t)(sim_rand() * 4294967296.0)));
+      if(sim_msc_writes + 1 == sim_opts.cut_write) sim_finish(0);
+      sim_msc_stall(SIM_MSC_WORD_NS);
+      sim_flash_store(&address[i], old & value);
+      sim_msc_writes++;
+  }
+  return mscReturnOk;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Erases a page to all ones, SIM_MSC_ERASE_NS with the core stalled.
+ *
+ * @details
+ * Half the words are erased before the time passes, the cut_erase-th erase of a boot
+ * stops there. Attempts on a page count towards its wear, failed ones too.
+ ******************************************************************************/
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress){
+  uint32_t page;
+
+  sim_call();
+  if(!sim_msc_unlocked) return mscReturnLocked;
+  if(((uintptr_t)startAddress - (uintptr_t)sim_flash) & (FLASH_PAGE_SIZE - 1)) return mscReturnUnaligned;
+  if(!sim_flash_range(startAddress, FLASH_PAGE_SIZE)) return mscReturnInvalidAddr;
+  page = (uint32_t)(((uint8_t *)startAddress - sim_flash) / FLASH_PAGE_SIZE);
+  sim_msc_erases++;
+  sim_msc_page_erases[page]++;
+  if(((int32_t)page == sim_opts.bad_page) || (sim_rand() < sim_opts.flash_fail_rate)){
+      sim_msc_fails++;
+      sim_msc_stall(SIM_MSC_ERASE_NS);
+      return mscReturnTimeOut;
+  }
+  for(uint32_t i = 0; i < FLASH_PAGE_SIZE / 4; i++){
+      if(sim_rand() < 0.5) sim_flash_store(&startAddress[i], 0xFFFFFFFFUL);
+  }
+  if(sim_msc_erases == sim_opts.cut_erase) sim_finish(0);
+  sim_msc_stall(SIM_MSC_ERASE_NS);
+  for(uint32_t i = 0; i < FLASH_PAGE_SIZE / 4; i++) sim_flash_store(&startAddress[i], 0xFFFFFFFFUL);
+  return mscReturnOk;
+}
@@ -0,0 +1,785 @@
+/**
+ * @file sim_timers.c
+ * @brief LETIMER, TIMER and sleeptimer models of the host simulation
+ *Responsible for LETIMER0 on ULFRCO, TIMER0 as the HW_delay.c one shot, TIMER1 as the LED PWM and the sleeptimer on the RTCC.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_LETIMER_TICK_NS (SIM_NS_PER_S / SIM_ULFRCO_HZ)
+#define SIM_RTCC_HZ         SIM_LFXO_HZ
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef struct {
+  TIMER_TypeDef *regs;
+  const char    *name;
+  int           clock;
+  IRQn_Type     irq;
+  bool          running;
+  uint32_t      cnt;        // counter at cnt_at
+  uint64_t      cnt_at;     // ns
+  uint32_t      hz;         // counter clock while running
+  uint32_t      flags;
+  SIM_EVENT     stop;       // one shot down count reaching 0
+  SIM_IOREG     cmd, status, ifr, ifs, ifc, cntr;
+} SIM_TIMER;
+
+static struct {
+  bool          running;
+  uint32_t      cnt;        // counter at tick cnt_at
+  uint64_t      cnt_at;     // ULFRCO tick
+  uint32_t      flags;
+  SIM_EVENT     uf, comp1;
+  SIM_IOREG     cmd, status, cntr, ifr, ifs, ifc;
+} sim_let;
+
+static SIM_TIMER sim_timers[2];
+
+static sl_sleeptimer_timer_handle_t *sim_st_head;   // running timers, earliest first
+static SIM_EVENT sim_st_event;
+static bool sim_st_pending;
+static bool sim_st_init;
+static uint32_t sim_st_fired;
+
+LETIMER_TypeDef sim_letimer0;
+TIMER_TypeDef sim_timer0, sim_timer1;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint64_t sim_let_tick(void);
+static uint32_t sim_let_cnt(void);
+static void sim_let_schedule(void);
+static void sim_let_uf(SIM_EVENT *ev);
+static void sim_let_comp1(SIM_EVENT *ev);
+static bool sim_let_level(void);
+static void sim_let_cmd_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_let_status_read(SIM_IOREG *reg);
+static uint32_t sim_let_cnt_read(SIM_IOREG *reg);
+static void sim_let_cnt_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_let_if_read(SIM_IOREG *reg);
+static void sim_let_ifs_write(SIM_IOREG *reg, uint32_t value);
+static void sim_let_ifc_write(SIM_IOREG *reg, uint32_t value);
+
+static SIM_TIMER *sim_timer_of(TIMER_TypeDef *timer);
+static uint32_t sim_timer_cnt(SIM_TIMER *t);
+static void sim_timer_run(SIM_TIMER *t, bool run);
+static void sim_timer_stop(SIM_EVENT *ev);
+static bool sim_timer0_level(void);
+static bool sim_timer1_level(void);
+static void sim_timer_cmd_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_timer_status_read(SIM_IOREG *reg);
+static uint32_t sim_timer_if_read(SIM_IOREG *reg);
+static void sim_timer_ifs_write(SIM_IOREG *reg, uint32_t value);
+static void sim_timer_ifc_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_timer_cnt_read(SIM_IOREG *reg);
+static void sim_timer_cnt_write(SIM_IOREG *reg, uint32_t value);
+
+static uint32_t sim_st_now(void);
+static void sim_st_insert(sl_sleeptimer_timer_handle_t *handle);
+static bool sim_st_remove(sl_sleeptimer_timer_handle_t *handle);
+static void sim_st_arm(void);
+static void sim_st_due(SIM_EVENT *ev);
+static bool sim_st_level(void);
+void RTCC_IRQHandler(void);
+
+SIM_IO_FN(sim_let_cmd_io, sim_let.cmd)
+SIM_IO_FN(sim_let_status_io, sim_let.status)
+SIM_IO_FN(sim_let_cnt_io, sim_let.cntr)
+SIM_IO_FN(sim_let_if_io, sim_let.ifr)
+SIM_IO_FN(sim_let_ifs_io, sim_let.ifs)
+SIM_IO_FN(sim_let_ifc_io, sim_let.ifc)
+SIM_IO_FN(sim_timer0_cmd_io, sim_timers[0].cmd)
+SIM_IO_FN(sim_timer0_status_io, sim_timers[0].status)
+SIM_IO_FN(sim_timer0_if_io, sim_timers[0].ifr)
+SIM_IO_FN(sim_timer0_ifs_io, sim_timers[0].ifs)
+SIM_IO_FN(sim_timer0_ifc_io, sim_timers[0].ifc)
+SIM_IO_FN(sim_timer0_cnt_io, sim_timers[0].cntr)
+SIM_IO_FN(sim_timer1_cmd_io, sim_timers[1].cmd)
+SIM_IO_FN(sim_timer1_status_io, sim_timers[1].status)
+SIM_IO_FN(sim_timer1_if_io, sim_timers[1].ifr)
+SIM_IO_FN(sim_timer1_ifs_io, sim_timers[1].ifs)
+SIM_IO_FN(sim_timer1_ifc_io, sim_timers[1].ifc)
+SIM_IO_FN(sim_timer1_cnt_io, sim_timers[1].cntr)
+
+//***********************************************************************************
+// LETIMER0
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Returns the ULFRCO ticks since boot, the first tick at or after now.
+ ******************************************************************************/
+static uint64_t sim_let_tick(void){
+  return (sim_now + SIM_LETIMER_TICK_NS - 1) / SIM_LETIMER_TICK_NS;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the counter, which counts down from COMP0 and reloads one tick after 0.
+ *
+ * @details
+ * The UF event reloads the counter, so only the part of a period before the next
+ * underflow has to be worked out here.
+ ******************************************************************************/
+static uint32_t sim_let_cnt(void){
+  uint64_t elapsed;
+
+  if(!sim_let.running) return sim_let.cnt;
+  elapsed = (sim_now / SIM_LETIMER_TICK_NS) - sim_let.cnt_at;
+  if((sim_now / SIM_LETIMER_TICK_NS) < sim_let.cnt_at) return sim_let.cnt;
+  return (elapsed >= sim_let.cnt) ? 0 : sim_let.cnt - (uint32_t)elapsed;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Arms the next underflow and COMP1 match from the counter state.
+ ******************************************************************************/
+static void sim_let_schedule(void){
+  uint32_t cnt;
+
+  sim_event_cancel(&sim_let.uf);
+  sim_event_cancel(&sim_let.comp1);
+  if(!sim_let.running) return;
+  cnt = sim_let_cnt();
+  sim_event_at(&sim_let.uf, (sim_let.cnt_at + sim_let.cnt + 1) * SIM_LETIMER_TICK_NS);
+  if(sim_letimer0.COMP1 < cnt){
+      sim_event_at(&sim_let.comp1, (sim_let.cnt_at + sim_let.cnt - sim_letimer0.COMP1) * SIM_LETIMER_TICK_NS);
+  }
+}
+
+static void sim_let_uf(SIM_EVENT *ev){
+  (void)ev;
+  sim_let.flags |= LETIMER_IF_UF;
+  sim_let.cnt = sim_letimer0.COMP0;
+  sim_let.cnt_at = sim_now / SIM_LETIMER_TICK_NS;
+  sim_let_schedule();
+}
+
+static void sim_let_comp1(SIM_EVENT *ev){
+  (void)ev;
+  sim_let.flags |= LETIMER_IF_COMP1;
+}
+
+static bool sim_let_level(void){
+  return (sim_let.flags & sim_letimer0.IEN) != 0;
+}
+
+static void sim_let_cmd_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  if(value & LETIMER_CMD_CLEAR){
+      sim_let.cnt = 0;
+      sim_let.cnt_at = sim_let_tick();
+  }
+  if((value & LETIMER_CMD_START) && !sim_let.running){
+      sim_let.running = true;
+      sim_let.cnt_at = sim_let_tick();
+  }
+  if((value & LETIMER_CMD_STOP) && sim_let.running){
+      sim_let.cnt = sim_let_cnt();
+      sim_let.running = false;
+  }
+  sim_let_schedule();
+}
+
+static uint32_t sim_let_status_read(SIM_IOREG *reg){
+  (void)reg;
+  return sim_let.running ? LETIMER_STATUS_RUNNING : 0;
+}
+
+static uint32_t sim_let_cnt_read(SIM_IOREG *reg){
+  (void)reg;
+  return sim_let_cnt();
+}
+
+static void sim_let_cnt_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  sim_let.cnt = value & 0xFFFF;
+  sim_let.cnt_at = sim_let_tick();
+  sim_let_schedule();
+}
+
+static uint32_t sim_let_if_read(SIM_IOREG *reg){
+  (void)reg;
+  return sim_let.flags;
+}
+
+static void sim_let_ifs_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  sim_let.flags |= value;
+}
+
+static void sim_let_ifc_write(SIM_IOREG *reg, uint32_t value){
+  (void)reg;
+  sim_let.flags &= ~value;
+}
+
+//***********************************************************************************
+// TIMER0 and TIMER1
+//***********************************************************************************
+
+static SIM_TIMER *sim_timer_of(TIMER_TypeDef *timer){
+  return (timer == &sim_timer0) ? &sim_timers[0] : &sim_timers[1];
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the counter, a down count that stops at 0 or an up count wrapping at TOP.
+ ******************************************************************************/
+static uint32_t sim_timer_cnt(SIM_TIMER *t){
+  uint64_t ticks;
+
+  if(!t->running) return t->cnt;
+  ticks = (sim_now - t->cnt_at) * t->hz / SIM_NS_PER_S;
+  if((t->regs->CTRL & 0x3) == timerModeDown){
+      return (ticks >= t->cnt) ? 0 : t->cnt - (uint32_t)ticks;
+  }
+  return (uint32_t)((t->cnt + ticks) % ((uint64_t)t->regs->TOP + 1));
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts or stops the counter, the counter clock is taken from HFPER at the start.
+ ******************************************************************************/
+static void sim_timer_run(SIM_TIMER *t, bool run){
+  uint32_t prescale = (t->regs->CTRL >> 24) & 0xF;
+
+  if(run == t->running) return;
+  if(t == &sim_timers[1]) sim_ldma_pace(run);
+  if(!run){
+      t->cnt = sim_timer_cnt(t);
+      t->running = false;
+      sim_event_cancel(&t->stop);
+      return;
+  }
+  t->running = true;
+  t->cnt_at = sim_now;
+  t->hz = sim_hf_hz() >> prescale;
+  if((t->regs->CTRL & 0x3) == timerModeDown){
+      sim_event_in(&t->stop, ((uint64_t)t->cnt * SIM_NS_PER_S + t->hz - 1) / t->hz);
+  }
+}
+
+static void sim_timer_stop(SIM_EVENT *ev){
+  SIM_TIMER *t = ev->ctx;
+
+  t->cnt = 0;
+  t->flags |= TIMER_IF_UF;
+  if(t->regs->CTRL & (1UL << 4)) t->running = false;    // OSMEN
+}
+
+static bool sim_timer0_level(void){
+  return (sim_timers[0].flags & sim_timer0.IEN) != 0;
+}
+
+static bool sim_timer1_level(void){
+  return (sim_timers[1].flags & sim_timer1.IEN) != 0;
+}
+
+static void sim_timer_cmd_write(SIM_IOREG *reg, uint32_t value){
+  if(value & TIMER_CMD_START) sim_timer_run(reg->ctx, true);
+  if(value & TIMER_CMD_STOP) sim_timer_run(reg->ctx, false);
+}
+
+static uint32_t sim_timer_status_read(SIM_IOREG *reg){
+  return ((SIM_TIMER *)reg->ctx)->running ? TIMER_STATUS_RUNNING : 0;
+}
+
+static uint32_t sim_timer_if_read(SIM_IOREG *reg){
+  return ((SIM_TIMER *)reg->ctx)->flags;
+}
+
+static void sim_timer_ifs_write(SIM_IOREG *reg, uint32_t value){
+  ((SIM_TIMER *)reg->ctx)->flags |= value;
+}
+
+static void sim_timer_ifc_write(SIM_IOREG *reg, uint32_t value){
+  ((SIM_TIMER *)reg->ctx)->flags &= ~value;
+}
+
+static uint32_t sim_timer_cnt_read(SIM_IOREG *reg){
+  return sim_timer_cnt(reg->ctx);
+}
+
+static void sim_timer_cnt_write(SIM_IOREG *reg, uint32_t value){
+  SIM_TIMER *t = reg->ctx;
+  bool run = t->running;
+
+  sim_timer_run(t, false);
+  t->cnt = value & 0xFFFF;
+  sim_timer_run(t, run);
+}
+
+//***********************************************************************************
+// sleeptimer
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Returns the RTCC counter, 32768 Hz from LFXO.
+ ******************************************************************************/
+static uint32_t sim_st_now(void){
+  return (uint32_t)(sim_now * SIM_RTCC_HZ / SIM_NS_PER_S);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds a timer to the running list. delta holds the expiry tick while a timer runs.
+ ******************************************************************************/
+static void sim_st_insert(sl_sleeptimer_timer_handle_t *handle){
+  sl_sleeptimer_timer_handle_t **pos = &sim_st_head;
+  uint32_t now = sim_st_now();
+
+  while(*pos && ((*pos)->delta - now <= handle->delta - now)) pos = &(*pos)->next;
+  handle->next = *pos;
+  *pos = handle;
+}
+
+static bool sim_st_remove(sl_sleeptimer_timer_handle_t *handle){
+  for(sl_sleeptimer_timer_handle_t **pos = &sim_st_head; *pos; pos = &(*pos)->next){
+      if(*pos == handle){
+          *pos = handle->next;
+          handle->next = NULL;
+          return true;
+      }
+  }
+  return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Arms the compare match of the earliest timer.
+ ******************************************************************************/
+static void sim_st_arm(void){
+  uint64_t base, at;
+
+  if(!sim_st_head){
+      sim_event_cancel(&sim_st_event);
+      return;
+  }
+  base = sim_now * SIM_RTCC_HZ / SIM_NS_PER_S;
+  at = base + (uint32_t)(sim_st_head->delta - (uint32_t)base);
+  sim_event_at(&sim_st_event, (at * SIM_NS_PER_S + SIM_RTCC_HZ - 1) / SIM_RTCC_HZ);
+}
+
+static void sim_st_due(SIM_EVENT *ev){
+  (void)ev;
+  sim_st_pending = true;
+}
+
+static bool sim_st_level(void){
+  return sim_st_pending;
+}
+
+/***************************************************************************//**
+ * @brief
+ * The sleeptimer's RTCC interrupt, runs the callbacks of expired timers.
+ ******************************************************************************/
+void RTCC_IRQHandler(void){
+  uint32_t now = sim_st_now();
+
+  sim_st_pending = false;
+  while(sim_st_head && ((int32_t)(now - sim_st_head->delta) >= 0)){
+      sl_sleeptimer_timer_handle_t *handle = sim_st_head;
+
+      sim_st_head = handle->next;
+      handle->next = NULL;
+      if(handle->timeout_periodic){
+          handle->delta += handle->timeout_periodic;
+          sim_st_insert(handle);
+      }
+      sim_st_fired++;
+      sim_count_resume();
+      handle->callback(handle, handle->callback_data);
+  }
+  sim_st_arm();
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Puts LETIMER0, TIMER0, TIMER1 and the sleeptimer in their reset state.
+ ******************************************************************************/
+void sim_timers_reset(void){
+  memset(&sim_let, 0, sizeof(sim_let));
+  memset(&sim_letimer0, 0, sizeof(sim_letimer0));
+  sim_event_init(&sim_let.uf, "LETIMER0 underflow", SIM_DOMAIN_ULFRCO, sim_let_uf, NULL);
+  sim_event_init(&sim_let.comp1, "LETIMER0 COMP1", SIM_DOMAIN_ULFRCO, sim_let_comp1, NULL);
+  sim_reg_init(&sim_let.cmd, "LETIMER0_CMD", cmuClock_LETIMER0, NULL, sim_let_cmd_write, NULL, 0);
+  sim_reg_init(&sim_let.status, "LETIMER0_STATUS", cmuClock_LETIMER0, sim_let_status_read, NULL, NULL, 0);
+  sim_reg_init(&sim_let.cntr, "LETIMER0_CNT", cmuClock_LETIMER0, sim_let_cnt_read, sim_let_cnt_write, NULL, 0);
+  sim_reg_init(&sim_let.ifr, "LETIMER0_IF", cmuClock_LETIMER0, sim_let_if_read, NULL, NULL, 0);
+  sim_reg_init(&sim_let.ifs, "LETIMER0_IFS", cmuClock_LETIMER0, NULL, sim_let_ifs_write, NULL, 0);
+  sim_reg_init(&sim_let.ifc, "LETIMER0_IFC", cmuClock_LETIMER0, NULL, sim_let_ifc_write, NULL, 0);
+  sim_letimer0.CMD_io = sim_let_cmd_io;
+  sim_letimer0.STATUS_io = sim_let_status_io;
+  sim_letimer0.CNT_io = sim_let_cnt_io;
+  sim_letimer0.IF_io = sim_let_if_io;
+  sim_letimer0.IFS_io = sim_let_ifs_io;
+  sim_letimer0.IFC_io = sim_let_ifc_io;
+  sim_irq_level(LETIMER0_IRQn, sim_let_level);
+
+  memset(sim_timers, 0, sizeof(sim_timers));
+  memset(&sim_timer0, 0, sizeof(sim_timer0));
+  memset(&sim_timer1, 0, sizeof(sim_timer1));
+  sim_timers[0] = (SIM_TIMER){ .regs = &sim_timer0, .name = "TIMER0", .clock = cmuClock_TIMER0, .irq = TIMER0_IRQn };
+  sim_timers[1] = (SIM_TIMER){ .regs = &sim_timer1, .name = "TIMER1", .clock = cmuClock_TIMER1, .irq = TIMER1_IRQn };
+  for(int i = 0; i < 2; i++){
+      SIM_TIMER *t = &sim_timers[i];
+
+      t->regs->TOP = 0xFFFF;
+      sim_event_init(&t->stop, i ? "TIMER1 underflow" : "TIMER0 underflow", SIM_DOMAIN_HF, sim_timer_stop, t);
+      sim_reg_init(&t->cmd, i ? "TIMER1_CMD" : "TIMER0_CMD", t->clock, NULL, sim_timer_cmd_write, t, 0);
+      sim_reg_init(&t->status, i ? "TIMER1_STATUS" : "TIMER0_STATUS", t->clock, sim_timer_status_read, NULL, t, 0);
+      sim_reg_init(&t->ifr, i ? "TIMER1_IF" : "TIMER0_IF", t->clock, sim_timer_if_read, NULL, t, 0);
+      sim_reg_init(&t->ifs, i ? "TIMER1_IFS" : "TIMER0_IFS", t->clock, NULL, sim_timer_ifs_write, t, 0);
+      sim_reg_init(&t->ifc, i ? "TIMER1_IFC" : "TIMER0_IFC", t->clock, NULL, sim_timer_ifc_write, t, 0);
+      sim_reg_init(&t->cntr, i ? "TIMER1_CNT" : "TIMER0_CNT", t->clock, sim_timer_cnt_read, sim_timer_cnt_write, t, 0);
+  }
+  sim_timer0.CMD_io = sim_timer0_cmd_io;
+  sim_timer0.STATUS_io = sim_timer0_status_io;
+  sim_timer0.IF_io = sim_timer0_if_io;
+  sim_timer0.IFS_io = sim_timer0_ifs_io;
+  sim_timer0.IFC_io = sim_timer0_ifc_io;
+  sim_timer0.CNT_io = sim_timer0_cnt_io;
+  sim_timer1.CMD_io = sim_timer1_cmd_io;
+  sim_timer1.STATUS_io = sim_timer1_status_io;
+  sim_timer1.IF_io = sim_timer1_if_io;
+  sim_timer1.IFS_io = sim_timer1_ifs_io;
+  sim_timer1.IFC_io = sim_timer1_ifc_io;
+  sim_timer1.CNT_io = sim_timer1_cnt_io;
+  sim_irq_level(TIMER0_IRQn, sim_timer0_level);
+  sim_irq_level(TIMER1_IRQn, sim_timer1_level);
+
+  sim_st_head = NULL;
+  sim_st_pending = false;
+  sim_st_init = false;
+  sim_st_fired = 0;
+  sim_event_init(&sim_st_event, "RTCC compare", SIM_DOMAIN_LFXO, sim_st_due, NULL);
+  sim_irq_level(RTCC_IRQn, sim_st_level);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns one PWM period of TIMER1, the pace of the LED fade DMA requests.
+ ******************************************************************************/
+uint64_t sim_timer1_period_ns(void){
+  uint32_t prescale = (sim_timer1.CTRL >> 24) & 0xF;
+
+  return ((uint64_t)sim_timer1.TOP + 1) * (1ULL << prescale) * SIM_NS_PER_S / sim_hf_hz();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether TIMER1 counts, and so raises the compare matches pacing the fades.
+ ******************************************************************************/
+bool sim_timer1_running(void){
+  return sim_timers[1].running;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the timer totals as key=value lines.
+ ******************************************************************************/
+void sim_report_timers(FILE *out){
+  fprintf(out, "sleeptimer_fired=%u\n", sim_st_fired);
+  fprintf(out, "letimer_running=%d\n", sim_let.running);
+}
+
+//***********************************************************************************
+// emlib LETIMER
+//***********************************************************************************
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init){
+  sim_call();
+  letimer->CTRL = (uint32_t)init->repMode | ((uint32_t)init->ufoa0 << 2) | ((uint32_t)init->ufoa1 << 4)
+                  | ((uint32_t)init->out0Pol << 6) | ((uint32_t)init->out1Pol << 7)
+                  | ((uint32_t)init->bufTop << 8) | ((uint32_t)init->comp0Top << 9)
+                  | ((uint32_t)init->debugRun << 12);
+  if(init->enable) sim_let_cmd_write(&sim_let.cmd, LETIMER_CMD_START);
+}
+
+void LETIMER_Enable(LETIMER_TypeDef *letimer, bool enable){
+  (void)letimer;
+  sim_call();
+  sim_let_cmd_write(&sim_let.cmd, enable ? LETIMER_CMD_START : LETIMER_CMD_STOP);
+}
+
+void LETIMER_Reset(LETIMER_TypeDef *letimer){
+  sim_call();
+  sim_let_cmd_write(&sim_let.cmd, LETIMER_CMD_STOP | LETIMER_CMD_CLEAR);
+  letimer->CTRL = 0;
+  letimer->COMP0 = 0;
+  letimer->COMP1 = 0;
+  letimer->IEN = 0;
+  sim_let.flags = 0;
+}
+
+uint32_t LETIMER_CompareGet(LETIMER_TypeDef *letimer, unsigned int comp){
+  sim_call();
+  return comp ? letimer->COMP1 : letimer->COMP0;
+}
+
+void LETIMER_CompareSet(LETIMER_TypeDef *letimer, unsigned int comp, uint32_t value){
+  sim_call();
+  if(comp){
+      letimer->COMP1 = value & 0xFFFF;
+  }else{
+      letimer->COMP0 = value & 0xFFFF;
+  }
+  sim_let_schedule();
+}
+
+uint32_t LETIMER_RepeatGet(LETIMER_TypeDef *letimer, unsigned int rep){
+  sim_call();
+  return rep ? letimer->REP1 : letimer->REP0;
+}
+
+void LETIMER_RepeatSet(LETIMER_TypeDef *letimer, unsigned int rep, uint32_t value){
+  sim_call();
+  if(rep){
+      letimer->REP1 = value & 0xFF;
+  }else{
+      letimer->REP0 = value & 0xFF;
+  }
+}
+
+uint32_t LETIMER_CounterGet(LETIMER_TypeDef *letimer){
+  (void)letimer;
+  sim_call();
+  return sim_let_cnt();
+}
+
+//***********************************************************************************
+// emlib TIMER
+//***********************************************************************************
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init){
+  SIM_TIMER *t = sim_timer_of(timer);
+
+  sim_call();
+  sim_timer_run(t, false);
+  timer->CTRL = (uint32_t)init->mode | ((uint32_t)init->oneShot << 4) | ((uint32_t)init->prescale << 24);
+  if(init->enable) sim_timer_run(t, true);
+}
+
+void TIMER_InitCC(TIMER_TypeDef *timer, unsigned int ch, const TIMER_InitCC_TypeDef *init){
+  sim_call();
+  timer->CC[ch].CTRL = (uint32_t)init->mode | ((uint32_t)init->outInvert << 2) | ((uint32_t)init->coist << 4);
+}
+
+void TIMER_Enable(TIMER_TypeDef *timer, bool enable){
+  sim_call();
+  sim_timer_run(sim_timer_of(timer), enable);
+}
+
+void TIMER_Reset(TIMER_TypeDef *timer){
+  SIM_TIMER *t = sim_timer_of(timer);
+
+  sim_call();
+  sim_timer_run(t, false);
+  t->cnt = 0;
+  t->flags = 0;
+  timer->CTRL = 0;
+  timer->IEN = 0;
+  timer->TOP = 0xFFFF;
+}
+
+void TIMER_TopSet(TIMER_TypeDef *timer, uint32_t val){
+  sim_call();
+  timer->TOP = val;
+}
+
+void TIMER_TopBufSet(TIMER_TypeDef *timer, uint32_t val){
+  sim_call();
+  timer->TOPB = val;
+}
+
+uint32_t TIMER_TopGet(TIMER_TypeDef *timer){
+  sim_call();
+  return timer->TOP;
+}
+
+void TIMER_CompareSet(TIMER_TypeDef *timer, unsigned int ch, uint32_t val){
+  sim_call();
+  timer->CC[ch].CCV = val;
+}
+
+void TIMER_CompareBufSet(TIMER_TypeDef *timer, unsigned int ch, uint32_t val){
+  sim_call();
+  timer->CC[ch].CCVB = val;
+}
+
+uint32_t TIMER_CounterGet(TIMER_TypeDef *timer){
+  sim_call();
+  return sim_timer_cnt(sim_timer_of(timer));
+}
+
+void TIMER_CounterSet(TIMER_TypeDef *timer, uint32_t val){
+  SIM_TIMER *t = sim_timer_of(timer);
+
+  sim_call();
+  sim_timer_cnt_write(&t->cntr, val);
+}
+
+//***********************************************************************************
+// sleeptimer
+//***********************************************************************************
+
+sl_status_t sl_sleeptimer_init(void){
+  sim_call();
+  if(!sim_st_init){
+      CMU_ClockEnable(cmuClock_RTCC, true);     // as the SDK's RTCC driver does
+      sim_st_init = true;
+      NVIC_EnableIRQ(RTCC_IRQn);
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_sleeptimer_start_timer(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout,
+                                      sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                      uint8_t priority, uint16_t option_flags){
+  CORE_DECLARE_IRQ_STATE;
+
+  if(!handle) return SL_STATUS_NULL_POINTER;
+  sim_call();
+  CORE_ENTER_CRITICAL();
+  if(sim_st_remove(handle)){
+      CORE_EXIT_CRITICAL();
+      return SL_STATUS_INVALID_STATE;
+  }
+  handle->callback = callback;
+  handle->callback_data = callback_data;
+  handle->priority = priority;
+  handle->option_flags = option_flags;
+  handle->timeout_periodic = 0;
+  handle->delta = sim_st_now() + timeout;
+  sim_st_insert(handle);
+  sim_st_arm();
+  CORE_EXIT_CRITICAL();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_sleeptimer_start_timer_ms(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout_ms,
+                                         sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                         uint8_t priority, uint16_t option_flags){
+  uint32_t ticks;
+  sl_status_t status = sl_sleeptimer_ms32_to_tick(timeout_ms, &ticks);
+
+  if(status != SL_STATUS_OK) return status;
+  return sl_sleeptimer_start_timer(handle, ticks, callback, callback_data, priority, option_flags);
+}
+
+sl_status_t sl_sleeptimer_start_periodic_timer(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout,
+                                               sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                               uint8_t priority, uint16_t option_flags){
+  sl_status_t status = sl_sleeptimer_start_timer(handle, timeout, callback, callback_data, priority, option_flags);
+
+  if(status == SL_STATUS_OK) handle->timeout_periodic = timeout;
+  return status;
+}
+
+sl_status_t sl_sleeptimer_start_periodic_timer_ms(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout_ms,
+                                                  sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                                  uint8_t priority, uint16_t option_flags){
+  uint32_t ticks;
+  sl_status_t status = sl_sleeptimer_ms32_to_tick(timeout_ms, &ticks);
+
+  if(status != SL_STATUS_OK) return status;
+  return sl_sleeptimer_start_periodic_timer(handle, ticks, callback, callback_data, priority, option_flags);
+}
+
+sl_status_t sl_sleeptimer_restart_timer(sl_sleeptimer_timer_handle_t *handle, uint32_t timeout,
+                                        sl_sleeptimer_timer_callback_t callback, void *callback_data,
+                                        uint8_t priority, uint16_t option_flags){
+  sl_sleeptimer_stop_timer(handle);
+  return sl_sleeptimer_start_timer(handle, timeout, callback, callback_data, priority, option_flags);
+}
+
+sl_status_t sl_sleeptimer_stop_timer(sl_sleeptimer_timer_handle_t *handle){
+  bool found;
+  CORE_DECLARE_IRQ_STATE;
+
+  if(!handle) return SL_STATUS_NULL_POINTER;
+  sim_call();
+  CORE_ENTER_CRITICAL();
+  found = sim_st_remove(handle);
+  sim_st_arm();
+  CORE_EXIT_CRITICAL();
+  return found ? SL_STATUS_OK : SL_STATUS_INVALID_STATE;
+}
+
+sl_status_t sl_sleeptimer_is_timer_running(sl_sleeptimer_timer_handle_t *handle, bool *running){
+  if(!handle || !running) return SL_STATUS_NULL_POINTER;
+  sim_call();
+  *running = false;
+  for(sl_sleeptimer_timer_handle_t *h = sim_st_head; h; h = h->next){
+      if(h == handle) *running = true;
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_sleeptimer_get_timer_time_remaining(sl_sleeptimer_timer_handle_t *handle, uint32_t *time){
+  bool running = false;
+
+  if(!time) return SL_STATUS_NULL_POINTER;
+  sl_sleeptimer_is_timer_running(handle, &running);
+  if(!running) return SL_STATUS_NOT_READY;
+  *time = handle->delta - sim_st_now();
+  return SL_STATUS_OK;
+}
+
+sl_status_t sl_sleeptimer_get_remaining_time_of_first_timer(uint16_t option_flags, uint32_t *time_remaining){
+  if(!time_remaining) return SL_STATUS_NULL_POINTER;
+  sim_call();
+  for(sl_sleeptimer_timer_handle_t *h = sim_st_head; h; h = h->next){
+      if(option_flags && !(h->option_flags & option_flags)) continue;
+      *time_remaining = h->delta - sim_st_now();
+      return SL_STATUS_OK;
+  }
+  return SL_STATUS_EMPTY;
+}
+
+uint32_t sl_sleeptimer_get_tick_count(void){
+  sim_call();
+  return sim_st_now();
+}
+
+uint64_t sl_sleeptimer_get_tick_count64(void){
+  sim_call();
+  return sim_now * SIM_RTCC_HZ / SIM_NS_PER_S;
+}
+
+uint32_t sl_sleeptimer_get_timer_frequency(void){
+  return SIM_RTCC_HZ;
+}
+
+uint32_t sl_sleeptimer_ms_to_tick(uint16_t time_ms){
+  return (uint32_t)(((uint64_t)time_ms * SIM_RTCC_HZ + 999) / 1000);
+}
+
+sl_status_t sl_sleeptimer_ms32_to_tick(uint32_t time_ms, uint32_t *tick){
+  uint64_t ticks = ((uint64_t)time_ms * SIM_RTCC_HZ + 999) / 1000;
+
+  if(ticks > UINT32_MAX) return SL_STATUS_INVALID_PARAMETER;
+  *tick = (uint32_t)ticks;
+  return SL_STATUS_OK;
+}
+
+uint32_t sl_sleeptimer_tick_to_ms(uint32_t tick){
+  return (uint32_t)((uint64_t)tick * 1000 / SIM_RTCC_HZ);
+}
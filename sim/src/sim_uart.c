@@ -0,0 +1,483 @@
+/**
+ * @file sim_uart.c
+ * @brief LEUART0 and USART0 models of the host simulation
+ *Responsible for the transmit buffer and shifter, the two frame receive FIFO, LEUART frame blocking and the pins shared with the HM-10.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "sim.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SIM_UART_FRAME_BITS 10        // start, 8 data and stop bits
+#define SIM_UART_FIFO       2
+#define SIM_UART_BAUD_TOL   0.05      // baud mismatch a receiver still samples correctly
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef struct {
+  const char  *name;
+  bool        leuart;
+  int         clock;
+  SIM_DOMAIN  domain;
+  uint32_t    baud;         // as set
+  uint32_t    baud_hz;      // clock the divider was computed for, USART only
+  bool        txen, rxen, rxblock;
+  bool        buf_full;
+  uint8_t     buf;
+  bool        shifting;
+  uint8_t     shift;
+  uint32_t    shift_baud;   // rate of the frame on the wire
+  uint8_t     fifo[SIM_UART_FIFO];
+  uint32_t    fifo_count;
+  uint32_t    flags;        // latched flags, TXBL and RXDATAV are levels
+  uint32_t    tx_bytes, rx_bytes, rx_lost, rx_garbled, rx_blocked;
+  SIM_EVENT   tx_done;
+  SIM_IOREG   cmd, status, ifr, ifs, ifc, rxdata, txdata;
+} SIM_UART;
+
+static SIM_UART sim_leu, sim_usa;
+
+LEUART_TypeDef sim_leuart0;
+USART_TypeDef sim_usart0;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t sim_uart_baud(SIM_UART *u);
+static void sim_uart_load(SIM_UART *u);
+static void sim_uart_tx_done(SIM_EVENT *ev);
+static void sim_uart_write(SIM_UART *u, uint8_t byte);
+static void sim_uart_rx(SIM_UART *u, uint8_t byte);
+static void sim_uart_cmd(SIM_UART *u, uint32_t cmd);
+static uint32_t sim_uart_if(SIM_UART *u);
+static bool sim_leuart_level(void);
+static bool sim_usart_rx_level(void);
+static bool sim_usart_tx_level(void);
+static void sim_uart_cmd_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_uart_status_read(SIM_IOREG *reg);
+static uint32_t sim_uart_if_read(SIM_IOREG *reg);
+static void sim_uart_ifs_write(SIM_IOREG *reg, uint32_t value);
+static void sim_uart_ifc_write(SIM_IOREG *reg, uint32_t value);
+static uint32_t sim_uart_rxdata_read(SIM_IOREG *reg);
+static void sim_uart_txdata_write(SIM_IOREG *reg, uint32_t value);
+static void sim_uart_regs(SIM_UART *u);
+
+SIM_IO_FN(sim_leu_cmd_io, sim_leu.cmd)
+SIM_IO_FN(sim_leu_status_io, sim_leu.status)
+SIM_IO_FN(sim_leu_if_io, sim_leu.ifr)
+SIM_IO_FN(sim_leu_ifs_io, sim_leu.ifs)
+SIM_IO_FN(sim_leu_ifc_io, sim_leu.ifc)
+SIM_IO_FN(sim_leu_rxdata_io, sim_leu.rxdata)
+SIM_IO_FN(sim_leu_txdata_io, sim_leu.txdata)
+SIM_IO_FN(sim_usa_cmd_io, sim_usa.cmd)
+SIM_IO_FN(sim_usa_status_io, sim_usa.status)
+SIM_IO_FN(sim_usa_if_io, sim_usa.ifr)
+SIM_IO_FN(sim_usa_ifs_io, sim_usa.ifs)
+SIM_IO_FN(sim_usa_ifc_io, sim_usa.ifc)
+SIM_IO_FN(sim_usa_rxdata_io, sim_usa.rxdata)
+SIM_IO_FN(sim_usa_txdata_io, sim_usa.txdata)
+
+/***************************************************************************//**
+ * @brief
+ * Returns the rate on the wire.
+ *
+ * @details
+ * The LEUART runs from LFXO and keeps its rate. The USART divider is computed for the
+ * HFPER clock at USART_InitAsync(), a later core clock change moves the rate with it
+ * until the divider is set again.
+ ******************************************************************************/
+static uint32_t sim_uart_baud(SIM_UART *u){
+  if(u->leuart || !u->baud_hz) return u->baud;
+  return (uint32_t)((uint64_t)u->baud * sim_hf_hz() / u->baud_hz);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Moves the buffered byte into an idle shifter.
+ ******************************************************************************/
+static void sim_uart_load(SIM_UART *u){
+  if(u->shifting || !u->buf_full || !u->txen) return;
+  u->shift = u->buf;
+  u->buf_full = false;
+  u->shifting = true;
+  u->shift_baud = sim_uart_baud(u);
+  sim_event_in(&u->tx_done, (SIM_UART_FRAME_BITS * SIM_NS_PER_S + u->shift_baud - 1) / u->shift_baud);
+  if(!u->leuart) sim_ldma_signal(ldmaPeripheralSignal_USART0_TXBL);
+}
+
+/***************************************************************************//**
+ * @brief
+ * End of a frame on TX: out the pin and, in loopback, into the own receiver.
+ ******************************************************************************/
+static void sim_uart_tx_done(SIM_EVENT *ev){
+  SIM_UART *u = ev->ctx;
+  uint32_t routepen = u->leuart ? sim_leuart0.ROUTEPEN : sim_usart0.ROUTEPEN;
+  bool loopback = u->leuart && (sim_leuart0.CTRL & LEUART_CTRL_LOOPBK);
+
+  u->shifting = false;
+  u->tx_bytes++;
+  if(routepen & (u->leuart ? LEUART_ROUTEPEN_TXPEN : USART_ROUTEPEN_TXPEN)) sim_hm10_rx(u->shift, u->shift_baud);
+  if(loopback) sim_uart_rx(u, u->shift);
+  sim_uart_load(u);
+  if(!u->shifting) u->flags |= u->leuart ? LEUART_IF_TXC : USART_IF_TXC;
+}
+
+/***************************************************************************//**
+ * @brief
+ * A TXDATA write, a byte written to a full buffer is lost.
+ ******************************************************************************/
+static void sim_uart_write(SIM_UART *u, uint8_t byte){
+  if(u->buf_full){
+      u->flags |= LEUART_IF_TXOF;
+      return;
+  }
+  u->buf = byte;
+  u->buf_full = true;
+  u->flags &= ~(u->leuart ? LEUART_IF_TXC : USART_IF_TXC);
+  sim_uart_load(u);
+}
+
+/***************************************************************************//**
+ * @brief
+ * A frame received, blocked, overflowed or buffered.
+ *
+ * @details
+ * While the LEUART receiver is blocked a frame is discarded unless it is the start frame
+ * and SFUBRX is set, which unblocks the receiver and is buffered. STARTF is raised for
+ * a start frame and SIGF for a signal frame that is buffered.
+ ******************************************************************************/
+static void sim_uart_rx(SIM_UART *u, uint8_t byte){
+  if(!u->rxen) return;
+  if(u->leuart){
+      bool start = (byte == (uint8_t)sim_leuart0.STARTFRAME);
+
+      if(start) u->flags |= LEUART_IF_STARTF;
+      if(u->rxblock){
+          if(!start || !(sim_leuart0.CTRL & LEUART_CTRL_SFUBRX)){
+              u->rx_blocked++;
+              return;
+          }
+          u->rxblock = false;
+      }
+  }
+  if(u->fifo_count == SIM_UART_FIFO){
+      u->flags |= u->leuart ? LEUART_IF_RXOF : USART_IF_RXOF;
+      u->rx_lost++;
+      return;
+  }
+  u->fifo[u->fifo_count++] = byte;
+  u->rx_bytes++;
+  if(u->leuart && (byte == (uint8_t)sim_leuart0.SIGFRAME)) u->flags |= LEUART_IF_SIGF;
+}
+
+static void sim_uart_cmd(SIM_UART *u, uint32_t cmd){
+  // LEUART and USART share the enable bits, the clear bits differ
+  uint32_t clear_tx = u->leuart ? LEUART_CMD_CLEARTX : USART_CMD_CLEARTX;
+  uint32_t clear_rx = u->leuart ? LEUART_CMD_CLEARRX : USART_CMD_CLEARRX;
+
+  if(cmd & LEUART_CMD_RXEN) u->rxen = true;
+  if(cmd & LEUART_CMD_RXDIS) u->rxen = false;
+  if(cmd & LEUART_CMD_TXEN) u->txen = true;
+  if(cmd & LEUART_CMD_TXDIS) u->txen = false;
+  if(u->leuart){
+      if(cmd & LEUART_CMD_RXBLOCKEN) u->rxblock = true;
+      if(cmd & LEUART_CMD_RXBLOCKDIS) u->rxblock = false;
+  }
+  if(cmd & clear_tx){
+      sim_event_cancel(&u->tx_done);
+      u->shifting = false;
+      u->buf_full = false;
+  }
+  if(cmd & clear_rx) u->fifo_count = 0;
+  sim_uart_load(u);
+}
+
+static uint32_t sim_uart_if(SIM_UART *u){
+  uint32_t flags = u->flags;
+
+  if(u->leuart){
+      if(!u->buf_full) flags |= LEUART_IF_TXBL;
+      if(u->fifo_count) flags |= LEUART_IF_RXDATAV;
+  }else{
+      if(!u->buf_full) flags |= USART_IF_TXBL;
+      if(u->fifo_count) flags |= USART_IF_RXDATAV;
+      if(u->fifo_count == SIM_UART_FIFO) flags |= USART_IF_RXFULL;
+  }
+  return flags;
+}
+
+static bool sim_leuart_level(void){
+  return (sim_uart_if(&sim_leu) & sim_leuart0.IEN) != 0;
+}
+
+static bool sim_usart_rx_level(void){
+  return (sim_uart_if(&sim_usa) & sim_usart0.IEN & (USART_IF_RXDATAV | USART_IF_RXFULL | USART_IF_RXOF)) != 0;
+}
+
+static bool sim_usart_tx_level(void){
+  return (sim_uart_if(&sim_usa) & sim_usart0.IEN & (USART_IF_TXC | USART_IF_TXBL)) != 0;
+}
+
+static void sim_uart_cmd_write(SIM_IOREG *reg, uint32_t value){
+  sim_uart_cmd(reg->ctx, value);
+}
+
+static uint32_t sim_uart_status_read(SIM_IOREG *reg){
+  SIM_UART *u = reg->ctx;
+  uint32_t status = 0;
+  bool txc = !u->buf_full && !u->shifting;
+
+  if(u->leuart){
+      if(u->rxen) status |= LEUART_STATUS_RXENS;
+      if(u->txen) status |= LEUART_STATUS_TXENS;
+      if(u->rxblock) status |= LEUART_STATUS_RXBLOCK;
+      if(txc) status |= LEUART_STATUS_TXC;
+      if(!u->buf_full) status |= LEUART_STATUS_TXBL;
+      if(u->fifo_count) status |= LEUART_STATUS_RXDATAV;
+  }else{
+      if(u->rxen) status |= USART_STATUS_RXENS;
+      if(u->txen) status |= USART_STATUS_TXENS;
+      if(txc) status |= USART_STATUS_TXC;
+      if(!u->buf_full) status |= USART_STATUS_TXBL;
+      if(u->fifo_count) status |= USART_STATUS_RXDATAV;
+      if(u->fifo_count == SIM_UART_FIFO) status |= USART_STATUS_RXFULL;
+  }
+  return status;
+}
+
+static uint32_t sim_uart_if_read(SIM_IOREG *reg){
+  return sim_uart_if(reg->ctx);
+}
+
+static void sim_uart_ifs_write(SIM_IOREG *reg, uint32_t value){
+  ((SIM_UART *)reg->ctx)->flags |= value;
+}
+
+static void sim_uart_ifc_write(SIM_IOREG *reg, uint32_t value){
+  ((SIM_UART *)reg->ctx)->flags &= ~value;
+}
+
+static uint32_t sim_uart_rxdata_read(SIM_IOREG *reg){
+  SIM_UART *u = reg->ctx;
+  uint8_t byte;
+
+  if(!u->fifo_count){
+      u->flags |= u->leuart ? LEUART_IF_RXUF : 0;
+      return 0;
+  }
+  byte = u->fifo[0];
+  u->fifo[0] = u->fifo[1];
+  u->fifo_count--;
+  return byte;
+}
+
+static void sim_uart_txdata_write(SIM_IOREG *reg, uint32_t value){
+  sim_uart_write(reg->ctx, (uint8_t)value);
+}
+
+static void sim_uart_regs(SIM_UART *u){
+  void *ctx = u;
+
+  sim_event_init(&u->tx_done, u->leuart ? "LEUART0 TX frame" : "USART0 TX frame", u->domain, sim_uart_tx_done, ctx);
+  sim_reg_init(&u->cmd, u->leuart ? "LEUART0_CMD" : "USART0_CMD", u->clock, NULL, sim_uart_cmd_write, ctx, 0);
+  sim_reg_init(&u->status, u->leuart ? "LEUART0_STATUS" : "USART0_STATUS", u->clock, sim_uart_status_read, NULL, ctx, 0);
+  sim_reg_init(&u->ifr, u->leuart ? "LEUART0_IF" : "USART0_IF", u->clock, sim_uart_if_read, NULL, ctx, 0);
+  sim_reg_init(&u->ifs, u->leuart ? "LEUART0_IFS" : "USART0_IFS", u->clock, NULL, sim_uart_ifs_write, ctx, 0);
+  sim_reg_init(&u->ifc, u->leuart ? "LEUART0_IFC" : "USART0_IFC", u->clock, NULL, sim_uart_ifc_write, ctx, 0);
+  sim_reg_init(&u->rxdata, u->leuart ? "LEUART0_RXDATA" : "USART0_RXDATA", u->clock, sim_uart_rxdata_read, NULL, ctx, 0);
+  sim_reg_init(&u->txdata, u->leuart ? "LEUART0_TXDATA" : "USART0_TXDATA", u->clock, NULL, sim_uart_txdata_write, ctx, SIM_IDLE_DATA);
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Puts LEUART0 and USART0 in their reset state.
+ ******************************************************************************/
+void sim_uart_reset(void){
+  memset(&sim_leu, 0, sizeof(sim_leu));
+  memset(&sim_usa, 0, sizeof(sim_usa));
+  memset(&sim_leuart0, 0, sizeof(sim_leuart0));
+  memset(&sim_usart0, 0, sizeof(sim_usart0));
+  sim_leu.name = "LEUART0";
+  sim_leu.leuart = true;
+  sim_leu.clock = cmuClock_LEUART0;
+  sim_leu.domain = SIM_DOMAIN_LFXO;
+  sim_usa.name = "USART0";
+  sim_usa.clock = cmuClock_USART0;
+  sim_usa.domain = SIM_DOMAIN_HF;
+  sim_uart_regs(&sim_leu);
+  sim_uart_regs(&sim_usa);
+
+  sim_leuart0.CMD_io = sim_leu_cmd_io;
+  sim_leuart0.STATUS_io = sim_leu_status_io;
+  sim_leuart0.IF_io = sim_leu_if_io;
+  sim_leuart0.IFS_io = sim_leu_ifs_io;
+  sim_leuart0.IFC_io = sim_leu_ifc_io;
+  sim_leuart0.RXDATA_io = sim_leu_rxdata_io;
+  sim_leuart0.TXDATA_io = sim_leu_txdata_io;
+  sim_usart0.CMD_io = sim_usa_cmd_io;
+  sim_usart0.STATUS_io = sim_usa_status_io;
+  sim_usart0.IF_io = sim_usa_if_io;
+  sim_usart0.IFS_io = sim_usa_ifs_io;
+  sim_usart0.IFC_io = sim_usa_ifc_io;
+  sim_usart0.RXDATA_io = sim_usa_rxdata_io;
+  sim_usart0.TXDATA_io = sim_usa_txdata_io;
+  sim_irq_level(LEUART0_IRQn, sim_leuart_level);
+  sim_irq_level(USART0_RX_IRQn, sim_usart_rx_level);
+  sim_irq_level(USART0_TX_IRQn, sim_usart_tx_level);
+}
+
+/***************************************************************************//**
+ * @brief
+ * A frame from the HM-10 reaching the MCU, taken by the UART whose RX pin is routed.
+ *
+ * @details
+ * A receiver more than SIM_UART_BAUD_TOL off the sender's rate samples garbage. A
+ * receiver whose clock is stopped by the energy mode loses the frame, which is counted
+ * against the domain like an event firing there.
+ *
+ * @param[in] byte
+ * Frame sent
+ *
+ * @param[in] baud
+ * Rate it was sent at
+ ******************************************************************************/
+void sim_uart_pin_rx(uint8_t byte, uint32_t baud){
+  SIM_UART *u;
+  uint32_t rate;
+
+  if((sim_leuart0.ROUTEPEN & LEUART_ROUTEPEN_RXPEN) && sim_clock_on(cmuClock_LEUART0)){
+      u = &sim_leu;
+      if(sim_em >= SIM_EM3){
+          if(sim_stats.lf_in_em3++ < 8) sim_log("LEUART0 frame received in EM3, LFXO is stopped");
+          return;
+      }
+  }else if((sim_usart0.ROUTEPEN & USART_ROUTEPEN_RXPEN) && sim_clock_on(cmuClock_USART0)){
+      u = &sim_usa;
+      if(sim_em >= SIM_EM2){
+          if(sim_stats.hf_in_sleep++ < 8) sim_log("USART0 frame received in EM%d, HFPER is stopped", sim_em);
+          return;
+      }
+  }else{
+      return;
+  }
+  rate = sim_uart_baud(u);
+  if(((double)baud > rate * (1.0 + SIM_UART_BAUD_TOL)) || ((double)baud < rate * (1.0 - SIM_UART_BAUD_TOL))){
+      u->rx_garbled++;
+      byte = (uint8_t)(byte * 0x9D + 0x5B);   // not the byte sent, and not a clean start frame
+  }
+  sim_uart_rx(u, byte);
+  sim_progress();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether the USART transmit buffer takes a DMA request.
+ ******************************************************************************/
+bool sim_usart_tx_ready(void){
+  return sim_usa.txen && !sim_usa.buf_full;
+}
+
+/***************************************************************************//**
+ * @brief
+ * A byte moved into TXDATA by the LDMA.
+ ******************************************************************************/
+void sim_usart_tx_dma(uint8_t byte){
+  sim_uart_write(&sim_usa, byte);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the UART totals as key=value lines.
+ ******************************************************************************/
+void sim_report_uart(FILE *out){
+  SIM_UART *uarts[] = { &sim_leu, &sim_usa };
+
+  for(int i = 0; i < 2; i++){
+      SIM_UART *u = uarts[i];
+
+      fprintf(out, "%s_tx=%u\n", u->leuart ? "leuart" : "usart", u->tx_bytes);
+      fprintf(out, "%s_rx=%u\n", u->leuart ? "leuart" : "usart", u->rx_bytes);
+      fprintf(out, "%s_rx_lost=%u\n", u->leuart ? "leuart" : "usart", u->rx_lost);
+      fprintf(out, "%s_rx_garbled=%u\n", u->leuart ? "leuart" : "usart", u->rx_garbled);
+      fprintf(out, "%s_rx_blocked=%u\n", u->leuart ? "leuart" : "usart", u->rx_blocked);
+  }
+}
+
+//***********************************************************************************
+// emlib LEUART
+//***********************************************************************************
+
+void LEUART_Init(LEUART_TypeDef *leuart, LEUART_Init_TypeDef const *init){
+  sim_call();
+  EFM_ASSERT(sim_clock_on(cmuClock_LEUART0));
+  sim_uart_cmd(&sim_leu, LEUART_CMD_RXDIS | LEUART_CMD_TXDIS);
+  leuart->CTRL = ((uint32_t)init->databits << 1) | ((uint32_t)init->parity << 2) | ((uint32_t)init->stopbits << 4);
+  sim_leu.baud = init->baudrate;
+  leuart->CLKDIV = (uint32_t)(((256ULL * SIM_LFXO_HZ) / init->baudrate) - 256) & ~7UL;
+  LEUART_Enable(leuart, init->enable);
+}
+
+void LEUART_Enable(LEUART_TypeDef *leuart, LEUART_Enable_TypeDef enable){
+  (void)leuart;
+  sim_call();
+  sim_uart_cmd(&sim_leu, (uint32_t)enable | ((~(uint32_t)enable & leuartEnable) << 1));
+}
+
+void LEUART_Reset(LEUART_TypeDef *leuart){
+  sim_call();
+  sim_uart_cmd(&sim_leu, LEUART_CMD_RXDIS | LEUART_CMD_TXDIS | LEUART_CMD_RXBLOCKDIS
+                         | LEUART_CMD_CLEARTX | LEUART_CMD_CLEARRX);
+  sim_leu.flags = 0;
+  leuart->CTRL = 0;
+  leuart->IEN = 0;
+  leuart->ROUTEPEN = 0;
+  leuart->STARTFRAME = 0;
+  leuart->SIGFRAME = 0;
+}
+
+//***********************************************************************************
+// emlib USART
+//***********************************************************************************
+
+void USART_InitAsync(USART_TypeDef *usart, const USART_InitAsync_TypeDef *init){
+  sim_call();
+  EFM_ASSERT(sim_clock_on(cmuClock_USART0));
+  sim_uart_cmd(&sim_usa, USART_CMD_RXDIS | USART_CMD_TXDIS);
+  usart->FRAME = (uint32_t)init->databits | ((uint32_t)init->parity << 8) | ((uint32_t)init->stopbits << 12);
+  USART_BaudrateAsyncSet(usart, init->refFreq, init->baudrate, init->oversampling);
+  USART_Enable(usart, init->enable);
+}
+
+void USART_Enable(USART_TypeDef *usart, USART_Enable_TypeDef enable){
+  (void)usart;
+  sim_call();
+  sim_uart_cmd(&sim_usa, (uint32_t)enable | ((~(uint32_t)enable & usartEnable) << 1));
+}
+
+void USART_Reset(USART_TypeDef *usart){
+  sim_call();
+  sim_uart_cmd(&sim_usa, USART_CMD_RXDIS | USART_CMD_TXDIS | USART_CMD_CLEARTX | USART_CMD_CLEARRX);
+  sim_usa.flags = 0;
+  usart->IEN = 0;
+  usart->ROUTEPEN = 0;
+}
+
+void USART_BaudrateAsyncSet(USART_TypeDef *usart, uint32_t refFreq, uint32_t baudrate, USART_OVS_TypeDef ovs){
+  (void)ovs;
+  sim_call();
+  sim_usa.baud = baudrate;
+  sim_usa.baud_hz = refFreq ? refFreq : sim_hf_hz();
+  usart->CLKDIV = (uint32_t)(((uint64_t)sim_usa.baud_hz * 256 / (16ULL * baudrate)) - 256);
+}
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Drops, delays and garbles HM-10 AT replies during the boot and checks the engine's retries.
+
+fw_sim_ble_test is fw_sim built with BLE_TEST_ENABLED, so the boot names the module
+through the AT command engine of ble.c: AT, AT+NAME and AT+RESET, three replies. Each
+case breaks some of them with --at-fault and runs one boot:
+
+  - none:        every reply on time;
+  - drop:        the first reply is lost, AT is sent again after BLE_AT_TIMEOUT_MS;
+  - slow:        the second reply comes 300 ms late, inside the timeout, nothing is resent;
+  - late:        the first reply comes after the timeout, the retry has to ignore it;
+  - garble:      the second reply has a wrong first byte, the engine drains and resends;
+  - reset drop:  the OK+RESET reply is lost, AT+RESET goes out a second time;
+  - dead:        AT goes unanswered on all BLE_AT_RETRIES + 1 tries, the boot gives up.
+
+The check fails if a boot does not end normally, if the LETIMER never starts the
+sensors after the AT sequence, if the module is not sent the commands the case needs,
+or if the red LED does not say whether the sequence failed.
+
+The link cases then connect a phone and move the link to the USART ("#B1!") after the
+boot, breaking the replies of the switch: the OK+RESET at 9600 (reply 6), or all tries
+of the AT check at 115200 (replies 7 to 9). The module keeps its rate over the reset, so
+ble_link_task() has to find it again. These fail if the module does not end at 9600 or
+the phone gets no readings in the last seconds of the run.
+
+    python3 sim/tests/at_fault.py _gate_build/fw_sim_ble_test
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+from sim_fuzz import parse_report
+
+CASES = [                          # name, faults, AT commands the module sees, red LED
+    ("none", [], 3, False),
+    ("drop", ["1:drop"], 4, False),
+    ("slow", ["2:delay:300"], 3, False),
+    ("late", ["1:delay:700"], 4, False),
+    ("garble", ["2:garble"], 4, False),
+    ("reset drop", ["3:drop"], 4, False),
+    ("dead", ["1:drop", "2:drop", "3:drop"], 3, True),
+]
+LINK_CASES = [                     # name, faults of the switch replies
+    ("switch", []),
+    ("switch reset", ["6:drop"]),
+    ("switch check", ["7:drop", "8:drop", "9:drop"]),
+]
+LINK_MS = 20000
+READING = re.compile(r"^(\d+\.\d+) < \[")
+
+
+def run(fw_sim, time_ms, faults, extra=()):
+    """Runs one boot with the AT replies given broken, returns its report and why it failed."""
+    args = [fw_sim, "--quiet", "--time", str(time_ms)] + list(extra)
+    for fault in faults:
+        args += ["--at-fault", fault]
+    result = subprocess.run(args, capture_output=True, text=True, timeout=120)
+    report = parse_report(result.stdout)
+    if report.get("status") != "0":
+        return None, "fw_sim failed: %s" % (result.stderr.strip() or result.stdout.strip())
+    return report, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim_ble_test executable")
+    parser.add_argument("--time", type=int, default=8000, help="simulated ms per boot")
+    opts = parser.parse_args()
+
+    problems = []
+    print("%-11s %5s %8s %6s %7s %4s" % ("case", "cmds", "replies", "faults", "resets", "red"))
+    for name, faults, cmds, red in CASES:
+        report, error = run(opts.fw_sim, opts.time, faults)
+        if error:
+            problems.append("%s: %s" % (name, error))
+            continue
+        print("%-11s %5s %8s %6s %7s %4s" % (name, report["hm10_at_cmds"], report["hm10_at_replies"],
+                                           report["hm10_at_faults"], report["hm10_resets"],
+                                           report["red_led_on"]))
+        if int(report["si1133_forces"]) == 0:
+            problems.append("%s: the boot never started the sensors" % name)
+        if int(report["hm10_at_cmds"]) != cmds:
+            problems.append("%s: %s AT commands, expected %d" % (name, report["hm10_at_cmds"], cmds))
+        if int(report["hm10_at_faults"]) != len(faults):
+            problems.append("%s: %s replies broken, expected %d" % (name, report["hm10_at_faults"], len(faults)))
+        if (int(report["red_led_on"]) != 0) != red:
+            problems.append("%s: red LED %s" % (name, "off" if red else "on"))
+
+    print()
+    print("%-13s %5s %8s %7s %9s" % ("link case", "cmds", "faults", "baud", "readings"))
+    with tempfile.TemporaryDirectory() as tmp:
+        log = os.path.join(tmp, "phone.txt")
+        for name, faults in LINK_CASES:
+            report, error = run(opts.fw_sim, LINK_MS, faults,
+                                ["--connect", "3000", "--cmd", "6000:B1", "--phone-log", log])
+            if error:
+                problems.append("%s: %s" % (name, error))
+                continue
+            with open(log) as f:
+                times = [float(m.group(1)) for m in map(READING.match, f) if m]
+            readings = len([t for t in times if t * 1000 >= LINK_MS - 5000])
+            print("%-13s %5s %8s %7s %9d" % (name, report["hm10_at_cmds"], report["hm10_at_faults"],
+                                           report["hm10_baud"], readings))
+            if report["hm10_baud"] != "9600":
+                problems.append("%s: the module ended at %s baud" % (name, report["hm10_baud"]))
+            if readings == 0:
+                problems.append("%s: the phone lost the link" % name)
+
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
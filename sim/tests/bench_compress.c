@@ -0,0 +1,128 @@
+/**
+ * @file bench_compress.c
+ * @brief Host benchmark of the sample compressor
+ *Responsible for the size and speed of the 'Z' live frames and 'Y' flash replay frames, filled the way app.c and flashlog.c fill them from generated sensor data.
+ *Usage: bench_compress [frames] [seed]
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "compress.h"
+#include "test_util.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define BENCH_FRAMES        200000
+#define BENCH_Z_CHANNELS    4         // light, RH, temperature, valid flags
+#define BENCH_Z_BATCH       16
+#define BENCH_Z_PAYLOAD     77        // APP_Z_FRAME less the header
+#define BENCH_Z_RAW         7         // 16 bit light, RH and temperature, a flag byte
+#define BENCH_Y_CHANNELS    3         // sequence number, ms timestamp, sample
+#define BENCH_Y_PAYLOAD     77        // FLOG_FRAME_MAX less the header
+#define BENCH_Y_RAW         10        // 32 bit sequence and timestamp, 16 bit sample
+#define BENCH_MAX_VALUES    1024
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef struct {
+  const char  *name;
+  uint8_t     channels;
+  uint32_t    payload;
+  uint32_t    raw;          // bytes per sample uncompressed
+  uint32_t    batch;        // samples per frame at most, 0 for as many as fit
+} BENCH_FRAME;
+
+static const BENCH_FRAME bench_frames[] = {
+  { "Z live",   BENCH_Z_CHANNELS, BENCH_Z_PAYLOAD, BENCH_Z_RAW, BENCH_Z_BATCH },
+  { "Y replay", BENCH_Y_CHANNELS, BENCH_Y_PAYLOAD, BENCH_Y_RAW, 0 },
+};
+
+static int32_t bench_light = 20, bench_rh = 450, bench_temp = 2250, bench_seq;
+static int32_t bench_ms;
+static volatile int32_t bench_sink;     // keeps the decoded values live
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Fills the channels of the next sample: light mostly flat with dark/light steps, RH
+ * and temperature drifting, a 1 s period with jitter.
+ ******************************************************************************/
+static void bench_sample(const BENCH_FRAME *frame, int32_t *values){
+  if(test_below(200) == 0) bench_light = (bench_light == 20) ? 200 : 20;
+  if(test_below(4) == 0) bench_rh += (int32_t)test_below(3) - 1;
+  if(test_below(3) == 0) bench_temp += (int32_t)test_below(5) - 2;
+  bench_ms += 1000 + (int32_t)test_below(3);
+  if(frame->channels == BENCH_Z_CHANNELS){
+      values[0] = bench_light;
+      values[1] = bench_rh;
+      values[2] = bench_temp;
+      values[3] = 1;
+  }else{
+      values[0] = bench_seq++;
+      values[1] = bench_ms;
+      values[2] = bench_light;
+  }
+}
+
+static void bench_run(const BENCH_FRAME *frame, uint32_t frames){
+  static int32_t values[BENCH_MAX_VALUES];
+  uint8_t out[BENCH_Z_PAYLOAD > BENCH_Y_PAYLOAD ? BENCH_Z_PAYLOAD : BENCH_Y_PAYLOAD];
+  uint64_t samples = 0, bytes = 0;
+  double enc_s = 0, dec_s = 0;
+
+  for(uint32_t f = 0; f < frames; f++){
+      COMP_ENC enc;
+      COMP_DEC dec;
+      uint32_t count = 0, len, got = 0;
+      int32_t value;
+      double start;
+
+      // samples are drawn first so only the compressor is timed
+      for(uint32_t i = 0; i + frame->channels <= BENCH_MAX_VALUES; i += frame->channels){
+          bench_sample(frame, &values[i]);
+      }
+      start = test_seconds();
+      comp_enc_init(&enc, frame->channels, out, frame->payload);
+      while(((frame->batch == 0) || (count < frame->batch * frame->channels)) &&
+            comp_enc_fits(&enc, frame->channels)){
+          for(uint8_t ch = 0; ch < frame->channels; ch++) comp_enc_put(&enc, values[count++]);
+      }
+      len = comp_enc_finish(&enc);
+      enc_s += test_seconds() - start;
+
+      start = test_seconds();
+      comp_dec_init(&dec, frame->channels, out, len);
+      while(comp_dec_get(&dec, &value)){
+          bench_sink = value;
+          got++;
+      }
+      dec_s += test_seconds() - start;
+      CHECK_EQ(got, count);
+      samples += count / frame->channels;
+      bytes += len;
+  }
+  printf("%-9s %8.2f %9.2f %7.2f %9.1f %9.1f\n", frame->name, (double)samples / frames,
+         (double)bytes / samples, (double)(samples * frame->raw) / bytes,
+         enc_s * 1e9 / (samples * frame->channels), dec_s * 1e9 / (samples * frame->channels));
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+int main(int argc, char *argv[]){
+  uint32_t frames = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_FRAMES;
+
+  if(argc > 2) test_seed(strtoull(argv[2], NULL, 0));
+  printf("%-9s %8s %9s %7s %9s %9s\n", "frame", "samples", "B/sample", "ratio", "enc_ns", "dec_ns");
+  for(uint32_t i = 0; i < sizeof(bench_frames) / sizeof(bench_frames[0]); i++){
+      bench_run(&bench_frames[i], frames);
+  }
+  return test_failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file bench_crc.c
+ * @brief Host benchmark of the CRC module, built once per CRC_BACKEND
+ *Responsible for the time per byte of CRC-16 and CRC-32 over BLE frame, flash record and page sized buffers, with the table memory of the backend.
+ *The GPCRC build times the simulation's bitwise model of the unit, its figures only compare the driver overhead across buffer sizes.
+ *Usage: bench_crc [megabytes]
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "crc.h"
+#include "test_util.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define BENCH_MEGABYTES     64
+#define BENCH_BUFFER        2048      // a flash page
+
+#if CRC_BACKEND == CRC_BACKEND_SLICE4
+#define BENCH_NAME          "SLICE4"
+#define BENCH_RAM           (4 * 256 * (sizeof(uint16_t) + sizeof(uint32_t)))
+#define BENCH_FLASH         0
+#elif CRC_BACKEND == CRC_BACKEND_NIBBLE
+#define BENCH_NAME          "NIBBLE"
+#define BENCH_RAM           0
+#define BENCH_FLASH         (16 * (sizeof(uint16_t) + sizeof(uint32_t)))
+#else
+#define BENCH_NAME          "GPCRC"
+#define BENCH_RAM           0
+#define BENCH_FLASH         0
+#endif
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static const uint32_t bench_sizes[] = { 8, 16, 64, 128, BENCH_BUFFER };
+static uint8_t bench_buffer[BENCH_BUFFER + 1];
+static volatile uint32_t bench_sink;
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+#if CRC_BACKEND == CRC_BACKEND_GPCRC
+void sim_call(void);
+bool sim_clock_on(int clock);
+
+void sim_call(void){
+}
+
+bool sim_clock_on(int clock){
+  (void)clock;
+  return true;
+}
+
+void clock_request(CMU_Clock_TypeDef clock){
+  (void)clock;
+}
+
+void clock_release(CMU_Clock_TypeDef clock){
+  (void)clock;
+}
+
+void assertEFM(const char *file, int line){
+  fprintf(stderr, "%s:%d: EFM_ASSERT failed\n", file, line);
+  exit(1);
+}
+#endif
+
+int main(int argc, char *argv[]){
+  uint64_t total = (uint64_t)((argc > 1) ? strtoul(argv[1], NULL, 0) : BENCH_MEGABYTES) << 20;
+
+#if CRC_BACKEND == CRC_BACKEND_GPCRC
+  total >>= 4;      // the bitwise model is slow
+#endif
+  for(uint32_t i = 0; i < sizeof(bench_buffer); i++) bench_buffer[i] = (uint8_t)test_rand();
+  crc_open();
+  printf("backend %s, tables %u B RAM, %u B flash\n", BENCH_NAME, (unsigned)BENCH_RAM, (unsigned)BENCH_FLASH);
+  printf("%6s %6s %10s %10s\n", "bytes", "align", "crc16_ns/B", "crc32_ns/B");
+  for(uint32_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++){
+      // frames start at any byte, so the unaligned case counts as much as the aligned one
+      for(uint32_t offset = 0; offset < 2; offset++){
+          uint32_t size = bench_sizes[i];
+          uint64_t calls = total / size;
+          double start, ns16, ns32;
+
+          start = test_seconds();
+          for(uint64_t call = 0; call < calls; call++) bench_sink = crc16(&bench_buffer[offset], size);
+          ns16 = (test_seconds() - start) * 1e9 / (double)(calls * size);
+          start = test_seconds();
+          for(uint64_t call = 0; call < calls; call++) bench_sink = crc32(&bench_buffer[offset], size);
+          ns32 = (test_seconds() - start) * 1e9 / (double)(calls * size);
+          printf("%6u %6u %10.3f %10.3f\n", (unsigned)size, (unsigned)offset, ns16, ns32);
+      }
+  }
+  return 0;
+}
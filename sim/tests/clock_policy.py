@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Compares the energy of the app's schedule with the core boosted for heavy jobs and pinned at full speed.
+
+Every scenario runs once on each build, both with --count-insns so the firmware's own
+instructions take core time at the HF clock:
+
+  - boost: fw_sim, the core runs at CMU_HFRCO_LOW and only goes to CMU_HFRCO_HIGH while a
+           job holds clock_boost_request(), the firmware default;
+  - hfxo:  fw_sim_hfxo, built with CMU_HFRCO_LOW as MCU_HFXO_FREQ, the core never slows.
+
+fw_sim draws EM0 power in proportion to the HF clock, so code costs the same energy at
+either speed and only takes 26/7 times as long at 7 MHz. What the boost policy saves is
+the time the core spends in EM0 waiting on the hardware, in polling loops and emlib
+calls, which costs per cycle and so less at the low clock.
+
+The check fails if a run does not end normally, if the boost run does not spend longer
+in EM0 than the hfxo run, which would mean the slow clock is not stretching the code, or
+if it uses more energy than the hfxo run.
+
+    python3 sim/tests/clock_policy.py _gate_build/fw_sim _gate_build/fw_sim_hfxo --time 60000
+"""
+
+import argparse
+import subprocess
+import sys
+
+from sim_fuzz import parse_report
+
+
+def scenarios(time_ms):
+    every = range(10000, time_ms, 10000)
+    return [
+        ("idle, no phone", ["--no-phone"]),
+        ("reports", ["--connect", "2000"] +
+         sum((["--cmd", "%d:S" % at, "--cmd", "%d:K" % (at + 2000)] for at in every), [])),
+    ]
+
+
+def run(fw_sim, args):
+    result = subprocess.run([fw_sim, "--quiet", "--count-insns"] + args, capture_output=True, text=True,
+                            timeout=600)
+    report = parse_report(result.stdout)
+    if report.get("status") != "0":
+        sys.exit("%s %s failed: %s" % (fw_sim, " ".join(args), result.stderr.strip() or result.stdout.strip()))
+    return report
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("fw_sim_hfxo", help="path of the fw_sim_hfxo executable")
+    parser.add_argument("--time", type=int, default=30000, help="simulated ms per run")
+    parser.add_argument("--seed", type=int, default=1)
+    opts = parser.parse_args()
+
+    problems = []
+    print("%-16s %-6s %11s %9s %9s %9s %10s %9s" %
+          ("scenario", "build", "energy_uj", "avg_uw", "em0_ms", "em0_uj", "insns", "saved"))
+    for scenario, args in scenarios(opts.time):
+        reports = {}
+        for build, fw_sim in (("hfxo", opts.fw_sim_hfxo), ("boost", opts.fw_sim)):
+            reports[build] = run(fw_sim, ["--seed", str(opts.seed), "--time", str(opts.time)] + args)
+        pinned = float(reports["hfxo"]["energy_uj"])
+        for build, report in reports.items():
+            energy = float(report["energy_uj"])
+            print("%-16s %-6s %11.1f %9.2f %9.1f %9.1f %10s %8.1f%%" %
+                  (scenario, build, energy, float(report["avg_uw"]), float(report["em0_ms"]),
+                   float(report["em0_uj"]), report["insns"], 100 * (pinned - energy) / pinned))
+        if float(reports["boost"]["em0_ms"]) <= float(reports["hfxo"]["em0_ms"]):
+            problems.append("%s: boost spent %s ms in EM0, hfxo %s" %
+                            (scenario, reports["boost"]["em0_ms"], reports["hfxo"]["em0_ms"]))
+        if float(reports["boost"]["energy_uj"]) > pinned:
+            problems.append("%s: boost used %s uJ, hfxo %s" % (scenario, reports["boost"]["energy_uj"], pinned))
+
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Measures the wear and the write cost of the flash log over days of logging without a phone.
+
+Each case is one long boot of fw_sim with no phone, so every sample goes to the flash log:
+
+  - clean:      no flash faults;
+  - bad page:   one log page never erases (--bad-page), the ring steps over it;
+  - flash fail: erases and word writes fail at random (--flash-fail).
+
+fw_sim counts the erases of every page. Their mean per page and day gives the years
+until the pages reach the MSC_CYCLES they are rated for, which print next to the years
+flashlog.h states for FLOG_PAGES. The most and least worn page show how even the ring
+keeps the wear. The time the MSC stalled the core is divided by the records logged,
+which is the cost a record adds to the average current.
+
+The check fails if a run does not end normally, if the clean or the bad page case wears
+the log out before the years flashlog.h states, scaled by the pages the case has left,
+or if the clean case does not spread its erases evenly over all FLOG_PAGES. The flash
+fail case only shows what the extra erases of a failed write cost.
+
+    python3 sim/tests/flash_bench.py _gate_build/fw_sim --days 2
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+from sim_fuzz import parse_report
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HEADER = os.path.normpath(os.path.join(HERE, "..", "..", "src", "Header Files", "flashlog.h"))
+MSC_CYCLES = 10000                # erase cycles per page MSC is rated for
+RECORD_S = 8                      # FLOG_DECIMATE samples of PWM_PER
+FIRST_S = 37                      # the first record of a boot is logged by then
+CASES = [                         # name, fw_sim options, log pages lost, None for no check
+    ("clean", [], 0),
+    ("bad page", ["--bad-page", "495"], 1),
+    ("flash fail", ["--flash-fail", "0.001"], None),
+]
+
+
+def stated():
+    """Returns FLOG_PAGES and the years of endurance the comment in flashlog.h states."""
+    with open(HEADER) as f:
+        text = f.read()
+    pages = int(re.search(r"#define\s+FLOG_PAGES\s+(\d+)", text).group(1))
+    years = int(re.search(r"(\d+) years to the", text).group(1))
+    return pages, years
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("--days", type=float, default=1, help="simulated days per case")
+    parser.add_argument("--seed", type=int, default=1)
+    opts = parser.parse_args()
+
+    pages, claim = stated()
+    seconds = opts.days * 86400
+    problems = []
+    print("%-10s %7s %6s %6s %6s %9s %7s %9s %10s" % ("case", "records", "pages", "max", "min",
+                                                       "erase/day", "years", "busy_ms", "us/record"))
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, args, lost in CASES:
+            flash = os.path.join(tmp, "flash.bin")
+            if os.path.exists(flash):
+                os.remove(flash)
+            result = subprocess.run([opts.fw_sim, "--quiet", "--no-phone", "--seed", str(opts.seed),
+                                     "--time", str(int(seconds * 1000)), "--flash", flash] + args,
+                                    capture_output=True, text=True, timeout=900)
+            report = parse_report(result.stdout)
+            if report.get("status") != "0":
+                problems.append("%s: fw_sim failed: %s" % (name, result.stderr.strip() or result.stdout.strip()))
+                continue
+            records = int((seconds - FIRST_S) // RECORD_S + 1)
+            most, least = int(report["flash_erases_max"]), int(report["flash_erases_min"])
+            per_day = int(report["flash_erases"]) / int(report["flash_pages_erased"]) / opts.days
+            years = MSC_CYCLES / (per_day * 365) if per_day else float("inf")
+            busy = float(report["flash_busy_ms"])
+            print("%-10s %7d %6s %6d %6d %9.2f %7.1f %9.1f %10.1f" %
+                  (name, records, report["flash_pages_erased"], most, least, per_day, years, busy,
+                   busy * 1000 / records))
+            if (lost is not None) and (years < claim * (pages - lost) / pages):
+                problems.append("%s: %.1f years to %d erases, flashlog.h states %d" % (name, years, MSC_CYCLES, claim))
+            if not args and (int(report["flash_pages_erased"]) != pages or most - least > 1):
+                problems.append("%s: %s pages erased, %d to %d times" % (name, report["flash_pages_erased"], least, most))
+
+    print()
+    print("flashlog.h states %d years over %d pages" % (claim, pages))
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
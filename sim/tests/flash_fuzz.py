@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Cuts the power under the flash log in random places and checks what the phone gets back.
+
+Each run boots fw_sim several times on one fresh flash image. Every boot but the last
+loses its power at --cut-at, or earlier in a flash word write (--cut-write) or a page
+erase (--cut-erase). Some runs also fail erases and writes at random (--flash-fail) or
+have a log page that never erases (--bad-page). The phone asks for the replay ("#R!") in
+every boot, the one of the last boot is checked:
+
+  - every boot ended normally, no failed EFM_ASSERT, and every line had a good CRC;
+  - "R end n:" counts the records the phone got;
+  - sequence numbers only go up, so no record comes twice or out of order;
+  - without injected faults there is no gap in them, a torn record is written again
+    under its number by the next boot;
+  - without injected faults every boot kept all but its last FLOG_BATCH records.
+
+A failing run prints the command line that reproduces it.
+
+    python3 sim/tests/flash_fuzz.py _gate_build/fw_sim --runs 200
+"""
+
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+from sim_fuzz import parse_report
+
+LOG_PAGES = range(480, 512)       # FLOG_PAGES at the end of the 1 MB flash
+RECORD_S = 8                      # FLOG_DECIMATE samples of PWM_PER
+FIRST_S = 37                      # the first record of a boot is logged by then
+BATCH = 8                         # FLOG_BATCH, the records a power cut may lose
+RING = (len(LOG_PAGES) - 1) * 170 # records the ring keeps, one page is being recycled
+REPLAY_MS = 5000
+RECORD = re.compile(r"(\d+),(\d+),(\d+);")
+
+
+def draw(rng):
+    boots = rng.randrange(2, 9)
+    args = ["--quiet", "--seed", str(rng.randrange(1 << 31)), "--boots", str(boots),
+            "--cut-at", str(rng.randrange(60, 7200) * 1000)]
+    kind = rng.choice(["time", "write", "write", "erase"])
+    if kind == "write":
+        args += ["--cut-write", str(rng.randrange(1, 600))]
+    elif kind == "erase":
+        args += ["--cut-erase", str(rng.randrange(1, 3))]
+    faults = False
+    if rng.random() < 0.2:
+        args += ["--flash-fail", "%.4f" % rng.uniform(0.0005, 0.01)]
+        faults = True
+    if rng.random() < 0.2:
+        args += ["--bad-page", str(rng.choice(LOG_PAGES))]
+        faults = True
+    args += ["--time", "150000", "--connect", "2000", "--cmd", "%d:R" % REPLAY_MS]
+    return args, faults
+
+
+def boots(text):
+    """Returns the report of every boot."""
+    reports = []
+    for part in re.split(r"^(?=boot=)", text, flags=re.M):
+        if part.strip():
+            reports.append(parse_report(part))
+    return reports
+
+
+def replay(log):
+    """Returns the sequence numbers of the last replay and the n of its "R end" line."""
+    seqs, end = None, None
+    for line in log.splitlines():
+        if " > #R*" in line:
+            seqs, end = [], None
+        elif seqs is not None and " < " in line:
+            text = line.split(" < ", 1)[1]
+            m = re.match(r"R end n:(\d+)", text)
+            if m:
+                end = int(m.group(1))
+            else:
+                seqs += [int(r.group(1)) for r in RECORD.finditer(text.split("*")[0])]
+    return seqs or [], end
+
+
+def check(reports, seqs, end, faults):
+    problems = []
+    for k, report in enumerate(reports):
+        if report.get("status") != "0":
+            problems.append("boot %d status %s" % (k, report.get("status")))
+        if report.get("phone_text_bad", "0") != "0":
+            problems.append("boot %d phone_text_bad=%s" % (k, report["phone_text_bad"]))
+    if end is None:
+        problems.append("the last replay did not end")
+        return problems
+    if end != len(seqs):
+        problems.append("R end n:%d after %d records" % (end, len(seqs)))
+    gaps = 0
+    for a, b in zip(seqs, seqs[1:]):
+        step = (b - a) & 0xFFFF
+        if step == 0 or step >= 0x8000:
+            problems.append("sequence %d after %d" % (b, a))
+            break
+        gaps += step - 1
+    if faults:
+        return problems
+    if gaps:
+        problems.append("%d sequence numbers missing" % gaps)
+    logged = sum(max(0, int(float(r["time_s"]) - FIRST_S) // RECORD_S + 1 - BATCH) for r in reports[:-1])
+    if logged <= RING and len(seqs) < logged:
+        problems.append("%d records replayed, at least %d kept" % (len(seqs), logged))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("--runs", type=int, default=100)
+    parser.add_argument("--seed", type=int, default=1, help="seed of the drawn runs")
+    opts = parser.parse_args()
+
+    rng = random.Random(opts.seed)
+    failures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        flash = os.path.join(tmp, "flash.bin")
+        log = os.path.join(tmp, "phone.txt")
+        for run in range(opts.runs):
+            args, faults = draw(rng)
+            for path in (flash, log):
+                if os.path.exists(path):
+                    os.remove(path)
+            result = subprocess.run([opts.fw_sim, "--flash", flash, "--phone-log", log] + args,
+                                    capture_output=True, text=True, timeout=300)
+            with open(log, errors="replace") as f:
+                seqs, end = replay(f.read())
+            problems = check(boots(result.stdout), seqs, end, faults)
+            if result.returncode and not problems:
+                problems.append("exit %d" % result.returncode)
+            if problems:
+                failures += 1
+                print("run %d: %s" % (run, ", ".join(problems)))
+                print("  %s --flash FILE --phone-log FILE %s" % (opts.fw_sim, " ".join(args)))
+                if result.stderr:
+                    print("  " + result.stderr.strip().replace("\n", "\n  "))
+    print("%d runs, %d failed" % (opts.runs, failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Compares the flash log replay over the LEUART and the USART link of the HM-18 module.
+
+A first boot without a phone fills the flash log for a while, each backlog size gets its
+own flash image. Every run then boots on a copy of that image, the phone connects at 2 s
+and, at 10 s:
+
+  - idle:   sends nothing, the energy the other runs are measured against;
+  - leuart: asks for the replay ("#R!") on the LEUART at 9600 baud;
+  - switch: moves the link to the USART ("#B1!") and sends nothing else;
+  - usart:  moves the link to the USART and asks for the replay once it is up.
+
+The replay time runs from the "#R!" to the "R end" line the phone gets, its bytes are
+what the UARTs sent on top of the idle run. The energy of a run is taken over the idle
+run, for the USART it includes both switches and the EM1 time the USART holds until
+ble_link_task() finds the link idle. A straight line through the energies of the backlog
+sizes splits each link into a fixed cost and a cost per KB, the backlog from which the
+USART saves energy is where the two lines cross.
+
+The check fails if a replay does not end or loses a frame, if the USART does not carry
+the replay at least MIN_SPEEDUP times as fast, if it does not cost less per KB, or if it
+does not use less energy than the LEUART for the largest backlog.
+
+    python3 sim/tests/link_bench.py _gate_build/fw_sim
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+from sim_fuzz import parse_report
+
+BACKLOGS_S = [1200, 7200, 21600]      # logging time before the replay boot
+RUN_MS = 90000
+CMD_MS = 10000
+SWITCH_MS = 3000                      # the USART link is up this long after "#B1!"
+MIN_SPEEDUP = 5
+RUNS = {
+    "idle": [],
+    "leuart": ["--cmd", "%d:R" % CMD_MS],
+    "switch": ["--cmd", "%d:B1" % CMD_MS],
+    "usart": ["--cmd", "%d:B1" % CMD_MS, "--cmd", "%d:R" % (CMD_MS + SWITCH_MS)],
+}
+END = re.compile(r"^(\d+\.\d+) < R end n:(\d+)")
+
+
+def run(fw_sim, flash, args, tmp):
+    """Returns the report of a run on a copy of flash and (end s, records) of its replay."""
+    image = os.path.join(tmp, "run.bin")
+    log = os.path.join(tmp, "phone.txt")
+    shutil.copyfile(flash, image)
+    result = subprocess.run([fw_sim, "--quiet", "--time", str(RUN_MS), "--connect", "2000",
+                             "--flash", image, "--phone-log", log] + args,
+                            capture_output=True, text=True, timeout=300)
+    report = parse_report(result.stdout)
+    if report.get("status") != "0":
+        sys.exit("fw_sim %s failed: %s" % (" ".join(args), result.stderr.strip() or result.stdout.strip()))
+    end = None
+    with open(log) as f:
+        for line in f:
+            m = END.match(line)
+            if m:
+                end = (float(m.group(1)), int(m.group(2)))
+    return report, end
+
+
+def sent(report):
+    return int(report["leuart_tx"]) + int(report["usart_tx"])
+
+
+def fit(points):
+    """Returns the least squares (fixed, per byte) of (bytes, energy) points."""
+    n = len(points)
+    mx = sum(x for x, _ in points) / n
+    my = sum(y for _, y in points) / n
+    slope = sum((x - mx) * (y - my) for x, y in points) / sum((x - mx) ** 2 for x, _ in points)
+    return my - slope * mx, slope
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    opts = parser.parse_args()
+
+    problems = []
+    points = {"leuart": [], "usart": []}
+    switch = []
+    print("%8s %-7s %7s %8s %8s %9s %10s" % ("backlog", "link", "records", "bytes", "time_s", "bytes/s", "energy_uj"))
+    with tempfile.TemporaryDirectory() as tmp:
+        for backlog in BACKLOGS_S:
+            flash = os.path.join(tmp, "backlog%d.bin" % backlog)
+            fill = subprocess.run([opts.fw_sim, "--quiet", "--no-phone", "--time", str(backlog * 1000),
+                                   "--flash", flash], capture_output=True, text=True, timeout=300)
+            if parse_report(fill.stdout).get("status") != "0":
+                sys.exit("filling the log for %d s failed: %s" % (backlog, fill.stderr.strip()))
+            reports, ends = {}, {}
+            for name, args in RUNS.items():
+                reports[name], ends[name] = run(opts.fw_sim, flash, args, tmp)
+            base = reports["idle"]
+            energy = {name: float(r["energy_uj"]) - float(base["energy_uj"]) for name, r in reports.items()}
+            switch.append(energy["switch"])
+            rates = {}
+            for link, start in (("leuart", CMD_MS), ("usart", CMD_MS + SWITCH_MS)):
+                report, end = reports[link], ends[link]
+                if end is None:
+                    problems.append("%d s backlog: the %s replay did not end" % (backlog, link))
+                    continue
+                if int(report["phone_text_bad"]) or (int(report["phone_cut"]) > int(reports["switch"]["phone_cut"])):
+                    problems.append("%d s backlog: frames lost on the %s replay" % (backlog, link))
+                size = sent(report) - sent(base)
+                seconds = end[0] - start / 1000.0
+                rates[link] = size / seconds
+                points[link].append((size, energy[link]))
+                print("%7ds %-7s %7d %8d %8.3f %9.0f %10.1f" %
+                      (backlog, link, end[1], size, seconds, rates[link], energy[link]))
+            if len(rates) == 2:
+                if rates["usart"] < rates["leuart"] * MIN_SPEEDUP:
+                    problems.append("%d s backlog: USART %.0f B/s, LEUART %.0f B/s" %
+                                    (backlog, rates["usart"], rates["leuart"]))
+                if (backlog == BACKLOGS_S[-1]) and (energy["usart"] >= energy["leuart"]):
+                    problems.append("%d s backlog: USART %.1f uJ, LEUART %.1f uJ" %
+                                    (backlog, energy["usart"], energy["leuart"]))
+
+    print()
+    print("switching to the USART and back without a transfer: %.1f uJ" % (sum(switch) / len(switch)))
+    if all(len(p) == len(BACKLOGS_S) for p in points.values()):
+        (fixed_l, byte_l), (fixed_u, byte_u) = fit(points["leuart"]), fit(points["usart"])
+        for link, fixed, per_byte in (("leuart", fixed_l, byte_l), ("usart", fixed_u, byte_u)):
+            print("%-7s %9.1f uJ fixed %9.2f uJ/KB" % (link, fixed, per_byte * 1024))
+        if byte_u < byte_l:
+            print("the USART uses less energy from %.1f KB of backlog" % ((fixed_u - fixed_l) / (byte_l - byte_u) / 1024))
+        else:
+            problems.append("the USART costs %.2f uJ/KB, the LEUART %.2f uJ/KB" % (byte_u * 1024, byte_l * 1024))
+
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Checks the deferred logger end to end on the host build of the firmware.
+
+  - the "logstr" section of fw_sim holds one entry per log site compiled in at
+    LOG_LEVEL, each with the file, line and format of its LOG_ call;
+  - the 'G' frames the phone receives format through tools/logfmt.py with fw_sim as
+    the ELF: every format id resolves, no record is dropped, and the "#K" and "#P"
+    reports, the boot message, the Si1133 lines and an I2C warning all come out.
+
+    python3 sim/tests/log_check.py _gate_build/fw_sim
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, "..", ".."))
+sys.path.insert(0, os.path.join(REPO, "tools"))
+
+import logfmt  # noqa: E402
+
+SOURCES = os.path.join(REPO, "src", "Source Files")
+LOG_H = os.path.join(REPO, "src", "Header Files", "log.h")
+SITE = re.compile(r'\bLOG_(TRACE|DEBUG|INFO|WARN|ERROR)\s*\(\s*"((?:[^"\\]|\\.)*)"')
+LEVEL = re.compile(r"#define\s+LOG_LEVEL\s+LOG_LVL_(\w+)")
+NAMES = {"TRACE": "T", "DEBUG": "D", "INFO": "I", "WARN": "W", "ERROR": "E"}
+
+EXPECTED = [
+    r"I app\.c:\d+ +Hello World",
+    r"I app\.c:\d+ +z = \d+\.\d",
+    r"I app\.c:\d+ +EM ms 0:\d+ 1:\d+ 2:\d+ 3:\d+",
+    r"I app\.c:\d+ +LEUART0 on:\d+ r:\d+",
+    r"I app\.c:\d+ +RTCC on:\d+ r:\d+",
+    r"I app\.c:\d+ +EM2 n:\d+ min:\d+ med:\d+ max:\d+",
+    r"I app\.c:\d+ +EM2 @\d+:\d+(,\d+){5}",
+    r"I app\.c:\d+ +SCHED n:\d+",
+    r"W i2c\.c:\d+ +I2C1 0x[0-9a-f]{2} failed, status \d+",
+]
+
+
+def source_sites():
+    """Returns {(file, line): (level, format)} of the LOG_ calls compiled in."""
+    with open(LOG_H) as f:
+        lowest = logfmt.LEVELS[NAMES[LEVEL.search(f.read()).group(1)]]
+    sites = {}
+    for name in sorted(os.listdir(SOURCES)):
+        if not name.endswith(".c"):
+            continue
+        with open(os.path.join(SOURCES, name)) as f:
+            for number, line in enumerate(f, 1):
+                m = SITE.search(line)
+                if m and logfmt.LEVELS[NAMES[m.group(1)]] >= lowest:
+                    fmt = m.group(2).encode().decode("unicode_escape")
+                    sites[(name, str(number))] = (NAMES[m.group(1)], fmt)
+    return sites
+
+
+def table_sites(elf):
+    """Returns {(file, line): (level, format)} of the "logstr" entries of the ELF."""
+    table = logfmt.elf_section(elf, logfmt.SECTION)
+    sites = {}
+    for k, entry in enumerate(table.split(b"\0")):
+        if not entry:
+            continue            # padding between the aligned entries
+        parts = entry.decode("utf-8", "replace").split(logfmt.SEP, 2)
+        if len(parts) != 3:
+            sys.exit("logstr entry %d is not level, place and format: %r" % (k, entry))
+        level, place, fmt = parts
+        file_name, _, line = place.rpartition(":")
+        sites[(os.path.basename(file_name), line)] = (level, fmt)
+    return sites
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    opts = parser.parse_args()
+    problems = []
+
+    expected, found = source_sites(), table_sites(opts.fw_sim)
+    for place in sorted(set(expected) | set(found)):
+        if expected.get(place) != found.get(place):
+            problems.append("%s:%s in the source %r, in logstr %r" %
+                            (place[0], place[1], expected.get(place), found.get(place)))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        capture = os.path.join(tmp, "capture.bin")
+        run = subprocess.run([opts.fw_sim, "--quiet", "--time", "30000", "--connect", "0",
+                              "--i2c-nack", "0.2", "--cmd", "6000:K", "--cmd", "8000:S",
+                              "--cmd", "12000:P", "--capture", capture],
+                             capture_output=True, text=True, timeout=60)
+        if "status=0" not in run.stdout.splitlines():
+            problems.append("fw_sim failed: %s" % (run.stderr.strip() or run.stdout.strip()))
+        out = subprocess.run([sys.executable, os.path.join(REPO, "tools", "logfmt.py"), capture,
+                              "--elf", opts.fw_sim], capture_output=True, text=True, timeout=60)
+    lines = out.stdout.splitlines()
+    if out.returncode:
+        problems.append("logfmt.py failed: %s" % out.stderr.strip())
+    for line in lines:
+        if "unknown format id" in line or "dropped" in line:
+            problems.append("logfmt.py: %s" % line.strip())
+    for pattern in EXPECTED:
+        if not any(re.search(pattern, line) for line in lines):
+            problems.append("no line matches %s" % pattern)
+
+    for problem in problems:
+        print(problem)
+    print("%d log sites, %d formatted lines, %d problems" % (len(found), len(lines), len(problems)))
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
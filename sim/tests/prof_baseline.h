@@ -0,0 +1,29 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef PROF_BASELINE_SIM_HG
+#define PROF_BASELINE_SIM_HG
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+/* PROF_BASELINE of fw_sim, included through PROF_BASELINE_FILE. The medians are firmware
+ * instructions counted with --count-insns, the sleeps have no baseline.
+ * Written by python3 sim/tests/prof_bench.py fw_sim --write. */
+#define PROF_BASELINE { \
+  0,    /* EM1 */ \
+  0,    /* EM2 */ \
+  0,    /* EM3 */ \
+  221,  /* LEUART0 */ \
+  0,    /* LEUART1 */ \
+  0,    /* I2C0 */ \
+  378,  /* I2C1 */ \
+  220,  /* LETIMER0 */ \
+  35,   /* TXBL */ \
+  19,   /* RXDATAV */ \
+  25,   /* I2CACK */ \
+  42,   /* I2CRX */ \
+  47    /* SCHED */ \
+}
+
+#endif
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Counts the firmware instructions of the profiled ISRs and paths, against a stored baseline.
+
+fw_sim --count-insns makes DWT_CYCCNT count the instructions the firmware's own code
+executes, so the profiler channels of a "#P" report hold instruction counts that do not
+depend on the host. The run connects the phone, has I2C1 NACK some transfers and asks for
+the report; its 'G' frames format through tools/logfmt.py with fw_sim as the ELF.
+
+The min/median/max of every channel print next to the median stored in
+sim/tests/prof_baseline.h, which fw_sim builds in as PROF_BASELINE_FILE. The check fails
+if a median exceeds its baseline by more than PROF_REGRESS_PCT, if the firmware flagged
+a channel with REG, or if a channel with a baseline got no samples. Sleep channels are
+in sleeptimer ticks and have no baseline. --write stores the medians of this run.
+
+    python3 sim/tests/prof_bench.py _gate_build/fw_sim [--write]
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+from sim_fuzz import parse_report
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, "..", ".."))
+BASELINE = os.path.join(HERE, "prof_baseline.h")
+FW_BASELINE = os.path.join(REPO, "src", "Header Files", "prof_baseline.h")
+
+# in the order of PROF_CHANNEL, the sleeps first
+CHANNELS = ["EM1", "EM2", "EM3", "LEUART0", "LEUART1", "I2C0", "I2C1", "LETIMER0",
+            "TXBL", "RXDATAV", "I2CACK", "I2CRX", "SCHED"]
+SLEEPS = 3
+LINE = re.compile(r"\b(\w+) n:(\d+) min:(\d+) med:(\d+) max:(\d+)(?: @[\d:,]+)?( REG)?\s*$")
+ENTRY = re.compile(r"^\s*(\d+),?\s*/\*\s*(\w+)\s*\*/")
+
+HEADER = """//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef PROF_BASELINE_SIM_HG
+#define PROF_BASELINE_SIM_HG
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+/* PROF_BASELINE of fw_sim, included through PROF_BASELINE_FILE. The medians are firmware
+ * instructions counted with --count-insns, the sleeps have no baseline.
+ * Written by python3 sim/tests/prof_bench.py fw_sim --write. */
+#define PROF_BASELINE { \\
+%s
+}
+
+#endif
+"""
+
+
+def read_baseline():
+    """Returns {channel: median} of the stored baseline."""
+    with open(BASELINE) as f:
+        entries = [ENTRY.match(line) for line in f]
+    baseline = {m.group(2): int(m.group(1)) for m in entries if m}
+    if list(baseline) != CHANNELS:
+        sys.exit("%s does not list the channels %s" % (BASELINE, " ".join(CHANNELS)))
+    return baseline
+
+
+def write_baseline(stats):
+    rows = []
+    for k, name in enumerate(CHANNELS):
+        median = stats[name][2] if (k >= SLEEPS) and (name in stats) and stats[name][0] else 0
+        rows.append("  %-6s/* %s */ \\" % ("%d%s" % (median, "," if k < len(CHANNELS) - 1 else ""), name))
+    with open(BASELINE, "w") as f:
+        f.write(HEADER % "\n".join(rows))
+
+
+def regress_pct():
+    with open(FW_BASELINE) as f:
+        return int(re.search(r"#define\s+PROF_REGRESS_PCT\s+(\d+)", f.read()).group(1))
+
+
+def measure(fw_sim, time_ms, seed):
+    """Returns the report of fw_sim and {channel: (n, min, med, max, REG)} of its "#P" lines."""
+    with tempfile.TemporaryDirectory() as tmp:
+        capture = os.path.join(tmp, "capture.bin")
+        run = subprocess.run([fw_sim, "--quiet", "--count-insns", "--seed", str(seed),
+                              "--time", str(time_ms), "--connect", "0", "--i2c-nack", "0.2",
+                              "--cmd", "6000:K", "--cmd", "8000:S",
+                              "--cmd", "%d:P" % (time_ms - 3000), "--capture", capture],
+                             capture_output=True, text=True, timeout=600)
+        report = parse_report(run.stdout)
+        if report.get("status") != "0":
+            sys.exit("fw_sim failed: %s" % (run.stderr.strip() or run.stdout.strip()))
+        out = subprocess.run([sys.executable, os.path.join(REPO, "tools", "logfmt.py"), capture,
+                              "--elf", fw_sim], capture_output=True, text=True, timeout=60)
+    if out.returncode:
+        sys.exit("logfmt.py failed: %s" % out.stderr.strip())
+    stats = {}
+    for line in out.stdout.splitlines():
+        m = LINE.search(line)
+        if m and m.group(1) in CHANNELS:
+            stats[m.group(1)] = tuple(int(v) for v in m.group(2, 3, 4, 5)) + (bool(m.group(6)),)
+    return report, stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("--time", type=int, default=15000, help="simulated ms, the report is asked for 3 s before the end")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--write", action="store_true", help="store the medians of this run as the baseline")
+    opts = parser.parse_args()
+
+    report, stats = measure(opts.fw_sim, opts.time, opts.seed)
+    missing = [name for name in CHANNELS if name not in stats]
+    if missing:
+        sys.exit("no \"#P\" line for %s" % " ".join(missing))
+    if opts.write:
+        write_baseline(stats)
+        print("wrote %s" % BASELINE)
+        return 0
+
+    baseline, pct = read_baseline(), regress_pct()
+    problems = []
+    print("%d firmware instructions in %d ms" % (int(report["insns"]), opts.time))
+    print("%-9s %7s %8s %8s %8s %9s %7s" % ("channel", "n", "min", "med", "max", "baseline", "change"))
+    for name in CHANNELS:
+        n, low, median, high, flagged = stats[name]
+        base = baseline[name]
+        change = "%+.1f%%" % ((median - base) * 100.0 / base) if base and n else ""
+        print("%-9s %7d %8d %8d %8d %9s %7s%s" % (name, n, low, median, high, base or "-", change,
+                                                  " REG" if flagged else ""))
+        if flagged:
+            problems.append("%s: the firmware flagged a regression" % name)
+        if not base:
+            continue
+        if not n:
+            problems.append("%s: no samples, baseline %d" % (name, base))
+        elif median * 100 > base * (100 + pct):
+            problems.append("%s: median %d over the baseline %d by more than %d%%" % (name, median, base, pct))
+        elif median * (100 + pct) < base * 100:
+            print("%s improved by more than %d%%, refresh the baseline with --write" % (name, pct))
+
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Times the host simulation and tabulates the energy of a few firmware workloads.
+
+Each scenario is one fw_sim run; the table gives the host time it took, how many
+simulated seconds run per host second, and from the fw_sim report the average
+power, the energy mode residency, the core cycles and the interrupts taken.
+
+    python3 sim/tests/sim_bench.py _gate_build/fw_sim --time 600000
+"""
+
+import argparse
+import subprocess
+import sys
+import time
+
+from sim_fuzz import parse_report
+
+
+def scenarios(time_ms):
+    every = range(10000, time_ms, 10000)
+    return [
+        ("periodic reads", ["--connect", "2000"]),
+        ("sensor reads", ["--connect", "2000"] + sum((["--cmd", "%d:S" % at] for at in every), [])),
+        ("LED fades", ["--connect", "2000"] +
+         sum((["--cmd", "%d:C%s" % (at, "100000050" if (at // 10000) % 2 else "000100000")]
+              for at in every), [])),
+        ("USART link", ["--connect", "2000", "--cmd", "3000:B1"]),
+        ("I2C NACKs 20%", ["--connect", "2000", "--i2c-nack", "0.2"]),
+    ]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("--time", type=int, default=600000, help="simulated ms per scenario")
+    parser.add_argument("--seed", type=int, default=1)
+    opts = parser.parse_args()
+
+    print("%-16s %8s %9s %9s %7s %7s %7s %7s %12s %7s" %
+          ("scenario", "host_s", "sim_x", "avg_uw", "em0_%", "em1_%", "em2_%", "em3_%",
+           "cycles", "irqs"))
+    status = 0
+    for name, args in scenarios(opts.time):
+        cmd = [opts.fw_sim, "--quiet", "--seed", str(opts.seed), "--time", str(opts.time)] + args
+        start = time.perf_counter()
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        host_s = time.perf_counter() - start
+        report = parse_report(result.stdout)
+        if report.get("status") != "0":
+            print("%-16s failed: %s" % (name, result.stderr.strip() or result.stdout.strip()))
+            status = 1
+            continue
+        sim_ms = float(report["time_s"]) * 1000.0
+        residency = [100.0 * float(report.get("em%d_ms" % em, 0)) / sim_ms for em in range(4)]
+        irqs = sum(int(value) for key, value in report.items() if key.startswith("irq"))
+        print("%-16s %8.3f %9.0f %9.2f %7.2f %7.2f %7.2f %7.2f %12s %7d" %
+              (name, host_s, sim_ms / 1000.0 / host_s, float(report["avg_uw"]),
+               residency[0], residency[1], residency[2], residency[3], report["cycles"], irqs))
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Runs the host simulation with random faults and phone commands.
+
+Each run draws a seed, fault rates and a list of phone commands, then checks the
+key=value report of fw_sim:
+
+  - the boot ended normally, no failed EFM_ASSERT, stall or interrupt storm;
+  - no register was accessed with its clock off, no HF event fired in EM2/EM3 and
+    no LFXO event in EM3;
+  - without garbling on the link, every frame the phone got had a good CRC.
+
+A failing run prints the command line that reproduces it.
+
+    python3 sim/tests/sim_fuzz.py _gate_build/fw_sim --runs 200
+"""
+
+import argparse
+import random
+import subprocess
+import sys
+
+COMMANDS = ["S", "P", "K", "T", "T1700000000000", "X", "R", "Y", "Z", "B1", "B0",
+            "U+010", "U-010", "L+020", "L-020", "C050020080", "C100000000", "C1x0000000",
+            "U+1", "L-1x0", "U+0100"]
+RAW = ["#S!", "#Q*0000!", "garbage", "##", "!!!", "#" + "A" * 100 + "!"]
+
+
+def parse_report(text):
+    report = {}
+    for line in text.splitlines():
+        key, sep, value = line.partition("=")
+        if sep:
+            report[key] = value
+    return report
+
+
+def draw(rng, time_ms):
+    args = ["--quiet", "--seed", str(rng.randrange(1 << 31)), "--time", str(time_ms)]
+    garbled = False
+    if rng.random() < 0.3:
+        args += ["--i2c-nack", "%.2f" % rng.uniform(0.05, 0.5)]
+    if rng.random() < 0.2:
+        args += ["--sda-stuck"]
+    if rng.random() < 0.2:
+        args += ["--garble", "%.3f" % rng.uniform(0.001, 0.05)]
+        garbled = True
+    if rng.random() < 0.2:
+        args += ["--no-phone"]
+    else:
+        args += ["--connect", str(rng.randrange(0, time_ms // 2))]
+    args += ["--light", str(rng.choice([0, 1000, 4000, 10000]))]
+    for _ in range(rng.randrange(0, 12)):
+        at = rng.randrange(1000, time_ms)
+        if rng.random() < 0.15:
+            args += ["--raw", "%d:%s" % (at, rng.choice(RAW))]
+            garbled = True   # the firmware answers a bad frame, that is not a link error
+        else:
+            args += ["--cmd", "%d:%s" % (at, rng.choice(COMMANDS))]
+    return args, garbled
+
+
+def check(report, garbled):
+    problems = []
+    if report.get("status") != "0":
+        problems.append("status %s" % report.get("status"))
+    for key in ("no_clock", "hf_in_sleep", "lf_in_em3"):
+        if report.get(key, "0") != "0":
+            problems.append("%s=%s" % (key, report[key]))
+    if not garbled:
+        for key in ("phone_text_bad", "phone_bin_bad"):
+            if report.get(key, "0") != "0":
+                problems.append("%s=%s" % (key, report[key]))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("--runs", type=int, default=100)
+    parser.add_argument("--seed", type=int, default=1, help="seed of the drawn runs")
+    parser.add_argument("--time", type=int, default=40000, help="simulated ms per run")
+    opts = parser.parse_args()
+
+    rng = random.Random(opts.seed)
+    failures = 0
+    for run in range(opts.runs):
+        args, garbled = draw(rng, opts.time)
+        result = subprocess.run([opts.fw_sim] + args, capture_output=True, text=True, timeout=60)
+        problems = check(parse_report(result.stdout), garbled)
+        if result.returncode and not problems:
+            problems.append("exit %d" % result.returncode)
+        if problems:
+            failures += 1
+            print("run %d: %s" % (run, ", ".join(problems)))
+            print("  %s %s" % (opts.fw_sim, " ".join("'%s'" % a if " " in a else a for a in args)))
+            if result.stderr:
+                print("  " + result.stderr.strip().replace("\n", "\n  "))
+    print("%d runs, %d failed" % (opts.runs, failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Compares the energy of the app's schedule under the sleep policies of sleep_routines.c.
+
+Every scenario runs once per board and policy (fw_sim --sleep-policy):
+
+  - predictive: sleep_select_mode() with the board's own cost table, the firmware default;
+  - deepest:    the deepest mode the blocks allow, as without SLEEP_PREDICTIVE;
+  - em1:        EM1 whenever a deadline is known.
+
+The "default" board has the firmware's default cost table. Its EM2 exit takes 31 us,
+so EM2 beats EM1 for any deadline over about 127 us, and the shortest deadline the app
+ever has is a LEUART character at 9600 baud, about 1 ms. So there predictive and
+deepest come out the same. The "slow wake" board exits EM2 and EM3 in 600 us, as with the core on the
+HFXO, which has to restart after EM2. There the character gaps cost less in EM1, and
+predictive must choose EM1 for them and use less energy than deepest.
+
+The check fails if predictive uses more energy than either other policy on any board,
+or if it does not choose differently from deepest on the slow wake board.
+
+    python3 sim/tests/sleep_policy.py _gate_build/fw_sim --time 120000
+"""
+
+import argparse
+import subprocess
+import sys
+
+from sim_fuzz import parse_report
+
+POLICIES = ["predictive", "deepest", "em1"]
+BOARDS = [
+    ("default", []),
+    ("slow wake", ["--em-cost", "2:8,600,40", "--em-cost", "3:7,600,40"]),
+]
+TOLERANCE = 1.001       # predictive may not cost more than another policy by over 0.1%
+MIN_SAVING = 0.05       # and must save 5% over deepest on the slow wake board
+
+
+def scenarios(time_ms):
+    every = range(10000, time_ms, 10000)
+    return [
+        ("idle, no phone", ["--no-phone"]),
+        ("reports", ["--connect", "2000"] +
+         sum((["--cmd", "%d:S" % at, "--cmd", "%d:K" % (at + 2000)] for at in every), [])),
+        ("log traffic", ["--connect", "2000", "--i2c-nack", "0.2", "--cmd", "4000:P"]),
+    ]
+
+
+def run(fw_sim, args):
+    result = subprocess.run([fw_sim, "--quiet"] + args, capture_output=True, text=True, timeout=300)
+    report = parse_report(result.stdout)
+    if report.get("status") != "0":
+        sys.exit("fw_sim %s failed: %s" % (" ".join(args),
+                                           result.stderr.strip() or result.stdout.strip()))
+    return report
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    parser.add_argument("--time", type=int, default=60000, help="simulated ms per run")
+    parser.add_argument("--seed", type=int, default=1)
+    opts = parser.parse_args()
+
+    problems = []
+    print("%-16s %-10s %-11s %11s %9s %9s %9s %9s" %
+          ("scenario", "board", "policy", "energy_uj", "avg_uw", "em1_n", "em2_n", "switch_uj"))
+    for scenario, args in scenarios(opts.time):
+        for board, costs in BOARDS:
+            reports = {}
+            for policy in POLICIES:
+                report = run(opts.fw_sim, ["--seed", str(opts.seed), "--time", str(opts.time),
+                                           "--sleep-policy", policy] + costs + args)
+                reports[policy] = report
+                print("%-16s %-10s %-11s %11.1f %9.2f %9s %9s %9.1f" %
+                      (scenario, board, policy, float(report["energy_uj"]),
+                       float(report["avg_uw"]), report["em1_sleeps"], report["em2_sleeps"],
+                       float(report["switch_uj"])))
+            energy = {policy: float(report["energy_uj"]) for policy, report in reports.items()}
+            for policy in POLICIES[1:]:
+                if energy["predictive"] > energy[policy] * TOLERANCE:
+                    problems.append("%s on %s: predictive %.1f uJ over %s %.1f uJ" %
+                                    (scenario, board, energy["predictive"], policy, energy[policy]))
+            changed = reports["predictive"]["em1_sleeps"] != reports["deepest"]["em1_sleeps"]
+            if board == "slow wake":
+                if not changed or energy["predictive"] > energy["deepest"] * (1 - MIN_SAVING):
+                    problems.append("%s on %s: predictive did not beat deepest" % (scenario, board))
+        print()
+
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
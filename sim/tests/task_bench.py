@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Counts the firmware instructions of a task resume through scheduler_dispatch against a plain callback.
+
+fw_sim --count-insns makes DWT_CYCCNT count the instructions the firmware's own code
+executes, and scheduler_dispatch() records each handler's count in the trace ring as
+the argument of its TRACE_T_EVT_DONE record. The run connects the phone and, a few
+times, sends "#B0!" while the link is already on the LEUART: ble_link_request() posts
+BLE_LINK_CB, ble_link_task() resumes at its AWAIT_EVENT, finds nothing to switch and
+waits again, which is the whole cost of a resume. Each "B ok" reply ends on
+BLE_WRITE_DONE_CB, whose handler is scheduler_discard(), the plain callback. A "#X!"
+right after dumps the ring, read with tools/trace2chrome.py.
+
+Both counts include the same trace hook around the handler, their difference is what
+the task layer adds to a dispatch. These are x86-64 instructions of the host build,
+they rank the two paths but are not Cortex-M cycles.
+
+The check fails if the run does not end normally, if either event has no samples, or
+if a resume costs more than MAX_EXTRA instructions over the plain callback.
+
+    python3 sim/tests/task_bench.py _gate_build/fw_sim
+"""
+
+import argparse
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+
+from sim_fuzz import parse_report
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.normpath(os.path.join(HERE, "..", "..", "tools")))
+
+import trace2chrome  # noqa: E402
+
+ROUNDS_MS = [4000, 7000, 10000]  # each round sends B0 three times, then dumps the ring
+STEP_MS = 150
+RUN_MS = 12000
+TASK, PLAIN = "BLE_LINK_CB", "BLE_WRITE_DONE_CB"
+MAX_EXTRA = 40
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("fw_sim", help="path of the fw_sim executable")
+    opts = parser.parse_args()
+
+    args = ["--quiet", "--count-insns", "--time", str(RUN_MS), "--connect", "2000"]
+    for start in ROUNDS_MS:
+        args += sum((["--cmd", "%d:B0" % (start + k * STEP_MS)] for k in range(3)), [])
+        args += ["--cmd", "%d:X" % (start + 3 * STEP_MS)]
+
+    problems = []
+    counts = {TASK: [], PLAIN: []}
+    with tempfile.TemporaryDirectory() as tmp:
+        capture = os.path.join(tmp, "capture.bin")
+        result = subprocess.run([opts.fw_sim, "--capture", capture] + args, capture_output=True, text=True,
+                                timeout=300)
+        report = parse_report(result.stdout)
+        if report.get("status") != "0":
+            print("fw_sim failed: %s" % (result.stderr.strip() or result.stdout.strip()))
+            return 1
+        with open(capture, "rb") as f:
+            dumps = trace2chrome.split_dumps(f.read())
+
+    events = trace2chrome.event_names(trace2chrome.EVENTS_H)
+    for dump in dumps:
+        for _, rtype, rid, arg in dump["recs"]:
+            label = trace2chrome.name(events, rid, "EVT")
+            if (rtype == trace2chrome.T_EVT_DONE) and (label in counts) and (arg != trace2chrome.SATURATED):
+                counts[label].append(arg)
+
+    print("%-18s %-16s %4s %5s %5s %5s" % ("dispatch", "event", "n", "min", "med", "max"))
+    for kind, label in (("task resume", TASK), ("plain callback", PLAIN)):
+        values = counts[label]
+        if not values:
+            problems.append("%s: no %s in %d dumps" % (kind, label, len(dumps)))
+            continue
+        print("%-18s %-16s %4d %5d %5d %5d" % (kind, label, len(values), min(values),
+                                               statistics.median(values), max(values)))
+    if not problems:
+        extra = statistics.median(counts[TASK]) - statistics.median(counts[PLAIN])
+        print()
+        print("a resume costs %d instructions over a plain callback" % extra)
+        if extra > MAX_EXTRA:
+            problems.append("a resume costs %d instructions over a plain callback, at most %d" % (extra, MAX_EXTRA))
+
+    for problem in problems:
+        print(problem)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,237 @@
+/**
+ * @file test_compress.c
+ * @brief Host tests of the sample compressor
+ *Responsible for known encodings, round trips of generated streams over 1 to 4 channels, the output bound and decoding of malformed and random blocks.
+ *Usage: test_compress [fuzz iterations] [seed]
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "compress.h"
+#include "test_util.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TEST_MAX_VALUES     4096
+#define TEST_FUZZ_DEFAULT   5000
+#define TEST_FUZZ_MAX_LEN   64
+#define TEST_FUZZ_MAX_GETS  100000    // run tokens can stand for up to 2^30 zeros
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef enum {
+  TEST_WALK,          // Si1133 like: slow drift with noise
+  TEST_FLAT,          // long zero runs
+  TEST_STEPS,         // flat stretches broken by jumps
+  TEST_EXTREME,       // deltas near the limit, 2^30 after zigzag and the run flag
+  TEST_COUNTERS,      // sequence number and ms timestamp channels
+  TEST_PATTERNS
+} TEST_PATTERN;
+
+static int32_t test_values[TEST_MAX_VALUES];
+static int32_t test_decoded[TEST_MAX_VALUES];
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Encodes values into a fresh buffer of exactly cap bytes and returns it.
+ ******************************************************************************/
+static uint8_t *test_encode(const int32_t *values, uint32_t count, uint8_t channels, uint32_t cap,
+                            uint32_t *put, uint32_t *len){
+  uint8_t *out = malloc(cap ? cap : 1);
+  COMP_ENC enc;
+
+  comp_enc_init(&enc, channels, out, cap);
+  for(*put = 0; *put < count; (*put)++){
+      if(!comp_enc_put(&enc, values[*put])) break;
+  }
+  *len = comp_enc_finish(&enc);
+  CHECK(*len <= cap);
+  return out;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Decodes a block into test_decoded[] and returns the number of values read.
+ ******************************************************************************/
+static uint32_t test_decode(const uint8_t *in, uint32_t len, uint8_t channels, uint32_t max){
+  COMP_DEC dec;
+  uint32_t count = 0;
+
+  comp_dec_init(&dec, channels, in, len);
+  while((count < max) && comp_dec_get(&dec, &test_decoded[count])) count++;
+  CHECK(dec.pos <= len);
+  return count;
+}
+
+static void test_expect_bytes(const int32_t *values, uint32_t count, uint8_t channels,
+                              const uint8_t *expected, uint32_t expected_len){
+  uint32_t put, len;
+  uint8_t *out = test_encode(values, count, channels, 64, &put, &len);
+
+  CHECK_EQ(put, count);
+  CHECK_EQ(len, expected_len);
+  CHECK(memcmp(out, expected, expected_len) == 0);
+  CHECK_EQ(test_decode(out, len, channels, TEST_MAX_VALUES), count);
+  CHECK(memcmp(test_decoded, values, count * sizeof(values[0])) == 0);
+  free(out);
+}
+
+static void test_known_encodings(void){
+  test_expect_bytes((const int32_t[]){ 5 }, 1, 1, (const uint8_t[]){ 0x14 }, 1);
+  test_expect_bytes((const int32_t[]){ -1 }, 1, 1, (const uint8_t[]){ 0x02 }, 1);
+  // a single zero delta is a plain token, two or more fold into a run token
+  test_expect_bytes((const int32_t[]){ 0, 1 }, 2, 1, (const uint8_t[]){ 0x00, 0x04 }, 2);
+  test_expect_bytes((const int32_t[]){ 0, 0, 0, 5 }, 4, 1, (const uint8_t[]){ 0x07, 0x14 }, 2);
+  test_expect_bytes((const int32_t[]){ 0, 0 }, 2, 1, (const uint8_t[]){ 0x05 }, 1);
+  // 100 zigzags to 200, token 400 = 0x190 takes two varint bytes
+  test_expect_bytes((const int32_t[]){ 100 }, 1, 1, (const uint8_t[]){ 0x90, 0x03 }, 2);
+  // channels delta against their own previous value
+  test_expect_bytes((const int32_t[]){ 10, 20, 10, 20 }, 4, 2, (const uint8_t[]){ 0x28, 0x50, 0x05 }, 3);
+}
+
+static void test_generate(TEST_PATTERN pattern, uint8_t channels, uint32_t count){
+  int32_t level = (int32_t)test_below(65536);
+
+  for(uint32_t i = 0; i < count; i++){
+      uint8_t ch = (uint8_t)(i % channels);
+
+      switch(pattern){
+        case TEST_WALK:
+          level += (int32_t)test_below(9) - 4;
+          test_values[i] = level + (int32_t)ch * 1000;
+          break;
+        case TEST_FLAT:
+          test_values[i] = (test_below(200) == 0) ? (int32_t)test_below(65536) : 42;
+          break;
+        case TEST_STEPS:
+          if(test_below(16) == 0) level = (int32_t)test_below(65536) - 32768;
+          test_values[i] = level;
+          break;
+        case TEST_EXTREME:
+          test_values[i] = (test_rand() & 1) ? 0x1FFFFFFF : -0x1FFFFFFF;
+          break;
+        default:
+          test_values[i] = (ch == 0) ? (int32_t)(i / channels) : (int32_t)(i * 1000 + test_below(5));
+          break;
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Round trips generated streams through buffers sized by comp_enc_fits() and through
+ * buffers too small, where every value the encoder accepted must come back.
+ ******************************************************************************/
+static void test_round_trips(void){
+  for(int pattern = 0; pattern < TEST_PATTERNS; pattern++){
+      for(uint8_t channels = 1; channels <= COMP_MAX_CHANNELS; channels++){
+          for(int trial = 0; trial < 20; trial++){
+              uint32_t count = 1 + test_below(TEST_MAX_VALUES);
+              uint32_t cap = (trial & 1) ? test_below(count * 2) : (count + 1) * COMP_TOKEN_MAX;
+              uint32_t put, len;
+              uint8_t *out;
+
+              test_generate((TEST_PATTERN)pattern, channels, count);
+              out = test_encode(test_values, count, channels, cap, &put, &len);
+              if(!(trial & 1)) CHECK_EQ(put, count);
+              CHECK_EQ(test_decode(out, len, channels, TEST_MAX_VALUES), put);
+              CHECK(memcmp(test_decoded, test_values, put * sizeof(test_values[0])) == 0);
+              free(out);
+          }
+      }
+  }
+}
+
+static void test_rejects(const uint8_t *in, uint32_t len, uint32_t good){
+  uint8_t *copy = malloc(len ? len : 1);
+
+  if(len) memcpy(copy, in, len);
+  CHECK_EQ(test_decode(copy, len, 1, TEST_MAX_VALUES), good);
+  free(copy);
+}
+
+static void test_malformed(void){
+  test_rejects(NULL, 0, 0);
+  test_rejects((const uint8_t[]){ 0x01 }, 1, 0);                   // run of 0
+  test_rejects((const uint8_t[]){ 0x03 }, 1, 0);                   // run of 1
+  test_rejects((const uint8_t[]){ 0x14, 0x03, 0x14 }, 3, 1);       // stops at the bad run
+  test_rejects((const uint8_t[]){ 0x14, 0x80 }, 2, 1);             // truncated varint
+  test_rejects((const uint8_t[]){ 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 }, 6, 0); // over 5 bytes
+  test_rejects((const uint8_t[]){ 0x05, 0x14 }, 2, 3);
+  // deltas of -2^30 that no encoder wrote, the sum wraps instead of overflowing
+  test_rejects((const uint8_t[]){ 0xFE, 0xFF, 0xFF, 0xFF, 0x0F, 0xFE, 0xFF, 0xFF, 0xFF, 0x0F,
+                                  0xFE, 0xFF, 0xFF, 0xFF, 0x0F }, 15, 3);
+}
+
+// Values the encoder takes, every delta within the 2^30 its tokens hold
+static bool test_encodable(const int32_t *values, uint32_t count){
+  for(uint32_t i = 0; i < count; i++){
+      if((values[i] >= (1 << 29)) || (values[i] <= -(1 << 29))) return false;
+  }
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Decodes random blocks from buffers of their exact size, the sanitizers catch any read
+ * past the end. A block that decodes fully must re-encode to values that decode the same.
+ ******************************************************************************/
+static void test_fuzz(uint32_t iterations){
+  static int32_t first[TEST_FUZZ_MAX_GETS];
+
+  for(uint32_t i = 0; i < iterations; i++){
+      uint32_t len = test_below(TEST_FUZZ_MAX_LEN + 1);
+      uint8_t channels = (uint8_t)(1 + test_below(COMP_MAX_CHANNELS));
+      uint8_t *in = malloc(len ? len : 1);
+      COMP_DEC dec;
+      uint32_t count = 0;
+      int32_t value;
+
+      for(uint32_t j = 0; j < len; j++){
+          // bias towards small tokens, run tokens and long varints, which random bytes rarely are
+          switch(test_below(3)){
+            case 0:  in[j] = (uint8_t)test_below(8); break;
+            case 1:  in[j] = (uint8_t)(0xF8 | test_below(8)); break;
+            default: in[j] = (uint8_t)test_rand(); break;
+          }
+      }
+      comp_dec_init(&dec, channels, in, len);
+      while((count < TEST_FUZZ_MAX_GETS) && comp_dec_get(&dec, &value)) first[count++] = value;
+      CHECK(dec.pos <= len);
+      if((dec.pos == len) && (count <= TEST_MAX_VALUES) && test_encodable(first, count)){
+          uint32_t put, out_len;
+          uint8_t *out;
+
+          memcpy(test_values, first, count * sizeof(first[0]));
+          out = test_encode(test_values, count, channels, (count + 1) * COMP_TOKEN_MAX, &put, &out_len);
+          CHECK_EQ(test_decode(out, out_len, channels, TEST_MAX_VALUES), count);
+          CHECK(memcmp(test_decoded, first, count * sizeof(first[0])) == 0);
+          free(out);
+      }
+      free(in);
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+int main(int argc, char *argv[]){
+  uint32_t iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : TEST_FUZZ_DEFAULT;
+
+  if(argc > 2) test_seed(strtoull(argv[2], NULL, 0));
+  test_known_encodings();
+  test_round_trips();
+  test_malformed();
+  test_fuzz(iterations);
+  return test_result("test_compress");
+}
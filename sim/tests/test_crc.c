@@ -0,0 +1,153 @@
+/**
+ * @file test_crc.c
+ * @brief Host tests of the CRC module, built once per CRC_BACKEND
+ *Responsible for the catalogue check values, and for every length, alignment and split of random data against a bitwise reference. The GPCRC build runs crc.c against the simulation's model of the unit.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "crc.h"
+#include "test_util.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TEST_MAX_LEN        300
+#define TEST_SPLITS         2000
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#if CRC_BACKEND == CRC_BACKEND_GPCRC
+static int test_gpcrc_clock;          // requests of cmuClock_GPCRC not yet released
+#endif
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint16_t test_ref16(const uint8_t *data, uint32_t length){
+  uint16_t crc = CRC16_INIT;
+
+  while(length--){
+      crc ^= *data++;
+      for(int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ CRC16_POLY_REV) : (uint16_t)(crc >> 1);
+  }
+  return crc ^ CRC16_XOROUT;
+}
+
+static uint32_t test_ref32(const uint8_t *data, uint32_t length){
+  uint32_t crc = CRC32_INIT;
+
+  while(length--){
+      crc ^= *data++;
+      for(int bit = 0; bit < 8; bit++) crc = (crc & 1) ? ((crc >> 1) ^ CRC32_POLY_REV) : (crc >> 1);
+  }
+  return crc ^ CRC32_XOROUT;
+}
+
+static void test_check_values(void){
+  static const char check[] = "123456789";
+  static const char fox[] = "The quick brown fox jumps over the lazy dog";
+
+  CHECK_EQ(crc16(check, 9), 0x906E);
+  CHECK_EQ(crc32(check, 9), 0xCBF43926UL);
+  CHECK_EQ(crc32(fox, sizeof(fox) - 1), 0x414FA339UL);
+  CHECK_EQ(crc16(check, 0), 0x0000);
+  CHECK_EQ(crc32(check, 0), 0x00000000UL);
+  // the residue of a message followed by its CRC, LSB first as the frames carry it
+  {
+    uint8_t frame[11];
+    uint16_t crc = crc16(check, 9);
+
+    memcpy(frame, check, 9);
+    frame[9] = (uint8_t)crc;
+    frame[10] = (uint8_t)(crc >> 8);
+    CHECK_EQ(crc16_update(CRC16_INIT, frame, sizeof(frame)), 0xF0B8);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Every length up to TEST_MAX_LEN at every alignment of a word, the table backends take
+ * words and the GPCRC driver feeds bytes up to an aligned address.
+ ******************************************************************************/
+static void test_lengths(void){
+  static uint8_t buffer[TEST_MAX_LEN + 8];
+
+  for(uint32_t i = 0; i < sizeof(buffer); i++) buffer[i] = (uint8_t)test_rand();
+  for(uint32_t offset = 0; offset < 8; offset++){
+      for(uint32_t length = 0; length <= TEST_MAX_LEN; length++){
+          CHECK_EQ(crc16(&buffer[offset], length), test_ref16(&buffer[offset], length));
+          CHECK_EQ(crc32(&buffer[offset], length), test_ref32(&buffer[offset], length));
+      }
+  }
+}
+
+// A CRC carried across calls, as flashlog.c and the frame builders do
+static void test_splits(void){
+  static uint8_t buffer[TEST_MAX_LEN];
+
+  for(int trial = 0; trial < TEST_SPLITS; trial++){
+      uint32_t length = test_below(TEST_MAX_LEN + 1);
+      uint16_t c16 = CRC16_INIT;
+      uint32_t c32 = CRC32_INIT;
+      uint32_t at = 0;
+
+      for(uint32_t i = 0; i < length; i++) buffer[i] = (uint8_t)test_rand();
+      while(at < length){
+          uint32_t part = 1 + test_below(length - at);
+
+          c16 = crc16_update(c16, &buffer[at], part);
+          c32 = crc32_update(c32, &buffer[at], part);
+          at += part;
+      }
+      CHECK_EQ(c16 ^ CRC16_XOROUT, test_ref16(buffer, length));
+      CHECK_EQ(c32 ^ CRC32_XOROUT, test_ref32(buffer, length));
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+#if CRC_BACKEND == CRC_BACKEND_GPCRC
+// The firmware's cmu.c and the simulation core stand behind these in fw_sim
+void sim_call(void);
+bool sim_clock_on(int clock);
+
+void sim_call(void){
+}
+
+void assertEFM(const char *file, int line){
+  test_failures++;
+  fprintf(stderr, "%s:%d: EFM_ASSERT failed\n", file, line);
+}
+
+bool sim_clock_on(int clock){
+  return (clock == cmuClock_GPCRC) && (test_gpcrc_clock > 0);
+}
+
+void clock_request(CMU_Clock_TypeDef clock){
+  CHECK_EQ(clock, cmuClock_GPCRC);
+  test_gpcrc_clock++;
+}
+
+void clock_release(CMU_Clock_TypeDef clock){
+  CHECK_EQ(clock, cmuClock_GPCRC);
+  CHECK(test_gpcrc_clock > 0);
+  test_gpcrc_clock--;
+}
+#endif
+
+int main(void){
+  crc_open();
+  test_check_values();
+  test_lengths();
+  test_splits();
+#if CRC_BACKEND == CRC_BACKEND_GPCRC
+  CHECK_EQ(test_gpcrc_clock, 0);
+#endif
+  return test_result("test_crc");
+}
@@ -0,0 +1,457 @@
+#!/usr/bin/env python3
+"""Tests the capture decoders in tools/ against synthetic captures.
+
+  - swo_profile.py: ITM packets of every kind, nested exceptions dated by the
+    timestamps that follow them, trace records, DWT counters, overflows and a
+    stream that starts mid-packet;
+  - trace2chrome.py: 'X' dumps with every record type, a wrapping tick, saturated
+    cycle counts, a corrupt frame and text between the frames;
+  - logfmt.py: printf conversions of the raw argument bytes, 'G' frames with
+    delta ticks, drops and a corrupt CRC, and 32 and 64 bit ELFs holding a logstr
+    section.
+
+Each tool also runs once as a command on a capture file.
+
+    python3 sim/tests/test_tools.py
+"""
+
+import io
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.normpath(os.path.join(HERE, "..", ".."))
+TOOLS = os.path.join(REPO, "tools")
+sys.path.insert(0, TOOLS)
+
+import logfmt  # noqa: E402
+import swo_profile  # noqa: E402
+import trace2chrome  # noqa: E402
+
+EVENTS = ["FIRST_CB", "SECOND_CB", "THIRD_CB"]
+
+
+def run_tool(script, *args):
+    return subprocess.run([sys.executable, os.path.join(TOOLS, script)] + list(args),
+                          capture_output=True, text=True, timeout=60)
+
+
+# ITM packets, ARMv7-M Architecture Reference Manual appendix D4
+def itm_sync():
+    return b"\x00" * 5 + b"\x80"
+
+
+def itm_sw(port, payload):
+    return bytes([(port << 3) | {1: 1, 2: 2, 4: 3}[len(payload)]]) + payload
+
+
+def itm_hw(ident, payload):
+    return bytes([(ident << 3) | 0x04 | {1: 1, 2: 2, 4: 3}[len(payload)]]) + payload
+
+
+def itm_ts(delta):
+    if 0 < delta < 7:
+        return bytes([delta << 4])
+    out = bytearray([0xC0])
+    while True:
+        out.append((delta & 0x7F) | (0x80 if delta >= 0x80 else 0))
+        delta >>= 7
+        if not delta:
+            return bytes(out)
+
+
+def itm_exception(number, function, delta):
+    """An exception trace packet and the timestamp that dates it."""
+    return itm_hw(1, bytes([number & 0xFF, ((number >> 8) & 1) | (function << 4)])) + itm_ts(delta)
+
+
+def itm_record(rtype, rid, arg):
+    return itm_sw(swo_profile.PORT_TRACE, struct.pack("<BBH", rtype, rid, arg))
+
+
+def itm_pc(pc):
+    return itm_hw(2, struct.pack("<I", pc))
+
+
+class SwoProfileTest(unittest.TestCase):
+    SYMS = ["00001000 00000040 T main", "00001040 00000020 t helper", "00002000 00000010 D data"]
+
+    def profile(self, data):
+        profile = swo_profile.Profile(EVENTS, 1000000)
+        profile.feed(swo_profile.parse_itm(data))
+        return profile
+
+    def test_packets(self):
+        data = (itm_sync() + itm_sw(0, b"hi\n!") + itm_sw(0, b"x") + itm_ts(3) + itm_ts(1000) +
+                b"\x70" + itm_hw(0, b"\x05"))
+        self.assertEqual(list(swo_profile.parse_itm(data)), [
+            ("sync", None), ("sw", (0, b"hi\n!")), ("sw", (0, b"x")), ("ts", 3), ("ts", 1000),
+            ("overflow", None), ("dwt", (0, b"\x05"))])
+
+    def test_resync(self):
+        # a capture starting inside a packet, then the end of a sync whose zeros were cut
+        data = b"\x42\x13\x37" + b"\x00\x00\x80" + itm_sync() + itm_pc(0x1004)
+        self.assertEqual(list(swo_profile.parse_itm(data))[-2:],
+                         [("sync", None), ("dwt", (2, struct.pack("<I", 0x1004)))])
+        # a packet cut off at the end of the capture is dropped
+        self.assertEqual(list(swo_profile.parse_itm(itm_pc(0x20000)[:3])), [])
+
+    def test_pc_samples(self):
+        data = itm_sync()
+        for pc in [0x1000, 0x1010, 0x103E, 0x1044, 0x3000]:
+            data += itm_pc(pc)
+        data += itm_hw(2, b"\x00") * 5
+        profile = self.profile(data)
+        self.assertEqual(profile.sleep_samples, 5)
+        self.assertEqual(sum(profile.pcs.values()), 5)
+
+        symbols = swo_profile.Symbols(self.SYMS)
+        self.assertEqual(symbols.lookup(0x1001), "main")
+        self.assertEqual(symbols.lookup(0x1040), "helper")
+        self.assertEqual(symbols.lookup(0x2000), "0x00002000")     # data, not code
+        self.assertEqual(symbols.lookup(0x0FFF), "0x00000fff")
+
+        out = io.StringIO()
+        profile.report(symbols, out, 10)
+        text = out.getvalue()
+        self.assertIn("PC samples: 10, 5 asleep in EM1", text)
+        self.assertRegex(text, r"50\.00\s+5\s+\(sleep\)")
+        self.assertRegex(text, r"30\.00\s+3\s+main")
+        self.assertRegex(text, r"10\.00\s+1\s+helper")
+        self.assertRegex(text, r"10\.00\s+1\s+0x00003000")
+
+    def test_nested_exceptions(self):
+        letimer, leuart = 16 + 27, 16 + 22
+        data = (itm_sync() + itm_ts(100) +
+                itm_exception(letimer, 1, 10) +         # enters at 110
+                itm_exception(leuart, 1, 20) +          # preempts at 130
+                itm_exception(leuart, 2, 25) +          # leaves at 155
+                itm_exception(letimer, 3, 0x100) +      # returns at 411
+                itm_exception(letimer, 2, 40) +         # leaves at 451
+                itm_exception(leuart, 1, 1000) +        # enters at 1451
+                itm_exception(leuart, 2, 5))            # leaves at 1456
+        profile = self.profile(data)
+        self.assertEqual(profile.exc_count[letimer], 1)
+        self.assertEqual(profile.exc_count[leuart], 2)
+        # exclusive time, the LEUART0 ISR's 25 ticks are not counted in LETIMER0's
+        self.assertEqual(profile.exc_time[letimer], 20 + 256 + 40)
+        self.assertEqual(profile.exc_time[leuart], 25 + 5)
+        self.assertEqual(profile.exc_max[letimer], 451 - 110)
+        self.assertEqual(profile.exc_max[leuart], 25)
+        self.assertEqual(profile.stack, [0])
+
+        out = io.StringIO()
+        profile.report(None, out, 10)
+        self.assertRegex(out.getvalue(), r"LETIMER0\s+1\s+316\.0\s+316\.00\s+341\.00")
+        self.assertRegex(out.getvalue(), r"LEUART0\s+2\s+30\.0\s+15\.00\s+25\.00")
+
+    def test_overflow_drops_open_exceptions(self):
+        i2c1 = 16 + 42
+        data = (itm_sync() + itm_exception(i2c1, 1, 10) + b"\x70" +
+                itm_exception(i2c1, 2, 50) + itm_exception(i2c1, 1, 5) + itm_exception(i2c1, 2, 5))
+        profile = self.profile(data)
+        self.assertEqual(profile.overflows, 1)
+        self.assertEqual(profile.exc_count[i2c1], 2)
+        # the exit after the overflow has no entry to time against
+        self.assertEqual(profile.exc_max[i2c1], 5)
+        self.assertEqual(profile.stack, [0])
+        out = io.StringIO()
+        profile.report(None, out, 10)
+        self.assertIn("ITM overflows: 1", out.getvalue())
+
+    def test_trace_records_and_counters(self):
+        data = (itm_sync() + itm_record(swo_profile.T_CLOCK, 0, 19) +
+                itm_record(swo_profile.T_ISR_EXIT, 1, 300) +
+                itm_record(swo_profile.T_ISR_EXIT, 1, 500) +
+                itm_record(swo_profile.T_ISR_EXIT, 1, swo_profile.SATURATED) +
+                itm_record(swo_profile.T_EVT_DONE, 2, 4000) +
+                itm_record(swo_profile.T_EVT_DONE, 9, 7) +
+                itm_record(0, 3, 0) +                    # ISR enter, no cycle count
+                itm_hw(0, b"\x05") + itm_hw(0, b"\x04") + itm_hw(0, b"\x20"))
+        profile = self.profile(data)
+        self.assertEqual(profile.mhz, 19)
+        self.assertEqual(profile.rec_cycles["isr LEUART0"], [300, 500, swo_profile.SATURATED])
+        self.assertEqual(profile.rec_cycles["event THIRD_CB"], [4000])
+        self.assertEqual(profile.rec_cycles["event EVT9"], [7])
+        self.assertEqual(len(profile.rec_cycles), 3)
+        self.assertEqual(profile.counters["CPI"], 256)
+        self.assertEqual(profile.counters["SLEEP"], 512)
+        self.assertEqual(profile.counters["POST"], 256)
+
+        out = io.StringIO()
+        profile.report(None, out, 10)
+        text = out.getvalue()
+        self.assertIn("Trace records, cycles at 19 MHz", text)
+        self.assertRegex(text, r"isr LEUART0\s+3\s+800\s+400\s+500 1")
+        self.assertRegex(text, r"event THIRD_CB\s+1\s+4000\s+4000\s+4000 0")
+        self.assertRegex(text, r"SLEEP\s+512")
+
+    def test_command(self):
+        data = itm_sync() + itm_pc(0x1000) * 3 + itm_pc(0x1040) + itm_sw(0, b"boot")
+        with tempfile.TemporaryDirectory() as tmp:
+            capture, syms = os.path.join(tmp, "swo.bin"), os.path.join(tmp, "app.syms")
+            with open(capture, "wb") as f:
+                f.write(data)
+            with open(syms, "w") as f:
+                f.write("\n".join(self.SYMS))
+            run = run_tool("swo_profile.py", capture, "--syms", syms, "--text")
+        self.assertEqual(run.returncode, 0, run.stderr)
+        self.assertRegex(run.stdout, r"75\.00\s+3\s+main")
+        self.assertIn("Port 0 text:\nboot", run.stdout)
+
+
+# 'X' frames of trace_dump(), trace.h
+def x_frame(payload, count):
+    frame = bytes([ord("X"), count]) + payload
+    return frame + struct.pack("<H", trace2chrome.crc16_x25(frame))
+
+
+def x_meta(tick_hz, core_hz, written, count):
+    return x_frame(struct.pack("<4I", tick_hz, core_hz, written, count), 0)
+
+
+def x_records(recs):
+    return x_frame(b"".join(struct.pack("<IBBH", *rec) for rec in recs), len(recs))
+
+
+class Trace2ChromeTest(unittest.TestCase):
+    TICK_HZ = 1000000       # one tick per us keeps the expected times exact
+
+    def convert(self, data):
+        dumps = trace2chrome.split_dumps(data)
+        self.assertEqual(len(dumps), 1)
+        conv = trace2chrome.Converter(EVENTS, 1)
+        conv.convert(dumps[0])
+        return conv.out
+
+    def spans(self, out, tid):
+        return [(e["name"], e["ts"], e["dur"]) for e in out if e["ph"] == "X" and e["tid"] == tid]
+
+    def test_frames(self):
+        recs = [(1000, trace2chrome.T_EVT_POST, 1, 0)]
+        good = x_meta(self.TICK_HZ, 19000000, 300, 1) + x_records(recs)
+        corrupt = bytearray(x_records([(5, 0, 0, 0)]))
+        corrupt[3] ^= 0x01
+        data = b"Hello World\n" + b"X" + good[:10] + bytes(corrupt) + good + b"S 23.5\n"
+        dumps = trace2chrome.split_dumps(data)
+        self.assertEqual(dumps, [{"meta": (self.TICK_HZ, 19000000, 300, 1), "recs": recs}])
+        # records before any meta frame belong to no dump
+        self.assertEqual(trace2chrome.split_dumps(x_records(recs)), [])
+
+    def test_spans(self):
+        T = trace2chrome
+        recs = [
+            (1000, T.T_CLOCK, 0, 7),
+            (1010, T.T_SLEEP_ENTER, 2, 0),
+            (1100, T.T_ISR_ENTER, 0, 0),
+            (1100, T.T_SLEEP_EXIT, 2, 0),
+            (1110, T.T_ISR_EXIT, 0, 70),                # 70 cycles at 7 MHz, 10 us
+            (1120, T.T_EVT_POST, 1, 0),
+            (1130, T.T_EVT_RUN, 1, 0),
+            (1170, T.T_EVT_DONE, 1, T.SATURATED),       # longer than 0xFFFF cycles, RUN dates it
+            (1175, T.T_CLOCK, 0, 19),
+            (1200, T.T_EVT_DONE, 2, 190),               # no RUN recorded, 10 us at 19 MHz
+            (1210, T.T_I2C_STATE, 1, 0),
+            (1230, T.T_I2C_STATE, 1, 3),
+            (1250, T.T_I2C_STATE, 1, 0x101),
+            (1260, T.T_LEUART_TX, 0, 0),
+            (1300, T.T_LEUART_TX, 0, 2),
+            (1320, T.T_ISR_EXIT, 9, T.SATURATED),       # neither timed nor opened
+        ]
+        out = self.convert(x_meta(self.TICK_HZ, 19000000, 40, len(recs)) + x_records(recs))
+
+        self.assertEqual(self.spans(out, T.TID_SLEEP), [("EM2", 10.0, 90.0)])
+        self.assertEqual(self.spans(out, T.TID_ISR), [("LETIMER0", 100.0, 10.0), ("ISR9", 320.0, 0.0)])
+        self.assertEqual(self.spans(out, T.TID_MAIN), [("SECOND_CB", 130.0, 40.0), ("THIRD_CB", 190.0, 10.0)])
+        self.assertEqual(self.spans(out, T.TID_I2C + 1),
+                         [("I2C1 init_write", 210.0, 20.0), ("I2C1 read_data", 230.0, 20.0)])
+        # the state still open when the records end closes at the last record
+        self.assertEqual(self.spans(out, T.TID_LEUART), [("TX STRING_INIT", 260.0, 40.0), ("TX end", 300.0, 20.0)])
+        instants = [(e["name"], e["ts"]) for e in out if e["ph"] == "i"]
+        self.assertEqual(instants, [("post SECOND_CB", 120.0), ("I2C1 NACK", 250.0)])
+        counters = [(e["ts"], e["args"]["MHz"]) for e in out if e["ph"] == "C"]
+        self.assertEqual(counters, [(0.0, 7), (175.0, 19)])
+        process = [e for e in out if e["name"] == "process_name"]
+        self.assertEqual(process[0]["args"]["name"], "dump 1: 16 of 40 records")
+
+    def test_tick_wrap(self):
+        T = trace2chrome
+        recs = [(0xFFFFFF00, T.T_EVT_RUN, 0, 0), (0x40, T.T_EVT_DONE, 0, T.SATURATED)]
+        out = self.convert(x_meta(self.TICK_HZ, 7000000, 2, 2) + x_records(recs))
+        self.assertEqual(self.spans(out, T.TID_MAIN), [("FIRST_CB", 0.0, 320.0)])
+
+    def test_command(self):
+        T = trace2chrome
+        recs = [(10, T.T_ISR_ENTER, 1, 0), (20, T.T_ISR_EXIT, 1, 70)]
+        dump = x_meta(self.TICK_HZ, 7000000, 2, 2) + x_records(recs)
+        with tempfile.TemporaryDirectory() as tmp:
+            capture, output = os.path.join(tmp, "capture.bin"), os.path.join(tmp, "trace.json")
+            with open(capture, "wb") as f:
+                f.write(b"noise" + dump + b"more noise" + dump)
+            run = run_tool("trace2chrome.py", capture, "-o", output, "--last")
+            self.assertEqual(run.returncode, 0, run.stderr)
+            with open(output) as f:
+                trace = json.load(f)
+            with open(capture, "wb") as f:
+                f.write(b"no dump here")
+            empty = run_tool("trace2chrome.py", capture)
+        self.assertEqual({e["pid"] for e in trace["traceEvents"]}, {1})
+        spans = [e for e in trace["traceEvents"] if e["ph"] == "X"]
+        self.assertEqual([(e["name"], e["ts"], e["dur"]) for e in spans], [("LEUART0", 0.0, 10.0)])
+        self.assertNotEqual(empty.returncode, 0)
+        self.assertIn("no trace dump found", empty.stderr)
+
+
+# 'G' frames of log.c, log.h
+def g_record(ident, delta, args=b""):
+    tick = bytearray()
+    while True:
+        tick.append((delta & 0x7F) | (0x80 if delta >= 0x80 else 0))
+        delta >>= 7
+        if not delta:
+            break
+    body = struct.pack("<H", ident) + bytes(tick) + args
+    return bytes([len(body)]) + body
+
+
+def g_frame(dropped, base, recs):
+    body = b"".join(recs)
+    frame = bytes([ord("G"), len(body), dropped]) + struct.pack("<I", base) + body
+    return frame + struct.pack("<H", logfmt.crc16_x25(frame))
+
+
+def log_table(entries):
+    """Returns the logstr bytes and the id of each (level, place, format) entry."""
+    table, ids = bytearray(b"\0"), []
+    for level, place, fmt in entries:
+        ids.append(len(table))
+        table += logfmt.SEP.join([level, place, fmt]).encode() + b"\0"
+    return bytes(table), ids
+
+
+def make_elf(sections, bits):
+    """Returns a little endian ELF with the given (name, bytes) sections and no segments."""
+    names = bytearray(b"\0")
+    offsets = []
+    for label, _ in sections + [(".shstrtab", b"")]:
+        offsets.append(len(names))
+        names += label.encode() + b"\0"
+    header = 52 if bits == 32 else 64
+    body = bytearray()
+    placed = []
+    for (label, data), name_off in zip(sections + [(".shstrtab", bytes(names))], offsets):
+        placed.append((name_off, header + len(body), len(data)))
+        body += data
+    shoff = header + len(body)
+    entries = [(0, 0, 0)] + placed
+    if bits == 32:
+        ident = b"\x7fELF\x01\x01\x01" + b"\0" * 9
+        elf = ident + struct.pack("<HHIIIIIHHHHHH", 2, 40, 1, 0, 0, shoff, 0, header, 0, 0,
+                                  40, len(entries), len(entries) - 1)
+        table = b"".join(struct.pack("<10I", n, 1 if o else 0, 0, 0, o, s, 0, 0, 1, 0)
+                         for n, o, s in entries)
+    else:
+        ident = b"\x7fELF\x02\x01\x01" + b"\0" * 9
+        elf = ident + struct.pack("<HHIQQQIHHHHHH", 3, 62, 1, 0, 0, shoff, 0, header, 0, 0,
+                                  64, len(entries), len(entries) - 1)
+        table = b"".join(struct.pack("<IIQQQQIIQQ", n, 1 if o else 0, 0, 0, o, s, 0, 0, 1, 0)
+                         for n, o, s in entries)
+    assert len(elf) == header
+    return elf + bytes(body) + table
+
+
+class LogfmtTest(unittest.TestCase):
+    ENTRIES = [
+        ("I", "../src/Source Files/app.c:120", "Hello World"),
+        ("W", "i2c.c:88", "I2C%u 0x%02x failed, status %d"),
+        ("D", "app.c:200", "z = %.1f %s%c %lld%%"),
+    ]
+
+    def test_render(self):
+        args = struct.pack("<iI", -5, 0xBEEF)
+        self.assertEqual(logfmt.render("a %d b %x c", args), "a -5 b beef c")
+        self.assertEqual(logfmt.render("%5u|%-4d|%08X", struct.pack("<IiI", 7, 3, 0xABC)),
+                         "    7|3   |00000ABC")
+        self.assertEqual(logfmt.render("%.2f %e", struct.pack("<ff", 1.25, 1024.0)),
+                         "1.25 1.024000e+03")
+        self.assertEqual(logfmt.render("%lld %llu", struct.pack("<qQ", -(1 << 40), 1 << 63)),
+                         "-1099511627776 9223372036854775808")
+        self.assertEqual(logfmt.render("[%s] [%-4s]", b"\x02hi\x01x"), "[hi] [x   ]")
+        self.assertEqual(logfmt.render("%c%c %p", b"o\0\0\0k\0\0\0" + struct.pack("<I", 0x20000010)),
+                         "ok 0x20000010")
+        self.assertEqual(logfmt.render("100%% %lu", struct.pack("<I", 9)), "100% 9")
+        # arguments cut short mark the first one missing, the rest of the format is left as is
+        self.assertEqual(logfmt.render("%d %d %s", struct.pack("<i", 1) + b"\x01"), "1 <?> %s")
+        self.assertEqual(logfmt.render("%s", b""), "<?>")
+
+    def test_site(self):
+        table, ids = log_table(self.ENTRIES)
+        self.assertEqual(logfmt.site(table, ids[0]), ("I", "app.c:120", "Hello World"))
+        self.assertEqual(logfmt.site(table, ids[1]), ("W", "i2c.c:88", self.ENTRIES[1][2]))
+        self.assertIsNone(logfmt.site(table + b"E no separators\0", len(table)))
+        self.assertIsNone(logfmt.site(table + b"E" + logfmt.SEP.encode() + b"unterminated", len(table)))
+        self.assertIsNone(logfmt.site(table, len(table)))
+        self.assertIsNone(logfmt.site(table, len(table) + 100))
+
+    def test_frames(self):
+        recs = [g_record(5, 0), g_record(9, 300, b"\x01"), g_record(7, 1 << 21)]
+        good = g_frame(0, 0x1000, recs)
+        corrupt = bytearray(g_frame(3, 0, [g_record(1, 1)]))
+        corrupt[-1] ^= 0xFF
+        data = b"S 23.5\n" + b"G\xff" + bytes(corrupt) + good + g_frame(255, 7, []) + good[:-1]
+        frames = list(logfmt.parse_frames(data))
+        self.assertEqual([(d, b) for d, b, _ in frames], [(0, 0x1000), (255, 7)])
+        self.assertEqual(list(logfmt.records(frames[0][2])),
+                         [(0, 5, b""), (300, 9, b"\x01"), (1 << 21, 7, b"")])
+        self.assertEqual(list(logfmt.records(frames[1][2])), [])
+
+    def test_elf_section(self):
+        table, _ = log_table(self.ENTRIES)
+        with tempfile.TemporaryDirectory() as tmp:
+            for bits in (32, 64):
+                path = os.path.join(tmp, "app%d.elf" % bits)
+                with open(path, "wb") as f:
+                    f.write(make_elf([(".text", b"\0" * 12), (logfmt.SECTION, table)], bits))
+                self.assertEqual(logfmt.elf_section(path, logfmt.SECTION), table)
+                self.assertEqual(logfmt.elf_section(path, ".text"), b"\0" * 12)
+                with self.assertRaises(SystemExit):
+                    logfmt.elf_section(path, ".missing")
+            path = os.path.join(tmp, "not.elf")
+            with open(path, "wb") as f:
+                f.write(b"MZ" + b"\0" * 62)
+            with self.assertRaises(SystemExit):
+                logfmt.elf_section(path, logfmt.SECTION)
+
+    def test_command(self):
+        table, ids = log_table(self.ENTRIES)
+        args = struct.pack("<IIi", 1, 0x40, 2)
+        more = struct.pack("<f", 23.25) + b"\x02ok" + b"!" + b"\0\0\0" + struct.pack("<q", -7)
+        data = (g_frame(0, 32768, [g_record(ids[0], 0), g_record(ids[1], 16384, args)]) +
+                b"noise" + g_frame(2, 0x10000, [g_record(ids[2], 0, more), g_record(999, 1)]))
+        with tempfile.TemporaryDirectory() as tmp:
+            capture, elf = os.path.join(tmp, "capture.bin"), os.path.join(tmp, "app.elf")
+            with open(capture, "wb") as f:
+                f.write(data)
+            with open(elf, "wb") as f:
+                f.write(make_elf([(logfmt.SECTION, table)], 32))
+            run = run_tool("logfmt.py", capture, "--elf", elf)
+            info = run_tool("logfmt.py", capture, "--elf", elf, "--level", "I")
+        self.assertEqual(run.returncode, 0, run.stderr)
+        self.assertEqual(run.stdout.splitlines(), [
+            "     1.000 I app.c:120      Hello World",
+            "     1.500 W i2c.c:88       I2C1 0x40 failed, status 2",
+            "-- 2 records dropped on the board",
+            "     2.000 D app.c:200      z = 23.2 ok! -7%",
+            "     2.000 ? unknown format id 999, is the ELF the one on the board?",
+        ])
+        self.assertNotIn("z = ", info.stdout)
+        self.assertIn("I2C1 0x40 failed", info.stdout)
+
+
+if __name__ == "__main__":
+    unittest.main()
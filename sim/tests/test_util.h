@@ -0,0 +1,78 @@
+/**
+ * @file test_util.h
+ * @brief Checks, a seeded generator and a clock shared by the host unit tests and benchmarks
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef TEST_UTIL_HG
+#define TEST_UTIL_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Counts and reports a failed check, the test goes on so one run shows every failure
+#define CHECK(cond) do { \
+    if(!(cond)){ \
+        test_failures++; \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+  } while(0)
+
+#define CHECK_EQ(a, b) do { \
+    unsigned long long check_a = (unsigned long long)(a), check_b = (unsigned long long)(b); \
+    if(check_a != check_b){ \
+        test_failures++; \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (0x%llX != 0x%llX)\n", \
+                __FILE__, __LINE__, #a, #b, check_a, check_b); \
+    } \
+  } while(0)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+static unsigned test_failures;
+static uint64_t test_rng_state = 0x9E3779B97F4A7C15ULL;
+
+//***********************************************************************************
+// functions
+//***********************************************************************************
+static inline void test_seed(uint64_t seed){
+  test_rng_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+// xorshift64*, the same sequence on every host for a given seed
+static inline uint32_t test_rand(void){
+  test_rng_state ^= test_rng_state >> 12;
+  test_rng_state ^= test_rng_state << 25;
+  test_rng_state ^= test_rng_state >> 27;
+  return (uint32_t)((test_rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static inline uint32_t test_below(uint32_t n){
+  return (uint32_t)(((uint64_t)test_rand() * n) >> 32);
+}
+
+static inline double test_seconds(void){
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Exit status of a test, with the failure count on stderr
+static inline int test_result(const char *name){
+  if(test_failures) fprintf(stderr, "%s: %u checks failed\n", name, test_failures);
+  else printf("%s: all checks passed\n", name);
+  return test_failures ? 1 : 0;
+}
+
+#endif
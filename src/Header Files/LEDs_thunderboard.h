@@ -11,9 +11,14 @@
 #include "stdbool.h"
 #include "stdint.h"
 #include "em_gpio.h"
+#include "em_timer.h"
+#include "em_cmu.h"
+#include "cmu.h"
 
 /* The developer's include statements */
 #include "brd_config.h"
+#include "ldma.h"
+#include "sleep_routines.h"
 
 
 
@@ -31,9 +36,33 @@
 #define RGB_LED_3		(0x01 << 3)
 #define NO_LEDS			(0x00 << 0)
 
+/* Pin masks generated from brd_config.h. Each group must sit on one port so an update
+ * is a single DOUT set or clear store per group. */
+#define RGB_COLOR_PORT	RGB_RED_PORT
+#define RGB_SELECT_PORT	RGB0_PORT
+#define RGB_COLOR_PINS(color)	((((color) & COLOR_RED) ? (1UL << RGB_RED_PIN) : 0) | \
+				(((color) & COLOR_GREEN) ? (1UL << RGB_GREEN_PIN) : 0) | \
+				(((color) & COLOR_BLUE) ? (1UL << RGB_BLUE_PIN) : 0))
+#define RGB_SELECT_PINS(leds)	((((leds) & RGB_LED_0) ? (1UL << RGB0_PIN) : 0) | \
+				(((leds) & RGB_LED_1) ? (1UL << RGB1_PIN) : 0) | \
+				(((leds) & RGB_LED_2) ? (1UL << RGB2_PIN) : 0) | \
+				(((leds) & RGB_LED_3) ? (1UL << RGB3_PIN) : 0))
+#define ALL_COLORS		(COLOR_RED | COLOR_GREEN | COLOR_BLUE)
+#define ALL_LEDS		(RGB_LED_0 | RGB_LED_1 | RGB_LED_2 | RGB_LED_3)
+
 #define	RGB_PWM_PERIOD	20
 #define RGB_PWM_ACTIVE	1
 
+// Hardware PWM on TIMER1 CC0..2, routed to the color pins through RED/GREEN/BLUE_RGB_LOC
+#define RGB_PWM_TIMER     TIMER1
+#define RGB_PWM_TOP       255                 // 8 bit duty cycle
+#define RGB_PWM_PRESCALE  timerPrescale16     // ~1.7 kHz at 7 MHz, ~6.3 kHz boosted, no visible flicker
+#define RGB_PWM_EM        EM2                 // TIMER1 runs from HFPER, block EM2 while dimming
+#define RGB_DUTY_OFF      0
+#define RGB_DUTY_ON       RGB_PWM_TOP         // 0 and RGB_DUTY_ON are driven by GPIO, timer off
+#define RGB_FADE_STEPS    16                  // duty steps per fade, one LDMA descriptor each
+#define RGB_COLORS        3
+
 
 //***********************************************************************************
 // global variables
@@ -46,4 +75,9 @@
 void rgb_init(void);
 void leds_enabled(uint32_t leds, uint32_t color, bool enable);
 
+void rgb_pwm_open(uint32_t fade_done_evt);
+void rgb_pwm_set(uint8_t red, uint8_t green, uint8_t blue);
+void rgb_pwm_fade(uint8_t red, uint8_t green, uint8_t blue, uint32_t fade_ms);
+void rgb_pwm_fade_done_cb(void);
+
 #endif
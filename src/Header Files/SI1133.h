@@ -11,6 +11,7 @@
 #include "i2c.h"
 #include "HW_delay.h"
 #include "brd_config.h"
+#include "task.h"
 
 /* The developer's include statements */
 
@@ -41,16 +42,20 @@
 #define NULL_CB 0x00
 #define PART_ID_REGISTER 0x00
 #define TimerDelay 25
+#define SI1133_CFG_TRIES 3 //configuration attempts before the sensor is given up on
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
-void Si1133_i2c_open();
+void Si1133_i2c_open(uint32_t done_evt);
+void Si1133_configure_task(void);
 void Si1133_read(uint32_t bytes_per_transfer, uint32_t register_address, uint32_t i2c_callback);
 void Si1133_force();
 void SI1133_request_result();
 
 uint32_t Si1133_read_result();
+bool Si1133_ready(void);
+I2C_STATUS Si1133_status(void);
 
 void Si1133_write(uint32_t bytes_per_transfer, uint32_t register_address, uint32_t i2c_callback);
 
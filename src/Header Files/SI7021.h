@@ -0,0 +1,47 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef Si7021_HG
+#define Si7021_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "i2c.h"
+#include "brd_config.h"
+#include "task.h"
+
+/* The developer's include statements */
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SI7021_MEAS_RH_NOHOLD   0xF5  //measure RH, NACK reads until the result is ready
+#define SI7021_READ_TEMP_PREV   0xE0  //temperature taken during the last RH measurement
+#define SI7021_RESET            0xFE
+
+#define SI7021_POWERUP_MS       80    //power up time, max
+#define SI7021_RESET_MS         15    //reset time, max
+#define SI7021_CONV_MS          23    //12 bit RH plus 14 bit temperature conversion, max
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void Si7021_open(uint32_t done_evt);
+void Si7021_configure_task(void);
+bool Si7021_measure(uint32_t done_evt);
+void Si7021_measure_task(void);
+
+bool Si7021_ready(void);
+bool Si7021_valid(void);
+int32_t Si7021_rh_x10(void);
+int32_t Si7021_temp_x100(void);
+I2C_STATUS Si7021_status(void);
+
+#endif
@@ -11,7 +11,9 @@
 
 #include "em_cmu.h"
 #include "em_assert.h"
+#include "sl_sleeptimer.h"
 #include <stdio.h>
+#include <string.h>
 
 
 /* The developer's include statements */
@@ -24,9 +26,17 @@
 #include "LEDs_thunderboard.h"
 #include "sleep_routines.h"
 #include "Si1133.h"
+#include "SI7021.h"
 
 #include "HW_delay.h"
 #include "ble.h"
+#include "flashlog.h"
+#include "compress.h"
+#include "crc.h"
+#include "task.h"
+#include "timestamp.h"
+#include "swo.h"
+#include "log.h"
 
 //***********************************************************************************
 // defined files
@@ -34,26 +44,29 @@
 #define SYSTEM_BLOCK_EM EM3
 
 
-#define DELAYTIME 2000
 #define   PWM_PER         2.0   // PWM period in seconds
 #define   PWM_ACT_PER     0.002  // PWM active period in seconds
+#define   APP_RAMP_STEP   10     // "#L" period ramp step in LETIMER ticks per period
+#define   APP_FADE_MS     500    // "#C" RGB fade length in ms
+#define   APP_DUTY_PCT_MAX 100   // "#C" duty cycles are given in percent
+#define   APP_Z_BATCH     16     // samples per compressed live frame
+#define   APP_Z_CHANNELS  4      // light, RH in 0.1 %RH, temperature in 0.01 C, APP_Z_VALID_ flags
+#define   APP_Z_VALID_RH  0x01   // RH and temperature were read this period, else the last good values
+#define   APP_Z_FRAME     80     // compressed live frame, with the CRC within LEUART_STR_LEN
+#define   APP_Z_HDR       3      // 'Z', sample count, payload length
+#define   APP_PROF_BINS   6      // "#P" histogram bins per log record, with the name and index LOG_ARGS_MAX
+
+#define   APP_ENV_LIGHT   0x01   // Si1133 reading still outstanding this period
+#define   APP_ENV_RH      0x02   // Si7021 reading still outstanding this period
 
 
 #define   EXPECTED_DATA  51 //Part ID to be returned from a read. Not needed for lab 5
 #define   READ_DATA_B          1 //Bytes to be read from SI1133
 
-#define LETIMER0_COMP0_CB 0x00000001 //0b0001
-#define LETIMER0_COMP1_CB 0x00000002 //0b0010
-#define LETIMER0_UF_CB 0x00000004 //0b0100
+// Scheduler events such as LETIMER0_UF_CB and SI1133_CB are assigned in events.h
 
-#define SI1133_CB 0x00000008   //0b1000
 #define EXPECTED_READ 20 //Lab 5 sensor value to be read
 
-#define BOOT_UP_CB 0x00000010
-#define TX_CALLBACK 0x00000020
-#define RX_CALLBACK 0x00000040
-#define BLE_TX_DONE_CB 0x00000080
-
 
 //***********************************************************************************
 // global variables
@@ -70,8 +83,10 @@ void scheduled_letimer0_comp0_cb(void);
 void scheduled_letimer0_comp1_cb(void);
 
 void scheduled_si1133_read_cb(void);
+void scheduled_si7021_read_cb(void);
 
 void scheduled_boot_up_cb(void);
+void scheduled_prof_report_cb(void);
 
 void scheduled_BLE_TX_DONE_CB(void);
 
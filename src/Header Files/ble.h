@@ -18,6 +18,10 @@
 #include "leuart.h"
 #include "gpio.h"
 #include "brd_config.h"
+#include "sl_sleeptimer.h"
+#include "crc.h"
+#include "usart.h"
+#include "task.h"
 
 
 //***********************************************************************************
@@ -25,17 +29,123 @@
 //***********************************************************************************
 #define STARTF_CHR '#'
 #define SIGF_CHR '!'
+
+#define BLE_CRC_CHR         '*'     // text frames end in "*hhhh", the CRC-16 in hex
+#define BLE_CRC_TEXT_LEN    5
+#define BLE_CRC_BYTES       2       // binary frames end in the CRC-16, low byte first
+#define BLE_CRC_REQUIRED    true    // false also takes frames without a checksum, typed in a terminal
+#define BLE_PEER_IDLE_MS    30000   // a phone that sent no frame for this long counts as gone
+
+#define BLE_AT_QUEUE_LEN    4       // AT commands that can be pending at once
+#define BLE_AT_STR_LEN      24      // max length of an AT command or response
+#define BLE_AT_TIMEOUT_MS   500     // HM-18 answers well within this at 9600 baud
+#define BLE_AT_RETRIES      2       // resends after the first attempt
+#define BLE_AT_RESET_MS     2000    // time for the HM-18 to reboot after AT+RESET
+#define BLE_AT_SETTLE_MS    100     // lets the rest of a longer reply, such as "OK+LOST", drain
+
+#define BLE_LINK_IDLE_MS    5000    // the USART link is checked for idling this often
+#define BLE_LINK_IDLE_BYTES 1200    // below a quarter of what 9600 baud carries in BLE_LINK_IDLE_MS
+#define BLE_LINK_IDLE_MAX_MS 80000  // idle checks back off up to this after failed fallbacks
+
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+typedef enum {
+  BLE_AT_IDLE,
+  BLE_AT_BUSY,
+  BLE_AT_OK,
+  BLE_AT_FAIL
+} BLE_AT_STATUS;
+
+typedef enum {
+  BLE_RX_OK,
+  BLE_RX_CRC,                         // bad or missing checksum, counted by ble_crc_errors()
+  BLE_RX_LENGTH                       // frame longer than the caller's buffer
+} BLE_RX_STATUS;
+
+typedef enum {
+  BLE_LINK_LEUART,                    // 9600 baud, the core can sleep in EM2 between characters
+  BLE_LINK_USART,                     // HM10_USART_BAUDRATE with LDMA, EM1 while selected
+  BLE_LINK_COUNT
+} BLE_LINK;
 
+/* One way of moving bytes to and from the HM-18, ble.c only talks to the module through
+ * the transport of the current link. */
+typedef struct {
+  void      (*start)(char *string, uint32_t length, uint32_t done_evt);
+  bool      (*tx_busy)(void);
+  void      (*received)(char *out_str);
+  void      (*raw_rx)(bool enable, uint32_t rx_evt);
+  uint32_t  (*raw_read)(char *out_str, uint32_t max_len);
+} BLE_TRANSPORT;
+
+typedef struct {
+  TASK      task;                     // runs ble_link_task() on BLE_LINK_CB
+  BLE_LINK  current;
+  BLE_LINK  wanted;
+  bool      switching;                // frames written meanwhile are dropped
+  bool      ok;
+  BLE_LINK  probe;                    // link the module is looked for on after a failed switch
+  uint32_t  window_bytes;             // bytes written since the last idle check
+  uint32_t  idle_ms;                  // time between idle checks, doubled by each failed fallback
+  uint32_t  fallbacks;                // switches to the USART the module did not answer after
+  uint32_t  rx_evt;                   // framed receive event of both transports
+} BLE_LINK_STATE;
+
+typedef enum {
+  AT_WAIT_RESP,
+  AT_WAIT_DRAIN,                      // wrong reply, the rest of it is discarded until the timeout
+  AT_WAIT_SETTLE
+} BLE_AT_STATES;
+
+typedef struct {
+  char      cmd[BLE_AT_STR_LEN];      // command written to the HM-18
+  char      expect[BLE_AT_STR_LEN];   // response prefix that completes the command
+  uint32_t  timeout_ms;               // time allowed for the response, per attempt
+  uint32_t  retries;                  // resends allowed after the first attempt
+  uint32_t  settle_ms;                // delay after a match before the next command
+} BLE_AT_CMD;
+
+typedef struct {
+  BLE_AT_CMD    queue[BLE_AT_QUEUE_LEN];
+  uint32_t      head;
+  uint32_t      count;
+  uint32_t      attempts;
+  char          resp[BLE_AT_STR_LEN];
+  uint32_t      resp_length;
+  BLE_AT_STATES current_state;
+  BLE_AT_STATUS status;
+  uint32_t      timer_gen;            // tags each timer start so stale expiries are ignored
+  volatile uint32_t expired_gen;
+  sl_sleeptimer_timer_handle_t timer;
+  uint32_t      rx_evt;
+  uint32_t      timeout_evt;
+  uint32_t      done_evt;             // events of every submit in the running sequence
+} BLE_AT_ENGINE;
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void ble_open(uint32_t tx_event, uint32_t rx_event);
 void ble_write(char *string);
+void ble_write_cb(char *string, uint32_t done_evt);
+void ble_write_bytes(const uint8_t *data, uint32_t length, uint32_t done_evt);
+BLE_RX_STATUS ble_read(char *out_str, uint32_t size);
+uint32_t ble_crc_errors(void);
+bool ble_peer_active(void);
+bool ble_tx_busy(void);
+
+void ble_at_open(uint32_t rx_evt, uint32_t timeout_evt);
+bool ble_at_submit(char *cmd, char *expect, uint32_t timeout_ms, uint32_t retries, uint32_t settle_ms, uint32_t done_evt);
+void ble_at_rx_cb(void);
+void ble_at_timeout_cb(void);
+BLE_AT_STATUS ble_at_status(void);
+
+bool ble_set_name(char *mod_name, uint32_t done_evt);
 
-bool ble_test(char *mod_name);
+bool ble_link_request(BLE_LINK link);
+BLE_LINK ble_link_get(void);
+uint32_t ble_link_fallbacks(void);
+void ble_link_task(void);
 
 #endif
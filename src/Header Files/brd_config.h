@@ -39,6 +39,14 @@
 #define HM10_REFREQ 0
 #define HM10_STOPBITS leuartStopbits1
 
+//HM10 high speed link, USART0 on the same pins as LEUART0
+#define HM10_USART0 USART0
+#define USART0_TX_ROUTE USART_ROUTELOC0_TXLOC_LOC27
+#define USART0_RX_ROUTE USART_ROUTELOC0_RXLOC_LOC27
+#define HM10_USART_BAUDRATE 115200
+#define HM10_USART_BAUD_CODE "4"    // AT+BAUD parameter for HM10_USART_BAUDRATE
+#define HM10_BAUD_CODE "0"          // AT+BAUD parameter for HM10_BAUDRATE
+
 
 
 // RGB LED locations
@@ -106,6 +114,12 @@
 #define SI1133_SDA_PORT gpioPortC
 #define SI1133_SDA_PIN 4
 
+#define SI1133_I2C I2C1
+#define SI1133_I2C_ADDRESS 0x55
+
+#define SI7021_I2C SI1133_I2C //on the same bus and enable pin as the Si1133
+#define SI7021_I2C_ADDRESS 0x40
+
 #define SI1133_SENSOR_EN_PORT gpioPortF
 #define SI1133_SENSOR_EN_PIN 9
 
@@ -117,6 +131,11 @@
 #define SI1133_SDA_DEFAULT_EN true
 #define SI1133_SENSOR_DEFAULT_EN true
 
+// SWO, the debug adapter's trace input on the Thunderboard
+#define SWO_PORT gpioPortF
+#define SWO_PIN 2
+#define SWO_ROUTE GPIO_ROUTELOC0_SWVLOC_LOC0
+
 
 //***********************************************************************************
 // function prototypes
@@ -5,29 +5,76 @@
 #define CMU_HG
 
 /* System include statements */
-
+#include <stdint.h>
+#include <stdbool.h>
 
 /* Silicon Labs include statements */
 #include "em_cmu.h"
 #include "em_assert.h"
+#include "em_core.h"
+#include "em_emu.h"
 
 /* The developer's include statements */
-
+#include "sleep_routines.h"
+#include "brd_config.h"
 
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
+#define CMU_HF_EM_BLOCK   EM2   // HF branch clocks stop in EM2, block it while one is requested
+#define CMU_NO_PARENT     0xFF
+
+// HFRCO policy: run slow unless a heavy job holds a boost. A build defining CMU_HFRCO_LOW
+// as MCU_HFXO_FREQ keeps the core at full speed, see sim/tests/clock_policy.py
+#ifndef CMU_HFRCO_LOW
+#define CMU_HFRCO_LOW     cmuHFRCOFreq_7M0Hz  // ISR only work, below the 20 MHz low power VSCALE limit
+#endif
+#define CMU_HFRCO_HIGH    MCU_HFXO_FREQ       // formatting, parsing, filtering
+#define CMU_FREQ_HOOKS    4
 
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+typedef enum {
+  CMU_NODE_HFPER,
+  CMU_NODE_CORELE,
+  CMU_NODE_LFXO,
+  CMU_NODE_TIMER0,
+  CMU_NODE_TIMER1,
+  CMU_NODE_I2C0,
+  CMU_NODE_I2C1,
+  CMU_NODE_LDMA,
+  CMU_NODE_GPCRC,
+  CMU_NODE_USART0,
+  CMU_NODE_LEUART0,
+#if LEUART_COUNT > 1
+  CMU_NODE_LEUART1,
+#endif
+  CMU_NODE_LETIMER0,
+  CMU_NODE_RTCC,
+  CMU_NODE_COUNT
+} CMU_NODE;
+
+typedef void (*CMU_FREQ_FN)(uint32_t hf_hz);   // called after the HFRCO band changed
 
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
+void cmu_lf_open(void);
 void cmu_open(void);
 
+void clock_request(CMU_Clock_TypeDef clock);
+void clock_release(CMU_Clock_TypeDef clock);
+
+void clock_boost_request(void);
+void clock_boost_release(void);
+void clock_freq_register(CMU_FREQ_FN fn);
+
+const char *clock_name(CMU_NODE node);
+uint32_t clock_refs(CMU_NODE node);
+uint64_t clock_on_ticks(CMU_NODE node);
+
 #endif
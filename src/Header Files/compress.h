@@ -0,0 +1,62 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef COMPRESS_HG
+#define COMPRESS_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define COMP_MAX_CHANNELS   4       // interleaved values per record
+#define COMP_TOKEN_MAX      5       // bytes of the longest varint (32 bit)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+/* Streaming encoder. Values are split round robin over the channels, each channel is
+ * delta coded against its previous value, zigzag mapped and written as a varint token.
+ * Runs of two or more zero tokens collapse into a single run token. Memory use is this
+ * struct plus the caller's output buffer. Deltas must fit in 31 bits, which holds for
+ * 16 bit samples, sequence numbers and ms timestamps. */
+typedef struct {
+  uint8_t   *out;
+  uint32_t  cap;
+  uint32_t  len;
+  uint32_t  run;                          // pending zero tokens
+  int32_t   prev[COMP_MAX_CHANNELS];
+  uint8_t   channels;
+  uint8_t   next_ch;
+} COMP_ENC;
+
+typedef struct {
+  const uint8_t *in;
+  uint32_t  len;
+  uint32_t  pos;
+  uint32_t  run;                          // zero tokens still to hand out
+  int32_t   prev[COMP_MAX_CHANNELS];
+  uint8_t   channels;
+  uint8_t   next_ch;
+} COMP_DEC;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void comp_enc_init(COMP_ENC *enc, uint8_t channels, uint8_t *out, uint32_t cap);
+bool comp_enc_fits(const COMP_ENC *enc, uint32_t values);
+bool comp_enc_put(COMP_ENC *enc, int32_t value);
+uint32_t comp_enc_finish(COMP_ENC *enc);
+
+void comp_dec_init(COMP_DEC *dec, uint8_t channels, const uint8_t *in, uint32_t len);
+bool comp_dec_get(COMP_DEC *dec, int32_t *value);
+
+#endif
@@ -0,0 +1,58 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef CRC_HG
+#define CRC_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_gpcrc.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "cmu.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Backends, all produce the same results
+#define CRC_BACKEND_SLICE4  0   // software, 4 tables of 256 entries built in RAM, fastest without hardware
+#define CRC_BACKEND_NIBBLE  1   // software, 16 entry tables in flash, for images short on memory
+#define CRC_BACKEND_GPCRC   2   // EFR32 GPCRC peripheral
+
+#ifndef CRC_BACKEND
+#define CRC_BACKEND         CRC_BACKEND_GPCRC
+#endif
+
+// CRC-16/X-25: reflected 0x1021, check value of "123456789" is 0x906E
+#define CRC16_POLY          0x1021
+#define CRC16_POLY_REV      0x8408
+#define CRC16_INIT          0xFFFF
+#define CRC16_XOROUT        0xFFFF
+
+// CRC-32/ISO-HDLC (zlib, Ethernet): reflected 0x04C11DB7, check value 0xCBF43926
+#define CRC32_POLY          0x04C11DB7UL
+#define CRC32_POLY_REV      0xEDB88320UL
+#define CRC32_INIT          0xFFFFFFFFUL
+#define CRC32_XOROUT        0xFFFFFFFFUL
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void crc_open(void);
+
+uint16_t crc16_update(uint16_t crc, const void *data, uint32_t length);
+uint32_t crc32_update(uint32_t crc, const void *data, uint32_t length);
+
+uint16_t crc16(const void *data, uint32_t length);
+uint32_t crc32(const void *data, uint32_t length);
+
+#endif
@@ -0,0 +1,73 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EVENTS_HG
+#define EVENTS_HG
+
+/* System include statements */
+#include <stdint.h>
+
+/* Silicon Labs include statements */
+
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+/* Every scheduler event as X(event, handler), highest priority first. An event's bit in
+ * the event mask and its slot in the dispatch table both follow from its line, so a module
+ * adds an event by adding a line here. Using a name twice does not compile. Events that
+ * only have to wake the main loop use scheduler_discard as their handler, a task (task.h)
+ * is the handler of its own event. */
+#define SCHEDULER_EVENT_LIST(X) \
+  X(LETIMER0_UF_CB,       scheduled_letimer0_uf_cb) \
+  X(LETIMER0_COMP0_CB,    scheduled_letimer0_comp0_cb) \
+  X(LETIMER0_COMP1_CB,    scheduled_letimer0_comp1_cb) \
+  X(SI1133_CFG_CB,        Si1133_configure_task) \
+  X(SI1133_CB,            scheduled_si1133_read_cb) \
+  X(SI7021_CFG_CB,        Si7021_configure_task) \
+  X(SI7021_TASK_CB,       Si7021_measure_task) \
+  X(SI7021_CB,            scheduled_si7021_read_cb) \
+  X(BOOT_UP_CB,           scheduled_boot_up_cb) \
+  X(TX_CALLBACK,          scheduler_discard) \
+  X(BLE_TX_DONE_CB,       BLE_RX_cb) \
+  X(BLE_AT_RX_CB,         ble_at_rx_cb) \
+  X(BLE_AT_TIMEOUT_CB,    ble_at_timeout_cb) \
+  X(BLE_LINK_CB,          ble_link_task) \
+  X(RGB_FADE_DONE_CB,     rgb_pwm_fade_done_cb) \
+  X(FLOG_REPLAY_CB,       flog_replay_cb) \
+  X(TRACE_DUMP_CB,        trace_dump_cb) \
+  X(LOG_DRAIN_CB,         log_drain_cb) \
+  X(PROF_REPORT_CB,       scheduled_prof_report_cb) \
+  X(BLE_WRITE_DONE_CB,    scheduler_discard)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Bit positions, also the dispatch table index
+typedef enum {
+#define EVENT_ID(event, handler)  event##_ID,
+  SCHEDULER_EVENT_LIST(EVENT_ID)
+#undef EVENT_ID
+  SCHEDULER_EVENT_COUNT
+} SCHEDULER_EVENT_ID;
+
+// Event masks handed to add_scheduled_event()
+enum {
+#define EVENT_BIT(event, handler) event = (1 << event##_ID),
+  SCHEDULER_EVENT_LIST(EVENT_BIT)
+#undef EVENT_BIT
+};
+
+_Static_assert(SCHEDULER_EVENT_COUNT <= 31, "scheduler events no longer fit the event mask");
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+#define EVENT_HANDLER(event, handler) void handler(void);
+SCHEDULER_EVENT_LIST(EVENT_HANDLER)
+#undef EVENT_HANDLER
+
+#endif
@@ -0,0 +1,74 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef FLASHLOG_HG
+#define FLASHLOG_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_msc.h"
+#include "em_core.h"
+#include "em_assert.h"
+#include "sl_sleeptimer.h"
+
+/* The developer's include statements */
+#include "cmu.h"
+#include "ble.h"
+#include "scheduler.h"
+#include "compress.h"
+#include "crc.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+/* Endurance: a page takes FLOG_RECORDS_PER_PAGE (170) records of FLOG_DECIMATE samples at
+ * PWM_PER (2 s), so each page is erased every 32 * 170 * 4 * 2 s = 12 h when the phone is
+ * never around. That is 730 erases a year, 13 years to the 10k cycles MSC is rated for. */
+#define FLOG_PAGES          32      // flash pages used as a ring at the end of main flash
+#define FLOG_DECIMATE       4       // samples averaged into one record
+#define FLOG_BASE           (FLASH_BASE + FLASH_SIZE - (FLOG_PAGES * FLASH_PAGE_SIZE))
+#define FLOG_MAGIC          0x32474C46UL    // "FLG2", marks an initialized page with CRC-32 records
+#define FLOG_ERASED         0xFFFFFFFFUL
+#define FLOG_BATCH          8       // records buffered in RAM before one MSC write
+#define FLOG_BAD_MAGIC      0UL     // written over the magic of a page that failed to erase or program
+#define FLOG_LINE_RECORDS   3       // records per replay line, with the CRC fits the 96 byte LEUART buffer
+#define FLOG_FRAME_MAX      80      // compressed replay frame, the CRC bytes fit the 96 byte LEUART buffer
+#define FLOG_FRAME_HDR      3       // 'Y', record count, payload length
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+/* Page header, written right after the erase. A page without a valid header is free. */
+typedef struct {
+  uint32_t  magic;
+  uint32_t  page_seq;     // increases by one for every page started, finds the newest page
+} FLOG_PAGE_HDR;
+
+/* One record, the mean of FLOG_DECIMATE samples. The commit word is written last and only matches the CRC-32 of the two data
+ * words when all three made it to flash, so a record torn by a power failure or corrupted
+ * by a worn cell is skipped on replay. */
+typedef struct {
+  uint32_t  tick;         // sleeptimer tick count when logged
+  uint32_t  data;         // sequence number << 16 | 16 bit mean sample
+  uint32_t  commit;       // CRC-32 of tick and data
+} FLOG_RECORD;
+
+#define FLOG_RECORDS_PER_PAGE ((FLASH_PAGE_SIZE - sizeof(FLOG_PAGE_HDR)) / sizeof(FLOG_RECORD))
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void flog_open(void);
+void flog_append(uint16_t sample);
+void flog_flush(void);
+uint32_t flog_count(void);
+uint32_t flog_bad_pages(void);
+
+bool flog_replay_start(uint32_t chunk_evt, bool compressed);
+void flog_replay_cb(void);
+
+#endif
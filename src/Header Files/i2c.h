@@ -8,17 +8,29 @@
 /* Silicon Labs include statements */
 #include "em_i2c.h"
 #include "em_cmu.h"
+#include "em_gpio.h"
+#include "cmu.h"
 #include "sleep_routines.h"
 #include "scheduler.h"
+#include "log.h"
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
 #define I2C_EM_BLOCK   EM2
 
+#define I2C_RETRIES         2     // restarts after a NACK or bus error before a transfer fails
+#define I2C_NACK_BACKOFF_MS 2     // wait before the first restart after a NACK, doubled per attempt
+#define I2C_RECOVER_CLOCKS  9     // SCL pulses that let a slave finish the byte it is stuck in
+#define I2C_RECOVER_SPIN    50    // busy loop per SCL half period, >= 5 us at the top HFRCO band
+#define I2C_STOP_SPIN       10000 // busy loop bound for the STOP issued by i2c_bus_reset()
+#define I2C_ERR_IRQS        (I2C_IEN_NACK | I2C_IEN_ARBLOST | I2C_IEN_BUSERR | I2C_IEN_CLTO)
+#define I2C_QUEUE_LEN       4     // transfers that can wait per bus behind the running one
+
 
 #define READ_OP  1
 #define WRITE_OP 0
+#define READ_NOREG_OP 2 //read without sending a register address first
 
 typedef enum {
   init_write,
@@ -26,9 +38,37 @@ typedef enum {
   init_read,
   read_data,
   rec_data,
+  stop_retry,     // STOP sent after a NACK, the transfer restarts after a backoff from MSTOP
   end_process
 }DEFINED_STATES;
 
+// Result of a device's last transfer, read with i2c_dev_status() from the callback
+typedef enum {
+  I2C_STATUS_OK,
+  I2C_STATUS_NACK,      // the slave did not acknowledge, on every attempt
+  I2C_STATUS_ARBLOST,   // lost arbitration, on a single master bus a glitch or a stuck line
+  I2C_STATUS_BUSERR,    // misplaced START or STOP, or an interrupt the transfer did not expect
+  I2C_STATUS_TIMEOUT,   // SCL held low past the clock low timeout
+  I2C_STATUS_STUCK,     // the bus was still not free after recovery
+  I2C_STATUS_FULL       // the bus queue was full, the transfer never started and can be retried
+} I2C_STATUS;
+
+// A peripheral on a bus, handed to i2c_start() instead of a bus and an address
+typedef struct {
+  I2C_TypeDef *bus;
+  uint32_t address;
+  I2C_STATUS status;    // result of the device's last transfer
+} I2C_DEVICE;
+
+// A transfer waiting for its bus
+typedef struct {
+  I2C_DEVICE *dev;
+  uint32_t mode;
+  uint32_t *data;
+  uint32_t bytes_per_transfer;
+  uint32_t reg_address;
+  uint32_t callback;
+} I2C_XFER;
 
 
 typedef struct {
@@ -44,6 +84,11 @@ typedef struct {
   uint32_t scl_Location;//SCLLOC value route
   uint32_t sda_Location;//SDALOC value route
 
+  GPIO_Port_TypeDef scl_port; //pins, for clocking out a stuck slave
+  uint32_t scl_pin;
+  GPIO_Port_TypeDef sda_port;
+  uint32_t sda_pin;
+
   bool irq_ack_en;
   bool rxdata_irq_en;
   bool irq_stop_en;
@@ -51,9 +96,15 @@ typedef struct {
 } I2C_OPEN_STRUCT;
 
 
+// Transaction engine, one per bus, so transfers on I2C0 and I2C1 run side by side
 typedef struct {
   I2C_TypeDef *i2cx;
-    bool busy;
+    bool busy; //a transfer is running
+    CMU_Clock_TypeDef clock;
+    SLEEP_CLIENT sleep_client;
+    uint32_t byte_us; //time for one byte plus ACK at this bus's SCL frequency
+
+    I2C_DEVICE *dev; //device of the running transfer
 
     uint32_t rwrite;
 
@@ -63,20 +114,40 @@ typedef struct {
     uint32_t bytes_per_transfer;
     uint32_t i2c_callback;
     DEFINED_STATES current_state;
+
+    uint32_t bus_freq; //SCL frequency from i2c_open, reapplied after HFRCO changes
+    I2C_ClockHLR_TypeDef clhr;
+    bool freq_stale; //HFPER changed since the divider was set
+
+    uint32_t bytes_total; //bytes_per_transfer at the start, restored for a retry
+    uint32_t attempts;
+    sl_sleeptimer_timer_handle_t backoff; //delays the restart after a NACK
+    uint32_t recoveries; //bus recoveries run since i2c_open
+    GPIO_Port_TypeDef scl_port;
+    uint32_t scl_pin;
+    GPIO_Port_TypeDef sda_port;
+    uint32_t sda_pin;
+
+    I2C_XFER queue[I2C_QUEUE_LEN]; //transfers waiting for the bus, oldest at queue_head
+    uint32_t queue_head;
+    uint32_t queued;
 } I2C_STATE_MACHINE;
 
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
-void i2c_start(I2C_TypeDef *i2c, uint32_t dev_address, uint32_t mode, uint32_t *data, uint32_t bytes_per_transfer, uint32_t reg_address, uint32_t callback);
+void i2c_start(I2C_DEVICE *dev, uint32_t mode, uint32_t *data, uint32_t bytes_per_transfer, uint32_t reg_address, uint32_t callback);
 
 void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup);
+bool i2c_is_open(I2C_TypeDef *i2c);
 
 void I2C0_IRQHandler(void);
 void I2C1_IRQHandler(void);
 
-bool busy_state(I2C_TypeDef *i2c);
+bool i2c_busy(I2C_TypeDef *i2c);
+I2C_STATUS i2c_dev_status(const I2C_DEVICE *dev);
+uint32_t i2c_recoveries(I2C_TypeDef *i2c);
 
 //static functions, not available outside of i2c.c
 //void i2c_ack_sm(I2C_STATE_MACHINE *i2c_ackSM);
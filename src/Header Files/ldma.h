@@ -0,0 +1,44 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef LDMA_HG
+#define LDMA_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_ldma.h"
+#include "em_cmu.h"
+#include "cmu.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LDMA_CHANNELS       8
+
+// Channel allocation
+#define LDMA_CH_RGB_RED     0
+#define LDMA_CH_RGB_GREEN   1
+#define LDMA_CH_RGB_BLUE    2
+#define LDMA_CH_USART0_TX   3
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void ldma_open(void);
+void ldma_done_event(uint32_t channel, uint32_t done_evt);
+
+void LDMA_IRQHandler(void);
+
+#endif
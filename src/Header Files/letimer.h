@@ -12,6 +12,7 @@
 #include "em_letimer.h"
 #include "em_gpio.h"
 #include "em_cmu.h"
+#include "cmu.h"
 #include "em_assert.h"
 
 #include "scheduler.h"
@@ -24,6 +25,7 @@
 //***********************************************************************************
 #define LETIMER_HZ    1000      // Utilizing ULFRCO oscillator for LETIMERs
 #define LETIMER_EM    EM4 //using the ULFRCO, block from entering energy mode 4
+#define LETIMER_TOP_MAX   0xFFFF    // COMP0 is a 16 bit register
 
 //***********************************************************************************
 // global variables
@@ -46,6 +48,17 @@ typedef struct {
   uint32_t  uf_cb; //cb stands for CallBack
 } APP_LETIMER_PWM_TypeDef ;
 
+typedef struct {
+  bool      valid;        // new top/active waiting for the next underflow
+  uint32_t  top;          // COMP0, period in LETIMER ticks
+  uint32_t  active;       // COMP1, active time in LETIMER ticks
+  bool      ramping;      // step top towards ramp_target once per period
+  uint32_t  ramp_target;  // final COMP0 of the ramp
+  uint32_t  ramp_step;    // largest change of COMP0 per period
+  bool      comp1_due;    // comp1 goes to COMP1 at the next underflow
+  uint32_t  comp1;        // active time of the COMP0 loaded at the last underflow
+} LETIMER_PENDING;
+
 
 //***********************************************************************************
 // function prototypes
@@ -56,6 +69,8 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable);
 void LETIMER0_IRQHandler(void);
 
 
-void letimer0_period(LETIMER_TypeDef *letimer, uint32_t added_pwm);
+bool letimer0_period(LETIMER_TypeDef *letimer, int32_t added_pwm);
+bool letimer0_pwm_set(LETIMER_TypeDef *letimer, uint32_t top, uint32_t active);
+bool letimer0_period_ramp(LETIMER_TypeDef *letimer, int32_t added_pwm, uint32_t step);
 
 #endif
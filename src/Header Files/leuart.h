@@ -5,6 +5,7 @@
 #define	LEUART_GUARD_H
 
 #include "em_leuart.h"
+#include "cmu.h"
 #include "sleep_routines.h"
 #include "ble.h"
 #include "HW_delay.h"
@@ -20,6 +21,7 @@
 #define Tdelay    2
 #define TdelayLong    50
 #define IFC_CLR       0xFF
+#define LEUART_STR_LEN  96    // frame buffers, 80 characters plus the BLE checksum
 
 /***************************************************************************//**
  * @addtogroup leuart
@@ -58,14 +60,15 @@ typedef enum {
 typedef enum {
   STARTFRAME,
   RXDATAV,
-  SIGFRAME
+  SIGFRAME,
+  RAW_RX
 } LEUART_READ_STATES ;
 
 typedef struct {
   LEUART_WRITE_STATES current_state;
   LEUART_TypeDef *leuart;
 
-  char data[80];
+  char data[LEUART_STR_LEN];
   uint32_t str_length;
   uint32_t leuart0_write_cb;
   volatile bool busy;
@@ -78,12 +81,22 @@ typedef struct {
 
   uint32_t leuart0_read_cb;
   volatile bool read_busy;
-  char read_str[80];
+  char read_str[LEUART_STR_LEN];
 //  uint32_t sigframe;
 //  uint32_t startframe;
   uint32_t str_length;
+  uint32_t raw_rx_evt;        // event scheduled per byte while in RAW_RX mode
 } LEUART_READ_SM;
 
+/* Driver state of one LEUART instance, the write and read state machines run
+ * independently of those of any other instance. */
+typedef struct {
+  LEUART_WRITE_SM write;
+  LEUART_READ_SM  read;
+  uint32_t        char_us;    //time to shift out one character
+  uint32_t        routepen;   //pins enabled by leuart_open()
+} LEUART_CTX;
+
 /** @} (end addtogroup leuart) */
 
 //***********************************************************************************
@@ -96,9 +109,13 @@ typedef struct {
 //***********************************************************************************
 void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings);
 void LEUART0_IRQHandler(void);
+#if LEUART_COUNT > 1
+void LEUART1_IRQHandler(void);
+#endif
 void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len, uint32_t leuart_cb);
 
-bool leuart_tx_busy(void);
+bool leuart_tx_busy(LEUART_TypeDef *leuart);
+void leuart_pins(LEUART_TypeDef *leuart, bool enable);
 
 
 uint32_t leuart_status(LEUART_TypeDef *leuart);
@@ -111,7 +128,10 @@ uint8_t leuart_app_receive_byte(LEUART_TypeDef *leuart);
 void TXBL_IRQ(LEUART_WRITE_SM *LEUART_SM);
 void TXC_IRQ(LEUART_WRITE_SM *LEUART_SM);
 
-void leuart_rx_tdd(void);
-void received_str(char *out_str);
+void leuart_rx_tdd(LEUART_TypeDef *leuart);
+void received_str(LEUART_TypeDef *leuart, char *out_str);
+
+void leuart_raw_rx(LEUART_TypeDef *leuart, bool enable, uint32_t rx_evt);
+uint32_t leuart_raw_read(LEUART_TypeDef *leuart, char *out_str, uint32_t max_len);
 
 #endif
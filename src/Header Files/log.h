@@ -0,0 +1,144 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef LOG_HG
+#define LOG_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+#include "em_core.h"
+#include "sl_sleeptimer.h"
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LOG_LVL_TRACE       0
+#define LOG_LVL_DEBUG       1
+#define LOG_LVL_INFO        2
+#define LOG_LVL_WARN        3
+#define LOG_LVL_ERROR       4
+#define LOG_LVL_OFF         5
+
+/* Lowest level compiled in. A file can define LOG_FILE_LEVEL before its first include of
+ * this header to log more or less than the rest. */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           LOG_LVL_INFO
+#endif
+#ifndef LOG_FILE_LEVEL
+#define LOG_FILE_LEVEL      LOG_LEVEL
+#endif
+
+#define LOG_RING_BYTES      512       // record ring, a power of two
+#define LOG_REC_MAX         48        // argument bytes of a record, the ones past it are left out
+#define LOG_STR_MAX         16        // characters kept of a %s argument
+#define LOG_FRAME_HDR       7         // 'G', record bytes, dropped records, base tick
+#define LOG_FRAME_MAX       80        // record bytes per frame, header and CRC fit LEUART_STR_LEN
+#define LOG_SEP             "\x1f"    // between level, file:line and format in the string table
+#define LOG_REC_HDR         3         // record length, format id
+#define LOG_TICK_MAX        5         // bytes of a 32 bit varint
+#define LOG_REC_ROOM        (LOG_REC_HDR + LOG_TICK_MAX + LOG_REC_MAX)  // ring bytes of the largest record
+
+/* Log sites. The format string and its level and place go to the "logstr" section and the
+ * record only holds the string's offset there, the time and the raw arguments. Formatting
+ * is done on the host by tools/logfmt.py with the section taken from the ELF.
+ *
+ * An argument takes 4 bytes, 8 for 64 bit integers and a length byte plus up to
+ * LOG_STR_MAX characters for a string. Floats and doubles go as 4 byte floats. The host
+ * reads sizes off the conversions, so 64 bit integers need a "ll" conversion, all other
+ * integers one without. At most LOG_ARGS_MAX arguments. Safe from interrupts. */
+#define LOG_ARGS_MAX        8
+
+#if LOG_FILE_LEVEL <= LOG_LVL_TRACE
+#define LOG_TRACE(...)      LOG_EMIT("T", __VA_ARGS__)
+#else
+#define LOG_TRACE(...)      do{}while(0)
+#endif
+#if LOG_FILE_LEVEL <= LOG_LVL_DEBUG
+#define LOG_DEBUG(...)      LOG_EMIT("D", __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)      do{}while(0)
+#endif
+#if LOG_FILE_LEVEL <= LOG_LVL_INFO
+#define LOG_INFO(...)       LOG_EMIT("I", __VA_ARGS__)
+#else
+#define LOG_INFO(...)       do{}while(0)
+#endif
+#if LOG_FILE_LEVEL <= LOG_LVL_WARN
+#define LOG_WARN(...)       LOG_EMIT("W", __VA_ARGS__)
+#else
+#define LOG_WARN(...)       do{}while(0)
+#endif
+#if LOG_FILE_LEVEL <= LOG_LVL_ERROR
+#define LOG_ERROR(...)      LOG_EMIT("E", __VA_ARGS__)
+#else
+#define LOG_ERROR(...)      do{}while(0)
+#endif
+
+#define LOG_XSTR(x)         LOG_STR(x)
+#define LOG_STR(x)          #x
+#define LOG_CAT(a, b)       LOG_CAT_(a, b)
+#define LOG_CAT_(a, b)      a##b
+
+#define LOG_EMIT(level, fmt, ...) do{ \
+    static const char log_fmt_[] __attribute__((section("logstr"))) = \
+        level LOG_SEP __FILE__ ":" LOG_XSTR(__LINE__) LOG_SEP fmt; \
+    LOG_REC log_rec_; \
+    log_begin(&log_rec_, log_fmt_); \
+    LOG_ARGS(&log_rec_, ##__VA_ARGS__); \
+    log_commit(&log_rec_); \
+  }while(0)
+
+#define LOG_ARG(rec, x)     _Generic((x), \
+    float: log_put_f32, double: log_put_f32, \
+    int64_t: log_put_u64, uint64_t: log_put_u64, \
+    char *: log_put_str, const char *: log_put_str, \
+    default: log_put_u32)((rec), (x))
+
+#define LOG_NARGS(...)      LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define LOG_ARGS(rec, ...)  LOG_CAT(LOG_ARGS_, LOG_NARGS(__VA_ARGS__))(rec, ##__VA_ARGS__)
+#define LOG_ARGS_0(rec)
+#define LOG_ARGS_1(rec, a)       LOG_ARG(rec, a)
+#define LOG_ARGS_2(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_1(rec, __VA_ARGS__)
+#define LOG_ARGS_3(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_2(rec, __VA_ARGS__)
+#define LOG_ARGS_4(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_3(rec, __VA_ARGS__)
+#define LOG_ARGS_5(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_4(rec, __VA_ARGS__)
+#define LOG_ARGS_6(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_5(rec, __VA_ARGS__)
+#define LOG_ARGS_7(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_6(rec, __VA_ARGS__)
+#define LOG_ARGS_8(rec, a, ...)  LOG_ARG(rec, a); LOG_ARGS_7(rec, __VA_ARGS__)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// A record being built on the stack of the log site
+typedef struct {
+  uint16_t  id;         // offset of the format in "logstr"
+  uint8_t   len;        // argument bytes in args
+  uint8_t   args[LOG_REC_MAX];
+} LOG_REC;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void log_open(uint32_t drain_evt);
+
+void log_begin(LOG_REC *rec, const char *fmt);
+void log_put_u32(LOG_REC *rec, uint32_t value);
+void log_put_u64(LOG_REC *rec, uint64_t value);
+void log_put_f32(LOG_REC *rec, float value);
+void log_put_str(LOG_REC *rec, const char *str);
+void log_commit(LOG_REC *rec);
+
+uint32_t log_dropped(void);
+uint32_t log_room(void);
+void log_room_event(uint32_t room_evt);
+void log_drain_cb(void);
+
+#endif
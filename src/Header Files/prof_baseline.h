@@ -0,0 +1,38 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef PROF_BASELINE_HG
+#define PROF_BASELINE_HG
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+/* Stored median per profiler channel, in the order of PROF_CHANNEL. Sleep channels are in
+ * sleeptimer ticks, all others in core cycles. 0 means no baseline for that channel, as for
+ * the sleeps, where a longer median is no regression.
+ * Refresh by copying the med: values of a "#P!" report from a known good build.
+ * The host simulation defines PROF_BASELINE_FILE, its table holds the firmware instructions
+ * counted by sim/tests/prof_bench.py. */
+#ifdef PROF_BASELINE_FILE
+#include PROF_BASELINE_FILE
+#else
+#define PROF_BASELINE { \
+  0,    /* EM1 */ \
+  0,    /* EM2 */ \
+  0,    /* EM3 */ \
+  0,    /* LEUART0 */ \
+  0,    /* LEUART1 */ \
+  0,    /* I2C0 */ \
+  0,    /* I2C1 */ \
+  0,    /* LETIMER0 */ \
+  0,    /* TXBL */ \
+  0,    /* RXDATAV */ \
+  0,    /* I2C ACK */ \
+  0,    /* I2C RX */ \
+  0     /* add_scheduled_event */ \
+}
+#endif
+
+#define PROF_REGRESS_PCT    20    // flag a channel whose median exceeds its baseline by this much
+
+#endif
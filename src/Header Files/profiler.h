@@ -0,0 +1,113 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef PROFILER_HG
+#define PROFILER_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#ifndef PROF_HOST
+#include "em_device.h"
+#include "em_core.h"
+#include "sl_sleeptimer.h"
+#endif
+
+/* The developer's include statements */
+#include "prof_baseline.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define PROF_ENABLE               // comment out to compile the ISR and sleep hooks away
+#define PROF_PATHS                // also time the handlers inside the ISRs and add_scheduled_event
+#define PROF_BINS         32      // log2 bins, bin n holds durations in [2^(n-1), 2^n)
+
+/* Time sources. On target ISR durations use the DWT cycle counter, which stops while the
+ * core sleeps, so sleep durations use the RTCC based sleeptimer tick count instead.
+ * Defining PROF_HOST replaces both with variables so the aggregation code builds on Linux
+ * against a virtual clock. */
+#ifdef PROF_HOST
+extern uint32_t prof_host_cycles;
+extern uint32_t prof_host_ticks;
+#define PROF_CYCLES()     (prof_host_cycles)
+#define PROF_LE_TICKS()   (prof_host_ticks)
+#else
+#define PROF_CYCLES()     (DWT->CYCCNT)
+#define PROF_LE_TICKS()   (sl_sleeptimer_get_tick_count())
+#endif
+
+/* ISR and path durations are taken on a cycle clock that stands still while an excluded
+ * span runs inside them: an ISR that preempts another and add_scheduled_event(). An ISR
+ * channel then holds the cost of that handler alone. prof_excluded only grows. */
+extern volatile uint32_t prof_excluded;
+#define PROF_OWN_CYCLES()             (PROF_CYCLES() - prof_excluded)
+
+#ifdef PROF_ENABLE
+#define PROF_ISR_ENTER()              PROF_OWN_CYCLES()
+#define PROF_ISR_EXIT(channel, start) prof_record_excluded((channel), PROF_OWN_CYCLES() - (start))
+#else
+#define PROF_ISR_ENTER()              0
+#define PROF_ISR_EXIT(channel, start) ((void)(start))
+#endif
+
+/* Hot paths called from the ISRs. TXBL, RXDATAV and the I2C handlers are part of their
+ * ISR's time, the scheduler path is left out of it with PROF_PATH_EXIT_EXCLUDED. The
+ * ISR totals still include the cost of the hooks themselves while PROF_PATHS is defined. */
+#if defined(PROF_ENABLE) && defined(PROF_PATHS)
+#define PROF_PATH_ENTER()                       PROF_OWN_CYCLES()
+#define PROF_PATH_EXIT(channel, start)          prof_record((channel), PROF_OWN_CYCLES() - (start))
+#define PROF_PATH_EXIT_EXCLUDED(channel, start) prof_record_excluded((channel), PROF_OWN_CYCLES() - (start))
+#else
+#define PROF_PATH_ENTER()                       0
+#define PROF_PATH_EXIT(channel, start)          ((void)(start))
+#define PROF_PATH_EXIT_EXCLUDED(channel, start) ((void)(start))
+#endif
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  PROF_SLEEP_EM1,       // sleeptimer ticks
+  PROF_SLEEP_EM2,
+  PROF_SLEEP_EM3,
+  PROF_ISR_LEUART0,     // core cycles
+  PROF_ISR_LEUART1,
+  PROF_ISR_I2C0,
+  PROF_ISR_I2C1,
+  PROF_ISR_LETIMER0,
+  PROF_PATH_TXBL,       // core cycles, part of their ISR channel
+  PROF_PATH_RXDATAV,
+  PROF_PATH_I2C_ACK,
+  PROF_PATH_I2C_RX,
+  PROF_PATH_SCHED_ADD,  // core cycles, left out of the ISR channels
+  PROF_CHANNELS
+} PROF_CHANNEL;
+
+typedef struct {
+  uint16_t  bins[PROF_BINS];  // saturating counts
+  uint32_t  count;
+  uint32_t  min;
+  uint32_t  max;
+  uint64_t  total;
+} PROF_HIST;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void prof_open(void);
+void prof_reset(void);
+void prof_record(PROF_CHANNEL channel, uint32_t duration);
+void prof_record_excluded(PROF_CHANNEL channel, uint32_t duration);
+
+const PROF_HIST *prof_hist(PROF_CHANNEL channel);
+const char *prof_channel_name(PROF_CHANNEL channel);
+uint32_t prof_median(PROF_CHANNEL channel);
+bool prof_regressed(PROF_CHANNEL channel);
+bool prof_format(PROF_CHANNEL channel, char *out_str, uint32_t max_len);
+
+#endif
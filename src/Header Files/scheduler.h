@@ -14,6 +14,7 @@
 
 /* The developer's include statements */
 #include "sleep_routines.h"
+#include "events.h"
 
 //***********************************************************************************
 // defined files
@@ -36,5 +37,8 @@ void remove_scheduled_event(uint32_t event);
 
 uint32_t get_scheduled_events(void);
 
+void scheduler_dispatch(void);
+void scheduler_discard(void);
+
 
 #endif
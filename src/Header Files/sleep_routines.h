@@ -6,12 +6,18 @@
 
 
 /* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /* Silicon Labs include statements */
 #include "em_assert.h"
 #include "em_emu.h"
 #include "em_core.h"
+#include "sl_sleeptimer.h"
 /* The developer's include statements */
+#include "profiler.h"
+#include "trace.h"
 
 
 //***********************************************************************************
@@ -26,10 +32,40 @@
 
 #define I2C_EM_BLOCK EM2 // first mode it cannot enter
 
+#define SLEEP_MAX_CLIENT_BLOCKS 5   // nested blocks a single client may hold on one EM
+
+#define SLEEP_PREDICTIVE            // pick the EM from the next deadline instead of always the deepest
+#define SLEEP_DEADLINE_NONE     UINT32_MAX
+#define SLEEP_ACTIVE_UW         1600  // EM0 power while waking up, CMU_HFRCO_LOW on DCDC
+
 
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+typedef enum {
+  SLEEP_CLIENT_APP,
+  SLEEP_CLIENT_LETIMER,
+  SLEEP_CLIENT_LEUART_TX,
+  SLEEP_CLIENT_I2C0,
+  SLEEP_CLIENT_I2C1,
+  SLEEP_CLIENT_RGB,
+  SLEEP_CLIENT_CMU,
+  SLEEP_CLIENT_COUNT
+} SLEEP_CLIENT;
+
+typedef struct {
+  uint8_t   blocks[MAX_ENERGY_MODES];   // blocks currently held, per energy mode
+  uint32_t  underflows;                 // unblocks without a matching block
+  uint64_t  hold_ticks;                 // sleep time spent shallower than allowed because of this client
+} SLEEP_CLIENT_STATS;
+
+typedef struct {
+  uint32_t  power_uw;     // power drawn while sleeping in the mode
+  uint32_t  wakeup_us;    // entry plus exit latency, spent at SLEEP_ACTIVE_UW
+  uint32_t  switch_nj;    // energy of the transition on top, DCDC mode and voltage scale changes
+} SLEEP_EM_COST;
+
+typedef uint32_t (*SLEEP_DEADLINE_FN)(void);  // returns us until the client's next interrupt
 
 
 //***********************************************************************************
@@ -38,10 +74,19 @@
 
 void enter_sleep(void);
 void sleep_open(void);
-void sleep_block_mode(uint32_t EM);
-void sleep_unblock_mode(uint32_t EM);
+void sleep_block_mode(SLEEP_CLIENT client, uint32_t EM);
+void sleep_unblock_mode(SLEEP_CLIENT client, uint32_t EM);
 
 uint32_t current_block_energy_mode(void);
 
+uint64_t sleep_em_ticks(uint32_t EM);
+const SLEEP_CLIENT_STATS *sleep_client_stats(SLEEP_CLIENT client);
+const char *sleep_client_name(SLEEP_CLIENT client);
+
+void sleep_deadline_register(SLEEP_CLIENT client, SLEEP_DEADLINE_FN next_deadline_us);
+void sleep_em_costs_set(const SLEEP_EM_COST *costs);
+uint32_t sleep_next_deadline_us(void);
+uint32_t sleep_select_mode(uint32_t deepest_EM, uint32_t deadline_us);
+
 
 #endif
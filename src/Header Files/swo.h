@@ -0,0 +1,52 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SWO_HG
+#define SWO_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+
+/* The developer's include statements */
+#include "brd_config.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SWO_ENABLE                    // comment out to leave the ITM, DWT sampling and SWO pin off
+
+#define SWO_ACPR            21        // AUXHFRCO 19 MHz / (21 + 1) = 863.6 kbaud NRZ
+#define SWO_PC_POSTPRESET   15        // PC sample every (15 + 1) * 1024 cycles, about 1.2 kHz at 19 MHz
+
+// ITM stimulus ports, tools/swo_profile.py reads the same numbers
+#define SWO_PORT_TEXT       0         // bytes of text lines, swo_puts()
+#define SWO_PORT_TRACE      1         // one word per trace record, see swo_trace()
+
+/* DWT counters that send an event packet each time their 8 bit count wraps. CPI counts
+ * stall cycles, EXC exception overhead, SLEEP cycles asleep, LSU load and store cycles
+ * and FOLD folded instructions. */
+#define SWO_DWT_EVENTS      (DWT_CTRL_CPIEVTENA_Msk | DWT_CTRL_EXCEVTENA_Msk | DWT_CTRL_SLEEPEVTENA_Msk \
+                             | DWT_CTRL_LSUEVTENA_Msk | DWT_CTRL_FOLDEVTENA_Msk)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void swo_open(void);
+bool swo_enabled(void);
+
+bool swo_put(uint32_t port, uint32_t word);
+void swo_puts(const char *str);
+uint32_t swo_dropped(void);
+
+#endif
@@ -0,0 +1,71 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef TASK_HG
+#define TASK_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+#include "em_core.h"
+#include "sl_sleeptimer.h"
+
+/* The developer's include statements */
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TASK_SLEEPERS   4         // tasks that can wait on AWAIT_TIMEOUT at once
+#define TASK_DONE       0xFFFF    // resume point of a finished task
+
+/* Stackless tasks in the style of protothreads. A task is the handler of its own scheduler
+ * event and runs from the top each time that event is dispatched, TASK_BEGIN jumps to the
+ * line of the last AWAIT. Locals do not survive an AWAIT, keep them static, and a switch
+ * must not span an AWAIT.
+ *
+ *   void my_task(void){
+ *     static TASK task = TASK_INIT(MY_TASK_CB);
+ *     TASK_BEGIN(&task);
+ *     AWAIT_I2C(&task, Si1133_write(1, COMMAND_REG, TASK_EVENT(&task)));
+ *     AWAIT_TIMEOUT(&task, 25);
+ *     TASK_END(&task);
+ *   }
+ */
+#define TASK_INIT(evt)            { 0, (evt), 0 }
+#define TASK_EVENT(task)          ((task)->event)
+
+#define TASK_BEGIN(task)          switch((task)->lc){ case 0:
+#define TASK_END(task)            (task)->lc = TASK_DONE; case TASK_DONE: ; } return
+
+// Yields until the task's event is scheduled again, by whatever the task handed it to
+#define AWAIT_EVENT(task)         do{ (task)->lc = __LINE__; return; case __LINE__: ; }while(0)
+// Yields until cond holds, rechecked every time the task's event is dispatched
+#define AWAIT_UNTIL(task, cond)   do{ (task)->lc = __LINE__; case __LINE__: if(!(cond)) return; }while(0)
+// Yields for ms milliseconds, the core may sleep in EM2 meanwhile. Another source can
+// schedule the task's event earlier, the timer is then cancelled so it does not resume the
+// task again at a later AWAIT. Compare wake_tick with the tick count to tell the two apart.
+#define AWAIT_TIMEOUT(task, ms)   do{ task_sleep((task), (ms)); AWAIT_EVENT(task); task_sleep_cancel(task); }while(0)
+// Starts an I2C transfer whose callback is TASK_EVENT(task) and yields until it completes
+#define AWAIT_I2C(task, start)    do{ start; AWAIT_EVENT(task); }while(0)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+  uint16_t  lc;           // line to resume at, 0 before the first run
+  uint32_t  event;        // scheduler event whose handler runs the task
+  uint32_t  wake_tick;    // sleeptimer tick an AWAIT_TIMEOUT ends at
+} TASK;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void task_start(TASK *task);
+void task_sleep(TASK *task, uint32_t ms);
+void task_sleep_cancel(TASK *task);
+
+#endif
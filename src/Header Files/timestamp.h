@@ -0,0 +1,41 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef TIMESTAMP_HG
+#define TIMESTAMP_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+#include "em_core.h"
+#include "sl_sleeptimer.h"
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TS_KEEPALIVE_TICKS  0x40000000  // a quarter of the 32 bit counter, about 9 h at 32768 Hz
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void ts_open(void);
+
+uint64_t ts_now(void);
+uint64_t ts_ticks_to_ms(uint64_t ticks);
+uint64_t ts_now_ms(void);
+
+void ts_sync(uint64_t wall_ms);
+bool ts_synced(void);
+uint64_t ts_wall_ms(void);
+
+#endif
@@ -0,0 +1,115 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef TRACE_HG
+#define TRACE_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_core.h"
+#include "sl_sleeptimer.h"
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TRACE_ENABLE                  // comment out to compile every trace hook away
+#define TRACE_RECORDS       256       // ring size in records, a power of two
+#define TRACE_FRAME_RECORDS 8         // records per dump frame, fits the 96 byte LEUART buffer
+#define TRACE_FRAME_HDR     2         // 'X', record count, 0 for the meta frame
+
+// Categories, TRACE_CATEGORIES selects which hooks are compiled in
+#define TRACE_CAT_ISR       0x01      // ISR enter and exit
+#define TRACE_CAT_EVENT     0x02      // scheduler event post and dispatch
+#define TRACE_CAT_SLEEP     0x04      // sleep enter and exit
+#define TRACE_CAT_I2C       0x08      // I2C engine state changes
+#define TRACE_CAT_LEUART    0x10      // LEUART write and read state changes
+#define TRACE_CAT_CLOCK     0x20      // core clock changes, needed to turn cycles into time
+
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES    (TRACE_CAT_ISR | TRACE_CAT_EVENT | TRACE_CAT_SLEEP | TRACE_CAT_I2C | TRACE_CAT_LEUART | TRACE_CAT_CLOCK)
+#endif
+
+#ifdef TRACE_ENABLE
+#define TRACE_ON(cat)       ((TRACE_CATEGORIES & (cat)) != 0)
+#else
+#define TRACE_ON(cat)       0
+#endif
+
+/* Hooks. A disabled category folds to nothing. Exit and done records carry the duration
+ * in core cycles, measured with the DWT counter the profiler starts, as the 30.5 us
+ * sleeptimer tick is too coarse for an ISR. */
+#define TRACE_CYCLES()                (TRACE_ON(TRACE_CAT_ISR | TRACE_CAT_EVENT) ? DWT->CYCCNT : 0)
+#define TRACE_ISR_ENTER(isr)          (TRACE_ON(TRACE_CAT_ISR) ? (trace_put(TRACE_T_ISR_ENTER, (isr), 0), DWT->CYCCNT) : 0)
+#define TRACE_ISR_EXIT(isr, start)    do{ if(TRACE_ON(TRACE_CAT_ISR)) trace_put_cycles(TRACE_T_ISR_EXIT, (isr), (start)); }while(0)
+#define TRACE_EVT_POST(id)            do{ if(TRACE_ON(TRACE_CAT_EVENT)) trace_put(TRACE_T_EVT_POST, (id), 0); }while(0)
+#define TRACE_EVT_RUN(id)             do{ if(TRACE_ON(TRACE_CAT_EVENT)) trace_put(TRACE_T_EVT_RUN, (id), 0); }while(0)
+#define TRACE_EVT_DONE(id, start)     do{ if(TRACE_ON(TRACE_CAT_EVENT)) trace_put_cycles(TRACE_T_EVT_DONE, (id), (start)); }while(0)
+#define TRACE_SLEEP(type, em)         do{ if(TRACE_ON(TRACE_CAT_SLEEP)) trace_put((type), (em), 0); }while(0)
+#define TRACE_I2C(bus, state)         do{ if(TRACE_ON(TRACE_CAT_I2C)) trace_put(TRACE_T_I2C_STATE, (bus), (state)); }while(0)
+#define TRACE_LEUART(type, state)     do{ if(TRACE_ON(TRACE_CAT_LEUART)) trace_put((type), 0, (state)); }while(0)
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Record types, tools/trace2chrome.py keeps the same numbers
+typedef enum {
+  TRACE_T_ISR_ENTER,    // id: TRACE_ISR
+  TRACE_T_ISR_EXIT,     // id: TRACE_ISR, arg: cycles since enter, 0xFFFF if longer
+  TRACE_T_EVT_POST,     // id: SCHEDULER_EVENT_ID
+  TRACE_T_EVT_RUN,      // id: SCHEDULER_EVENT_ID
+  TRACE_T_EVT_DONE,     // id: SCHEDULER_EVENT_ID, arg: cycles since run, 0xFFFF if longer
+  TRACE_T_SLEEP_ENTER,  // id: energy mode
+  TRACE_T_SLEEP_EXIT,   // id: energy mode
+  TRACE_T_I2C_STATE,    // id: bus, arg: DEFINED_STATES, or 0x100 + I2C_STATUS at the end of a transfer
+  TRACE_T_LEUART_TX,    // arg: LEUART_WRITE_STATES
+  TRACE_T_LEUART_RX,    // arg: LEUART_READ_STATES
+  TRACE_T_CLOCK,        // arg: core clock in MHz from then on
+  TRACE_T_COUNT
+} TRACE_TYPE;
+
+// Traced interrupts
+typedef enum {
+  TRACE_ISR_LETIMER0,
+  TRACE_ISR_LEUART0,
+  TRACE_ISR_I2C0,
+  TRACE_ISR_I2C1,
+  TRACE_ISR_USART0_RX,
+  TRACE_ISR_USART0_TX,
+  TRACE_ISR_LEUART1,
+  TRACE_ISR_COUNT
+} TRACE_ISR;
+
+/* One trace record. tick is the low 32 bits of the sleeptimer count, which keeps running
+ * in EM2 and EM3 unlike the DWT. */
+typedef struct {
+  uint32_t  tick;
+  uint8_t   type;       // TRACE_TYPE
+  uint8_t   id;
+  uint16_t  arg;
+} TRACE_REC;
+
+_Static_assert(sizeof(TRACE_REC) == 8, "trace records are 8 bytes on the wire");
+_Static_assert((TRACE_RECORDS & (TRACE_RECORDS - 1)) == 0, "TRACE_RECORDS must be a power of two");
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void trace_open(void);
+void trace_put(TRACE_TYPE type, uint8_t id, uint16_t arg);
+void trace_put_cycles(TRACE_TYPE type, uint8_t id, uint32_t start);
+
+uint32_t trace_read(uint32_t from, TRACE_REC *out, uint32_t max);
+uint32_t trace_written(void);
+void trace_pause(bool pause);
+
+bool trace_dump_start(uint32_t chunk_evt);
+void trace_dump_cb(void);
+
+#endif
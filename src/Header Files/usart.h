@@ -0,0 +1,84 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef USART_HG
+#define USART_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_usart.h"
+#include "em_core.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "cmu.h"
+#include "ldma.h"
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define USART_STR_LEN       96      // frame buffers, the same size as LEUART_STR_LEN
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+  uint32_t  baudrate;
+  uint32_t  tx_loc;
+  uint32_t  rx_loc;
+  bool      tx_pin_en;
+  bool      rx_pin_en;
+  char      startframe;       // first character of a received frame
+  char      sigframe;         // last character of a received frame
+  uint32_t  rx_done_evt;      // scheduled when a whole frame has been received
+} USART_OPEN_STRUCT;
+
+typedef enum {
+  USART_RX_IDLE,              // closed, bytes are ignored
+  USART_RX_START,             // waiting for the start frame character
+  USART_RX_FRAME,             // collecting up to the signal frame character
+  USART_RX_RAW                // buffering every byte, for AT responses
+} USART_RX_STATES;
+
+/* Driver state of the USART. The LEUART matches frames in hardware, here the receive
+ * interrupt does it, so the frame being received and the last complete one are kept apart. */
+typedef struct {
+  USART_TypeDef     *usart;
+  uint32_t          baudrate;
+  uint32_t          routepen;
+
+  char              tx_data[USART_STR_LEN];
+  volatile bool     tx_busy;
+  uint32_t          tx_done_evt;
+
+  USART_RX_STATES   rx_state;
+  char              startframe;
+  char              sigframe;
+  char              rx_str[USART_STR_LEN];
+  uint32_t          rx_length;
+  char              read_str[USART_STR_LEN];
+  uint32_t          rx_done_evt;
+  uint32_t          raw_rx_evt;
+} USART_CTX;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void usart_open(USART_TypeDef *usart, USART_OPEN_STRUCT *usart_settings);
+void usart_close(USART_TypeDef *usart);
+
+void usart_start(USART_TypeDef *usart, char *string, uint32_t string_len, uint32_t done_evt);
+bool usart_tx_busy(USART_TypeDef *usart);
+
+void usart_received_str(USART_TypeDef *usart, char *out_str);
+void usart_raw_rx(USART_TypeDef *usart, bool enable, uint32_t rx_evt);
+uint32_t usart_raw_read(USART_TypeDef *usart, char *out_str, uint32_t max_len);
+
+void USART0_RX_IRQHandler(void);
+void USART0_TX_IRQHandler(void);
+
+#endif
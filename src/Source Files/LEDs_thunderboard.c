@@ -6,17 +6,131 @@
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-
+_Static_assert((RGB_GREEN_PORT == RGB_COLOR_PORT) && (RGB_BLUE_PORT == RGB_COLOR_PORT),
+               "RGB color pins must share a port");
+_Static_assert((RGB1_PORT == RGB_SELECT_PORT) && (RGB2_PORT == RGB_SELECT_PORT) &&
+               (RGB3_PORT == RGB_SELECT_PORT), "RGB select pins must share a port");
 
 //***********************************************************************************
 // Private variables
 //***********************************************************************************
 bool	rgb_enabled_status;
 
+static bool rgb_pwm_opened;
+static bool rgb_pwm_running;
+static uint32_t rgb_pwm_hz;
+static uint8_t rgb_duty[RGB_COLORS];
+static uint32_t rgb_fade_vals[RGB_COLORS][RGB_FADE_STEPS];
+static LDMA_Descriptor_t rgb_fade_desc[RGB_COLORS][RGB_FADE_STEPS];
+
+static const uint32_t rgb_ldma_ch[RGB_COLORS] = { LDMA_CH_RGB_RED, LDMA_CH_RGB_GREEN, LDMA_CH_RGB_BLUE };
+static const LDMA_PeripheralSignal_t rgb_ldma_signal[RGB_COLORS] = {
+  ldmaPeripheralSignal_TIMER1_CC0,
+  ldmaPeripheralSignal_TIMER1_CC1,
+  ldmaPeripheralSignal_TIMER1_CC2
+};
+
+// port masks indexed by the COLOR_ and RGB_LED_ bit sets
+static const uint16_t rgb_color_masks[ALL_COLORS + 1] = {
+  RGB_COLOR_PINS(0), RGB_COLOR_PINS(1), RGB_COLOR_PINS(2), RGB_COLOR_PINS(3),
+  RGB_COLOR_PINS(4), RGB_COLOR_PINS(5), RGB_COLOR_PINS(6), RGB_COLOR_PINS(7)
+};
+static const uint16_t rgb_select_masks[ALL_LEDS + 1] = {
+  RGB_SELECT_PINS(0), RGB_SELECT_PINS(1), RGB_SELECT_PINS(2), RGB_SELECT_PINS(3),
+  RGB_SELECT_PINS(4), RGB_SELECT_PINS(5), RGB_SELECT_PINS(6), RGB_SELECT_PINS(7),
+  RGB_SELECT_PINS(8), RGB_SELECT_PINS(9), RGB_SELECT_PINS(10), RGB_SELECT_PINS(11),
+  RGB_SELECT_PINS(12), RGB_SELECT_PINS(13), RGB_SELECT_PINS(14), RGB_SELECT_PINS(15)
+};
+
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
+static bool rgb_pwm_needed(void);
+static void rgb_pwm_run(bool enable);
+static void rgb_pwm_apply(void);
+static void rgb_pwm_freq_changed(uint32_t hf_hz);
+
+/***************************************************************************//**
+ * @brief
+ * Recomputes the PWM frequency used to time fades after an HFRCO band change.
+ ******************************************************************************/
+static void rgb_pwm_freq_changed(uint32_t hf_hz){
+  rgb_pwm_hz = hf_hz / ((1UL << RGB_PWM_PRESCALE) * (RGB_PWM_TOP + 1));
+}
+
+/***************************************************************************//**
+ * @brief
+ * Checks whether any color needs an intermediate duty cycle.
+ ******************************************************************************/
+static bool rgb_pwm_needed(void){
+  for(int i = 0; i < RGB_COLORS; i++){
+      if((rgb_duty[i] != RGB_DUTY_OFF) && (rgb_duty[i] != RGB_DUTY_ON)) return true;
+  }
+  return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Hands the color pins to TIMER1 or back to GPIO.
+ *
+ * @details
+ * While TIMER1 drives the pins EM2 is blocked, as the timer runs from HFPER. Fully on and
+ * fully off colors do not need the timer, so they are driven by the GPIO data register and
+ * the chip can still reach EM2.
+ ******************************************************************************/
+static void rgb_pwm_run(bool enable){
+  if(enable == rgb_pwm_running) return;
+
+  if(enable){
+      clock_request(cmuClock_TIMER1);
+      sleep_block_mode(SLEEP_CLIENT_RGB, RGB_PWM_EM);
+      for(int i = 0; i < RGB_COLORS; i++){
+          TIMER_CompareSet(RGB_PWM_TIMER, i, rgb_duty[i]);
+          TIMER_CompareBufSet(RGB_PWM_TIMER, i, rgb_duty[i]);
+      }
+      RGB_PWM_TIMER->CNT = 0;
+      TIMER_Enable(RGB_PWM_TIMER, true);
+      RGB_PWM_TIMER->ROUTEPEN = TIMER_ROUTEPEN_CC0PEN | TIMER_ROUTEPEN_CC1PEN | TIMER_ROUTEPEN_CC2PEN;
+  }else{
+      RGB_PWM_TIMER->ROUTEPEN = 0;
+      TIMER_Enable(RGB_PWM_TIMER, false);
+      clock_release(cmuClock_TIMER1);
+      sleep_unblock_mode(SLEEP_CLIENT_RGB, RGB_PWM_EM);
+  }
+  rgb_pwm_running = enable;
+}
 
+/***************************************************************************//**
+ * @brief
+ * Drives the pins from rgb_duty[].
+ *
+ * @details
+ * The GPIO data register is always updated so the pins are correct when the timer stops.
+ * Compare values go through the CCVB buffers and take effect at the next timer overflow,
+ * so a running PWM never shows a partial period.
+ ******************************************************************************/
+static void rgb_pwm_apply(void){
+  uint32_t on = 0;
+
+  for(int i = 0; i < RGB_COLORS; i++){
+      if(rgb_duty[i] == RGB_DUTY_ON) on |= COLOR_RED << i;
+  }
+  GPIO_PortOutSet(RGB_COLOR_PORT, rgb_color_masks[on]);
+  GPIO_PortOutClear(RGB_COLOR_PORT, rgb_color_masks[ALL_COLORS & ~on]);
+  if(!rgb_pwm_opened) return;
+
+  if(rgb_pwm_needed()){
+      if(rgb_pwm_running){
+          for(int i = 0; i < RGB_COLORS; i++){
+              TIMER_CompareBufSet(RGB_PWM_TIMER, i, rgb_duty[i]);
+          }
+      }else{
+          rgb_pwm_run(true);
+      }
+  }else{
+      rgb_pwm_run(false);
+  }
+}
 
 //***********************************************************************************
 // Global functions
@@ -24,42 +138,190 @@ bool	rgb_enabled_status;
 
 void rgb_init(void) {
 	rgb_enabled_status = false;
-  GPIO_PinOutClear(RGB0_PORT,RGB0_PIN);
-  GPIO_PinOutClear(RGB1_PORT,RGB1_PIN);
-  GPIO_PinOutClear(RGB2_PORT,RGB2_PIN);
-  GPIO_PinOutClear(RGB3_PORT,RGB3_PIN);
+  GPIO_PortOutClear(RGB_SELECT_PORT, rgb_select_masks[ALL_LEDS]);
   GPIO_PinOutSet(RGB_ENABLE_PORT,RGB_ENABLE_PIN);
 }
 
+/***************************************************************************//**
+ * @brief
+ * Turns the given colors of the given RGB LEDs on or off.
+ *
+ * @details
+ * The pin masks come from tables built at compile time from brd_config.h, so the update is
+ * one DOUT set or clear store for the color port and one for the select port. On Series 1
+ * GPIO_PortOutSet/Clear use the peripheral set/clear aliases and need no read-modify-write.
+ *
+ * @param[in] leds
+ * RGB_LED_ bit set selecting LEDs
+ *
+ * @param[in] color
+ * COLOR_ bit set selecting colors
+ *
+ * @param[in] enable
+ * true to turn the selection on, false to turn it off
+ ******************************************************************************/
 void leds_enabled(uint32_t leds, uint32_t color, bool enable){
+  uint32_t color_pins = rgb_color_masks[color & ALL_COLORS];
+  uint32_t select_pins = rgb_select_masks[leds & ALL_LEDS];
 
-    if ((color & COLOR_RED) && enable) {
-      GPIO_PinOutSet(RGB_RED_PORT,RGB_RED_PIN);
-    } else if ((color & COLOR_RED) && !enable) GPIO_PinOutClear(RGB_RED_PORT,RGB_RED_PIN);
+  if (enable) {
+    GPIO_PortOutSet(RGB_COLOR_PORT, color_pins);
+    GPIO_PortOutSet(RGB_SELECT_PORT, select_pins);
+  } else {
+    GPIO_PortOutClear(RGB_COLOR_PORT, color_pins);
+    GPIO_PortOutClear(RGB_SELECT_PORT, select_pins);
+  }
 
-    if ((color & COLOR_GREEN) && enable) {
-      GPIO_PinOutSet(RGB_GREEN_PORT,RGB_GREEN_PIN);
-    } else if ((color & COLOR_GREEN) && !enable)  GPIO_PinOutClear(RGB_GREEN_PORT,RGB_GREEN_PIN);
+  // keep the PWM duty cycles in step with colors switched fully on or off here
+  for (int i = 0; i < RGB_COLORS; i++) {
+    if (color & (COLOR_RED << i)) rgb_duty[i] = enable ? RGB_DUTY_ON : RGB_DUTY_OFF;
+  }
+  if (color && rgb_pwm_running) rgb_pwm_apply();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sets up TIMER1 for 8 bit PWM on the three color pins.
+ *
+ * @details
+ * The timer counts up to RGB_PWM_TOP with CC0..2 in PWM mode, routed with RED/GREEN/BLUE_RGB_LOC.
+ * The timer and its clock stay off until a color needs an intermediate duty cycle.
+ * Fades are written into the CCVB buffers by three LDMA channels, each triggered by the
+ * compare match of its own CC channel, so the CPU can stay in EM1 for the whole fade.
+ *
+ * @param[in] fade_done_evt
+ * Event scheduled when a fade finishes, the application must call rgb_pwm_fade_done_cb() from it
+ ******************************************************************************/
+void rgb_pwm_open(uint32_t fade_done_evt){
+  TIMER_Init_TypeDef timer_init = TIMER_INIT_DEFAULT;
+  TIMER_InitCC_TypeDef cc_init = TIMER_INITCC_DEFAULT;
 
-    if ((color & COLOR_BLUE) && enable) {
-      GPIO_PinOutSet(RGB_BLUE_PORT,RGB_BLUE_PIN);
-    } else if ((color & COLOR_BLUE) && !enable)  GPIO_PinOutClear(RGB_BLUE_PORT,RGB_BLUE_PIN);
+  clock_request(cmuClock_TIMER1);
 
-		if ((leds & RGB_LED_0) && enable) {
-			GPIO_PinOutSet(RGB0_PORT,RGB0_PIN);
-		} else if ((leds & RGB_LED_0) && !enable) GPIO_PinOutClear(RGB0_PORT,RGB0_PIN);
+  timer_init.enable = false;
+  timer_init.debugRun = false;
+  timer_init.prescale = RGB_PWM_PRESCALE;
+  TIMER_Init(RGB_PWM_TIMER, &timer_init);
 
-		if ((leds & RGB_LED_1) && enable) {
-			GPIO_PinOutSet(RGB1_PORT,RGB1_PIN);
-		} else if ((leds & RGB_LED_1) && !enable)  GPIO_PinOutClear(RGB1_PORT,RGB1_PIN);
+  cc_init.mode = timerCCModePWM;
+  for(int i = 0; i < RGB_COLORS; i++){
+      TIMER_InitCC(RGB_PWM_TIMER, i, &cc_init);
+      rgb_duty[i] = RGB_DUTY_OFF;
+  }
+  TIMER_TopSet(RGB_PWM_TIMER, RGB_PWM_TOP);
 
-		if ((leds & RGB_LED_2) && enable) {
-			GPIO_PinOutSet(RGB0_PORT,RGB2_PIN);
-		} else if ((leds & RGB_LED_2) && !enable)  GPIO_PinOutClear(RGB2_PORT,RGB2_PIN);
+  RGB_PWM_TIMER->ROUTELOC0 = RED_RGB_LOC | GREEN_RGB_LOC | BLUE_RGB_LOC;
+  RGB_PWM_TIMER->ROUTEPEN = 0;
 
-		if ((leds & RGB_LED_3) && enable) {
-			GPIO_PinOutSet(RGB3_PORT,RGB3_PIN);
-		} else if ((leds & RGB_LED_3) && !enable)  GPIO_PinOutClear(RGB3_PORT,RGB3_PIN);
+  rgb_pwm_freq_changed(CMU_ClockFreqGet(cmuClock_TIMER1));
+  clock_freq_register(rgb_pwm_freq_changed);
+  clock_release(cmuClock_TIMER1);
 
+  ldma_open();
+  ldma_done_event(LDMA_CH_RGB_RED, 0);
+  ldma_done_event(LDMA_CH_RGB_GREEN, 0);
+  ldma_done_event(LDMA_CH_RGB_BLUE, fade_done_evt);
+
+  rgb_pwm_running = false;
+  rgb_pwm_opened = true;
 }
 
+/***************************************************************************//**
+ * @brief
+ * Sets the duty cycle of the three colors, cancelling any fade in progress.
+ *
+ * @param[in] red
+ * Duty cycle 0 (off) to RGB_DUTY_ON (fully on)
+ *
+ * @param[in] green
+ * Duty cycle 0 (off) to RGB_DUTY_ON (fully on)
+ *
+ * @param[in] blue
+ * Duty cycle 0 (off) to RGB_DUTY_ON (fully on)
+ ******************************************************************************/
+void rgb_pwm_set(uint8_t red, uint8_t green, uint8_t blue){
+  if(rgb_pwm_opened){
+      for(int i = 0; i < RGB_COLORS; i++){
+          LDMA_StopTransfer(rgb_ldma_ch[i]);
+      }
+  }
+  rgb_duty[0] = red;
+  rgb_duty[1] = green;
+  rgb_duty[2] = blue;
+  rgb_pwm_apply();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Fades from the current duty cycles to new ones without waking the CPU.
+ *
+ * @details
+ * Each color gets a chain of RGB_FADE_STEPS descriptors. Every descriptor writes one
+ * interpolated duty into the CCVB of its channel once per PWM period, repeated for as many
+ * periods as the step lasts, then links to the next. The final descriptor raises the LDMA
+ * interrupt, which schedules the fade done event. The timer runs for the whole fade even if
+ * both end points are fully on or off, rgb_pwm_fade_done_cb() releases it afterwards.
+ *
+ * @param[in] red
+ * Final duty cycle
+ *
+ * @param[in] green
+ * Final duty cycle
+ *
+ * @param[in] blue
+ * Final duty cycle
+ *
+ * @param[in] fade_ms
+ * Length of the fade in ms
+ ******************************************************************************/
+void rgb_pwm_fade(uint8_t red, uint8_t green, uint8_t blue, uint32_t fade_ms){
+  const uint8_t target[RGB_COLORS] = { red, green, blue };
+  uint32_t hold;
+  int32_t start;
+
+  EFM_ASSERT(rgb_pwm_opened);
+
+  for(int i = 0; i < RGB_COLORS; i++){
+      LDMA_StopTransfer(rgb_ldma_ch[i]);
+  }
+  rgb_pwm_run(true); //starts from the current duty cycles
+
+  hold = (fade_ms * rgb_pwm_hz) / (1000 * RGB_FADE_STEPS);
+  if(hold == 0) hold = 1;
+  if(hold > (_LDMA_CH_CTRL_XFERCNT_MASK >> _LDMA_CH_CTRL_XFERCNT_SHIFT) + 1){
+      hold = (_LDMA_CH_CTRL_XFERCNT_MASK >> _LDMA_CH_CTRL_XFERCNT_SHIFT) + 1;
+  }
+
+  for(int i = 0; i < RGB_COLORS; i++){
+      start = rgb_duty[i];
+      for(int step = 0; step < RGB_FADE_STEPS; step++){
+          rgb_fade_vals[i][step] = start + ((int32_t)(target[i] - start) * (step + 1)) / RGB_FADE_STEPS;
+          if(step < RGB_FADE_STEPS - 1){
+              rgb_fade_desc[i][step] = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_LINKREL_M2P_BYTE(
+                  &rgb_fade_vals[i][step], &RGB_PWM_TIMER->CC[i].CCVB, hold, 1);
+          }else{
+              rgb_fade_desc[i][step] = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(
+                  &rgb_fade_vals[i][step], &RGB_PWM_TIMER->CC[i].CCVB, hold);
+          }
+          rgb_fade_desc[i][step].xfer.size = ldmaCtrlSizeWord;
+          rgb_fade_desc[i][step].xfer.srcInc = ldmaCtrlSrcIncNone; // repeat the step for hold periods
+      }
+      rgb_duty[i] = target[i];
+  }
+
+  for(int i = 0; i < RGB_COLORS; i++){
+      LDMA_TransferCfg_t cfg = LDMA_TRANSFER_CFG_PERIPHERAL(rgb_ldma_signal[i]);
+      LDMA_StartTransfer(rgb_ldma_ch[i], &cfg, &rgb_fade_desc[i][0]);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Finishes a fade, called by the application from the fade done event.
+ *
+ * @details
+ * Stops the timer and releases the EM2 block if the fade ended fully on or off.
+ ******************************************************************************/
+void rgb_pwm_fade_done_cb(void){
+  rgb_pwm_apply();
+}
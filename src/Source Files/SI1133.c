@@ -15,11 +15,19 @@
 // defined files
 //***********************************************************************************
 static uint32_t Si1133_read_data;
-uint32_t periph_address = 0x55;
+static I2C_DEVICE si1133_dev = { SI1133_I2C, SI1133_I2C_ADDRESS, I2C_STATUS_OK };
 
 static uint32_t Si1133_write_data;
 
-static void Si1133_configure();
+static TASK si1133_cfg_task = TASK_INIT(SI1133_CFG_CB);
+static uint32_t si1133_cfg_done_evt;
+static uint32_t si1133_cfg_tries;
+static bool si1133_ready;
+
+// One configuration transfer, a failed one makes the configuration start over
+#define SI1133_CFG_XFER(task, start)  AWAIT_I2C(task, start); if(i2c_dev_status(&si1133_dev) != I2C_STATUS_OK) continue
+
+static void Si1133_bus_open(void);
 
 //***********************************************************************************
 // global variables
@@ -36,79 +44,43 @@ static void Si1133_configure();
 
 /***************************************************************************//**
  * @brief
- * Configures Si133 read operation from the sensor, setting channel0 active.
- * @details
- * Resets counter initially to prevent miswrtes. After that, the RESPONSE0 reg is read
- * and the value is stored in the CMD_CTR_DATA. Specified color is then written to
- *sensor for white light in the INPUT0 register. Further configuration is done
- e first reset the reset cmd ctr to prevent any unwanted bugs. Then we read the
- * response0 register which is what holds the cmd ctr. The value of CHANNEL0 is sent to
- * INPUT0 and the chan list is sent to the command register. RESPONSE0 is read and
- * it is ensured that the CMD CTR Data is incremented for a second time.
- *
- *
+ *Initializes i2c parameters for specifically the Si1133 peripheral.
  *
+ * @details
+ *Configures a local I2C_OPEN_STRUCT, si_values and places initial parameters within.
  *
  * @note
- * Called by Si1133_i2c_open, has no inputs.
+ *I2C open function is run with this configuration, after the struct is filled with variables.
  *
  ******************************************************************************/
-static void Si1133_configure() {
-  uint32_t CMD_CTR_Data; //declare local private variable for CMD_CTR to keep track
-
-  Si1133_write_data = RESET_CMD_CTR;
-
-  Si1133_write(1, COMMAND_REG, NULL_CB); //send reset to counter through command register
-  while(!busy_state(I2C1)); //verify not busy
-
-
-  Si1133_read(1, RESPONSE0_REG, NULL_CB);
-
-  CMD_CTR_Data = (Si1133_read_data & 0x0F); //obtain cmd count initial (by reading RESPONSE0_REG above
-
-  while(!busy_state(I2C1)); //verify not busy
-
-  Si1133_write_data = WRITE_WHITE; //set white photo diode value
-  Si1133_write(1, INPUT0_REG, NULL_CB); //write to INPUT0_REG to set ADCMUX value as white
-
-
-  while(!busy_state(I2C1));//verify not busy
-
-  Si1133_write_data = PARAMTABLE | ADCCONFIG0; //parameter table write OR'd with ADCCONFIG0
-  Si1133_write(1, COMMAND_REG, NULL_CB);//write to command reg what is in Si1133_write_data
-
-  while(!busy_state(I2C1));//verify not busy
-  Si1133_read(1, RESPONSE0_REG, NULL_CB); //check state of RESPONSE0_REG
-
-  while(!busy_state(I2C1));//verify not busy
-
-
-  if((Si1133_read_data & 0x0F) != (CMD_CTR_Data+1)) { //compare to verify CMD_CTR got incremented
-      EFM_ASSERT(false);
-  }
-
+static void Si1133_bus_open(void) {
+  I2C_OPEN_STRUCT si_values;
 
-  Si1133_write_data = CHANNEL0_ACTIVE; //value to write to INPUT0_REG
-  Si1133_write(1,INPUT0_REG,NULL_CB); //write to INPUT0_REG to set Channel0 as active Si1133 Channel
+  if(i2c_is_open(SI1133_I2C)) return; //already opened for the Si7021
 
-  while(!busy_state(I2C1));//verify not busy
+  si_values.clhr = i2cClockHLRAsymetric;
+  si_values.enable = true;
+  si_values.freq = I2C_FREQ_FAST_MAX ;
 
-  Si1133_write_data = PARAMTABLE | CHAN_LIST; //parameter table write OR'd with CHAN_LISt
-  Si1133_write(1, COMMAND_REG, NULL_CB); //write that to command_reg
+  si_values.master = true;
+  si_values.scl_pin_en = true;
+  si_values.sda_pin_en = true;
 
-  while(!busy_state(I2C1));//verify not busy
+  si_values.refFreq = 0;
 
-  Si1133_read(1,RESPONSE0_REG, NULL_CB); //read RESPONSE0_REG to verify command success
+  si_values.scl_Location = I2C_ROUTE_SCL_0;
+  si_values.sda_Location = I2C_ROUTE_SDA_0;
 
-  while(!busy_state(I2C1));//verify not busy
+  si_values.scl_port = SI1133_SCL_PORT;
+  si_values.scl_pin = SI1133_SCL_PIN;
+  si_values.sda_port = SI1133_SDA_PORT;
+  si_values.sda_pin = SI1133_SDA_PIN;
 
-  if((Si1133_read_data  & 0x0F) != (CMD_CTR_Data+2)) { //verify CMD_CTR got incremented again
-    EFM_ASSERT(false);
-  }
-  else {
-      return; //success! exit si1133_configure function
-  }
+  si_values.irq_ack_en  = true;
+  si_values.rxdata_irq_en = true;
+  si_values.irq_stop_en = true;
 
+  i2c_open(SI1133_I2C, &si_values);
 }
 
 //***********************************************************************************
@@ -129,7 +101,6 @@ static void Si1133_configure() {
  ******************************************************************************/
 void Si1133_force() {
 //  Si1133_read(1,RESPONSE0_REG, NULL_CB);
-//  while(!busy_state(I2C1));//verify not busy
 
 
   Si1133_write_data = FORCE; //set force command to write
@@ -160,39 +131,87 @@ void SI1133_request_result(uint32_t LIGHT_CB) {
 
 /***************************************************************************//**
  * @brief
- *Initializes i2c parameters for specifically the Si1133 peripheral.
+ *Starts the Si1133 power up and configuration.
  *
  * @details
- *Configures a local I2C_OPEN_STRUCT, si_values and places initial parameters within.
+ *The sequence runs as a task from the scheduler, so the core can sleep through the power
+ *up delay and every I2C transfer instead of spinning on them.
  *
  * @note
- *I2C open function is run with this configuration, after the struct is filled with variables.
+ *No other Si1133 transfer may be started before done_evt is scheduled.
  *
+ * @param[in] done_evt
+ *Event scheduled once channel 0 is configured
  ******************************************************************************/
+void Si1133_i2c_open(uint32_t done_evt) {
+  si1133_cfg_done_evt = done_evt;
+  task_start(&si1133_cfg_task);
+}
 
-void Si1133_i2c_open() {
-  timer_delay(TimerDelay);
-  I2C_OPEN_STRUCT si_values;
-
-  si_values.clhr = i2cClockHLRAsymetric;
-  si_values.enable = true;
-  si_values.freq = I2C_FREQ_FAST_MAX ;
-
-  si_values.master = true;
-  si_values.scl_pin_en = true;
-  si_values.sda_pin_en = true;
-
-  si_values.refFreq = 0;
-
-  si_values.scl_Location = I2C_ROUTE_SCL_0;
-  si_values.sda_Location = I2C_ROUTE_SDA_0;
-
-  si_values.irq_ack_en  = true;
-  si_values.rxdata_irq_en = true;
-  si_values.irq_stop_en = true;
+/***************************************************************************//**
+ * @brief
+ * Configures Si133 read operation from the sensor, setting channel0 active.
+ * @details
+ * Waits out the sensor power up and opens the I2C bus. Then we first reset the cmd ctr
+ * to prevent any unwanted bugs and read the response0 register which is what holds the
+ * cmd ctr. Specified color is then written to sensor for white light in the INPUT0 register
+ * and written to ADCCONFIG0 through the command register. The value of CHANNEL0 is sent to
+ * INPUT0 and the chan list is sent to the command register. RESPONSE0 is read after each
+ * command and it is ensured that the CMD CTR Data is incremented each time.
+ * A transfer that failed after the I2C driver's retries, or a counter that did not
+ * increment, starts the sequence over, up to SI1133_CFG_TRIES times. done_evt is scheduled
+ * either way, Si1133_ready() tells whether the sensor was configured.
+ *
+ * @note
+ * Handler of SI1133_CFG_CB, started by Si1133_i2c_open(). Each AWAIT_I2C returns to the
+ * scheduler until the transfer's MSTOP schedules SI1133_CFG_CB again.
+ *
+ ******************************************************************************/
+void Si1133_configure_task(void) {
+  static uint32_t CMD_CTR_Data; //cmd ctr after the reset, static as it lives across transfers
+  TASK *task = &si1133_cfg_task;
+
+  TASK_BEGIN(task);
+  AWAIT_TIMEOUT(task, TimerDelay); //Si1133 start up time
+  Si1133_bus_open();
+
+  si1133_ready = false;
+  for(si1133_cfg_tries = 0; si1133_cfg_tries < SI1133_CFG_TRIES; si1133_cfg_tries++){
+      if(si1133_cfg_tries){
+          AWAIT_TIMEOUT(task, TimerDelay); //let the sensor settle before starting over
+      }
+
+      Si1133_write_data = RESET_CMD_CTR;
+      SI1133_CFG_XFER(task, Si1133_write(1, COMMAND_REG, TASK_EVENT(task))); //send reset to counter through command register
+      SI1133_CFG_XFER(task, Si1133_read(1, RESPONSE0_REG, TASK_EVENT(task)));
+      CMD_CTR_Data = (Si1133_read_data & 0x0F); //obtain cmd count initial (by reading RESPONSE0_REG above
+
+      Si1133_write_data = WRITE_WHITE; //set white photo diode value
+      SI1133_CFG_XFER(task, Si1133_write(1, INPUT0_REG, TASK_EVENT(task))); //write to INPUT0_REG to set ADCMUX value as white
+
+      Si1133_write_data = PARAMTABLE | ADCCONFIG0; //parameter table write OR'd with ADCCONFIG0
+      SI1133_CFG_XFER(task, Si1133_write(1, COMMAND_REG, TASK_EVENT(task))); //write to command reg what is in Si1133_write_data
+      SI1133_CFG_XFER(task, Si1133_read(1, RESPONSE0_REG, TASK_EVENT(task))); //check state of RESPONSE0_REG
+      if((Si1133_read_data & 0x0F) != (CMD_CTR_Data+1)) { //compare to verify CMD_CTR got incremented
+          continue;
+      }
+
+      Si1133_write_data = CHANNEL0_ACTIVE; //value to write to INPUT0_REG
+      SI1133_CFG_XFER(task, Si1133_write(1, INPUT0_REG, TASK_EVENT(task))); //write to INPUT0_REG to set Channel0 as active Si1133 Channel
+
+      Si1133_write_data = PARAMTABLE | CHAN_LIST; //parameter table write OR'd with CHAN_LISt
+      SI1133_CFG_XFER(task, Si1133_write(1, COMMAND_REG, TASK_EVENT(task))); //write that to command_reg
+      SI1133_CFG_XFER(task, Si1133_read(1, RESPONSE0_REG, TASK_EVENT(task))); //read RESPONSE0_REG to verify command success
+      if((Si1133_read_data  & 0x0F) != (CMD_CTR_Data+2)) { //verify CMD_CTR got incremented again
+          continue;
+      }
+
+      si1133_ready = true; //success!
+      break;
+  }
 
-  i2c_open(I2C1, &si_values);
-  Si1133_configure();
+  add_scheduled_event(si1133_cfg_done_evt);
+  TASK_END(task);
 }
 
 /***************************************************************************//**
@@ -216,7 +235,7 @@ void Si1133_i2c_open() {
  *
  ******************************************************************************/
 void Si1133_read(uint32_t bytes_per_transfer, uint32_t register_address, uint32_t i2c_callback){
-  i2c_start(I2C1, periph_address, READ_OP, &Si1133_read_data, bytes_per_transfer, register_address, i2c_callback);
+  i2c_start(&si1133_dev, READ_OP, &Si1133_read_data, bytes_per_transfer, register_address, i2c_callback);
 }
 
 
@@ -244,7 +263,7 @@ void Si1133_read(uint32_t bytes_per_transfer, uint32_t register_address, uint32_
  *
  ******************************************************************************/
 void Si1133_write(uint32_t bytes_per_transfer, uint32_t register_address, uint32_t i2c_callback){
-  i2c_start(I2C1, periph_address, WRITE_OP, &Si1133_write_data, bytes_per_transfer, register_address, i2c_callback);
+  i2c_start(&si1133_dev, WRITE_OP, &Si1133_write_data, bytes_per_transfer, register_address, i2c_callback);
 }
 
 
@@ -266,6 +285,18 @@ uint32_t Si1133_read_result(){
   return Si1133_read_data;
 }
 
+/***************************************************************************//**
+ * @brief
+ * Returns whether the configuration started by Si1133_i2c_open() succeeded.
+ ******************************************************************************/
+bool Si1133_ready(void){
+  return si1133_ready;
+}
 
-
-
+/***************************************************************************//**
+ * @brief
+ * Returns the result of the last Si1133 transfer, for the read callback.
+ ******************************************************************************/
+I2C_STATUS Si1133_status(void){
+  return i2c_dev_status(&si1133_dev);
+}
@@ -0,0 +1,223 @@
+/**
+ * @file Si7021.c
+ * @brief Si7021 relative humidity and temperature sensor
+ *Responsible for no hold master measurements through the I2C transaction engine, the core sleeps through the conversion.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "SI7021.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// One measurement transfer, a failed one ends the measurement
+#define SI7021_XFER(task, start)  AWAIT_I2C(task, start); if(i2c_dev_status(&si7021_dev) != I2C_STATUS_OK) break
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static I2C_DEVICE si7021_dev = { SI7021_I2C, SI7021_I2C_ADDRESS, I2C_STATUS_OK };
+
+static TASK si7021_cfg_task = TASK_INIT(SI7021_CFG_CB);
+static TASK si7021_meas_task = TASK_INIT(SI7021_TASK_CB);
+static uint32_t si7021_cfg_done_evt;
+static uint32_t si7021_meas_done_evt;
+
+static uint32_t si7021_write_data;
+static uint32_t si7021_rh_code;
+static uint32_t si7021_temp_code;
+static bool si7021_ready;
+static bool si7021_valid;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void Si7021_bus_open(void);
+
+/***************************************************************************//**
+ * @brief
+ *Opens the sensor I2C bus unless the Si1133 driver has already done so.
+ *
+ * @details
+ *Both sensors sit on the same bus behind the same enable pin, so the settings match
+ *those of the Si1133.
+ ******************************************************************************/
+static void Si7021_bus_open(void) {
+  I2C_OPEN_STRUCT si_values;
+
+  if(i2c_is_open(SI7021_I2C)) return;
+
+  si_values.clhr = i2cClockHLRAsymetric;
+  si_values.enable = true;
+  si_values.freq = I2C_FREQ_FAST_MAX;
+
+  si_values.master = true;
+  si_values.scl_pin_en = true;
+  si_values.sda_pin_en = true;
+
+  si_values.refFreq = 0;
+
+  si_values.scl_Location = I2C_ROUTE_SCL_0;
+  si_values.sda_Location = I2C_ROUTE_SDA_0;
+
+  si_values.scl_port = SI1133_SCL_PORT;
+  si_values.scl_pin = SI1133_SCL_PIN;
+  si_values.sda_port = SI1133_SDA_PORT;
+  si_values.sda_pin = SI1133_SDA_PIN;
+
+  si_values.irq_ack_en  = true;
+  si_values.rxdata_irq_en = true;
+  si_values.irq_stop_en = true;
+
+  i2c_open(SI7021_I2C, &si_values);
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *Starts the Si7021 power up and reset.
+ *
+ * @param[in] done_evt
+ *Event scheduled once the sensor is reset, Si7021_ready() tells whether it answered
+ ******************************************************************************/
+void Si7021_open(uint32_t done_evt) {
+  si7021_cfg_done_evt = done_evt;
+  task_start(&si7021_cfg_task);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Waits out the sensor power up, opens the bus and resets the sensor.
+ *
+ * @details
+ * The reset is a command only write. The sensor does not answer for SI7021_RESET_MS
+ * afterwards, the task sleeps through that before reporting.
+ *
+ * @note
+ * Handler of SI7021_CFG_CB, started by Si7021_open().
+ ******************************************************************************/
+void Si7021_configure_task(void) {
+  TASK *task = &si7021_cfg_task;
+
+  TASK_BEGIN(task);
+  AWAIT_TIMEOUT(task, SI7021_POWERUP_MS);
+  Si7021_bus_open();
+
+  AWAIT_I2C(task, i2c_start(&si7021_dev, WRITE_OP, &si7021_write_data, 0, SI7021_RESET, TASK_EVENT(task)));
+  si7021_ready = (i2c_dev_status(&si7021_dev) == I2C_STATUS_OK);
+  AWAIT_TIMEOUT(task, SI7021_RESET_MS);
+
+  add_scheduled_event(si7021_cfg_done_evt);
+  TASK_END(task);
+}
+
+/***************************************************************************//**
+ * @brief
+ *Starts a humidity and temperature measurement.
+ *
+ * @details
+ *Uses the no hold master command, so the bus is free for the Si1133 during the
+ *conversion and the core sleeps instead of the I2C block stretching the clock.
+ *
+ * @param[in] done_evt
+ *Event scheduled when the measurement is over, Si7021_valid() tells whether it succeeded
+ *
+ * @return
+ *false if the previous measurement is still running, nothing is started then
+ ******************************************************************************/
+bool Si7021_measure(uint32_t done_evt) {
+  if((si7021_meas_task.lc != 0) && (si7021_meas_task.lc != TASK_DONE)) return false;
+
+  si7021_meas_done_evt = done_evt;
+  task_start(&si7021_meas_task);
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Runs one measurement.
+ *
+ * @details
+ * Sends the RH command and sleeps for the worst case conversion time. The result is then
+ * read without a register address, the sensor would NACK a read header before it is done
+ * and the I2C driver retries that. The temperature measured along with the humidity is read
+ * with SI7021_READ_TEMP_PREV, which needs no second conversion.
+ *
+ * @note
+ * Handler of SI7021_TASK_CB, started by Si7021_measure().
+ ******************************************************************************/
+void Si7021_measure_task(void) {
+  TASK *task = &si7021_meas_task;
+
+  TASK_BEGIN(task);
+  si7021_valid = false;
+  si7021_rh_code = 0;
+  si7021_temp_code = 0;
+
+  do{
+      SI7021_XFER(task, i2c_start(&si7021_dev, WRITE_OP, &si7021_write_data, 0, SI7021_MEAS_RH_NOHOLD, TASK_EVENT(task)));
+      AWAIT_TIMEOUT(task, SI7021_CONV_MS);
+      SI7021_XFER(task, i2c_start(&si7021_dev, READ_NOREG_OP, &si7021_rh_code, 2, 0, TASK_EVENT(task)));
+      SI7021_XFER(task, i2c_start(&si7021_dev, READ_OP, &si7021_temp_code, 2, SI7021_READ_TEMP_PREV, TASK_EVENT(task)));
+      si7021_valid = true;
+  }while(0);
+
+  add_scheduled_event(si7021_meas_done_evt);
+  TASK_END(task);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether the reset started by Si7021_open() was acknowledged.
+ ******************************************************************************/
+bool Si7021_ready(void){
+  return si7021_ready;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether the last measurement completed.
+ ******************************************************************************/
+bool Si7021_valid(void){
+  return si7021_valid;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the last relative humidity in 0.1 %RH, clamped to 0 to 100 %RH.
+ *
+ * @details
+ * RH = 125 * code / 65536 - 6, the two status bits of the code are left in as the
+ * datasheet allows.
+ ******************************************************************************/
+int32_t Si7021_rh_x10(void){
+  int32_t rh = (int32_t)((1250 * si7021_rh_code) >> 16) - 60;
+
+  if(rh < 0) rh = 0;
+  if(rh > 1000) rh = 1000;
+  return rh;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the last temperature in 0.01 C.
+ *
+ * @details
+ * T = 175.72 * code / 65536 - 46.85
+ ******************************************************************************/
+int32_t Si7021_temp_x100(void){
+  return (int32_t)((17572 * si7021_temp_code) >> 16) - 4685;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the result of the last Si7021 transfer.
+ ******************************************************************************/
+I2C_STATUS Si7021_status(void){
+  return i2c_dev_status(&si7021_dev);
+}
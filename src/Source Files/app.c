@@ -23,12 +23,31 @@ static uint32_t y=0;
 // Private variables
 //***********************************************************************************
 //static unsigned int color = 0; //declare unsigned int to represent the current color of 3 settings: 0,1,2.
+static bool app_z_mode; //"#Z!" toggles compressed sample frames instead of text
+static COMP_ENC app_z_enc;
+static uint8_t app_z_frame[APP_Z_FRAME];
+static uint32_t app_z_count;
+static uint32_t app_env_pending; //APP_ENV_ readings of this period not in yet
+static bool app_env_light_ok;
+static bool app_env_rh_ok; //RH and temperature of this period are in
+static uint64_t app_env_stamp; //wall time in ms the conversions of this period started at
+static uint32_t app_env_light;
+static int32_t app_env_rh = 0; //last good Si7021 values, repeated in Z frames flagged stale after a failed read
+static int32_t app_env_temp = 0;
+static TASK app_boot_task = TASK_INIT(BOOT_UP_CB);
+static int app_prof_next = PROF_CHANNELS; //next channel of a "#P" report in progress
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
 
 static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_route, uint32_t out1_route); //declaration of defined function, shown later.
+static void app_sleep_report(void);
+static void app_clock_report(void);
+static void app_z_send(void);
+static void app_env_done(uint32_t reading);
+static void app_env_send(void);
+static void app_time_cmd(const char *digits);
 
 //***********************************************************************************
 // Global functions
@@ -47,16 +66,26 @@ static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_r
  ******************************************************************************/
 void app_peripheral_setup(void){
   scheduler_open();
+  cmu_lf_open();
+  sl_sleeptimer_init();   // before anything reads the tick count
+  log_open(LOG_DRAIN_CB);
   sleep_open();
+  prof_open();
   cmu_open();
+  trace_open();
+  swo_open();
   gpio_open();
-  Si1133_i2c_open();
 
   rgb_init();
-  sleep_block_mode(SYSTEM_BLOCK_EM);
-  ble_open(TX_CALLBACK, RX_CALLBACK);
+  rgb_pwm_open(RGB_FADE_DONE_CB);
+  crc_open();
+  flog_open();
+  sleep_block_mode(SLEEP_CLIENT_APP, SYSTEM_BLOCK_EM);
+  ts_open();
+  ble_open(TX_CALLBACK, BLE_TX_DONE_CB);
+  ble_at_open(BLE_AT_RX_CB, BLE_AT_TIMEOUT_CB);
   app_letimer_pwm_open(PWM_PER, PWM_ACT_PER, PWM_ROUTE_0, PWM_ROUTE_1);
-  add_scheduled_event(BOOT_UP_CB);
+  task_start(&app_boot_task);
 }
 
 /***************************************************************************//**
@@ -135,14 +164,12 @@ void scheduled_letimer0_uf_cb(void){
           color = 0;
       }
       */
-  SI1133_request_result(SI1133_CB);
   x = x+3;
   y = y+1;
   float z = (float) x/y;
 
-  char data[80];
-  sprintf(data, ", z = %.1f\n", z);
-  ble_write(data);
+  LOG_INFO("z = %.1f", z);
+  SI1133_request_result(SI1133_CB);
 
 }
 /***************************************************************************//**
@@ -167,7 +194,8 @@ void scheduled_letimer0_comp0_cb(void) {
  *Uses leds_enabled function in order to correctly set enabled leds based on state of color variable.
  *
  * @note
- *Uses COMP1 Interrupt, enabled.
+ *Uses COMP1 Interrupt, enabled. Starts the Si1133 and Si7021 conversions of this period,
+ *the frame goes out once both readings are in.
  *
  ******************************************************************************/
 void scheduled_letimer0_comp1_cb(void) {
@@ -185,6 +213,13 @@ void scheduled_letimer0_comp1_cb(void) {
      */
   //Si1133_read(READ_DATA_B, PART_ID_REGISTER, SI1133_CB);
   Si1133_force();
+  app_env_stamp = ts_wall_ms();
+  app_env_pending = APP_ENV_LIGHT;
+  app_env_light_ok = false;
+  app_env_rh_ok = false;
+  if(Si7021_ready() && Si7021_measure(SI7021_CB)){
+      app_env_pending |= APP_ENV_RH;
+  }
 }
 
 
@@ -193,68 +228,91 @@ void scheduled_letimer0_comp1_cb(void) {
  * Callback function upon completion of an i2c read operation on the SI1133
  *
  * @details
- * Reads value from si1133 peripheral and displays green if expected value is read. Turns on RED led if not properly able to read.
+ * Reads value from si1133 peripheral and displays blue if it is dark. The reading is then
+ * held until the Si7021 measurement of the same period is in as well.
 
  * @note
- * With successful operation, should always be green.
+ * A read that failed after the I2C driver's retries is left out of the frame, the next
+ * period reads again.
  ******************************************************************************/
 void scheduled_si1133_read_cb(){
   uint32_t si1133_data = Si1133_read_result();
-/*
-  if(si1133_data == EXPECTED_DATA){
-      leds_enabled(RGB_LED_1, COLOR_GREEN, true);
-  }else{
-      leds_enabled(RGB_LED_1, COLOR_RED, true);
-  }
 
-  if(si1133_data < EXPECTED_DATA){
-      leds_enabled(RGB_LED_1, COLOR_BLUE, true);
-  }else{
-      leds_enabled(RGB_LED_1, COLOR_BLUE, false);
-  }
+  if(Si1133_status() == I2C_STATUS_OK){
+      if(!ble_peer_active()) flog_append(si1133_data); //kept in flash while nobody is connected
+/*
+      if(si1133_data == EXPECTED_DATA){
+          leds_enabled(RGB_LED_1, COLOR_GREEN, true);
+      }else{
+          leds_enabled(RGB_LED_1, COLOR_RED, true);
+      }
 */
-
-  if(si1133_data < EXPECTED_DATA){
-
-      leds_enabled(RGB_LED_1, COLOR_BLUE, true);
-      char data[80];
-
-      int int_data = si1133_data;
-
-      sprintf(data, "It's Dark outside = %d", int_data);
-      ble_write(data);
-  }else{
-      leds_enabled(RGB_LED_1, COLOR_BLUE, false);
-      char data[80];
-
-      int int_data = si1133_data;
-
-      sprintf(data, "It's Light outside = %d", int_data);
-      ble_write(data);
+      if(si1133_data < EXPECTED_DATA){
+          leds_enabled(RGB_LED_1, COLOR_BLUE, true);
+      }else{
+          leds_enabled(RGB_LED_1, COLOR_BLUE, false);
+      }
+      app_env_light = si1133_data;
+      app_env_light_ok = true;
   }
+  app_env_done(APP_ENV_LIGHT);
+}
 
-
-
+/***************************************************************************//**
+ * @brief
+ * Callback function upon completion of an Si7021 measurement.
+ *
+ * @details
+ * The measurement was started at COMP1 together with the Si1133 force, both sensors
+ * convert in parallel and end up in one frame.
+ ******************************************************************************/
+void scheduled_si7021_read_cb(void){
+  if((app_env_pending & APP_ENV_RH) && Si7021_valid()){
+      app_env_rh = Si7021_rh_x10();
+      app_env_temp = Si7021_temp_x100();
+      app_env_rh_ok = true;
+  }
+  app_env_done(APP_ENV_RH);
 }
 
 /***************************************************************************//**
  * @brief
- * Callback function for booting up peripheral with correct name scheme, a test string, and enabling a timer.
+ * Boot sequence, run as a task from BOOT_UP_CB.
  *
  * @details
- * Performs a write of "Hello World" as a test to the BLE peripheral, as well as starting the letimer0.
+ * Configures the Si1133 and resets the Si7021, then with BLE_TEST_ENABLED programs the module name through the
+ * AT command engine, which reports back on BOOT_UP_CB as well. Performs a write of
+ * "Hello World" as a test to the BLE peripheral and starts the letimer0 last, so no
+ * Si1133 force is issued before the sensor is configured. The core sleeps between steps.
  * @note
- * With successful operation, "Hello World" will be printed, and the BLE peripheral name should also be changed if it is not commented out.
+ * If the HM-18 did not answer the AT sequence the red LED is turned on and the boot carries on,
+ * the module usually still passes data while a phone is connected. The same goes for an
+ * Si1133 that could not be configured, its reads then fail and are dropped, and an Si7021
+ * that did not answer, which is then not sampled.
  ******************************************************************************/
 void scheduled_boot_up_cb(void) {
+  TASK *task = &app_boot_task;
+
+  TASK_BEGIN(task);
+  Si1133_i2c_open(TASK_EVENT(task));
+  AWAIT_EVENT(task);
+  Si7021_open(TASK_EVENT(task));
+  AWAIT_EVENT(task);
+  if(!Si1133_ready() || !Si7021_ready()){
+      leds_enabled(RGB_LED_1, COLOR_RED, true);
+  }
+
 #ifdef BLE_TEST_ENABLED
-  char ble_mod_name[13] = "CSUARTSENS";
-  bool ble_result = ble_test(ble_mod_name);
-  EFM_ASSERT(ble_result);
-  timer_delay(DELAYTIME);
+  if(ble_set_name("CSUARTSENS", TASK_EVENT(task))){
+      AWAIT_EVENT(task);
+  }
+  if(ble_at_status() != BLE_AT_OK){
+      leds_enabled(RGB_LED_1, COLOR_RED, true);
+  }
 #endif
-  ble_write("\n Hello World \n");
+  LOG_INFO("Hello World");
   letimer_start(LETIMER0, true);
+  TASK_END(task);
 }
 
 /***************************************************************************//**
@@ -279,25 +337,301 @@ void BLE_TX_cb(void)
  * @details
  * Checks third value of string to either + or -, slows or speeds up based on this value.
  * Important for specific command we wish to issue, speeding up or slowing down by a specific amount specified
- * after the + or -. Calls letimer function to change period value as a result.
+ * after the + or -. Calls letimer function to change period value as a result, "#U" applies the
+ * change at the next period, "#L" ramps to it by APP_RAMP_STEP per period. Anything but
+ * exactly three digits after the sign is rejected with "U err" or "L err".
+ * "#Crrrgggbbb!" fades RGB LED 1 to the given duty cycles in percent, 000 to 100. A field
+ * that is not three digits or is above 100 rejects the whole command with "C err".
+ * A "#S!" frame requests the sleep statistics report instead, "#P!" the profiler histograms
+ * and "#K!" the clock on-times, all three reports come as log records (log.h). "#R!" replays the samples logged in flash since the last replay,
+ * "#Y!" does the same with compressed frames. "#Z!" toggles compressed live sample frames.
+ * "#X!" dumps the event trace ring, tools/trace2chrome.py turns it into a Chrome trace.
+ * "#T<ms>!" sets the wall time the sample frames are stamped with, "#T!" reads it back.
+ * "#B1!" moves the HM-18 link to the USART for a bulk transfer, "#B0!" back to the LEUART,
+ * the phone has to reconnect after either.
+ * A command carries "*hhhh", the CRC-16 of its text, ahead of the '!', BLE_CRC_REQUIRED
+ * rejects one without. One that fails the check is answered with "CRC err", one too long
+ * for the command buffer with "LEN err", and is ignored.
  ******************************************************************************/
 void BLE_RX_cb(void){
-  char private_input[80];
-  int added_pwm = 0;
-
-  received_str(private_input);
-
-  if(private_input[1] == 'U'){
-     if(private_input[2] == '+'){
-         added_pwm = ((private_input[3] - 0x30)*100);
-         added_pwm = added_pwm +((private_input[4] - 0x30)*10)+(private_input[5] - 0x30);
+  char private_input[LEUART_STR_LEN];
+  int32_t added_pwm = 0;
+  bool color_err = false;
+  bool period_err = false;
+  BLE_RX_STATUS status = ble_read(private_input, sizeof(private_input));
+
+  if(status == BLE_RX_CRC){
+      sprintf(private_input, "CRC err n:%lu\n", (unsigned long)ble_crc_errors());
+      ble_write(private_input); //tells the sender to repeat the command
+      return;
+  }
+  if(status == BLE_RX_LENGTH){
+      ble_write("LEN err\n"); //repeating it will not help
+      return;
+  }
+  clock_boost_request(); //parsing only, released before anything is sent
+
+  if((private_input[1] == 'U') || (private_input[1] == 'L')){
+     bool period_ok = (private_input[2] == '+') || (private_input[2] == '-');
+     for(int j = 3; period_ok && (j < 6); j++){
+         char c = private_input[j];
+         if((c < '0') || (c > '9')) period_ok = false;
+         added_pwm = (added_pwm * 10) + (c - 0x30);
      }
-     if(private_input[2] == '-'){
-         added_pwm  = (((private_input[3] - 0x30)*100)+((private_input[4] - 0x30)*10)+(private_input[5] - 0x30));
-         added_pwm  = added_pwm * (-1);
+     if(period_ok && (private_input[6] != SIGF_CHR)) period_ok = false;
+     if(!period_ok){
+         period_err = true;
+     }else{
+         if(private_input[2] == '-') added_pwm = added_pwm * (-1);
+         if(private_input[1] == 'U'){
+             letimer0_period(LETIMER0, added_pwm);
+         }else{
+             letimer0_period_ramp(LETIMER0, added_pwm, APP_RAMP_STEP);
+         }
      }
   }
-  letimer0_period(LETIMER0, added_pwm);
+  if(private_input[1] == 'C'){
+     uint8_t duty[RGB_COLORS];
+     bool duty_ok = true;
+     for(int i = 0; i < RGB_COLORS; i++){
+         uint32_t pct = 0;
+         for(int j = 0; j < 3; j++){
+             char c = private_input[2 + 3*i + j];
+             if((c < '0') || (c > '9')) duty_ok = false;
+             pct = (pct * 10) + (uint32_t)(c - 0x30);
+         }
+         if(!duty_ok || (pct > APP_DUTY_PCT_MAX)){
+             duty_ok = false;
+             break;
+         }
+         duty[i] = (uint8_t)(((pct * RGB_DUTY_ON) + (APP_DUTY_PCT_MAX / 2)) / APP_DUTY_PCT_MAX);
+     }
+     if(duty_ok){
+         leds_enabled(RGB_LED_1, NO_COLOR, true);
+         rgb_pwm_fade(duty[0], duty[1], duty[2], APP_FADE_MS);
+     }else{
+         color_err = true;
+     }
+  }
+  // a write can wait in leuart_start() for the one before it, that must not be boosted
+  clock_boost_release();
+
+  if(period_err){
+     ble_write((private_input[1] == 'U') ? "U err\n" : "L err\n");
+  }
+  if(color_err){
+     ble_write("C err\n");
+  }
+  if(private_input[1] == 'S'){
+     app_sleep_report();
+  }
+  if((private_input[1] == 'P') && (app_prof_next >= PROF_CHANNELS)){
+     app_prof_next = 0;
+     scheduled_prof_report_cb();
+  }
+  if(private_input[1] == 'K'){
+     app_clock_report();
+  }
+  if((private_input[1] == 'R') || (private_input[1] == 'Y')){
+     flog_replay_start(FLOG_REPLAY_CB, private_input[1] == 'Y');
+  }
+  if(private_input[1] == 'X'){
+     trace_dump_start(TRACE_DUMP_CB);
+  }
+  if(private_input[1] == 'B'){
+     if(ble_link_request((private_input[2] == '1') ? BLE_LINK_USART : BLE_LINK_LEUART)){
+         ble_write("B ok\n");
+     }else{
+         ble_write("B busy\n");
+     }
+  }
+  if(private_input[1] == 'T'){
+     app_time_cmd(&private_input[2]);
+  }
+  if(private_input[1] == 'Z'){
+     if(app_z_mode && app_z_count) app_z_send();
+     app_z_mode = !app_z_mode;
+     comp_enc_init(&app_z_enc, APP_Z_CHANNELS, &app_z_frame[APP_Z_HDR], APP_Z_FRAME - APP_Z_HDR);
+     app_z_count = 0;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Handles "#T<ms>!", which sets the wall time, and "#T!", which reads it back.
+ *
+ * @details
+ * The phone sends its Unix time in ms. Either way the answer is "T <s>.<ms>", the wall time
+ * after the command, with a '*' once the clock was synced since boot.
+ ******************************************************************************/
+static void app_time_cmd(const char *digits){
+  char data[40];
+  uint64_t wall_ms = 0;
+  bool given = false;
+
+  while((*digits >= '0') && (*digits <= '9')){
+      wall_ms = (wall_ms * 10) + (uint64_t)(*digits++ - '0');
+      given = true;
+  }
+  if(given) ts_sync(wall_ms);
+
+  clock_boost_request();
+  wall_ms = ts_wall_ms();
+  sprintf(data, "T %lu.%03lu%s\n", (unsigned long)(wall_ms / 1000), (unsigned long)(wall_ms % 1000), ts_synced() ? "*" : "");
+  clock_boost_release();
+  ble_write(data);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Logs the sleep manager statistics, requested with "#S!".
+ *
+ * @details
+ * First record is the time spent in EM0 to EM3 in ms. Then one per sleep client with
+ * the time it kept the chip out of a deeper mode (h), the blocks it holds on EM0 to EM4 (b)
+ * and the number of unmatched unblocks it made (u).
+ ******************************************************************************/
+static void app_sleep_report(void){
+  uint32_t em_ms[EM4];
+  uint32_t freq = sl_sleeptimer_get_timer_frequency();
+
+  for(int i = EM0; i < EM4; i++){
+      em_ms[i] = (uint32_t)((sleep_em_ticks(i) * 1000) / freq);
+  }
+  LOG_INFO("EM ms 0:%lu 1:%lu 2:%lu 3:%lu", em_ms[EM0], em_ms[EM1], em_ms[EM2], em_ms[EM3]);
+
+  for(int i = 0; i < SLEEP_CLIENT_COUNT; i++){
+      const SLEEP_CLIENT_STATS *stats = sleep_client_stats(i);
+      LOG_INFO("%s h:%lu b:%u%u%u%u%u u:%lu", sleep_client_name(i), (uint32_t)((stats->hold_ticks * 1000) / freq),
+               stats->blocks[EM0], stats->blocks[EM1], stats->blocks[EM2], stats->blocks[EM3], stats->blocks[EM4],
+               stats->underflows);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Logs the profiler histograms, requested with "#P!".
+ *
+ * @details
+ * One record per channel with its count, min, median and max, " REG" after a regression
+ * against the baseline, then its bins from the first non empty one, up to APP_PROF_BINS
+ * per record after the bin index of the first. Sleep channels count sleeptimer ticks,
+ * ISR channels count core cycles.
+ * The report is larger than the log ring, so channels are logged while their records fit
+ * and the rest continues from the PROF_REPORT_CB event once a frame has been drained.
+ ******************************************************************************/
+void scheduled_prof_report_cb(void){
+  uint16_t bins[PROF_BINS + APP_PROF_BINS] = { 0 };   // room for the zeros after the last bin
+
+  for(; app_prof_next < PROF_CHANNELS; app_prof_next++){
+      int i = app_prof_next;
+      const PROF_HIST *hist = prof_hist(i);
+      int first = -1, last = -1;
+      uint32_t records = 1;
+
+      for(int b = 0; b < PROF_BINS; b++){
+          if(hist->bins[b]){
+              if(first < 0) first = b;
+              last = b;
+          }
+      }
+      if(first >= 0) records += (uint32_t)((last - first) / APP_PROF_BINS) + 1;
+      if(log_room() < records * LOG_REC_ROOM){
+          log_room_event(PROF_REPORT_CB);
+          return;
+      }
+      LOG_INFO("%s n:%lu min:%lu med:%lu max:%lu%s", prof_channel_name(i), hist->count,
+               hist->count ? hist->min : 0, prof_median(i), hist->max, prof_regressed(i) ? " REG" : "");
+      memcpy(bins, hist->bins, sizeof(hist->bins));
+      for(int b = first; (b >= 0) && (b <= last); b += APP_PROF_BINS){
+          LOG_INFO("%s @%u:%u,%u,%u,%u,%u,%u", prof_channel_name(i), b,
+                   bins[b], bins[b + 1], bins[b + 2], bins[b + 3], bins[b + 4], bins[b + 5]);
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Logs the clock manager statistics, requested with "#K!".
+ *
+ * @details
+ * One record per managed clock with its on-time in ms and the references currently held.
+ * A clock with a large on-time and references held while the system is idle is leaking.
+ ******************************************************************************/
+static void app_clock_report(void){
+  uint32_t freq = sl_sleeptimer_get_timer_frequency();
+
+  for(int i = 0; i < CMU_NODE_COUNT; i++){
+      LOG_INFO("%s on:%lu r:%lu", clock_name(i), (uint32_t)((clock_on_ticks(i) * 1000) / freq), clock_refs(i));
+  }
 }
 
+/***************************************************************************//**
+ * @brief
+ * Marks a reading of this period as in and sends the frame once none is outstanding.
+ ******************************************************************************/
+static void app_env_done(uint32_t reading){
+  if(!(app_env_pending & reading)) return; //a late reading from a period already sent
+  app_env_pending &= ~reading;
+  if(app_env_pending == 0) app_env_send();
+}
 
+/***************************************************************************//**
+ * @brief
+ * Sends the light, humidity and temperature of one period as one frame.
+ *
+ * @details
+ * As text prefixed with the wall time in s the period's conversions started at, or with
+ * "#Z!" as a record of the compressed live frame. A reading that failed
+ * is left out of the text. A Z record repeats the last good RH and temperature instead,
+ * which costs less than a gap in the deltas, and clears APP_Z_VALID_RH in its flags
+ * channel so the receiver can tell them from a fresh reading.
+ ******************************************************************************/
+static void app_env_send(void){
+  bool rh_ok = app_env_rh_ok;
+
+  if(app_z_mode){
+      if(!app_env_light_ok) return;
+      if(!comp_enc_fits(&app_z_enc, APP_Z_CHANNELS)) app_z_send();
+      comp_enc_put(&app_z_enc, (int32_t)app_env_light);
+      comp_enc_put(&app_z_enc, app_env_rh);
+      comp_enc_put(&app_z_enc, app_env_temp);
+      comp_enc_put(&app_z_enc, rh_ok ? APP_Z_VALID_RH : 0);
+      if(++app_z_count >= APP_Z_BATCH) app_z_send();
+      return;
+  }
+
+  if(!app_env_light_ok && !rh_ok) return;
+
+  clock_boost_request();
+  char data[96];
+  int len = sprintf(data, "[%lu.%03lu] ", (unsigned long)(app_env_stamp / 1000), (unsigned long)(app_env_stamp % 1000));
+  if(app_env_light_ok){
+      int int_data = app_env_light;
+      len += sprintf(&data[len], "It's %s outside = %d%s", (app_env_light < EXPECTED_DATA) ? "Dark" : "Light", int_data, rh_ok ? ", " : "");
+  }
+  if(rh_ok){
+      sprintf(&data[len], "RH = %.1f%%, T = %.2fC", app_env_rh / 10.0f, app_env_temp / 100.0f);
+  }
+  clock_boost_release();
+  ble_write(data);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends the buffered live samples as one compressed frame and starts a new block.
+ *
+ * @details
+ * The frame is 'Z', the record count, the payload length and an APP_Z_CHANNELS channel
+ * compress.c block of light, RH, temperature and APP_Z_VALID_ flag records. Slowly changing readings mostly
+ * take one byte per value or less instead of the 50 odd characters of the text message.
+ ******************************************************************************/
+static void app_z_send(void){
+  app_z_frame[0] = 'Z';
+  app_z_frame[1] = (uint8_t)app_z_count;
+  app_z_frame[2] = (uint8_t)comp_enc_finish(&app_z_enc);
+  ble_write_bytes(app_z_frame, APP_Z_HDR + app_z_frame[2], BLE_WRITE_DONE_CB);
+
+  comp_enc_init(&app_z_enc, APP_Z_CHANNELS, &app_z_frame[APP_Z_HDR], APP_Z_FRAME - APP_Z_HDR);
+  app_z_count = 0;
+}
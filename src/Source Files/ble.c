@@ -13,6 +13,8 @@
 //***********************************************************************************
 #include "ble.h"
 #include <string.h>
+#include <stdio.h>
+#include <ctype.h>
 
 //***********************************************************************************
 // defined files
@@ -22,6 +24,11 @@
 //***********************************************************************************
 // private variables
 //***********************************************************************************
+static BLE_AT_ENGINE ble_at;
+static uint32_t ble_rx_crc_errors;
+static uint32_t ble_rx_tick;          // tick of the last frame accepted from the phone
+static bool ble_rx_seen;
+static BLE_LINK_STATE ble_link = { .task = TASK_INIT(BLE_LINK_CB), .current = BLE_LINK_LEUART, .wanted = BLE_LINK_LEUART };
 
 /***************************************************************************//**
  * @brief BLE module
@@ -37,13 +44,296 @@
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
+static void ble_at_timer_start(uint32_t ms);
+static void ble_at_timer_expired(sl_sleeptimer_timer_handle_t *handle, void *data);
+static void ble_at_send(void);
+static void ble_at_next(void);
+static void ble_at_retry(void);
+static void ble_at_finish(BLE_AT_STATUS status);
+static void ble_write_text(char *string, uint32_t done_evt);
+static void ble_write_frame(char *frame, uint32_t length, uint32_t done_evt);
+static bool ble_hex16(const char *hex, uint16_t *value);
+static void ble_leuart_start(char *string, uint32_t length, uint32_t done_evt);
+static bool ble_leuart_tx_busy(void);
+static void ble_leuart_received(char *out_str);
+static void ble_leuart_raw_rx(bool enable, uint32_t rx_evt);
+static uint32_t ble_leuart_raw_read(char *out_str, uint32_t max_len);
+static void ble_usart_start(char *string, uint32_t length, uint32_t done_evt);
+static bool ble_usart_tx_busy(void);
+static void ble_usart_received(char *out_str);
+static void ble_usart_raw_rx(bool enable, uint32_t rx_evt);
+static uint32_t ble_usart_raw_read(char *out_str, uint32_t max_len);
+static void ble_link_use(BLE_LINK link);
+
+_Static_assert(USART_STR_LEN >= LEUART_STR_LEN, "BLE frames must fit both transports");
+
+static const BLE_TRANSPORT ble_transports[BLE_LINK_COUNT] = {
+  [BLE_LINK_LEUART] = { ble_leuart_start, ble_leuart_tx_busy, ble_leuart_received, ble_leuart_raw_rx, ble_leuart_raw_read },
+  [BLE_LINK_USART]  = { ble_usart_start,  ble_usart_tx_busy,  ble_usart_received,  ble_usart_raw_rx,  ble_usart_raw_read  }
+};
+
+#define ble_tp()  (&ble_transports[ble_link.current])
+
+/***************************************************************************//**
+ * @brief
+ * LEUART transport, binds the LEUART driver calls to HM10_LEUART0.
+ ******************************************************************************/
+static void ble_leuart_start(char *string, uint32_t length, uint32_t done_evt){
+  leuart_start(HM10_LEUART0, string, length, done_evt);
+}
+
+static bool ble_leuart_tx_busy(void){
+  return leuart_tx_busy(HM10_LEUART0);
+}
+
+static void ble_leuart_received(char *out_str){
+  received_str(HM10_LEUART0, out_str);
+}
+
+static void ble_leuart_raw_rx(bool enable, uint32_t rx_evt){
+  leuart_raw_rx(HM10_LEUART0, enable, rx_evt);
+}
+
+static uint32_t ble_leuart_raw_read(char *out_str, uint32_t max_len){
+  return leuart_raw_read(HM10_LEUART0, out_str, max_len);
+}
+
+/***************************************************************************//**
+ * @brief
+ * USART transport, binds the USART driver calls to HM10_USART0.
+ ******************************************************************************/
+static void ble_usart_start(char *string, uint32_t length, uint32_t done_evt){
+  usart_start(HM10_USART0, string, length, done_evt);
+}
+
+static bool ble_usart_tx_busy(void){
+  return usart_tx_busy(HM10_USART0);
+}
+
+static void ble_usart_received(char *out_str){
+  usart_received_str(HM10_USART0, out_str);
+}
+
+static void ble_usart_raw_rx(bool enable, uint32_t rx_evt){
+  usart_raw_rx(HM10_USART0, enable, rx_evt);
+}
+
+static uint32_t ble_usart_raw_read(char *out_str, uint32_t max_len){
+  return usart_raw_read(HM10_USART0, out_str, max_len);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Moves the MCU side of the link to another transport.
+ *
+ * @details
+ * Both peripherals use the same pins, so the LEUART lets go of them before the USART is
+ * opened and takes them back after the USART is closed. Closing the USART releases its
+ * clock, which is what lets the core back into EM2.
+ *
+ * @note
+ * Only called while the AT engine is idle, so both transports are in framed reception.
+ ******************************************************************************/
+static void ble_link_use(BLE_LINK link){
+  USART_OPEN_STRUCT usart_vals;
+
+  if(link == ble_link.current) return;
+  while(ble_tp()->tx_busy());
+
+  if(link == BLE_LINK_USART){
+      usart_vals.baudrate = HM10_USART_BAUDRATE;
+      usart_vals.tx_loc = USART0_TX_ROUTE;
+      usart_vals.rx_loc = USART0_RX_ROUTE;
+      usart_vals.tx_pin_en = true;
+      usart_vals.rx_pin_en = true;
+      usart_vals.startframe = STARTF_CHR;
+      usart_vals.sigframe = SIGF_CHR;
+      usart_vals.rx_done_evt = ble_link.rx_evt;
+
+      leuart_pins(HM10_LEUART0, false);
+      usart_open(HM10_USART0, &usart_vals);
+  }else{
+      usart_close(HM10_USART0);
+      leuart_pins(HM10_LEUART0, true);
+  }
+  ble_link.current = link;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Hands a finished frame to the transport of the current link.
+ *
+ * @details
+ * While the link is being switched the AT engine owns the module, so frames are dropped and
+ * only their done event is scheduled, which keeps a chained transfer from stalling. Samples
+ * dropped this way are still in the flash log.
+ ******************************************************************************/
+static void ble_write_frame(char *frame, uint32_t length, uint32_t done_evt){
+  if(ble_link.switching){
+      add_scheduled_event(done_evt);
+      return;
+  }
+  ble_link.window_bytes += length;
+  ble_tp()->start(frame, length, done_evt);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends a text frame with its checksum.
+ *
+ * @details
+ * "*hhhh" with the CRC-16 of the text is added at the end, before the line feed when the
+ * text ends in one so the receiver still sees whole lines.
+ *
+ * @param[in] string
+ * Text to send, at most LEUART_STR_LEN - BLE_CRC_TEXT_LEN characters
+ *
+ * @param[in] done_evt
+ * Event scheduled when the last character has been sent
+ ******************************************************************************/
+static void ble_write_text(char *string, uint32_t done_evt){
+  char frame[LEUART_STR_LEN + 1];
+  uint32_t length = strlen(string);
+  uint32_t body = length;
+
+  EFM_ASSERT(length + BLE_CRC_TEXT_LEN <= LEUART_STR_LEN);
+  if(body && (string[body - 1] == '\n')) body--;
+
+  memcpy(frame, string, body);
+  sprintf(&frame[body], "%c%04X", BLE_CRC_CHR, crc16(string, body));
+  memcpy(&frame[body + BLE_CRC_TEXT_LEN], &string[body], length - body);
+  ble_write_frame(frame, length + BLE_CRC_TEXT_LEN, done_evt);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Parses exactly four hex digits.
+ ******************************************************************************/
+static bool ble_hex16(const char *hex, uint16_t *value){
+  *value = 0;
+  for(int i = 0; i < 4; i++){
+      if(!isxdigit((unsigned char)hex[i])) return false;
+      *value = (uint16_t)((*value << 4) | (isdigit((unsigned char)hex[i]) ? (hex[i] - '0') : ((toupper((unsigned char)hex[i]) - 'A') + 10)));
+  }
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Arms the AT command timer for the current command.
+ *
+ * @details
+ * Every start bumps timer_gen and hands it to the sleeptimer as callback data,
+ * so an expiry that was already pending when the timer got restarted can be
+ * told apart from the current one.
+ *
+ * @param[in] ms
+ * Time until the timeout event is scheduled
+ ******************************************************************************/
+static void ble_at_timer_start(uint32_t ms){
+  sl_sleeptimer_stop_timer(&ble_at.timer);
+  ble_at.timer_gen++;
+  sl_sleeptimer_start_timer_ms(&ble_at.timer, ms, ble_at_timer_expired,
+                               (void *)(uintptr_t)ble_at.timer_gen, 0, 0);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sleeptimer callback, runs in the RTCC interrupt.
+ *
+ * @details
+ * Records which timer start expired and schedules the timeout event so the
+ * work is done from the main loop.
+ ******************************************************************************/
+static void ble_at_timer_expired(sl_sleeptimer_timer_handle_t *handle, void *data){
+  (void)handle;
+  ble_at.expired_gen = (uint32_t)(uintptr_t)data;
+  add_scheduled_event(ble_at.timeout_evt);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the command at the head of the queue to the HM-18.
+ *
+ * @details
+ * Bytes still buffered from an earlier reply are discarded first so they can
+ * not be matched against this command's response.
+ ******************************************************************************/
+static void ble_at_send(void){
+  BLE_AT_CMD *cmd = &ble_at.queue[ble_at.head];
+
+  ble_tp()->raw_read(ble_at.resp, BLE_AT_STR_LEN);
+  ble_at.resp_length = 0;
+  ble_at.current_state = AT_WAIT_RESP;
+
+  ble_tp()->start(cmd->cmd, strlen(cmd->cmd), NULL_CB);
+  ble_at_timer_start(cmd->timeout_ms);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Retires the command at the head of the queue and starts the next one.
+ ******************************************************************************/
+static void ble_at_next(void){
+  ble_at.head = (ble_at.head + 1) % BLE_AT_QUEUE_LEN;
+  ble_at.count--;
+  ble_at.attempts = 0;
+
+  if(ble_at.count){
+      ble_at_send();
+  }else{
+      ble_at_finish(BLE_AT_OK);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Resends the current command, or fails the sequence when out of retries.
+ ******************************************************************************/
+static void ble_at_retry(void){
+  ble_at.attempts++;
+  if(ble_at.attempts <= ble_at.queue[ble_at.head].retries){
+      ble_at_send();
+  }else{
+      ble_at_finish(BLE_AT_FAIL);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Ends an AT command sequence.
+ *
+ * @details
+ * On failure the remaining queued commands are dropped since they usually
+ * depend on the one that failed. The transport is returned to framed reception
+ * and the done events of the sequence are scheduled.
+ *
+ * @param[in] status
+ * Result reported through ble_at_status()
+ ******************************************************************************/
+static void ble_at_finish(BLE_AT_STATUS status){
+  sl_sleeptimer_stop_timer(&ble_at.timer);
+  ble_at.timer_gen++;
+  ble_at.count = 0;
+  ble_at.attempts = 0;
+  ble_at.status = status;
+
+  ble_tp()->raw_rx(false, NULL_CB);
+  add_scheduled_event(ble_at.done_evt);
+  ble_at.done_evt = 0;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
 
 /***************************************************************************//**
  * @brief
  *Initializes bluetooth parameters for bluetooth transmitter peripheral
  *
  * @details
- *Configures a local LEUART_OPEN_STRUCT, designated by ble_open_vals.
+ *Configures a local LEUART_OPEN_STRUCT, designated by ble_open_vals. The link starts on the
+ *LEUART, ble_link_task() is started to handle later switches.
  *
  * @note
  *This function is run in app_peripheral_setup to configure the device.
@@ -53,6 +343,8 @@
 void ble_open(uint32_t tx_event, uint32_t rx_event){
   LEUART_OPEN_STRUCT ble_open_vals;
 
+  ble_link.rx_evt = rx_event;
+
   ble_open_vals.baudrate = HM10_BAUDRATE;
   ble_open_vals.databits = HM10_DATABITS;
   ble_open_vals.enable = HM10_ENABLE;
@@ -76,7 +368,8 @@ void ble_open(uint32_t tx_event, uint32_t rx_event){
 
   //ble_open_vals.txc_irq_en= LEUART_DEFAULT ;
   //ble_open_vals.txbl_irq_en = LEUART_DEFAULT ;
-  leuart_open(LEUART0, &ble_open_vals);
+  leuart_open(HM10_LEUART0, &ble_open_vals);
+  task_start(&ble_link.task);
 }
 
 
@@ -87,7 +380,7 @@ void ble_open(uint32_t tx_event, uint32_t rx_event){
  * @details
  * Sends a string, referenced by the input char* string to the bluetooth receiving device
  * @note
- * Uses size_t length to store the length of the input string to verify we write the correct amount of chars
+ * The CRC-16 is added as "*hhhh" ahead of a trailing line feed
  *
  * @param[in] *char string
  * Input string to be written to device
@@ -95,209 +388,461 @@ void ble_open(uint32_t tx_event, uint32_t rx_event){
  ******************************************************************************/
 
 void ble_write(char* string){
-  size_t length = strlen(string);
-  leuart_start(LEUART0, string, length,0x00010000);
+  ble_write_text(string, BLE_WRITE_DONE_CB);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes a string to the bluetooth link and schedules an event once it has been sent.
+ *
+ * @details
+ * Lets a caller chain long transfers from the scheduler instead of spinning in
+ * leuart_start() until the previous string is out.
+ *
+ * @param[in] string
+ * Input string to be written to device
+ *
+ * @param[in] done_evt
+ * Event scheduled when the last character has been sent
+ ******************************************************************************/
+void ble_write_cb(char *string, uint32_t done_evt){
+  ble_write_text(string, done_evt);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes a binary frame to the bluetooth link.
+ *
+ * @details
+ * Unlike ble_write() the length is given, so the frame may contain 0 bytes. The CRC-16
+ * of the frame is appended as two bytes, low byte first.
+ *
+ * @param[in] data
+ * Frame to send, at most LEUART_STR_LEN - BLE_CRC_BYTES bytes
+ *
+ * @param[in] length
+ * Number of bytes in data
+ *
+ * @param[in] done_evt
+ * Event scheduled when the last byte has been sent, BLE_WRITE_DONE_CB as for ble_write()
+ ******************************************************************************/
+void ble_write_bytes(const uint8_t *data, uint32_t length, uint32_t done_evt){
+  char frame[LEUART_STR_LEN];
+  uint16_t crc = crc16(data, length);
+
+  EFM_ASSERT(length + BLE_CRC_BYTES <= sizeof(frame));
+  memcpy(frame, data, length);
+  frame[length] = (char)(crc & 0xFF);
+  frame[length + 1] = (char)(crc >> 8);
+  ble_write_frame(frame, length + BLE_CRC_BYTES, done_evt);
 }
 
 /***************************************************************************//**
  * @brief
- *   BLE Test performs two functions.  First, it is a Test Driven Development
- *   routine to verify that the LEUART is correctly configured to communicate
- *   with the BLE HM-18 module.  Second, the input argument passed to this
- *   function will be written into the BLE module and become the new name
- *   advertised by the module while it is looking to pair.
+ * Fetches the last received frame and checks its checksum.
  *
  * @details
- * 	 This global function will use polling functions provided by the LEUART
- * 	 driver for both transmit and receive to validate communications with
- * 	 the HM-18 BLE module.  For the assignment, the communication with the
- * 	 BLE module must use low energy design principles of being an interrupt
- * 	 driven state machine.
+ * A frame "#text*hhhh!" is accepted when hhhh is the CRC-16 of text, and handed on as
+ * "#text!" so command parsing is unchanged. Frames without a checksum, typed by hand in a
+ * terminal app, are accepted unless BLE_CRC_REQUIRED is set. Rejected frames are counted.
+ *
+ * @param[out] out_str
+ * Received frame without its checksum, null terminated
+ *
+ * @param[in] size
+ * Size of out_str
+ *
+ * @return
+ * BLE_RX_OK, or why the frame was rejected
+ ******************************************************************************/
+BLE_RX_STATUS ble_read(char *out_str, uint32_t size){
+  char frame[LEUART_STR_LEN];
+  char *mark;
+  uint32_t length;
+  uint16_t rx_crc;
+
+  ble_tp()->received(frame);
+  length = strlen(frame);
+  mark = strrchr(frame, BLE_CRC_CHR);
+
+  if(mark == NULL){
+      if(BLE_CRC_REQUIRED){
+          ble_rx_crc_errors++;
+          return BLE_RX_CRC;
+      }
+  }else{
+      if((&frame[length] - mark != BLE_CRC_TEXT_LEN + 1) || !ble_hex16(mark + 1, &rx_crc) ||
+         (rx_crc != crc16(&frame[1], (uint32_t)(mark - &frame[1])))){
+          ble_rx_crc_errors++;
+          return BLE_RX_CRC;
+      }
+      memmove(mark, &frame[length - 1], 2);    // keep the signal frame and terminator
+      length -= BLE_CRC_TEXT_LEN;
+  }
+
+  if(length >= size) return BLE_RX_LENGTH;
+  memcpy(out_str, frame, length + 1);
+  ble_rx_tick = sl_sleeptimer_get_tick_count();
+  ble_rx_seen = true;
+  return BLE_RX_OK;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the number of received frames dropped for a bad or missing checksum.
+ ******************************************************************************/
+uint32_t ble_crc_errors(void){
+  return ble_rx_crc_errors;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether the current link is still sending a frame.
+ ******************************************************************************/
+bool ble_tx_busy(void){
+  return ble_tp()->tx_busy();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether a phone sent a frame within the last BLE_PEER_IDLE_MS.
+ *
+ * @details
+ * The HM-18 STATE pin is not wired on this board and its "OK+CONN" notices are not
+ * frames, so the link is judged by traffic. A phone that stays connected without
+ * sending anything counts as gone, which errs on the side of keeping samples.
+ ******************************************************************************/
+bool ble_peer_active(void){
+  uint32_t idle = sl_sleeptimer_get_tick_count() - ble_rx_tick;
+
+  return ble_rx_seen &&
+         ((uint64_t)idle * 1000 < (uint64_t)BLE_PEER_IDLE_MS * sl_sleeptimer_get_timer_frequency());
+}
+
+/***************************************************************************//**
+ * @brief
+ * Initializes the asynchronous AT command engine.
+ *
+ * @details
+ * The engine replaces the polled BLE test. Commands are written with the
+ * interrupt driven LEUART transmit state machine, responses are collected
+ * by the LEUART raw receive mode and timeouts come from the RTCC based
+ * sleeptimer, so interrupts stay enabled and the system may sleep in EM2
+ * for the whole exchange.
  *
  * @note
- *   For this test to run to completion, the phone most not be paired with
- *   the BLE module.  In addition for the name to be stored into the module
- *   a breakpoint must be placed at the end of the test routine and stopped
- *   at this breakpoint while in the debugger for a minimum of 5 seconds.
+ * sl_sleeptimer_init() must have been called before any command is submitted.
+ *
+ * @param[in] rx_evt
+ * Event scheduled when response bytes arrive, handled by ble_at_rx_cb()
+ *
+ * @param[in] timeout_evt
+ * Event scheduled when the AT timer expires, handled by ble_at_timeout_cb()
+ ******************************************************************************/
+void ble_at_open(uint32_t rx_evt, uint32_t timeout_evt){
+  memset(&ble_at, 0, sizeof(ble_at));
+  ble_at.status = BLE_AT_IDLE;
+  ble_at.rx_evt = rx_evt;
+  ble_at.timeout_evt = timeout_evt;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Queues an AT command for the HM-18.
+ *
+ * @details
+ * If the engine is idle the command is sent right away and the transport is put
+ * into raw receive mode. Otherwise it is sent once the commands ahead of it
+ * have matched their response, and its done event is scheduled with those of
+ * the sequence it joined.
+ *
+ * @param[in] cmd
+ * Command string, without line ending as the HM-18 does not use one
+ *
+ * @param[in] expect
+ * Response prefix that completes the command
+ *
+ * @param[in] timeout_ms
+ * Time allowed for the response on each attempt
+ *
+ * @param[in] retries
+ * Resends allowed after a timeout or wrong response
+ *
+ * @param[in] settle_ms
+ * Delay after the response before the next command is sent, 0 for none
+ *
+ * @param[in] done_evt
+ * Event scheduled once the sequence has completed or failed, 0 for none
+ *
+ * @return
+ * false if the queue is full or a string does not fit
+ ******************************************************************************/
+bool ble_at_submit(char *cmd, char *expect, uint32_t timeout_ms, uint32_t retries, uint32_t settle_ms, uint32_t done_evt){
+  BLE_AT_CMD *slot;
+
+  if(ble_at.count >= BLE_AT_QUEUE_LEN) return false;
+  if(strlen(cmd) >= BLE_AT_STR_LEN || strlen(expect) >= BLE_AT_STR_LEN) return false;
+
+  slot = &ble_at.queue[(ble_at.head + ble_at.count) % BLE_AT_QUEUE_LEN];
+  strcpy(slot->cmd, cmd);
+  strcpy(slot->expect, expect);
+  slot->timeout_ms = timeout_ms;
+  slot->retries = retries;
+  slot->settle_ms = settle_ms;
+  ble_at.count++;
+  ble_at.done_evt |= done_evt;
+
+  if(ble_at.status != BLE_AT_BUSY){
+      ble_at.status = BLE_AT_BUSY;
+      ble_at.attempts = 0;
+      ble_tp()->raw_rx(true, ble_at.rx_evt);
+      ble_at_send();
+  }
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Handles response bytes from the HM-18.
+ *
+ * @details
+ * Appends the newly received bytes to the response and compares it with the
+ * expected prefix once enough bytes are in. A match retires the command,
+ * after its settle time if it has one. A mismatch is retried once the
+ * command's timeout has run out, the bytes arriving until then are discarded.
+ * Resending right away would have the rest of the wrong reply, or the tail of
+ * a phone frame cut off by leuart_raw_rx(), read as the reply to the resend
+ * and use up the retries.
+ ******************************************************************************/
+void ble_at_rx_cb(void){
+  BLE_AT_CMD *cmd = &ble_at.queue[ble_at.head];
+  uint32_t expect_length;
+
+  if(ble_at.status != BLE_AT_BUSY) return;
+  if(ble_at.current_state == AT_WAIT_DRAIN){
+      ble_tp()->raw_read(ble_at.resp, BLE_AT_STR_LEN);
+      ble_at.resp_length = 0;
+      return;
+  }
+  if(ble_at.current_state != AT_WAIT_RESP) return;
+
+  ble_at.resp_length += ble_tp()->raw_read(&ble_at.resp[ble_at.resp_length],
+                                           BLE_AT_STR_LEN - 1 - ble_at.resp_length);
+  ble_at.resp[ble_at.resp_length] = 0;
+
+  expect_length = strlen(cmd->expect);
+  if(ble_at.resp_length < expect_length) return;
+
+  if(strncmp(ble_at.resp, cmd->expect, expect_length) == 0){
+      if(cmd->settle_ms){
+          ble_at.current_state = AT_WAIT_SETTLE;
+          ble_at_timer_start(cmd->settle_ms);
+      }else{
+          sl_sleeptimer_stop_timer(&ble_at.timer);
+          ble_at_next();
+      }
+  }else{
+      ble_at.current_state = AT_WAIT_DRAIN;    // the timer keeps running, it ends the drain
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Handles expiry of the AT command timer.
+ *
+ * @details
+ * Expiries from an earlier timer start are ignored. While waiting on or
+ * draining a response the command is retried, while settling the next one is
+ * started.
+ ******************************************************************************/
+void ble_at_timeout_cb(void){
+  if(ble_at.status != BLE_AT_BUSY || ble_at.expired_gen != ble_at.timer_gen) return;
+
+  if(ble_at.current_state == AT_WAIT_SETTLE){
+      ble_at_next();
+  }else{
+      ble_at_retry();
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the state of the AT command engine.
+ ******************************************************************************/
+BLE_AT_STATUS ble_at_status(void){
+  return ble_at.status;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Programs the name the HM-18 advertises while looking to pair.
+ *
+ * @details
+ *   Queues the same sequence the polled BLE test used to run: AT to break
+ *   any active connection, AT+NAME to program the name and AT+RESET so the
+ *   module takes it. The HM-10 datasheet has an error, the name response
+ *   starts with "OK+Set:". Completion is reported through done_evt.
+ *
+ * @note
+ *   For the name to be stored the phone must not be paired with the module.
  *
  * @param[in] *mod_name
- *   The name that will be written to the HM-18 BLE module to identify it
- *   while it is advertising over Bluetooth Low Energy.
+ *   The name that will be written to the HM-18 BLE module.
+ *
+ * @param[in] done_evt
+ *   Event scheduled once the sequence has completed or failed
+ *
+ * @return
+ *   false if the sequence could not be queued
+ ******************************************************************************/
+bool ble_set_name(char *mod_name, uint32_t done_evt){
+  char output_str[BLE_AT_STR_LEN] = "AT+NAME";
+  char result_str[BLE_AT_STR_LEN] = "OK+Set:";
+
+  if(strlen(mod_name) >= (BLE_AT_STR_LEN - strlen(result_str))) return false;
+  strcat(output_str, mod_name);
+  strcat(result_str, mod_name);
+
+  if(!ble_at_submit("AT", "OK", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, done_evt)) return false;
+  if(!ble_at_submit(output_str, result_str, BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, done_evt)) return false;
+  return ble_at_submit("AT+RESET", "OK+RESET", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, BLE_AT_RESET_MS, done_evt);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Asks for the link to the HM-18 to be moved to another transport.
+ *
+ * @details
+ * The switch is run by ble_link_task(). The USART link is meant for bulk transfers such as a
+ * flash log replay, once it carries less than BLE_LINK_IDLE_BYTES per BLE_LINK_IDLE_MS the
+ * task moves back to the LEUART by itself.
+ *
+ * @note
+ * The HM-18 only takes a new baud rate after AT+RESET. While a phone is connected the module
+ * passes AT commands on to it, so a switch starts with AT, which drops the connection as in
+ * ble_set_name(). The phone has to reconnect at the new rate.
+ *
+ * @param[in] link
+ * Link wanted
  *
  * @return
- *   Returns bool true if successfully passed through the tests in this
- *   function.
+ * false if a switch or another AT sequence is in progress
  ******************************************************************************/
+bool ble_link_request(BLE_LINK link){
+  EFM_ASSERT(link < BLE_LINK_COUNT);
+  if(ble_link.switching || (ble_at_status() == BLE_AT_BUSY)) return false;
 
-bool ble_test(char *mod_name){
-	uint32_t	str_len;
-
-	CORE_DECLARE_IRQ_STATE;
-	CORE_ENTER_CRITICAL();
-
-	// This test will limit the test to the proper setup of the LEUART
-	// peripheral, routing of the signals to the proper pins, pin
-	// configuration, and transmit/reception verification.  The test
-	// will communicate with the BLE module using polling routines
-	// instead of interrupts.
-	// How is polling different than using interrupts?
-	// ANSWER: we are constantly checking instead of checking when a flag is raised.
-	// How does interrupts benefit the system for low energy operation?
-	// ANSWER: They allow us to essentially not use the rest of the system UNTIL an interrupt is triggered, saving energy.
-	// How does interrupts benefit the system that has multiple tasks?
-	// ANSWER: Allows us to trigger tasks independent of each other and specifically run one thing if that is the only thing we need to do.
-
-	// First, you will need to review the DSD HM10 datasheet to determine
-	// what the default strings to write data to the BLE module and the
-	// expected return statement from the BLE module to test / verify the
-	// correct response
-
-	// The test_str is used to tell the BLE module to end a Bluetooth connection
-	// such as with your phone.  The ok_str is the result sent from the BLE module
-	// to the micro-controller if there was not active BLE connection at the time
-	// the break command was sent to the BLE module.
-	// Replace the test_str "" with the command to break or end a BLE connection
-	// Replace the ok_str "" with the result that will be returned from the BLE
-	//   module if there was no BLE connection
-	char		test_str[80] = "AT";
-	char		ok_str[80] = "OK";
-
-
-	// output_str will be the string that will program a name to the BLE module.
-	// From the DSD HM10 datasheet, what is the command to program a name into
-	// the BLE module?
-	// The  output_str will be a string concatenation of the DSD HM10 command
-	// and the input argument sent to the ble_test() function
-	// Replace the output_str "" with the command to change the program name
-	// Replace the result_str "" with the first part of the expected result
-	// The HM-10 datasheet has an error. This response starts with "OK+Set:"
-	//  the backend of the expected response will be concatenated with the
-	//  input argument
-	char		output_str[80] = "AT+NAME";
-	char		result_str[80] = "OK+Set:";
-
-
-	// To program the name into your module, you must reset the module after you
-	// have sent the command to update the modules name.  What is the DSD HM10
-	// name to reset the module?
-	// Replace the reset_str "" with the command to reset the module
-	// Replace the reset_result_str "" with the expected BLE module response to
-	//  to the reset command
-	char		reset_str[80] = "AT+RESET";
-	char		reset_result_str[80] = "OK+RESET";
-	char		return_str[80];
-
-	bool		success;
-	bool		rx_disabled, rx_en, tx_en;
-	uint32_t	status;
-
-	// These are the routines that will build up the entire command and response
-	// of programming the name into the BLE module.  Concatenating the command or
-	// response with the input argument name
-	strcat(output_str, mod_name);
-	strcat(result_str, mod_name);
-
-	// The test routine must not alter the function of the configuration of the
-	// LEUART driver, but requires certain functionality to insure the logical test
-	// of writing and reading to the DSD HM10 module.  The following c-lines of code
-	// save the current state of the LEUART driver that will be used later to
-	// re-instate the LEUART configuration
-
-	status = leuart_status(HM10_LEUART0);
-	if (status & LEUART_STATUS_RXBLOCK) {
-		rx_disabled = true;
-		// Enabling, unblocking, the receiving of data from the LEUART RX port
-		leuart_cmd_write(HM10_LEUART0, LEUART_CMD_RXBLOCKDIS);
-	}
-	else rx_disabled = false;
-	if (status & LEUART_STATUS_RXENS) {
-		rx_en = true;
-	} else {
-		rx_en = false;
-		// Enabling the receiving of data from the RX port
-		leuart_cmd_write(HM10_LEUART0, LEUART_CMD_RXEN);
-	// Why could you be stuck in the below while loop after a write to CMD register?
-	// Answer: If the status is not properly set then it will not continue.
-		while (!(leuart_status(HM10_LEUART0) & LEUART_STATUS_RXENS));
-	}
-
-	if (status & LEUART_STATUS_TXENS){
-		tx_en = true;
-	} else {
-		// Enabling the transmission of data to the TX port
-		leuart_cmd_write(HM10_LEUART0, LEUART_CMD_TXEN);
-		while (!(leuart_status(HM10_LEUART0) & LEUART_STATUS_TXENS));
-		tx_en = false;
-	}
-//	leuart_cmd_write(HM10_LEUART0, (LEUART_CMD_CLEARRX | LEUART_CMD_CLEARTX));
-
-	// This sequence of instructions is sending the break ble connection
-	// to the DSD HM10 module.
-	// Why is this command required if you want to change the name of the
-	// DSD HM10 module?
-	// ANSWER:
-	str_len = strlen(test_str);
-	for (uint32_t i = 0; i < str_len; i++){
-		leuart_app_transmit_byte(HM10_LEUART0, test_str[i]);
-	}
-
-	// What will the ble module response back to this command if there is
-	// a current ble connection?
-	// ANSWER:
-	str_len = strlen(ok_str);
-	for (uint32_t i = 0; i < str_len; i++){
-		return_str[i] = leuart_app_receive_byte(HM10_LEUART0);
-		if (ok_str[i] != return_str[i]) {
-				EFM_ASSERT(false);;
-		}
-	}
-
-	// This sequence of code will be writing or programming the name of
-	// the module to the DSD HM10
-	str_len = strlen(output_str);
-	for (uint32_t i = 0; i < str_len; i++){
-		leuart_app_transmit_byte(HM10_LEUART0, output_str[i]);
-	}
-
-	// Here will be the check on the response back from the DSD HM10 on the
-	// programming of its name
-	str_len = strlen(result_str);
-	for (uint32_t i = 0; i < str_len; i++){
-		return_str[i] = leuart_app_receive_byte(HM10_LEUART0);
-		if (result_str[i] != return_str[i]) {
-				EFM_ASSERT(false);;
-		}
-	}
-
-	// It is now time to send the command to RESET the DSD HM10 module
-	str_len = strlen(reset_str);
-	for (uint32_t i = 0; i < str_len; i++){
-		leuart_app_transmit_byte(HM10_LEUART0, reset_str[i]);
-	}
-
-	// After sending the command to RESET, the DSD HM10 will send a response
-	// back to the micro-controller
-	str_len = strlen(reset_result_str);
-	for (uint32_t i = 0; i < str_len; i++){
-		return_str[i] = leuart_app_receive_byte(HM10_LEUART0);
-		if (reset_result_str[i] != return_str[i]) {
-				EFM_ASSERT(false);;
-		}
-	}
-
-	// After the test and programming have been completed, the original
-	// state of the LEUART must be restored
-	if (!rx_en) leuart_cmd_write(HM10_LEUART0, LEUART_CMD_RXDIS);
-	if (rx_disabled) leuart_cmd_write(HM10_LEUART0, LEUART_CMD_RXBLOCKEN);
-	if (!tx_en) leuart_cmd_write(HM10_LEUART0, LEUART_CMD_TXDIS);
-	leuart_if_reset(HM10_LEUART0);
-
-	success = true;
-
-
-	CORE_EXIT_CRITICAL();
-	return success;
+  ble_link.wanted = link;
+  add_scheduled_event(TASK_EVENT(&ble_link.task));
+  return true;
 }
 
+/***************************************************************************//**
+ * @brief
+ * Returns the link currently carrying the frames.
+ ******************************************************************************/
+BLE_LINK ble_link_get(void){
+  return ble_link.current;
+}
 
+/***************************************************************************//**
+ * @brief
+ * Returns the number of times the USART link was given up because the module did not answer on it.
+ ******************************************************************************/
+uint32_t ble_link_fallbacks(void){
+  return ble_link.fallbacks;
+}
 
+/***************************************************************************//**
+ * @brief
+ * Link switching task, run on BLE_LINK_CB.
+ *
+ * @details
+ * A switch drops a connected phone with AT, tells the module its new baud rate at the old
+ * one, resets it, moves the MCU side to the other transport and checks the module answers
+ * there. Every step checks the reply before going on, nothing is sent at the new rate unless
+ * the module took it.
+ *
+ * The module keeps its baud rate over resets, so once AT+BAUD has gone out the link cannot
+ * simply fall back: a lost OK+RESET or a failed check leaves the module at a rate the MCU
+ * may not be on. In that case the module is told to go back to 9600 if the MCU is on the
+ * USART, then AT is tried on each transport in turn and the link stays on the first the
+ * module answers on, the LEUART if none does. While the USART link is up the task wakes every idle_ms and falls back
+ * once the traffic no longer needs it. A fallback that fails doubles idle_ms up to
+ * BLE_LINK_IDLE_MAX_MS, so a module that keeps refusing does not cost a switch window
+ * every BLE_LINK_IDLE_MS. Frames written during a switch are dropped, see ble_write_frame().
+ ******************************************************************************/
+void ble_link_task(void){
+  TASK *task = &ble_link.task;
+
+  TASK_BEGIN(task);
+  ble_link.idle_ms = BLE_LINK_IDLE_MS;
+  while(true){
+      if(ble_link.wanted == ble_link.current){
+          if(ble_link.current == BLE_LINK_LEUART){
+              AWAIT_EVENT(task);
+              continue;
+          }
+          ble_link.window_bytes = 0;
+          AWAIT_TIMEOUT(task, ble_link.idle_ms);
+          // a request can wake the task early, only a full window counts
+          if(((int32_t)(sl_sleeptimer_get_tick_count() - task->wake_tick) >= 0) &&
+             (ble_link.wanted == BLE_LINK_USART) && (ble_link.window_bytes < BLE_LINK_IDLE_BYTES) &&
+             (ble_at_status() != BLE_AT_BUSY)){
+              ble_link.wanted = BLE_LINK_LEUART;
+          }
+          continue;
+      }
+
+      ble_link.switching = true;
+      ble_link.ok = ble_at_submit("AT", "OK", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, BLE_AT_SETTLE_MS, TASK_EVENT(task));
+      AWAIT_UNTIL(task, ble_at_status() != BLE_AT_BUSY);
+      ble_link.ok = ble_link.ok && (ble_at_status() == BLE_AT_OK);
+
+      if(ble_link.ok){
+          if(ble_link.wanted == BLE_LINK_USART){
+              ble_link.ok = ble_at_submit("AT+BAUD" HM10_USART_BAUD_CODE, "OK+Set:" HM10_USART_BAUD_CODE,
+                                          BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, TASK_EVENT(task));
+          }else{
+              ble_link.ok = ble_at_submit("AT+BAUD" HM10_BAUD_CODE, "OK+Set:" HM10_BAUD_CODE,
+                                          BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, TASK_EVENT(task));
+          }
+          ble_link.ok = ble_link.ok && ble_at_submit("AT+RESET", "OK+RESET", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES,
+                                                     BLE_AT_RESET_MS, TASK_EVENT(task));
+          AWAIT_UNTIL(task, ble_at_status() != BLE_AT_BUSY);
+          ble_link.ok = ble_link.ok && (ble_at_status() == BLE_AT_OK);
+
+          if(ble_link.ok) ble_link_use(ble_link.wanted);
+          ble_at_submit("AT", "OK", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, TASK_EVENT(task));
+          AWAIT_UNTIL(task, ble_at_status() != BLE_AT_BUSY);
+
+          if(ble_at_status() != BLE_AT_OK){
+              if(ble_link.current == BLE_LINK_USART){
+                  ble_at_submit("AT+BAUD" HM10_BAUD_CODE, "OK+Set:" HM10_BAUD_CODE,
+                                BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, TASK_EVENT(task));
+                  ble_at_submit("AT+RESET", "OK+RESET", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES,
+                                BLE_AT_RESET_MS, TASK_EVENT(task));
+                  AWAIT_UNTIL(task, ble_at_status() != BLE_AT_BUSY);
+              }
+              for(ble_link.probe = BLE_LINK_LEUART; ble_link.probe < BLE_LINK_COUNT; ble_link.probe++){
+                  ble_link_use(ble_link.probe);
+                  ble_at_submit("AT", "OK", BLE_AT_TIMEOUT_MS, BLE_AT_RETRIES, 0, TASK_EVENT(task));
+                  AWAIT_UNTIL(task, ble_at_status() != BLE_AT_BUSY);
+                  if(ble_at_status() == BLE_AT_OK) break;
+              }
+              if(ble_link.probe == BLE_LINK_COUNT) ble_link_use(BLE_LINK_LEUART);
+              if((ble_link.wanted == BLE_LINK_USART) && (ble_link.current == BLE_LINK_LEUART)) ble_link.fallbacks++;
+          }
+      }
+
+      if(ble_link.current == BLE_LINK_LEUART){
+          ble_link.idle_ms = BLE_LINK_IDLE_MS;
+      }else if(ble_link.wanted == BLE_LINK_LEUART){
+          ble_link.idle_ms *= 2;
+          if(ble_link.idle_ms > BLE_LINK_IDLE_MAX_MS) ble_link.idle_ms = BLE_LINK_IDLE_MAX_MS;
+      }
+      ble_link.wanted = ble_link.current;
+      ble_link.switching = false;
+  }
+  TASK_END(task);
+}
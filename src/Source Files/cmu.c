@@ -18,60 +18,342 @@
 //***********************************************************************************
 // Private variables
 //***********************************************************************************
+typedef struct {
+  const char          *name;
+  bool                is_osc;     // oscillator instead of a clock gate
+  CMU_Clock_TypeDef   clock;
+  CMU_Osc_TypeDef     osc;
+  uint8_t             parent;     // nodes that must run while this one runs
+  uint8_t             parent2;
+  bool                hf;         // blocks CMU_HF_EM_BLOCK while requested
+  bool                freq_lock;  // HFRCO band changes wait until released
+} CMU_NODE_DEF;
 
+static const CMU_NODE_DEF cmu_nodes[CMU_NODE_COUNT] = {
+  [CMU_NODE_HFPER]    = { "HFPER",    false, cmuClock_HFPER,    0,          CMU_NO_PARENT,    CMU_NO_PARENT,  true,  false },
+  [CMU_NODE_CORELE]   = { "CORELE",   false, cmuClock_CORELE,   0,          CMU_NO_PARENT,    CMU_NO_PARENT,  false, false },
+  [CMU_NODE_LFXO]     = { "LFXO",     true,  0,                 cmuOsc_LFXO, CMU_NO_PARENT,   CMU_NO_PARENT,  false, false },
+  [CMU_NODE_TIMER0]   = { "TIMER0",   false, cmuClock_TIMER0,   0,          CMU_NODE_HFPER,   CMU_NO_PARENT,  false, false },
+  [CMU_NODE_TIMER1]   = { "TIMER1",   false, cmuClock_TIMER1,   0,          CMU_NODE_HFPER,   CMU_NO_PARENT,  false, false },
+  [CMU_NODE_I2C0]     = { "I2C0",     false, cmuClock_I2C0,     0,          CMU_NODE_HFPER,   CMU_NO_PARENT,  false, true  },
+  [CMU_NODE_I2C1]     = { "I2C1",     false, cmuClock_I2C1,     0,          CMU_NODE_HFPER,   CMU_NO_PARENT,  false, true  },
+  [CMU_NODE_LDMA]     = { "LDMA",     false, cmuClock_LDMA,     0,          CMU_NO_PARENT,    CMU_NO_PARENT,  false, false },
+  [CMU_NODE_GPCRC]    = { "GPCRC",    false, cmuClock_GPCRC,    0,          CMU_NO_PARENT,    CMU_NO_PARENT,  false, false },
+  [CMU_NODE_USART0]   = { "USART0",   false, cmuClock_USART0,   0,          CMU_NODE_HFPER,   CMU_NO_PARENT,  false, true  },  // baud divider is set for the band at open
+  [CMU_NODE_LEUART0]  = { "LEUART0",  false, cmuClock_LEUART0,  0,          CMU_NODE_CORELE,  CMU_NODE_LFXO,  false, false },
+#if LEUART_COUNT > 1
+  [CMU_NODE_LEUART1]  = { "LEUART1",  false, cmuClock_LEUART1,  0,          CMU_NODE_CORELE,  CMU_NODE_LFXO,  false, false },
+#endif
+  [CMU_NODE_LETIMER0] = { "LETIMER0", false, cmuClock_LETIMER0, 0,          CMU_NODE_CORELE,  CMU_NO_PARENT,  false, false },  // ULFRCO is always on
+  [CMU_NODE_RTCC]     = { "RTCC",     false, cmuClock_RTCC,     0,          CMU_NODE_CORELE,  CMU_NODE_LFXO,  false, false }
+};
+
+static uint8_t cmu_refs[CMU_NODE_COUNT];
+static uint32_t cmu_on_since[CMU_NODE_COUNT];
+static uint64_t cmu_on_ticks[CMU_NODE_COUNT];
+
+static uint32_t cmu_boosts;
+static uint32_t cmu_freq_locks;
+static CMU_HFRCOFreq_TypeDef cmu_hfrco;
+static CMU_FREQ_FN cmu_freq_hooks[CMU_FREQ_HOOKS];
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
+static uint32_t cmu_node_find(CMU_Clock_TypeDef clock);
+static void cmu_node_request(uint32_t node);
+static void cmu_node_release(uint32_t node);
+static void cmu_freq_update(void);
+
+/***************************************************************************//**
+ * @brief
+ *Moves the HFRCO to the band wanted by the boost count.
+ *
+ * @details
+ *Nothing changes while a freq_lock clock is requested, the last release calls this again.
+ *The EM01 core voltage is raised before speeding up and lowered after slowing down, so the
+ *core never runs faster than its supply allows. CMU_HFRCOBandSet() adjusts the flash wait
+ *states. The EM2/EM3 voltage set by EMU_EM23Init() is restored to this EM01 level on
+ *wake-up. Registered hooks then recompute their dividers for the new frequency.
+ *Must be called inside a critical section.
+ ******************************************************************************/
+static void cmu_freq_update(void){
+  CMU_HFRCOFreq_TypeDef target = cmu_boosts ? CMU_HFRCO_HIGH : CMU_HFRCO_LOW;
+
+  if((target == cmu_hfrco) || cmu_freq_locks) return;
+
+  if(target > cmu_hfrco){
+#if defined(_EMU_CTRL_EM01VSCALE_MASK)
+      EMU_VScaleEM01(emuVScaleEM01_HighPerformance, true);
+#endif
+      CMU_HFRCOBandSet(target);
+  }else{
+      CMU_HFRCOBandSet(target);
+#if defined(_EMU_CTRL_EM01VSCALE_MASK)
+      EMU_VScaleEM01(emuVScaleEM01_LowPower, true);
+#endif
+  }
+  cmu_hfrco = target;
+
+  for(int i = 0; i < CMU_FREQ_HOOKS; i++){
+      if(cmu_freq_hooks[i]) cmu_freq_hooks[i]((uint32_t)target);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *Finds the managed node of a clock, asserts if the clock is not managed.
+ ******************************************************************************/
+static uint32_t cmu_node_find(CMU_Clock_TypeDef clock){
+  for(uint32_t i = 0; i < CMU_NODE_COUNT; i++){
+      if(!cmu_nodes[i].is_osc && (cmu_nodes[i].clock == clock)) return i;
+  }
+  EFM_ASSERT(false);
+  return CMU_NODE_COUNT;
+}
+
+/***************************************************************************//**
+ * @brief
+ *Adds a reference to a node, turning it and its parents on with the first one.
+ *
+ * @details
+ *Parents are requested before the node so an oscillator is stable before its branch is
+ *gated on. Must be called inside a critical section.
+ ******************************************************************************/
+static void cmu_node_request(uint32_t node){
+  const CMU_NODE_DEF *def = &cmu_nodes[node];
+
+  EFM_ASSERT(cmu_refs[node] < UINT8_MAX);
+  if(cmu_refs[node]++ > 0) return;
+
+  if(def->freq_lock) cmu_freq_locks++;
+  if(def->parent != CMU_NO_PARENT) cmu_node_request(def->parent);
+  if(def->parent2 != CMU_NO_PARENT) cmu_node_request(def->parent2);
+
+  if(def->is_osc){
+      CMU_OscillatorEnable(def->osc, true, true);
+  }else{
+      CMU_ClockEnable(def->clock, true);
+  }
+  if(def->hf) sleep_block_mode(SLEEP_CLIENT_CMU, CMU_HF_EM_BLOCK);
+  cmu_on_since[node] = sl_sleeptimer_get_tick_count();
+}
+
+/***************************************************************************//**
+ * @brief
+ *Drops a reference to a node, turning it and then its parents off with the last one.
+ *
+ * @details
+ *A release without a matching request is ignored and asserts. Must be called inside a
+ *critical section.
+ ******************************************************************************/
+static void cmu_node_release(uint32_t node){
+  const CMU_NODE_DEF *def = &cmu_nodes[node];
 
+  if(cmu_refs[node] == 0){
+      EFM_ASSERT(false);
+      return;
+  }
+  if(--cmu_refs[node] > 0) return;
+
+  cmu_on_ticks[node] += sl_sleeptimer_get_tick_count() - cmu_on_since[node];
+  if(def->hf) sleep_unblock_mode(SLEEP_CLIENT_CMU, CMU_HF_EM_BLOCK);
+  if(def->is_osc){
+      CMU_OscillatorEnable(def->osc, false, false);
+  }else{
+      CMU_ClockEnable(def->clock, false);
+  }
+
+  if(def->parent2 != CMU_NO_PARENT) cmu_node_release(def->parent2);
+  if(def->parent != CMU_NO_PARENT) cmu_node_release(def->parent);
+
+  if(def->freq_lock && (--cmu_freq_locks == 0)) cmu_freq_update();
+}
 
 //***********************************************************************************
 // Global functions
 //***********************************************************************************
 
+/***************************************************************************//**
+ * @brief
+ *Selects the LF branch sources, the first clock setup at boot.
+ *
+ * @details
+ *Disables the LFRCO, puts LFA on the ULFRCO and LFB and LFE on the LFXO. The sleeptimer runs
+ *on the RTCC, which is clocked from LFE, so this has to run before sl_sleeptimer_init() and
+ *that before anything reads the tick count, cmu_open() and sleep_open() included. CORELE is
+ *turned on for the sleeptimer's register access, cmu_open() then takes it over through the
+ *RTCC request.
+ ******************************************************************************/
+void cmu_lf_open(void){
+
+    // By default, LFRCO is enabled, disable the LFRCO oscillator
+    CMU_OscillatorEnable(cmuOsc_LFRCO  , false, false);
+
+    // No requirement to enable the ULFRCO oscillator.  It is always enabled in EM0-4H1
+    CMU_ClockSelectSet(cmuClock_LFA , cmuSelect_ULFRCO);
+
+    // LFXO keeps the RTCC counting in EM2 for the AT command timeouts.
+    CMU_OscillatorEnable(cmuOsc_LFXO, true, true);
+    CMU_ClockSelectSet(cmuClock_LFB , cmuSelect_LFXO);
+    CMU_ClockSelectSet(cmuClock_LFE , cmuSelect_LFXO);
+    CMU_ClockEnable(cmuClock_CORELE, true);
+}
+
 /***************************************************************************//**
  * @brief
  *Configure oscillators so that we are working with the minimal power requirements.
  *
  * @details
- *Enables LE clock while disabling non needed clocks to save power, such as the low freq oscillator and high freq periph clock (HFPER).
- *This file and function only deals with enabling and disabling clocks on the efm, as well as selecting and setting proper clock tree routing.
+ *Peripheral clocks, HFPER, CORELE and the LFXO are no longer turned on here, each driver
+ *requests what it needs with clock_request() and the clock manager keeps them on only while
+ *referenced. The RTCC is requested for the sleeptimer, which keeps CORELE and the LFXO
+ *running. The core drops to CMU_HFRCO_LOW here and only runs faster while a boost is held.
  * @note
- *Does not have any return, simply a setup function.
+ *cmu_lf_open() and sl_sleeptimer_init() must have run, the on-times start from the tick
+ *count read here.
  *
  ******************************************************************************/
 
 void cmu_open(void){
 
+    // Taken over from cmu_lf_open(), from now on the reference counts keep them running
+    clock_request(cmuClock_RTCC);
 
-    CMU_ClockEnable(cmuClock_HFPER, true);
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_CRITICAL();
+    cmu_hfrco = CMU_HFRCOBandGet();
+    cmu_freq_update();
+    CORE_EXIT_CRITICAL();
+}
 
+/***************************************************************************//**
+ * @brief
+ *Requests a peripheral clock, turning on its branch and oscillator when needed.
+ *
+ * @details
+ *Reference counted, every request must be matched by a clock_release(). Requesting a clock
+ *on the HFPER branch blocks EM2 through the CMU sleep client until it is released.
+ *
+ * @note
+ *Safe to call from interrupt context.
+ *
+ * @param[in] clock
+ *Peripheral clock, must be one of the clocks in the managed tree.
+ ******************************************************************************/
+void clock_request(CMU_Clock_TypeDef clock){
+  uint32_t node = cmu_node_find(clock);
+  CORE_DECLARE_IRQ_STATE;
 
-    // By default, LFRCO is enabled, disable the LFRCO oscillator
-    // Disable the LFRCO oscillator
-    // What is the enumeration required for LFRCO?
-    // It can be found in the online HAL documentation
-    CMU_OscillatorEnable(cmuOsc_LFRCO  , false, false);
+  if(node >= CMU_NODE_COUNT) return;
+  CORE_ENTER_CRITICAL();
+  cmu_node_request(node);
+  CORE_EXIT_CRITICAL();
+}
 
-    // Disable the LFXO oscillator
-    // What is the enumeration required for LFXO?
-    // It can be found in the online HAL documentation
-   CMU_OscillatorEnable(cmuOsc_LFXO  , true, true);
+/***************************************************************************//**
+ * @brief
+ *Releases a peripheral clock requested with clock_request().
+ *
+ * @note
+ *Safe to call from interrupt context.
+ *
+ * @param[in] clock
+ *Peripheral clock, must be one of the clocks in the managed tree.
+ ******************************************************************************/
+void clock_release(CMU_Clock_TypeDef clock){
+  uint32_t node = cmu_node_find(clock);
+  CORE_DECLARE_IRQ_STATE;
 
-    // No requirement to enable the ULFRCO oscillator.  It is always enabled in EM0-4H1
+  if(node >= CMU_NODE_COUNT) return;
+  CORE_ENTER_CRITICAL();
+  cmu_node_release(node);
+  CORE_EXIT_CRITICAL();
+}
 
-    // Route LF clock to the LF clock tree
-    // What is the enumeration required to placed the ULFRCO onto the proper clock branch?
-    // It can be found in the online HAL documentation
-   // CMU_ClockSelectSet(cmuClock_LFA , cmuSelect_ULFRCO);    // routing ULFRCO to proper Low Freq clock tree
-   CMU_ClockSelectSet(cmuClock_LFA , cmuSelect_ULFRCO);
+/***************************************************************************//**
+ * @brief
+ *Raises the HFRCO to CMU_HFRCO_HIGH for a heavy job, until clock_boost_release().
+ *
+ * @details
+ *Reference counted. If an I2C transaction is in progress the change waits for its end, the
+ *job then simply starts at the lower frequency.
+ ******************************************************************************/
+void clock_boost_request(void){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  cmu_boosts++;
+  cmu_freq_update();
+  CORE_EXIT_CRITICAL();
+}
 
-    // What is the proper enumeration to enable the clock tree onto the LE clock branches?
-    // It can be found in the Assignment 2 documentation
-    CMU_ClockEnable(cmuClock_CORELE, true); // CORELE is low energy clocks
+/***************************************************************************//**
+ * @brief
+ *Releases a boost, the HFRCO drops back to CMU_HFRCO_LOW with the last one.
+ ******************************************************************************/
+void clock_boost_release(void){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if(cmu_boosts == 0){
+      EFM_ASSERT(false);
+  }else{
+      cmu_boosts--;
+      cmu_freq_update();
+  }
+  CORE_EXIT_CRITICAL();
+}
 
-    CMU_ClockEnable(cmuClock_LEUART0 , true);
-    CMU_ClockSelectSet(cmuClock_LFB , cmuSelect_LFXO);
+/***************************************************************************//**
+ * @brief
+ *Registers a function to be called after every HFRCO band change.
+ *
+ * @details
+ *The function runs inside a critical section and must only update dividers or flag them
+ *for an update.
+ ******************************************************************************/
+void clock_freq_register(CMU_FREQ_FN fn){
+  for(int i = 0; i < CMU_FREQ_HOOKS; i++){
+      if((cmu_freq_hooks[i] == fn) || (cmu_freq_hooks[i] == NULL)){
+          cmu_freq_hooks[i] = fn;
+          return;
+      }
+  }
+  EFM_ASSERT(false);
+}
 
+/***************************************************************************//**
+ * @brief
+ *Returns a printable name for a clock node.
+ ******************************************************************************/
+const char *clock_name(CMU_NODE node){
+  EFM_ASSERT(node < CMU_NODE_COUNT);
+  return cmu_nodes[node].name;
 }
 
+/***************************************************************************//**
+ * @brief
+ *Returns the number of references currently held on a clock node.
+ ******************************************************************************/
+uint32_t clock_refs(CMU_NODE node){
+  EFM_ASSERT(node < CMU_NODE_COUNT);
+  return cmu_refs[node];
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns how long a clock node has been on, in sleeptimer ticks.
+ *
+ * @details
+ *Includes the current on period for a node that is running.
+ ******************************************************************************/
+uint64_t clock_on_ticks(CMU_NODE node){
+  uint64_t ticks;
+  CORE_DECLARE_IRQ_STATE;
+
+  EFM_ASSERT(node < CMU_NODE_COUNT);
+  CORE_ENTER_CRITICAL();
+  ticks = cmu_on_ticks[node];
+  if(cmu_refs[node]) ticks += sl_sleeptimer_get_tick_count() - cmu_on_since[node];
+  CORE_EXIT_CRITICAL();
+  return ticks;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file compress.c
+ * @brief Delta, zigzag and varint coding with zero run-length folding
+ *Responsible for shrinking slowly changing sample streams before they go over the 9600 baud BLE link.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "compress.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+/* Token layout: varint(v << 1) carries one zigzag coded delta v, varint((n << 1) | 1)
+ * carries n zero deltas. Only runs of two or more use the run form. */
+#define COMP_RUN_FLAG   1UL
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t comp_zigzag(int32_t value);
+static int32_t comp_unzigzag(uint32_t value);
+static void comp_put_varint(COMP_ENC *enc, uint32_t value);
+static bool comp_get_varint(COMP_DEC *dec, uint32_t *value);
+static void comp_flush_run(COMP_ENC *enc);
+
+/***************************************************************************//**
+ * @brief
+ * Maps signed deltas to unsigned so small magnitudes of either sign stay short.
+ ******************************************************************************/
+static uint32_t comp_zigzag(int32_t value){
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Inverse of comp_zigzag().
+ ******************************************************************************/
+static int32_t comp_unzigzag(uint32_t value){
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes 7 bits per byte, low bits first, bit 7 set on all but the last byte.
+ ******************************************************************************/
+static void comp_put_varint(COMP_ENC *enc, uint32_t value){
+  while(value >= 0x80){
+      enc->out[enc->len++] = (uint8_t)(value | 0x80);
+      value >>= 7;
+  }
+  enc->out[enc->len++] = (uint8_t)value;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Reads one varint, false if the input ends inside it.
+ ******************************************************************************/
+static bool comp_get_varint(COMP_DEC *dec, uint32_t *value){
+  uint32_t result = 0;
+
+  for(uint32_t shift = 0; (shift < 35) && (dec->pos < dec->len); shift += 7){
+      uint8_t byte = dec->in[dec->pos++];
+      result |= (uint32_t)(byte & 0x7F) << shift;
+      if(!(byte & 0x80)){
+          *value = result;
+          return true;
+      }
+  }
+  return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the pending zero tokens, as a run token when there are two or more.
+ ******************************************************************************/
+static void comp_flush_run(COMP_ENC *enc){
+  if(enc->run == 1){
+      comp_put_varint(enc, 0);
+  }else if(enc->run > 1){
+      comp_put_varint(enc, (enc->run << 1) | COMP_RUN_FLAG);
+  }
+  enc->run = 0;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Starts a new independent block of encoded values.
+ *
+ * @details
+ * Every channel starts from a previous value of 0, so a block decodes without any state
+ * from earlier blocks and a lost BLE packet only loses its own samples.
+ *
+ * @param[in] enc
+ * Encoder state
+ *
+ * @param[in] channels
+ * Values per record, 1 to COMP_MAX_CHANNELS
+ *
+ * @param[in] out
+ * Output buffer
+ *
+ * @param[in] cap
+ * Size of out, at least 2 * COMP_TOKEN_MAX
+ ******************************************************************************/
+void comp_enc_init(COMP_ENC *enc, uint8_t channels, uint8_t *out, uint32_t cap){
+  enc->out = out;
+  enc->cap = cap;
+  enc->len = 0;
+  enc->run = 0;
+  enc->channels = channels;
+  enc->next_ch = 0;
+  for(int i = 0; i < COMP_MAX_CHANNELS; i++){
+      enc->prev[i] = 0;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Checks that a whole record of values can still be added to the block.
+ ******************************************************************************/
+bool comp_enc_fits(const COMP_ENC *enc, uint32_t values){
+  return enc->len + ((values + 1) * COMP_TOKEN_MAX) <= enc->cap;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds the next value, which belongs to the next channel in round robin order.
+ *
+ * @details
+ * Refuses the value when a pending run plus the worst case token might not fit, so the
+ * block never overflows. The caller then finishes the block, sends it and starts a new one.
+ * Callers with more than one channel check comp_enc_fits() before each record so a record
+ * is never split across blocks.
+ *
+ * @return
+ * false if the value was not added because the block is full
+ ******************************************************************************/
+bool comp_enc_put(COMP_ENC *enc, int32_t value){
+  uint8_t ch = enc->next_ch;
+  uint32_t token = comp_zigzag(value - enc->prev[ch]);
+
+  if(!comp_enc_fits(enc, 1)) return false;
+
+  enc->prev[ch] = value;
+  enc->next_ch = (ch + 1 == enc->channels) ? 0 : ch + 1;
+
+  if(token == 0){
+      enc->run++;
+      return true;
+  }
+  comp_flush_run(enc);
+  comp_put_varint(enc, token << 1);
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes any pending run and returns the block length in bytes.
+ ******************************************************************************/
+uint32_t comp_enc_finish(COMP_ENC *enc){
+  comp_flush_run(enc);
+  return enc->len;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts decoding a block written by comp_enc_init()/comp_enc_finish().
+ ******************************************************************************/
+void comp_dec_init(COMP_DEC *dec, uint8_t channels, const uint8_t *in, uint32_t len){
+  dec->in = in;
+  dec->len = len;
+  dec->pos = 0;
+  dec->run = 0;
+  dec->channels = channels;
+  dec->next_ch = 0;
+  for(int i = 0; i < COMP_MAX_CHANNELS; i++){
+      dec->prev[i] = 0;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the next value of the block.
+ *
+ * @return
+ * false at the end of the block, on a truncated token or on a run token of fewer than two
+ * zeros, which the encoder never writes. The block is not read past a malformed token.
+ ******************************************************************************/
+bool comp_dec_get(COMP_DEC *dec, int32_t *value){
+  uint8_t ch = dec->next_ch;
+  uint32_t token = 0;
+
+  if(dec->run){
+      dec->run--;
+  }else{
+      if(!comp_get_varint(dec, &token)) return false;
+      if(token & COMP_RUN_FLAG){
+          if((token >> 1) < 2){
+              dec->pos = dec->len;
+              return false;
+          }
+          dec->run = (token >> 1) - 1;
+          token = 0;
+      }else{
+          token >>= 1;
+      }
+  }
+
+  // unsigned, a corrupt block can add deltas no encoder wrote and must only wrap
+  dec->prev[ch] = (int32_t)((uint32_t)dec->prev[ch] + (uint32_t)comp_unzigzag(token));
+  dec->next_ch = (ch + 1 == dec->channels) ? 0 : ch + 1;
+  *value = dec->prev[ch];
+  return true;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file crc.c
+ * @brief CRC-16 and CRC-32 for BLE frames and flash records
+ *Responsible for computing the checksums with the backend picked by CRC_BACKEND.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "crc.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#if CRC_BACKEND == CRC_BACKEND_SLICE4
+/* crc_tbl[0] is the usual byte table, crc_tbl[k][i] is the CRC of byte i followed by k
+ * zero bytes, so four table lookups retire a whole 32 bit word. */
+static uint16_t crc16_tbl[4][256];
+static uint32_t crc32_tbl[4][256];
+#elif CRC_BACKEND == CRC_BACKEND_NIBBLE
+static const uint16_t crc16_nibble[16] = {
+  0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+  0x8408, 0x9489, 0xA50A, 0xB58B, 0xC60C, 0xD68D, 0xE70E, 0xF78F
+};
+static const uint32_t crc32_nibble[16] = {
+  0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+  0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+};
+#endif
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+#if CRC_BACKEND == CRC_BACKEND_GPCRC
+static uint32_t crc_gpcrc(uint32_t poly, uint32_t crc, const uint8_t *data, uint32_t length);
+
+/***************************************************************************//**
+ * @brief
+ * Runs a buffer through the GPCRC.
+ *
+ * @details
+ * With bit reversal off the GPCRC shifts each input LSB first, which is the reflected
+ * form both CRCs use, so the DATA register holds the running CRC without any swapping.
+ * emlib programs the bit reversed 16 bit polynomial itself. The aligned middle of the
+ * buffer is fed a word at a time, the GPCRC takes it in byte address order.
+ * Not reentrant, only called from the main loop.
+ *
+ * @param[in] poly
+ * CRC16_POLY or CRC32_POLY
+ *
+ * @param[in] crc
+ * Running CRC before the final XOR
+ ******************************************************************************/
+static uint32_t crc_gpcrc(uint32_t poly, uint32_t crc, const uint8_t *data, uint32_t length){
+  GPCRC_Init_TypeDef gpcrc_init = GPCRC_INIT_DEFAULT;
+  uint32_t word;
+
+  gpcrc_init.crcPoly = poly;
+  gpcrc_init.initValue = crc;
+  gpcrc_init.autoInit = false;
+  gpcrc_init.enable = true;
+
+  clock_request(cmuClock_GPCRC);
+  GPCRC_Init(GPCRC, &gpcrc_init);
+  GPCRC_Start(GPCRC);
+
+  while(length && ((uintptr_t)data & 3)){
+      GPCRC_InputU8(GPCRC, *data++);
+      length--;
+  }
+  while(length >= 4){
+      memcpy(&word, data, sizeof(word));
+      GPCRC_InputU32(GPCRC, word);
+      data += 4;
+      length -= 4;
+  }
+  while(length--){
+      GPCRC_InputU8(GPCRC, *data++);
+  }
+
+  crc = GPCRC_DataRead(GPCRC);
+  clock_release(cmuClock_GPCRC);
+  return crc;
+}
+#endif
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Prepares the selected backend.
+ *
+ * @details
+ * The slice-by-4 tables are generated here instead of being stored, 6 kB of RAM against
+ * 6 kB of constant data and a table that can not go stale. The other backends need nothing.
+ *
+ * @note
+ * Must run before flog_open(), which checks the flash records.
+ ******************************************************************************/
+void crc_open(void){
+#if CRC_BACKEND == CRC_BACKEND_SLICE4
+  for(uint32_t i = 0; i < 256; i++){
+      uint16_t c16 = (uint16_t)i;
+      uint32_t c32 = i;
+      for(int bit = 0; bit < 8; bit++){
+          c16 = (c16 & 1) ? (uint16_t)((c16 >> 1) ^ CRC16_POLY_REV) : (uint16_t)(c16 >> 1);
+          c32 = (c32 & 1) ? ((c32 >> 1) ^ CRC32_POLY_REV) : (c32 >> 1);
+      }
+      crc16_tbl[0][i] = c16;
+      crc32_tbl[0][i] = c32;
+  }
+  for(uint32_t i = 0; i < 256; i++){
+      for(int k = 1; k < 4; k++){
+          crc16_tbl[k][i] = (uint16_t)((crc16_tbl[k - 1][i] >> 8) ^ crc16_tbl[0][crc16_tbl[k - 1][i] & 0xFF]);
+          crc32_tbl[k][i] = (crc32_tbl[k - 1][i] >> 8) ^ crc32_tbl[0][crc32_tbl[k - 1][i] & 0xFF];
+      }
+  }
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds bytes to a running CRC-16.
+ *
+ * @details
+ * Start from CRC16_INIT and XOR the result with CRC16_XOROUT once all bytes are in, or
+ * use crc16() for a single buffer.
+ *
+ * @param[in] crc
+ * Running CRC, CRC16_INIT for the first call
+ *
+ * @param[in] data
+ * Bytes to add
+ *
+ * @param[in] length
+ * Number of bytes
+ *
+ * @return
+ * Running CRC including data
+ ******************************************************************************/
+uint16_t crc16_update(uint16_t crc, const void *data, uint32_t length){
+  const uint8_t *bytes = data;
+
+#if CRC_BACKEND == CRC_BACKEND_SLICE4
+  uint32_t word;
+
+  while(length >= 4){
+      memcpy(&word, bytes, sizeof(word));    // little endian on both the EFR32 and a host
+      word ^= crc;
+      crc = crc16_tbl[3][word & 0xFF] ^ crc16_tbl[2][(word >> 8) & 0xFF] ^
+            crc16_tbl[1][(word >> 16) & 0xFF] ^ crc16_tbl[0][word >> 24];
+      bytes += 4;
+      length -= 4;
+  }
+  while(length--){
+      crc = (uint16_t)((crc >> 8) ^ crc16_tbl[0][(crc ^ *bytes++) & 0xFF]);
+  }
+#elif CRC_BACKEND == CRC_BACKEND_NIBBLE
+  while(length--){
+      crc = (uint16_t)((crc >> 4) ^ crc16_nibble[(crc ^ *bytes) & 0x0F]);
+      crc = (uint16_t)((crc >> 4) ^ crc16_nibble[(crc ^ (*bytes++ >> 4)) & 0x0F]);
+  }
+#else
+  crc = (uint16_t)crc_gpcrc(CRC16_POLY, crc, bytes, length);
+#endif
+  return crc;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds bytes to a running CRC-32.
+ *
+ * @details
+ * Start from CRC32_INIT and XOR the result with CRC32_XOROUT once all bytes are in, or
+ * use crc32() for a single buffer.
+ *
+ * @param[in] crc
+ * Running CRC, CRC32_INIT for the first call
+ *
+ * @param[in] data
+ * Bytes to add
+ *
+ * @param[in] length
+ * Number of bytes
+ *
+ * @return
+ * Running CRC including data
+ ******************************************************************************/
+uint32_t crc32_update(uint32_t crc, const void *data, uint32_t length){
+  const uint8_t *bytes = data;
+
+#if CRC_BACKEND == CRC_BACKEND_SLICE4
+  uint32_t word;
+
+  while(length >= 4){
+      memcpy(&word, bytes, sizeof(word));
+      word ^= crc;
+      crc = crc32_tbl[3][word & 0xFF] ^ crc32_tbl[2][(word >> 8) & 0xFF] ^
+            crc32_tbl[1][(word >> 16) & 0xFF] ^ crc32_tbl[0][word >> 24];
+      bytes += 4;
+      length -= 4;
+  }
+  while(length--){
+      crc = (crc >> 8) ^ crc32_tbl[0][(crc ^ *bytes++) & 0xFF];
+  }
+#elif CRC_BACKEND == CRC_BACKEND_NIBBLE
+  while(length--){
+      crc = (crc >> 4) ^ crc32_nibble[(crc ^ *bytes) & 0x0F];
+      crc = (crc >> 4) ^ crc32_nibble[(crc ^ (*bytes++ >> 4)) & 0x0F];
+  }
+#else
+  crc = crc_gpcrc(CRC32_POLY, crc, bytes, length);
+#endif
+  return crc;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the CRC-16/X-25 of a buffer.
+ ******************************************************************************/
+uint16_t crc16(const void *data, uint32_t length){
+  return crc16_update(CRC16_INIT, data, length) ^ CRC16_XOROUT;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the CRC-32 of a buffer.
+ ******************************************************************************/
+uint32_t crc32(const void *data, uint32_t length){
+  return crc32_update(CRC32_INIT, data, length) ^ CRC32_XOROUT;
+}
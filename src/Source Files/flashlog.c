@@ -0,0 +1,447 @@
+/**
+ * @file flashlog.c
+ * @brief Append-only sample log in flash
+ *Responsible for keeping samples across BLE disconnects and power cycles and replaying them on request.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <stddef.h>
+
+#include "flashlog.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FLOG_PAGE(n)      ((uint32_t *)(FLOG_BASE + ((n) * FLASH_PAGE_SIZE)))
+#define FLOG_HDR(n)       ((const FLOG_PAGE_HDR *)FLOG_PAGE(n))
+#define FLOG_REC(n, i)    ((const FLOG_RECORD *)(FLOG_BASE + ((n) * FLASH_PAGE_SIZE) + \
+                              sizeof(FLOG_PAGE_HDR) + ((i) * sizeof(FLOG_RECORD))))
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static uint32_t flog_head;          // page being written
+static uint32_t flog_head_seq;      // its page_seq
+static uint32_t flog_slot;          // next free record slot in the head page
+static uint16_t flog_seq;           // record sequence number
+static bool flog_usable;            // false when no page could be started
+static uint32_t flog_bad;           // pages that failed to erase or program since boot
+static uint32_t flog_sum;           // samples of the record being averaged
+static uint32_t flog_sum_n;
+
+static FLOG_RECORD flog_batch[FLOG_BATCH];
+static uint32_t flog_batch_len;
+
+static struct {
+  bool      active;
+  uint32_t  page;
+  uint32_t  page_seq;       // detects the page being recycled under the cursor
+  uint32_t  slot;
+  uint32_t  chunk_evt;
+  bool      compressed;
+} flog_replay;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static bool flog_page_valid(uint32_t page);
+static bool flog_record_valid(const FLOG_RECORD *rec);
+static bool flog_record_erased(const FLOG_RECORD *rec);
+static uint32_t flog_oldest_page(void);
+static uint16_t flog_next_seq(void);
+static bool flog_page_start(uint32_t page, uint32_t page_seq);
+static bool flog_page_advance(void);
+static const FLOG_RECORD *flog_replay_next(void);
+
+/***************************************************************************//**
+ * @brief
+ * Returns the next valid record after the replay cursor, NULL when the log is drained.
+ *
+ * @details
+ * If the writer recycled the page under the cursor, the replay continues at the oldest
+ * page still in flash. Torn records are skipped.
+ ******************************************************************************/
+static const FLOG_RECORD *flog_replay_next(void){
+  const FLOG_RECORD *rec;
+
+  if(!flog_page_valid(flog_replay.page) || (FLOG_HDR(flog_replay.page)->page_seq != flog_replay.page_seq)){
+      flog_replay.page = flog_oldest_page();
+      flog_replay.page_seq = FLOG_HDR(flog_replay.page)->page_seq;
+      flog_replay.slot = 0;
+  }
+
+  while(1){
+      if((flog_replay.page == flog_head) && (flog_replay.slot >= flog_slot)) return NULL;
+      if(flog_replay.slot >= FLOG_RECORDS_PER_PAGE){
+          flog_replay.page = (flog_replay.page + 1) % FLOG_PAGES;
+          flog_replay.page_seq = FLOG_HDR(flog_replay.page)->page_seq;
+          flog_replay.slot = flog_page_valid(flog_replay.page) ? 0 : FLOG_RECORDS_PER_PAGE;
+          continue;
+      }
+      rec = FLOG_REC(flog_replay.page, flog_replay.slot++);
+      if(flog_record_valid(rec)) return rec;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Checks a page header.
+ ******************************************************************************/
+static bool flog_page_valid(uint32_t page){
+  return FLOG_HDR(page)->magic == FLOG_MAGIC;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Checks that all three words of a record were written intact.
+ ******************************************************************************/
+static bool flog_record_valid(const FLOG_RECORD *rec){
+  return (rec->commit != FLOG_ERASED) && (rec->commit == crc32(rec, offsetof(FLOG_RECORD, commit)));
+}
+
+/***************************************************************************//**
+ * @brief
+ * Checks that a record slot was never written.
+ ******************************************************************************/
+static bool flog_record_erased(const FLOG_RECORD *rec){
+  return (rec->tick == FLOG_ERASED) && (rec->data == FLOG_ERASED) && (rec->commit == FLOG_ERASED);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Finds the valid page with the lowest page_seq, the head page if it is the only one.
+ ******************************************************************************/
+static uint32_t flog_oldest_page(void){
+  uint32_t oldest = flog_head;
+
+  for(uint32_t i = 1; i < FLOG_PAGES; i++){
+      uint32_t page = (flog_head + i) % FLOG_PAGES;
+      if(flog_page_valid(page)){
+          oldest = page;
+          break;
+      }
+  }
+  return oldest;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the sequence number after the newest valid record in flash, 0 for none.
+ *
+ * @details
+ * Walks the ring back from the head. The head page may hold no valid record yet, when the
+ * power failed right after it was started or its writes failed, so the number is taken
+ * from the newest page that has one and does not start over.
+ ******************************************************************************/
+static uint16_t flog_next_seq(void){
+  for(uint32_t i = 0; i < FLOG_PAGES; i++){
+      uint32_t page = (flog_head + FLOG_PAGES - i) % FLOG_PAGES;
+      if(!flog_page_valid(page)) continue;
+      for(uint32_t slot = FLOG_RECORDS_PER_PAGE; slot > 0; slot--){
+          const FLOG_RECORD *rec = FLOG_REC(page, slot - 1);
+          if(flog_record_valid(rec)) return (uint16_t)((rec->data >> 16) + 1);
+      }
+  }
+  return 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Erases a page and writes its header, dropping the oldest samples.
+ *
+ * @details
+ * Pages are used strictly in ring order, so every page sees the same number of erases.
+ * A power failure between the erase and the header leaves a free page, which the next
+ * flog_open() treats as unused. A page that fails to erase or take its header gets
+ * FLOG_BAD_MAGIC over the magic, clearing bits works on a page that did not erase, so
+ * whatever it still holds is not mistaken for records. The next flog_open() tries it again.
+ *
+ * @return
+ * false if the page is bad, the head is unchanged
+ ******************************************************************************/
+static bool flog_page_start(uint32_t page, uint32_t page_seq){
+  FLOG_PAGE_HDR hdr = { FLOG_MAGIC, page_seq };
+  uint32_t bad = FLOG_BAD_MAGIC;
+  MSC_Status_TypeDef status;
+
+  status = MSC_ErasePage(FLOG_PAGE(page));
+  if(status == mscReturnOk){
+      status = MSC_WriteWord(FLOG_PAGE(page), &hdr, sizeof(hdr));
+  }
+  if(status != mscReturnOk){
+      (void)MSC_WriteWord(FLOG_PAGE(page), &bad, sizeof(bad));
+      flog_bad++;
+      return false;
+  }
+  flog_head = page;
+  flog_head_seq = page_seq;
+  flog_slot = 0;
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts the next good page of the ring after the head.
+ *
+ * @details
+ * Bad pages are stepped over, the page_seq still goes up by one so replay order holds.
+ * The head page itself is tried last.
+ *
+ * @return
+ * false if every page failed, flog_append() stops logging
+ ******************************************************************************/
+static bool flog_page_advance(void){
+  for(uint32_t i = 1; i <= FLOG_PAGES; i++){
+      if(flog_page_start((flog_head + i) % FLOG_PAGES, flog_head_seq + 1)) return true;
+  }
+  flog_usable = false;
+  return false;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Finds the end of the log left by the previous run.
+ *
+ * @details
+ * The head is the valid page with the highest page_seq. Its first erased slot is where
+ * writing continues, a torn record before it is skipped. An empty log starts at page 0.
+ * The replay cursor starts at the oldest record, so the first replay sends everything.
+ ******************************************************************************/
+void flog_open(void){
+  bool found = false;
+
+  MSC_Init();
+
+  for(uint32_t page = 0; page < FLOG_PAGES; page++){
+      if(flog_page_valid(page) && (!found || (int32_t)(FLOG_HDR(page)->page_seq - flog_head_seq) > 0)){
+          flog_head = page;
+          flog_head_seq = FLOG_HDR(page)->page_seq;
+          found = true;
+      }
+  }
+
+  flog_usable = true;
+  if(!found){
+      flog_head = FLOG_PAGES - 1;
+      flog_head_seq = UINT32_MAX;
+      clock_boost_request();
+      flog_page_advance();
+      clock_boost_release();
+  }else{
+      for(flog_slot = 0; flog_slot < FLOG_RECORDS_PER_PAGE; flog_slot++){
+          if(flog_record_erased(FLOG_REC(flog_head, flog_slot))) break;
+      }
+      flog_seq = flog_next_seq();
+  }
+
+  flog_batch_len = 0;
+  flog_sum = 0;
+  flog_sum_n = 0;
+  flog_replay.active = false;
+  flog_replay.page = flog_oldest_page();
+  flog_replay.page_seq = FLOG_HDR(flog_replay.page)->page_seq;
+  flog_replay.slot = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds a sample to the log.
+ *
+ * @details
+ * Every FLOG_DECIMATE samples make one record holding their mean, stamped with the time
+ * of the last. Records are collected in RAM and written FLOG_BATCH at a time, so the
+ * flash controller is set up once per batch instead of once per sample. Up to
+ * FLOG_BATCH * FLOG_DECIMATE - 1 samples are lost on a power failure.
+ *
+ * @param[in] sample
+ * Sample to log
+ ******************************************************************************/
+void flog_append(uint16_t sample){
+  FLOG_RECORD *rec;
+
+  if(!flog_usable) return;
+  flog_sum += sample;
+  if(++flog_sum_n < FLOG_DECIMATE) return;
+
+  rec = &flog_batch[flog_batch_len++];
+  rec->tick = sl_sleeptimer_get_tick_count();
+  rec->data = ((uint32_t)flog_seq++ << 16) | (uint16_t)(flog_sum / flog_sum_n);
+  rec->commit = crc32(rec, offsetof(FLOG_RECORD, commit));
+  flog_sum = 0;
+  flog_sum_n = 0;
+
+  if(flog_batch_len == FLOG_BATCH) flog_flush();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes the RAM batch to flash.
+ *
+ * @details
+ * Moves to the next page of the ring when the head page is full. The write is split at the
+ * page end. Flash programming stalls code fetches from flash, so interrupts are delayed
+ * for the duration, about 20 ms for a page erase. A BLE frame stalled that long reaches
+ * the phone in two pieces, so a page is only erased once the link has sent its frame,
+ * without the boost. The core is boosted while programming so the EM01 supply is at its
+ * high performance level.
+ *
+ * A failed write keeps the records it completed and leaves the slot it failed in torn,
+ * replay skips that by its commit word. The rest of that page is given up and the
+ * remaining records go to the next page. The batch
+ * is dropped if no page can be started or FLOG_PAGES writes in a row fail.
+ ******************************************************************************/
+void flog_flush(void){
+  uint32_t done = 0, failed = 0, n;
+
+  if(flog_batch_len == 0) return;
+
+  clock_boost_request();
+  while(flog_usable && (done < flog_batch_len)){
+      if(flog_slot >= FLOG_RECORDS_PER_PAGE){
+          clock_boost_release();
+          while(ble_tx_busy());     // the erase would stall the frame in flight
+          clock_boost_request();
+          if(!flog_page_advance()) break;
+      }
+      n = flog_batch_len - done;
+      if(n > FLOG_RECORDS_PER_PAGE - flog_slot) n = FLOG_RECORDS_PER_PAGE - flog_slot;
+
+      if(MSC_WriteWord((uint32_t *)FLOG_REC(flog_head, flog_slot), &flog_batch[done],
+                       n * sizeof(FLOG_RECORD)) != mscReturnOk){
+          while((n > 0) && flog_record_valid(FLOG_REC(flog_head, flog_slot))){
+              flog_slot++;      // written before the failed word, not written twice
+              done++;
+              n--;
+          }
+          flog_bad++;
+          if(++failed == FLOG_PAGES) break;
+          flog_slot = FLOG_RECORDS_PER_PAGE;
+          continue;
+      }
+      flog_slot += n;
+      done += n;
+  }
+  clock_boost_release();
+  flog_batch_len = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the number of records waiting for replay, including the RAM batch.
+ ******************************************************************************/
+uint32_t flog_count(void){
+  uint32_t count = flog_batch_len;
+  uint32_t page = flog_replay.page;
+  uint32_t slot = flog_replay.slot;
+
+  if(!flog_page_valid(page) || (FLOG_HDR(page)->page_seq != flog_replay.page_seq)){
+      page = flog_oldest_page();
+      slot = 0;
+  }
+  while(page != flog_head){
+      if(flog_page_valid(page)) count += FLOG_RECORDS_PER_PAGE - slot;
+      page = (page + 1) % FLOG_PAGES;
+      slot = 0;
+  }
+  return count + flog_slot - slot;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the number of failed page erases and record writes since boot.
+ ******************************************************************************/
+uint32_t flog_bad_pages(void){
+  return flog_bad;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts streaming the records logged since the last replay over BLE.
+ *
+ * @details
+ * Each line carries up to FLOG_LINE_RECORDS records as "seq,ms,sample;". The next line is
+ * sent from chunk_evt, scheduled when the previous one has left the LEUART, so the link
+ * stays busy without the CPU spinning on it. The last line is "R end n:<count>".
+ * In compressed mode each chunk is instead a binary frame 'Y', record count, payload
+ * length, then the records as a 3 channel (seq, ms, sample) compress.c block.
+ *
+ * @param[in] chunk_evt
+ * Event the application routes to flog_replay_cb()
+ *
+ * @param[in] compressed
+ * true to send compressed binary frames instead of text lines
+ *
+ * @return
+ * false if a replay is already running
+ ******************************************************************************/
+bool flog_replay_start(uint32_t chunk_evt, bool compressed){
+  if(flog_replay.active) return false;
+
+  flog_flush();
+  flog_replay.active = true;
+  flog_replay.chunk_evt = chunk_evt;
+  flog_replay.compressed = compressed;
+  add_scheduled_event(chunk_evt);
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends the next replay line or frame, called by the application from the chunk event.
+ ******************************************************************************/
+void flog_replay_cb(void){
+  static uint32_t sent;
+  static uint8_t frame[FLOG_FRAME_MAX];
+  char *line = (char *)frame;
+  int length = 0;
+  uint32_t records = 0;
+  uint32_t freq = sl_sleeptimer_get_timer_frequency();
+  const FLOG_RECORD *rec;
+  COMP_ENC enc;
+
+  if(!flog_replay.active) return;
+
+  if(flog_replay.compressed){
+      comp_enc_init(&enc, 3, &frame[FLOG_FRAME_HDR], FLOG_FRAME_MAX - FLOG_FRAME_HDR);
+      while((records < UINT8_MAX) && comp_enc_fits(&enc, 3) && ((rec = flog_replay_next()) != NULL)){
+          comp_enc_put(&enc, (int32_t)(rec->data >> 16));
+          comp_enc_put(&enc, (int32_t)(((uint64_t)rec->tick * 1000) / freq));
+          comp_enc_put(&enc, (int32_t)(rec->data & 0xFFFF));
+          records++;
+      }
+  }else{
+      while((records < FLOG_LINE_RECORDS) && ((rec = flog_replay_next()) != NULL)){
+          length += snprintf(&line[length], FLOG_FRAME_MAX - length, "%u,%lu,%u;",
+                             (unsigned)(rec->data >> 16),
+                             (unsigned long)(((uint64_t)rec->tick * 1000) / freq),
+                             (unsigned)(rec->data & 0xFFFF));
+          records++;
+      }
+  }
+
+  if(records == 0){
+      snprintf(line, FLOG_FRAME_MAX, "R end n:%lu\n", (unsigned long)sent);
+      sent = 0;
+      flog_replay.active = false;
+      ble_write(line);
+      return;
+  }
+  sent += records;
+  if(flog_replay.compressed){
+      frame[0] = 'Y';
+      frame[1] = (uint8_t)records;
+      frame[2] = (uint8_t)comp_enc_finish(&enc);
+      ble_write_bytes(frame, FLOG_FRAME_HDR + frame[2], flog_replay.chunk_evt);
+  }else{
+      line[length++] = '\n';
+      line[length] = 0;
+      ble_write_cb(line, flog_replay.chunk_evt);
+  }
+}
@@ -14,16 +14,265 @@
 //***********************************************************************************
 // Private Variables
 //***********************************************************************************
-static I2C_STATE_MACHINE i2c0_statemachine_vars, i2c1_statemachine_vars;
+static I2C_STATE_MACHINE i2c_engines[I2C_COUNT]; //one transaction engine per bus
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
 
-static void i2c_bus_reset(I2C_TypeDef *i2c);
+static bool i2c_bus_reset(I2C_STATE_MACHINE *i2c_sm);
+static void i2c_bus_recover(I2C_STATE_MACHINE *i2c_sm);
+static I2C_STATE_MACHINE *i2c_engine_get(I2C_TypeDef *i2c);
+static void i2c_run(I2C_STATE_MACHINE *i2c_sm, const I2C_XFER *xfer);
+static void i2c_begin(I2C_STATE_MACHINE *i2c_sm);
+static void i2c_finish(I2C_STATE_MACHINE *i2c_sm, I2C_STATUS status);
+static void i2c_fail(I2C_STATE_MACHINE *i2c_sm, I2C_STATUS status);
+static bool i2c_error_irq(I2C_STATE_MACHINE *i2c_sm, uint32_t int_flag);
+static void i2c_backoff_expired(sl_sleeptimer_timer_handle_t *handle, void *data);
+static void i2c_nack_sm(I2C_STATE_MACHINE *i2c_ackSM);
 static void i2c_ack_sm(I2C_STATE_MACHINE *i2c_ackSM);
 static void i2c_receive_sm(I2C_STATE_MACHINE *i2c_ackSM);
 static void i2c_msstop_sm(I2C_STATE_MACHINE *i2c_ackSM);
+static uint32_t i2c_engine_deadline_us(const I2C_STATE_MACHINE *i2c_sm);
+static uint32_t i2c0_next_deadline_us(void);
+static uint32_t i2c1_next_deadline_us(void);
+static void i2c_freq_changed(uint32_t hf_hz);
+
+/***************************************************************************//**
+ * @brief
+ * Maps an I2C peripheral to its transaction engine, asserts for anything else.
+ ******************************************************************************/
+static I2C_STATE_MACHINE *i2c_engine_get(I2C_TypeDef *i2c){
+  if(i2c == I2C1){
+      return &i2c_engines[1];
+  }
+  EFM_ASSERT(i2c == I2C0);
+  return &i2c_engines[0];
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts a transfer on an idle engine.
+ *
+ * @details
+ * Takes the bus clock and the engine's own sleep block for the length of the transfer, so
+ * the two buses never wait on each other. Called from i2c_start() and, for a queued
+ * transfer, from the interrupt that finished the one before. Must be called inside a
+ * critical section.
+ ******************************************************************************/
+static void i2c_run(I2C_STATE_MACHINE *i2c_sm, const I2C_XFER *xfer){
+  I2C_TypeDef *i2c = i2c_sm->i2cx;
+
+  clock_request(i2c_sm->clock);
+  if(i2c_sm->freq_stale){
+      I2C_BusFreqSet(i2c, 0, i2c_sm->bus_freq, i2c_sm->clhr);
+      i2c_sm->freq_stale = false;
+  }
+  if((i2c->STATE & _I2C_STATE_STATE_MASK) != I2C_STATE_STATE_IDLE){
+      i2c_bus_reset(i2c_sm); //left busy by a slave, a failed recovery shows up as an error on this transfer
+  }
+
+  sleep_block_mode(i2c_sm->sleep_client, I2C_EM_BLOCK); //block unwanted sleep mode ( > EM2)
+
+  i2c_sm->busy = true;
+  i2c_sm->dev = xfer->dev;
+  i2c_sm->rwrite = xfer->mode;
+  i2c_sm->i2c_callback = xfer->callback;
+  i2c_sm->data = xfer->data;
+  i2c_sm->bytes_total = xfer->bytes_per_transfer;
+  i2c_sm->attempts = 0;
+
+  i2c_sm->register_address = xfer->reg_address;
+  i2c_sm->peripheral_address = xfer->dev->address;
+  i2c_begin(i2c_sm);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends the START and slave address of the transfer set up by i2c_start().
+ *
+ * @details
+ * Also used to restart a transfer after a NACK or bus error, so the byte count is taken
+ * from bytes_total and a read builds its result from scratch. A READ_NOREG_OP read skips
+ * the register address and goes straight to the read header.
+ ******************************************************************************/
+static void i2c_begin(I2C_STATE_MACHINE *i2c_sm){
+  i2c_sm->bytes_per_transfer = i2c_sm->bytes_total;
+  i2c_sm->i2cx->CMD = I2C_CMD_START;
+  if(i2c_sm->rwrite == READ_NOREG_OP){
+      i2c_sm->current_state = init_read;
+      i2c_sm->i2cx->TXDATA = (i2c_sm->peripheral_address << 1) | READ_OP;
+  }else{
+      i2c_sm->current_state = init_write;
+      i2c_sm->i2cx->TXDATA = (i2c_sm->peripheral_address << 1) | WRITE_OP;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Ends a transfer and schedules its callback.
+ *
+ * @details
+ * The callback reads the result with i2c_dev_status(). Releases the sleep block and the clock
+ * taken by i2c_run() whether the transfer succeeded or not, then starts the next queued transfer.
+ *
+ * @param[in] status
+ * Result of the transfer
+ ******************************************************************************/
+static void i2c_finish(I2C_STATE_MACHINE *i2c_sm, I2C_STATUS status){
+  sleep_unblock_mode(i2c_sm->sleep_client, I2C_EM_BLOCK);
+  clock_release(i2c_sm->clock);
+  i2c_sm->dev->status = status;
+  i2c_sm->busy = false;
+  TRACE_I2C(i2c_sm - i2c_engines, 0x100 + status);
+  if(status != I2C_STATUS_OK){
+      LOG_WARN("I2C%u 0x%02lx failed, status %u", (unsigned)(i2c_sm - i2c_engines), i2c_sm->dev->address, status);
+  }
+
+  i2c_sm->current_state = init_write;
+  add_scheduled_event(i2c_sm->i2c_callback);
+
+  if(i2c_sm->queued){
+      I2C_XFER *next = &i2c_sm->queue[i2c_sm->queue_head];
+      i2c_sm->queue_head = (i2c_sm->queue_head + 1) % I2C_QUEUE_LEN;
+      i2c_sm->queued--;
+      i2c_run(i2c_sm, next);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Handles a bus error, lost arbitration, clock low timeout or an interrupt the state machines
+ * did not expect.
+ *
+ * @details
+ * The transfer is aborted and the bus reset, clocking out a slave that holds SDA low if need
+ * be. The transfer then restarts until I2C_RETRIES is used up. An error while no transfer is
+ * in progress only resets the bus.
+ *
+ * @param[in] status
+ * What went wrong, reported if the transfer finally fails
+ ******************************************************************************/
+static void i2c_fail(I2C_STATE_MACHINE *i2c_sm, I2C_STATUS status){
+  bool bus_free;
+
+  i2c_sm->i2cx->CMD = I2C_CMD_ABORT;
+  bus_free = i2c_bus_reset(i2c_sm);
+  if(!i2c_sm->busy) return;
+
+  if(!bus_free){
+      i2c_finish(i2c_sm, I2C_STATUS_STUCK);
+  }else if(i2c_sm->attempts < I2C_RETRIES){
+      i2c_sm->attempts++;
+      i2c_begin(i2c_sm);
+  }else{
+      i2c_finish(i2c_sm, status);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Handles the error flags of an I2C interrupt.
+ *
+ * @return
+ * true if an error was handled, the other flags are then stale
+ ******************************************************************************/
+static bool i2c_error_irq(I2C_STATE_MACHINE *i2c_sm, uint32_t int_flag){
+  if(int_flag & I2C_IF_CLTO){
+      i2c_fail(i2c_sm, I2C_STATUS_TIMEOUT);
+  }else if(int_flag & I2C_IF_ARBLOST){
+      i2c_fail(i2c_sm, I2C_STATUS_ARBLOST);
+  }else if(int_flag & I2C_IF_BUSERR){
+      i2c_fail(i2c_sm, I2C_STATUS_BUSERR);
+  }else{
+      return false;
+  }
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sleeptimer callback that restarts a transfer after its NACK backoff, runs in the RTCC
+ * interrupt.
+ ******************************************************************************/
+static void i2c_backoff_expired(sl_sleeptimer_timer_handle_t *handle, void *data){
+  I2C_STATE_MACHINE *i2c_sm = (I2C_STATE_MACHINE *)data;
+  (void)handle;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if(i2c_sm->busy && (i2c_sm->current_state == stop_retry)){
+      i2c_begin(i2c_sm);
+      TRACE_I2C(i2c_sm - i2c_engines, i2c_sm->current_state);
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * NACK interrupt state machine.
+ *
+ * @details
+ * The Si1133 NACKs its address while it is busy. A STOP is sent so the slave sees the bus
+ * free again, the MSTOP that follows arms the backoff timer that restarts the transfer. A
+ * NACK after the last byte of a write, when the STOP is already on its way, is ignored.
+ ******************************************************************************/
+static void i2c_nack_sm(I2C_STATE_MACHINE *i2c_ackSM){
+  switch (i2c_ackSM->current_state){
+    case init_write:
+    case write_data:
+    case init_read:
+    case read_data:
+      i2c_ackSM->i2cx->CMD = I2C_CMD_STOP;
+      i2c_ackSM->current_state = stop_retry;
+      break;
+
+    default:
+      break;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Marks the bus dividers stale after an HFRCO band change.
+ *
+ * @details
+ * The clock manager never changes the band during a transaction, so the new divider is
+ * set by the next i2c_run() while the I2C clock is requested.
+ ******************************************************************************/
+static void i2c_freq_changed(uint32_t hf_hz){
+  (void)hf_hz;
+  for(int i = 0; i < I2C_COUNT; i++){
+      i2c_engines[i].freq_stale = true;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Reports the time until a bus's next I2C interrupt to the sleep manager.
+ *
+ * @details
+ * While a transaction is in progress the next ACK, RXDATAV or MSTOP interrupt arrives within
+ * one byte time. Each bus is its own sleep client, so a long transfer on one does not make
+ * the other look busy.
+ *
+ * @return
+ * Time in us until the next interrupt, SLEEP_DEADLINE_NONE when the bus is idle.
+ ******************************************************************************/
+static uint32_t i2c_engine_deadline_us(const I2C_STATE_MACHINE *i2c_sm){
+  if(i2c_sm->busy){
+      return i2c_sm->byte_us;
+  }
+  return SLEEP_DEADLINE_NONE;
+}
+
+static uint32_t i2c0_next_deadline_us(void){
+  return i2c_engine_deadline_us(&i2c_engines[0]);
+}
+
+static uint32_t i2c1_next_deadline_us(void){
+  return i2c_engine_deadline_us(&i2c_engines[1]);
+}
 
 /***************************************************************************//**
  * @brief
@@ -37,7 +286,7 @@ static void i2c_msstop_sm(I2C_STATE_MACHINE *i2c_ackSM);
  * It will continually go through cases after the previous is completed.
  *
  * @note
- *This function should only do one of two things, other cases should not necessarily occur and as such, the default case has an EFM_ASSERT(false)
+ *This function should only do one of two things, other cases should not necessarily occur and as such, the default case is handled as a bus error
  *
  *@param[in] i2c_ackSM
  *Input state machine structure whose variables are to be checked.
@@ -64,6 +313,11 @@ static void i2c_ack_sm(I2C_STATE_MACHINE *i2c_ackSM){
       break;
 
     case read_data:
+      if(i2c_ackSM->bytes_per_transfer == 0) { //command only write, the register address was all
+          i2c_ackSM->i2cx->CMD = I2C_CMD_STOP;
+          i2c_ackSM->current_state = rec_data;
+          break;
+      }
       i2c_ackSM->bytes_per_transfer--;
       i2c_ackSM->i2cx->TXDATA = (*(i2c_ackSM->data) >> (8*i2c_ackSM->bytes_per_transfer)) & 0xFF;
       if(i2c_ackSM->bytes_per_transfer == 0) {
@@ -75,11 +329,14 @@ static void i2c_ack_sm(I2C_STATE_MACHINE *i2c_ackSM){
      case rec_data:
        break;
 
+    case stop_retry:
+      break;
+
     case end_process:
       break;
 
     default:
-      EFM_ASSERT(false);
+      i2c_fail(i2c_ackSM, I2C_STATUS_BUSERR);
       break;
   }
 }
@@ -127,10 +384,12 @@ static void i2c_receive_sm(I2C_STATE_MACHINE *i2c_ackSM){
 
       case rec_data:
 
+      case stop_retry:
+
       case end_process:
 
       default:
-        EFM_ASSERT(false);
+        i2c_fail(i2c_ackSM, I2C_STATUS_BUSERR);
         break;
     }
 
@@ -148,7 +407,9 @@ static void i2c_receive_sm(I2C_STATE_MACHINE *i2c_ackSM){
  *
  *
  * @note
- *Current state must be in receive_data, as an MSTOP condition cannot occur outside of this (or at least should not)
+ *Current state must be in receive_data, or stop_retry after a NACK. A STOP in the middle of a transfer is handled as a bus error.
+ *After a NACK the restart waits I2C_NACK_BACKOFF_MS, doubled for every attempt. The bus
+ *clock and the sleep block stay held meanwhile, the transfer is still in progress.
  *
  *@param[in] i2c_ackSM
  *Input state machine structure whose variables are to be checked.
@@ -156,31 +417,34 @@ static void i2c_receive_sm(I2C_STATE_MACHINE *i2c_ackSM){
 static void i2c_msstop_sm(I2C_STATE_MACHINE *i2c_ackSM){
   switch (i2c_ackSM->current_state){
         case init_write:
-          EFM_ASSERT(false);
-          break;
 
         case write_data:
-          EFM_ASSERT(false);
-          break;
 
         case init_read:
-          EFM_ASSERT(false);
+          i2c_fail(i2c_ackSM, I2C_STATUS_BUSERR);
           break;
 
         case read_data:
 
         case rec_data:
-              sleep_unblock_mode(I2C_EM_BLOCK);
-              i2c_ackSM->busy = true;
+          i2c_finish(i2c_ackSM, I2C_STATUS_OK);
+          break;
 
-              i2c_ackSM->current_state = init_write;
-              add_scheduled_event(i2c_ackSM->i2c_callback);
+        case stop_retry:
+          if(i2c_ackSM->attempts < I2C_RETRIES){
+              // a busy slave needs time, restarting at once would only collect more NACKs
+              sl_sleeptimer_start_timer_ms(&i2c_ackSM->backoff, I2C_NACK_BACKOFF_MS << i2c_ackSM->attempts,
+                                           i2c_backoff_expired, i2c_ackSM, 0, 0);
+              i2c_ackSM->attempts++;
+          }else{
+              i2c_finish(i2c_ackSM, I2C_STATUS_NACK);
+          }
           break;
 
         case end_process:
 
         default:
-          EFM_ASSERT(false);
+          if(i2c_ackSM->busy) i2c_fail(i2c_ackSM, I2C_STATUS_BUSERR);
           break;
       }
 }
@@ -206,14 +470,26 @@ static void i2c_msstop_sm(I2C_STATE_MACHINE *i2c_ackSM){
  ******************************************************************************/
 void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup){
 
-  if(address == I2C0){//set up clocks
-      CMU_ClockEnable(cmuClock_I2C0, true);
-      i2c0_statemachine_vars.busy = true;
-  }
-  if(address == I2C1){//set up clocks
-      CMU_ClockEnable(cmuClock_I2C1, true);
-      i2c1_statemachine_vars.busy = true;
-    }
+  I2C_STATE_MACHINE *i2c_local = i2c_engine_get(address);
+
+  i2c_local->clock = (address == I2C0) ? cmuClock_I2C0 : cmuClock_I2C1;
+  i2c_local->sleep_client = (address == I2C0) ? SLEEP_CLIENT_I2C0 : SLEEP_CLIENT_I2C1;
+  clock_request(i2c_local->clock); //set up clocks
+  i2c_local->busy = false;
+  i2c_local->queued = 0;
+  i2c_local->queue_head = 0;
+  i2c_local->i2cx = address;
+  i2c_local->scl_port = i2c_setup->scl_port;
+  i2c_local->scl_pin = i2c_setup->scl_pin;
+  i2c_local->sda_port = i2c_setup->sda_port;
+  i2c_local->sda_pin = i2c_setup->sda_pin;
+  i2c_local->recoveries = 0;
+  i2c_local->bus_freq = i2c_setup->freq;
+  i2c_local->clhr = i2c_setup->clhr;
+  i2c_local->freq_stale = false;
+  clock_freq_register(i2c_freq_changed);
+  i2c_local->byte_us = (9 * 1000000) / i2c_setup->freq; //8 data bits + ACK
+  sleep_deadline_register(i2c_local->sleep_client, (address == I2C0) ? i2c0_next_deadline_us : i2c1_next_deadline_us);
 
 
   if ((address->IF & 0x01) == 0) {//verify clock is working
@@ -234,6 +510,7 @@ void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup){
   i2c_local_vals.enable = i2c_setup->enable;
 
   I2C_Init(address, &i2c_local_vals);
+  address->CTRL |= I2C_CTRL_CLTO_1024PCC; //a slave holding SCL low ends the transfer with CLTO
 
 
   address->ROUTELOC0 = i2c_setup->scl_Location | i2c_setup->sda_Location;
@@ -243,6 +520,7 @@ void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup){
   address->IEN |= (I2C_IEN_ACK * i2c_setup->irq_ack_en);
   address->IEN |= (I2C_IEN_RXDATAV * i2c_setup->rxdata_irq_en);
   address->IEN |= (I2C_IEN_MSTOP * i2c_setup->irq_stop_en);
+  address->IEN |= I2C_ERR_IRQS;
 
   if(address == I2C0){
       NVIC_EnableIRQ(I2C0_IRQn);
@@ -252,8 +530,10 @@ void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup){
     }
 
 
-  i2c_bus_reset(address);
+  i2c_bus_reset(i2c_local);
 
+  // the clock is requested again for each transaction by i2c_run()
+  clock_release(i2c_local->clock);
 }
 
 /***************************************************************************//**
@@ -261,19 +541,22 @@ void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup){
  * Performs either a read or a write operation through i2c.
  *
  * @details
- * Depending on input arguments, will configure I2C0 or I2C1 interrupts and peripheral.
+ * Runs the transfer on the engine of the device's bus right away if that bus is idle,
+ * otherwise queues it behind the transfers already waiting there. Never waits for the bus,
+ * so transfers on I2C0 and I2C1 run in parallel. When I2C_QUEUE_LEN transfers are already
+ * waiting the transfer is not started, its callback is scheduled with I2C_STATUS_FULL so
+ * the caller can try again, nothing waiting is overwritten.
  *
  * @note
  * Reads or writes to a peripheral based on inputs.
  *
- * @param[in] i2c
- * Pointer to i2c peripheral that is being interacted with
- *
- * @param[in] dev_address
- * Address of the peripheral being communicated with master device.
+ * @param[in] dev
+ * Device handle, the bus and address of the peripheral. Its status holds the result of its
+ * last transfer.
  *
  * @param[in] mode
- * Write or Read mode, determines actions of i2c_start
+ * Write or Read mode, determines actions of i2c_start. READ_NOREG_OP reads without
+ * writing reg_address first, a write of 0 bytes sends reg_address alone as a command.
  *
  * @param[in] data
  * Pointer to data which will either be data read from, or data sent to peripheral.
@@ -285,55 +568,93 @@ void i2c_open(I2C_TypeDef *address, I2C_OPEN_STRUCT *i2c_setup){
  * Address of peripheral whose data will be read from, or written to that register.
  *
  * @param[in] callback
- *Callback to perform upon completing data transfer.
+ *Callback to perform upon completing data transfer, also scheduled when the transfer failed.
+ *i2c_dev_status() tells which.
  ******************************************************************************/
-void i2c_start(I2C_TypeDef *i2c, uint32_t dev_address, uint32_t mode, uint32_t *data, uint32_t bytes_per_transfer, uint32_t reg_address, uint32_t callback){
-
-  I2C_STATE_MACHINE *i2c_local;
-  if(i2c == I2C0){
-      i2c_local = &i2c0_statemachine_vars;
-  }else if(i2c == I2C1){
-      i2c_local = &i2c1_statemachine_vars;
+void i2c_start(I2C_DEVICE *dev, uint32_t mode, uint32_t *data, uint32_t bytes_per_transfer, uint32_t reg_address, uint32_t callback){
+  I2C_STATE_MACHINE *i2c_local = i2c_engine_get(dev->bus);
+  I2C_XFER xfer = { dev, mode, data, bytes_per_transfer, reg_address, callback };
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if(!i2c_local->busy){
+      i2c_run(i2c_local, &xfer);
+  }else if(i2c_local->queued < I2C_QUEUE_LEN){
+      i2c_local->queue[(i2c_local->queue_head + i2c_local->queued) % I2C_QUEUE_LEN] = xfer;
+      i2c_local->queued++;
   }else{
-      EFM_ASSERT(false);
+      dev->status = I2C_STATUS_FULL;
+      add_scheduled_event(callback);
+      LOG_WARN("I2C%u 0x%02lx queue full", (unsigned)(i2c_local - i2c_engines), dev->address);
   }
-  while(!i2c_local->busy);
-
-  EFM_ASSERT((i2c->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
-
-  sleep_block_mode(I2C_EM_BLOCK); //block unwanted sleep mode ( > EM2)
-
-
-  i2c_local->busy = false;
+  CORE_EXIT_CRITICAL();
+}
 
-  i2c_local->i2cx = i2c;
-  i2c_local->rwrite = mode;
-  i2c_local->i2c_callback = callback;
-  i2c_local->data = data;
-  i2c_local->bytes_per_transfer = bytes_per_transfer;
-  i2c_local->current_state = init_write;
 
-  i2c_local->register_address = reg_address;
-  i2c_local->peripheral_address = dev_address;
-  i2c->CMD = I2C_CMD_START;
-  i2c->TXDATA = (dev_address << 1) | WRITE_OP;
+/***************************************************************************//**
+ * @brief
+ *Frees the bus from a slave that is stuck driving SDA low.
+ *
+ * @details
+ *A slave reset or interrupted in the middle of a byte keeps waiting for the rest of its clocks.
+ *The pins are taken from the I2C, which leaves them as wired-and GPIOs, and SCL is pulsed
+ *until the slave lets go of SDA, at most I2C_RECOVER_CLOCKS times. A STOP made by hand then
+ *resets every slave's bus logic before the pins are given back.
+ ******************************************************************************/
+static void i2c_bus_recover(I2C_STATE_MACHINE *i2c_sm) {
+  I2C_TypeDef *i2c = i2c_sm->i2cx;
+  uint32_t routepen = i2c->ROUTEPEN;
+
+  i2c->ROUTEPEN = 0;
+  GPIO_PinOutSet(i2c_sm->sda_port, i2c_sm->sda_pin);
+  GPIO_PinOutSet(i2c_sm->scl_port, i2c_sm->scl_pin);
+
+  for(int i = 0; (i < I2C_RECOVER_CLOCKS) && !GPIO_PinInGet(i2c_sm->sda_port, i2c_sm->sda_pin); i++){
+      GPIO_PinOutClear(i2c_sm->scl_port, i2c_sm->scl_pin);
+      for(volatile int spin = 0; spin < I2C_RECOVER_SPIN; spin++);
+      GPIO_PinOutSet(i2c_sm->scl_port, i2c_sm->scl_pin);
+      for(volatile int spin = 0; spin < I2C_RECOVER_SPIN; spin++);
+  }
 
+  // STOP: SDA rises while SCL is high
+  GPIO_PinOutClear(i2c_sm->scl_port, i2c_sm->scl_pin);
+  for(volatile int spin = 0; spin < I2C_RECOVER_SPIN; spin++);
+  GPIO_PinOutClear(i2c_sm->sda_port, i2c_sm->sda_pin);
+  for(volatile int spin = 0; spin < I2C_RECOVER_SPIN; spin++);
+  GPIO_PinOutSet(i2c_sm->scl_port, i2c_sm->scl_pin);
+  for(volatile int spin = 0; spin < I2C_RECOVER_SPIN; spin++);
+  GPIO_PinOutSet(i2c_sm->sda_port, i2c_sm->sda_pin);
+  for(volatile int spin = 0; spin < I2C_RECOVER_SPIN; spin++);
+
+  i2c->ROUTEPEN = routepen;
+  i2c_sm->recoveries++;
 }
 
-
 /***************************************************************************//**
  * @brief
  *Performs a reset on the i2c bus.
  *
  * @details
- *Aborts current state of i2c bus, then clears interrupt flags. Clears both astop and start bits to reset all conditions.
+ *Clocks out a slave holding SDA or SCL low first, see i2c_bus_recover(). Then aborts current
+ *state of i2c bus and clears interrupt flags. Clears both astop and start bits to reset all
+ *conditions. The wait for the STOP is bounded so a bus that stays stuck can not hang the core.
  * @note
  * Called in app.c in order to configure i2c and clear any previous conditions, performing a clean reset.
- * @param[in] i2c
- *Pointer to desired i2c peripheral whose bus is to be reset.
+ * Also called from the interrupt handler after a bus error.
+ * @param[in] i2c_sm
+ *State machine of the i2c peripheral whose bus is to be reset.
+ *
+ * @return
+ *false if the bus is still not free
  ******************************************************************************/
-static void i2c_bus_reset(I2C_TypeDef *i2c) {
+static bool i2c_bus_reset(I2C_STATE_MACHINE *i2c_sm) {
+  I2C_TypeDef *i2c = i2c_sm->i2cx;
   uint32_t ien_save_state; //declare local int
+  uint32_t spin = I2C_STOP_SPIN;
+
+  if(!GPIO_PinInGet(i2c_sm->sda_port, i2c_sm->sda_pin) || !GPIO_PinInGet(i2c_sm->scl_port, i2c_sm->scl_pin)){
+      i2c_bus_recover(i2c_sm);
+  }
 
   i2c->CMD = I2C_CMD_ABORT; //ensure state is available to accept commands.
 
@@ -345,12 +666,14 @@ static void i2c_bus_reset(I2C_TypeDef *i2c) {
   i2c->CMD = I2C_CMD_CLEARTX; //clear tx bit
   i2c->CMD = (I2C_CMD_START | I2C_CMD_STOP); //clear start and stop bits in case they got triggered
 
-  while(!(i2c->IF & I2C_IF_MSTOP)); //hold until IF register cleared
+  while(!(i2c->IF & I2C_IF_MSTOP) && --spin); //hold until the STOP went out, or give up
   i2c->IFC = i2c->IF; //reset state of IF flag in IFC
 
   i2c->CMD = I2C_CMD_ABORT; //ensure state is left acceptable by resetting.
 
   i2c->IEN = ien_save_state; //return state of IEN to initial state.
+
+  return (spin != 0) && GPIO_PinInGet(i2c_sm->sda_port, i2c_sm->sda_pin);
 }
 
 
@@ -361,26 +684,44 @@ static void i2c_bus_reset(I2C_TypeDef *i2c) {
  * @details
  * Handles any interrupts triggered by the I2C0 peripheral. Based on which flags have been raised, will perform proper operations in response.
  * @note
- * Handles ACK, RXDATAV, and MSTOP interrupt flags.
+ * Handles ACK, RXDATAV, and MSTOP interrupt flags, NACK and the error flags first.
  ******************************************************************************/
 void I2C0_IRQHandler(void) {
+  uint32_t prof_start = PROF_ISR_ENTER();
+  uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_I2C0);
+  DEFINED_STATES state = i2c_engines[0].current_state;
   uint32_t int_flag = I2C0->IF & I2C0->IEN;
   I2C0->IFC = int_flag;
 
+  if (i2c_error_irq(&i2c_engines[0], int_flag)){
+      int_flag = 0; //the other flags belong to the aborted transfer
+  }
+  if (int_flag & I2C_IF_NACK){
+      i2c_nack_sm(&i2c_engines[0]);
+  }
   if (int_flag & I2C_IF_ACK){
-      i2c_ack_sm(&i2c0_statemachine_vars);
+      uint32_t path_start = PROF_PATH_ENTER();
+      i2c_ack_sm(&i2c_engines[0]);
+      PROF_PATH_EXIT(PROF_PATH_I2C_ACK, path_start);
     //EFM_ASSERT(!(I2C0->IF & I2C_IF_ACK));
   }
   if (int_flag & I2C_IF_RXDATAV){
-      i2c_receive_sm(&i2c0_statemachine_vars);
+      uint32_t path_start = PROF_PATH_ENTER();
+      i2c_receive_sm(&i2c_engines[0]);
+      PROF_PATH_EXIT(PROF_PATH_I2C_RX, path_start);
     //EFM_ASSERT(!(I2C0->IF & I2C_IF_RXDATAV));
 
   }
   if (int_flag & I2C_IF_MSTOP){
-      i2c_msstop_sm(&i2c0_statemachine_vars);
+      i2c_msstop_sm(&i2c_engines[0]);
     //EFM_ASSERT(!(I2C0->IF & I2C_IF_MSTOP));
 
   }
+  if (i2c_engines[0].current_state != state){
+      TRACE_I2C(0, i2c_engines[0].current_state);
+  }
+  TRACE_ISR_EXIT(TRACE_ISR_I2C0, trace_start);
+  PROF_ISR_EXIT(PROF_ISR_I2C0, prof_start);
 }
 
 /***************************************************************************//**
@@ -391,51 +732,81 @@ void I2C0_IRQHandler(void) {
  * Handles any interrupts triggered by the I2C1 peripheral. Based on which flags have been raised, will perform proper operations in response.
  *
  * @note
- * Handles ACK, RXDATAV, and MSTOP interrupt flags.
+ * Handles ACK, RXDATAV, and MSTOP interrupt flags, NACK and the error flags first.
  ******************************************************************************/
 void I2C1_IRQHandler(void) {
+  uint32_t prof_start = PROF_ISR_ENTER();
+  uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_I2C1);
+  DEFINED_STATES state = i2c_engines[1].current_state;
   uint32_t int_flag = I2C1->IF & I2C1->IEN;
   I2C1->IFC = int_flag;
 
+  if (i2c_error_irq(&i2c_engines[1], int_flag)){
+      int_flag = 0; //the other flags belong to the aborted transfer
+  }
+  if (int_flag & I2C_IF_NACK){
+      i2c_nack_sm(&i2c_engines[1]);
+  }
   if (int_flag & I2C_IF_ACK){
-      i2c_ack_sm(&i2c1_statemachine_vars);
+      uint32_t path_start = PROF_PATH_ENTER();
+      i2c_ack_sm(&i2c_engines[1]);
+      PROF_PATH_EXIT(PROF_PATH_I2C_ACK, path_start);
     //EFM_ASSERT(!(I2C1->IF & I2C_IF_ACK));
   }
   if (int_flag & I2C_IF_RXDATAV){
-      i2c_receive_sm(&i2c1_statemachine_vars);
+      uint32_t path_start = PROF_PATH_ENTER();
+      i2c_receive_sm(&i2c_engines[1]);
+      PROF_PATH_EXIT(PROF_PATH_I2C_RX, path_start);
     //EFM_ASSERT(!(I2C1->IF & I2C_IF_RXDATAV));
 
   }
   if (int_flag & I2C_IF_MSTOP){
-      i2c_msstop_sm(&i2c1_statemachine_vars);
+      i2c_msstop_sm(&i2c_engines[1]);
     //EFM_ASSERT(!(I2C1->IF & I2C_IF_MSTOP));
   }
+  if (i2c_engines[1].current_state != state){
+      TRACE_I2C(1, i2c_engines[1].current_state);
+  }
+  TRACE_ISR_EXIT(TRACE_ISR_I2C1, trace_start);
+  PROF_ISR_EXIT(PROF_ISR_I2C1, prof_start);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether i2c_open() has set up a bus, for drivers of devices that share one.
+ ******************************************************************************/
+bool i2c_is_open(I2C_TypeDef *i2c) {
+  return i2c_engine_get(i2c)->i2cx != NULL;
 }
 
 /***************************************************************************//**
  * @brief
- * Checks busy state of i2c peripheral.
+ * Returns whether a bus has a transfer running, for diagnostics only.
  *
  * @details
- *Determines if i2c periph is available based on input of I2C_Typedef *i2c
- *
- *
- * @note
- *Verifies availability of i2c
- *
+ * Nothing needs to wait for this, i2c_start() queues a transfer behind a running one.
  ******************************************************************************/
-bool busy_state(I2C_TypeDef *i2c) {
-  if(i2c == I2C0) {
-      return i2c0_statemachine_vars.busy;
-  }
-  if(i2c == I2C1) {
-      return i2c1_statemachine_vars.busy;
-  }
-  else {
-      return false;
-  }
+bool i2c_busy(I2C_TypeDef *i2c) {
+  return i2c_engine_get(i2c)->busy;
 }
 
+/***************************************************************************//**
+ * @brief
+ * Returns the result of the last transfer of a device.
+ *
+ * @details
+ * Meant for the transfer's callback, which is scheduled on failure as well. The status is
+ * kept per device, so a transfer finishing on the other bus or for another device on the
+ * same bus does not overwrite it.
+ ******************************************************************************/
+I2C_STATUS i2c_dev_status(const I2C_DEVICE *dev){
+  return dev->status;
+}
 
-
-
+/***************************************************************************//**
+ * @brief
+ * Returns how often the bus had to be clocked free since i2c_open().
+ ******************************************************************************/
+uint32_t i2c_recoveries(I2C_TypeDef *i2c){
+  return i2c_engine_get(i2c)->recoveries;
+}
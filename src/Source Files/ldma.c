@@ -0,0 +1,86 @@
+/**
+ * @file ldma.c
+ * @brief LDMA setup and completion events
+ *Responsible for initializing the LDMA once and turning channel done interrupts into scheduled events.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "ldma.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static bool ldma_opened;
+static uint32_t ldma_done_evts[LDMA_CHANNELS];
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Enables the LDMA clock and initializes the controller.
+ *
+ * @details
+ * Safe to call from every driver that uses a channel, only the first call initializes.
+ * LDMA_Init enables the LDMA interrupt in the NVIC.
+ ******************************************************************************/
+void ldma_open(void){
+  LDMA_Init_t ldma_init = LDMA_INIT_DEFAULT;
+
+  if(ldma_opened) return;
+
+  clock_request(cmuClock_LDMA);
+  LDMA_Init(&ldma_init);
+  ldma_opened = true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sets the event scheduled when a channel finishes a descriptor with doneIfs set.
+ *
+ * @param[in] channel
+ * LDMA channel
+ *
+ * @param[in] done_evt
+ * Event to schedule, 0 to only clear the flag
+ ******************************************************************************/
+void ldma_done_event(uint32_t channel, uint32_t done_evt){
+  EFM_ASSERT(channel < LDMA_CHANNELS);
+  ldma_done_evts[channel] = done_evt;
+}
+
+/***************************************************************************//**
+ * @brief
+ * IRQ handler for the LDMA.
+ *
+ * @details
+ * Clears the done flags and schedules the events registered for the finished channels.
+ *
+ * @note
+ * A bus error stops the LDMA, which should never happen with the static descriptors used here.
+ ******************************************************************************/
+void LDMA_IRQHandler(void){
+  uint32_t int_flag = LDMA->IF & LDMA->IEN;
+  LDMA->IFC = int_flag;
+
+  EFM_ASSERT(!(int_flag & LDMA_IF_ERROR));
+
+  for(uint32_t channel = 0; channel < LDMA_CHANNELS; channel++){
+      if((int_flag & (1UL << channel)) && ldma_done_evts[channel]){
+          add_scheduled_event(ldma_done_evts[channel]);
+      }
+  }
+}
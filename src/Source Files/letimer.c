@@ -22,10 +22,105 @@
   static uint32_t scheduled_comp0_cb;
   static uint32_t scheduled_comp1_cb;
   static uint32_t scheduled_uf_cb;
+  static volatile LETIMER_PENDING letimer0_pending;
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
+static uint32_t letimer0_next_deadline_us(void);
+static bool letimer0_pwm_valid(uint32_t top, uint32_t active);
+static void letimer0_pwm_apply(LETIMER_TypeDef *letimer);
+static uint32_t letimer0_active_get(LETIMER_TypeDef *letimer);
+
+/***************************************************************************//**
+ * @brief
+ *Checks that a period and active time can be loaded into COMP0 and COMP1.
+ *
+ * @details
+ *The top must fit the 16 bit COMP0 and the active time must be shorter than the period,
+ *otherwise the output never asserts.
+ ******************************************************************************/
+static bool letimer0_pwm_valid(uint32_t top, uint32_t active){
+  return (top <= LETIMER_TOP_MAX) && (active < top);
+}
+
+/***************************************************************************//**
+ * @brief
+ *Loads the pending period and active time, called from the UF interrupt.
+ *
+ * @details
+ *At underflow the counter has just reloaded from COMP0, so the period that starts now
+ *still has the old top. A new COMP0 written here only takes effect at the next underflow
+ *while COMP1 takes effect at once, so COMP1 is held back one period and written at the
+ *underflow that loads the COMP0 it belongs to. Every period then runs with a matching
+ *top and active time and the running period is never cut short. Each register is
+ *written at most once per period, so its SYNCBUSY bit is already clear and no spin is
+ *needed. While ramping the next step is staged right away for the following underflow.
+ ******************************************************************************/
+static void letimer0_pwm_apply(LETIMER_TypeDef *letimer){
+  uint32_t top;
+
+  if(letimer0_pending.comp1_due){
+      LETIMER_CompareSet(letimer, 1, letimer0_pending.comp1);
+      letimer0_pending.comp1_due = false;
+  }
+  if(!letimer0_pending.valid) return;
+
+  LETIMER_CompareSet(letimer, 0, letimer0_pending.top);
+  letimer0_pending.comp1 = letimer0_pending.active;
+  letimer0_pending.comp1_due = true;
+  letimer0_pending.valid = false;
+
+  if(letimer0_pending.ramping){
+      top = letimer0_pending.top;
+      if(top == letimer0_pending.ramp_target){
+          letimer0_pending.ramping = false;
+          return;
+      }
+      if(top < letimer0_pending.ramp_target){
+          top += letimer0_pending.ramp_step;
+          if(top > letimer0_pending.ramp_target) top = letimer0_pending.ramp_target;
+      }else{
+          top = (top - letimer0_pending.ramp_target > letimer0_pending.ramp_step) ?
+              top - letimer0_pending.ramp_step : letimer0_pending.ramp_target;
+      }
+      letimer0_pending.top = top;
+      letimer0_pending.valid = true;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns the active time of the last period loaded, including a COMP1 still held back.
+ ******************************************************************************/
+static uint32_t letimer0_active_get(LETIMER_TypeDef *letimer){
+  return letimer0_pending.comp1_due ? letimer0_pending.comp1 : LETIMER_CompareGet(letimer, 1);
+}
+
+/***************************************************************************//**
+ * @brief
+ *Reports the time until the next enabled LETIMER0 COMP1 or UF interrupt to the sleep manager.
+ *
+ * @details
+ *The counter runs down from COMP0, so COMP1 fires when CNT reaches COMP1 and UF when it
+ *passes 0. Called by enter_sleep() with interrupts disabled.
+ *
+ * @return
+ *Time in us until the next interrupt, SLEEP_DEADLINE_NONE when the LETIMER is stopped.
+ ******************************************************************************/
+static uint32_t letimer0_next_deadline_us(void){
+  uint32_t cnt, ticks;
+
+  if(!(LETIMER0->STATUS & LETIMER_STATUS_RUNNING)) return SLEEP_DEADLINE_NONE;
+
+  cnt = LETIMER0->CNT;
+  if((LETIMER0->IEN & LETIMER_IEN_COMP1) && (cnt > LETIMER0->COMP1)){
+      ticks = cnt - LETIMER0->COMP1;
+  }else{
+      ticks = cnt + 1;
+  }
+  return ticks * (1000000 / LETIMER_HZ);
+}
 
 
 //***********************************************************************************
@@ -67,7 +162,7 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
   /*  Enable the routed clock to the LETIMER0 peripheral */
 
    if(letimer == LETIMER0) {
-       CMU_ClockEnable(cmuClock_LETIMER0, true); // 16) b) v) and vi) ?
+       clock_request(cmuClock_LETIMER0); // kept for good, the LETIMER0 runs continuously
    }
 
    letimer_start(letimer,false);
@@ -160,8 +255,12 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
   scheduled_comp1_cb = app_letimer_struct->comp1_cb;
   scheduled_uf_cb = app_letimer_struct->uf_cb;
 
+  if(letimer == LETIMER0) {
+      sleep_deadline_register(SLEEP_CLIENT_LETIMER, letimer0_next_deadline_us);
+  }
+
   if(letimer->STATUS & LETIMER_STATUS_RUNNING) {
-      sleep_block_mode(LETIMER_EM);
+      sleep_block_mode(SLEEP_CLIENT_LETIMER, LETIMER_EM);
   }
 }
 
@@ -179,6 +278,8 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
  ******************************************************************************/
 void LETIMER0_IRQHandler(void) {
 
+    uint32_t prof_start = PROF_ISR_ENTER();
+    uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_LETIMER0);
     uint32_t int_flag;
     int_flag = LETIMER0->IF & LETIMER0->IEN;
     LETIMER0->IFC = int_flag; //clear flags
@@ -195,10 +296,11 @@ void LETIMER0_IRQHandler(void) {
 
     if (LETIMER_IF_UF & int_flag) {
         EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
+        letimer0_pwm_apply(LETIMER0);
         add_scheduled_event(scheduled_uf_cb);
     }
-
-
+    TRACE_ISR_EXIT(TRACE_ISR_LETIMER0, trace_start);
+    PROF_ISR_EXIT(PROF_ISR_LETIMER0, prof_start);
   }
 
 /***************************************************************************//**
@@ -224,11 +326,11 @@ void LETIMER0_IRQHandler(void) {
 void letimer_start(LETIMER_TypeDef *letimer, bool enable){
 
   if(!(letimer->STATUS & LETIMER_STATUS_RUNNING) && enable) {
-      sleep_block_mode(LETIMER_EM);
+      sleep_block_mode(SLEEP_CLIENT_LETIMER, LETIMER_EM);
   }
 
   if((letimer->STATUS & LETIMER_STATUS_RUNNING) && !(enable)){
-    sleep_unblock_mode(LETIMER_EM);
+    sleep_unblock_mode(SLEEP_CLIENT_LETIMER, LETIMER_EM);
   }
   while(letimer->SYNCBUSY);
 LETIMER_Enable(letimer, enable);
@@ -238,41 +340,133 @@ LETIMER_Enable(letimer, enable);
 
 
 
+/***************************************************************************//**
+ * @brief
+ * Requests a new PWM period and active time for LETIMER0.
+ *
+ * @details
+ * When the LETIMER is running the values are staged and loaded by the UF interrupt, so the
+ * change happens on a period boundary without stopping the timer. When it is stopped they
+ * are written directly. A pending ramp is cancelled.
+ *
+ * @param[in] letimer
+ * Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @param[in] top
+ * New COMP0 value, period in LETIMER ticks
+ *
+ * @param[in] active
+ * New COMP1 value, active time in LETIMER ticks
+ *
+ * @return
+ * false if the values are out of range, nothing is changed in that case
+ ******************************************************************************/
+bool letimer0_pwm_set(LETIMER_TypeDef *letimer, uint32_t top, uint32_t active)
+{
+  CORE_DECLARE_IRQ_STATE;
+
+  if(!letimer0_pwm_valid(top, active)) return false;
+
+  CORE_ENTER_CRITICAL();
+  letimer0_pending.ramping = false;
+  if(letimer->STATUS & LETIMER_STATUS_RUNNING){
+      letimer0_pending.top = top;
+      letimer0_pending.active = active;
+      letimer0_pending.valid = true;
+  }else{
+      letimer0_pending.valid = false;
+      letimer0_pending.comp1_due = false;
+      LETIMER_CompareSet(letimer, 0, top);
+      LETIMER_CompareSet(letimer, 1, active);
+  }
+  CORE_EXIT_CRITICAL();
+  return true;
+}
+
 /***************************************************************************//**
  * @brief
  * Adjusts PWM period based on input, adds specified amount to period.
  * @details
- * Adds input value to value in COMP0 register for the letimer, adjusting the period. Checks status of LETIMER
- * before changing values in order to prevent unexpected errors.
+ * Adds the signed input to the current (or already pending) COMP0 value and stages it with
+ * letimer0_pwm_set(). The active time is kept.
  *
  * @param[in] letimer
  * Pointer to the base peripheral address of the LETIMER peripheral being opened
  *
  *  @param[in] added_pwm
- *pwm amount to be added to current pwm from comp0 register
+ *signed amount of LETIMER ticks to add to the period
  *
+ * @return
+ * false if the resulting period is out of range, the period is left unchanged
  ******************************************************************************/
-void letimer0_period(LETIMER_TypeDef * letimer, uint32_t added_pwm)
+bool letimer0_period(LETIMER_TypeDef * letimer, int32_t added_pwm)
 {
-  uint32_t new_period;
-  uint32_t old_period;
-  if((letimer->STATUS & LETIMER_STATUS_RUNNING) != 0){
-      LETIMER_Enable(letimer, false);
-
-      while(letimer->SYNCBUSY);
-      old_period = LETIMER_CompareGet(letimer,0);
-      new_period = old_period + added_pwm;
-
-      LETIMER_CompareSet(letimer, 0, new_period);
-      LETIMER_Enable(letimer, true);
-      while(letimer->SYNCBUSY);
+  int32_t new_period;
+  uint32_t active;
+  bool ok = false;
+  CORE_DECLARE_IRQ_STATE;
+
+  CORE_ENTER_CRITICAL();
+  if(letimer0_pending.valid){
+      new_period = (int32_t)letimer0_pending.top + added_pwm;
+      active = letimer0_pending.active;
+  }else{
+      new_period = (int32_t)LETIMER_CompareGet(letimer, 0) + added_pwm;
+      active = letimer0_active_get(letimer);
   }
-  if((letimer->STATUS & LETIMER_STATUS_RUNNING) == 0){
-      old_period = LETIMER_CompareGet(letimer,0);
-      new_period = old_period + added_pwm;
-
-      LETIMER_CompareSet(letimer, 0, new_period);
-      while(letimer->SYNCBUSY);
+  if(new_period > 0){
+      ok = letimer0_pwm_set(letimer, (uint32_t)new_period, active);
   }
+  CORE_EXIT_CRITICAL();
+  return ok;
 }
 
+/***************************************************************************//**
+ * @brief
+ * Moves the PWM period by a signed amount in steps, one step per period.
+ *
+ * @details
+ * The first step is staged for the next underflow and every UF interrupt stages the next
+ * one until the target is reached. A stopped LETIMER takes the target directly.
+ *
+ * @param[in] letimer
+ * Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @param[in] added_pwm
+ * signed amount of LETIMER ticks to add to the period
+ *
+ * @param[in] step
+ * largest change of the period per PWM period in LETIMER ticks, must not be 0
+ *
+ * @return
+ * false if the target period is out of range, nothing is changed in that case
+ ******************************************************************************/
+bool letimer0_period_ramp(LETIMER_TypeDef *letimer, int32_t added_pwm, uint32_t step)
+{
+  int32_t target;
+  uint32_t top, active;
+  CORE_DECLARE_IRQ_STATE;
+
+  EFM_ASSERT(step != 0);
+
+  CORE_ENTER_CRITICAL();
+  top = letimer0_pending.valid ? letimer0_pending.top : LETIMER_CompareGet(letimer, 0);
+  active = letimer0_pending.valid ? letimer0_pending.active : letimer0_active_get(letimer);
+  target = (int32_t)top + added_pwm;
+  if((target <= 0) || !letimer0_pwm_valid((uint32_t)target, active)){
+      CORE_EXIT_CRITICAL();
+      return false;
+  }
+  if(!(letimer->STATUS & LETIMER_STATUS_RUNNING)){
+      CORE_EXIT_CRITICAL();
+      return letimer0_pwm_set(letimer, (uint32_t)target, active);
+  }
+  letimer0_pending.ramp_target = (uint32_t)target;
+  letimer0_pending.ramp_step = step;
+  letimer0_pending.top = top;
+  letimer0_pending.active = active;
+  letimer0_pending.ramping = true;
+  letimer0_pending.valid = true; //first apply loads the current top and stages the first step
+  CORE_EXIT_CRITICAL();
+  return true;
+}
@@ -33,12 +33,7 @@
 //***********************************************************************************
 // private variables
 //***********************************************************************************
-uint32_t	rx_done_evt;
-uint32_t	tx_done_evt;
-bool		leuart0_tx_busy;
-
-static LEUART_WRITE_SM leuart0_SM; //write
-static LEUART_READ_SM leuart0_SM_READ; //read
+static LEUART_CTX leuart_ctx[LEUART_COUNT]; //write and read state machines, one set per instance
 
 
 /***************************************************************************//**
@@ -60,6 +55,98 @@ static LEUART_READ_SM leuart0_SM_READ; //read
 static void STARTFRAME_HANDLER(LEUART_READ_SM*leuart0_SM_READ);
 static void SIGFRAME_HANDLER(LEUART_READ_SM*leuart0_SM_READ);
 static void RXDATAV_HANDLER(LEUART_READ_SM*leuart0_SM_READ);
+static uint32_t leuart_next_deadline_us(void);
+static LEUART_CTX *leuart_ctx_get(LEUART_TypeDef *leuart);
+static void leuart_irq(LEUART_CTX *ctx);
+
+/***************************************************************************//**
+ * @brief
+ * Reports the time until the next LEUART transmit interrupt to the sleep manager.
+ * @details
+ * While a string is being written the next TXBL or TXC arrives within one character time.
+ * With several instances transmitting the soonest one counts.
+ *
+ * @return
+ * Time in us until the next interrupt, SLEEP_DEADLINE_NONE when not transmitting.
+ ******************************************************************************/
+static uint32_t leuart_next_deadline_us(void)
+{
+  uint32_t deadline = SLEEP_DEADLINE_NONE;
+
+  for(int i = 0; i < LEUART_COUNT; i++){
+      if(leuart_ctx[i].write.busy && (leuart_ctx[i].char_us < deadline)){
+          deadline = leuart_ctx[i].char_us;
+      }
+  }
+  return deadline;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the driver state of a LEUART instance.
+ *
+ * @param[in] leuart
+ * Address of the leuart peripheral
+ ******************************************************************************/
+static LEUART_CTX *leuart_ctx_get(LEUART_TypeDef *leuart)
+{
+#if LEUART_COUNT > 1
+  if(leuart == LEUART1) return &leuart_ctx[1];
+#endif
+  EFM_ASSERT(leuart == LEUART0);
+  return &leuart_ctx[0];
+}
+
+/***************************************************************************//**
+ * @brief
+ * Interrupt handling shared by all LEUART instances.
+ * @details
+ * Handles any interrupts triggered by the LEUART peripheral. Includes interrupts triggered for read and write operations, as well as completion of operations.
+ *@note
+ * TXC should only occur once transmission is fully complete. TXBL should occur once per character transmission. Read operations use STARFRAME,RXDATAV,SIGFRAME
+ *
+ * @param[in] ctx
+ * Driver state of the instance that raised the interrupt
+ ******************************************************************************/
+static void leuart_irq(LEUART_CTX *ctx)
+{
+  LEUART_TypeDef *leuart = ctx->read.leuart_read;
+  uint32_t interrupt_flag = leuart->IF & leuart->IEN;
+  LEUART_WRITE_STATES tx_state = ctx->write.current_state;
+  LEUART_READ_STATES rx_state = ctx->read.current_read_state;
+  leuart->IFC = interrupt_flag;
+
+  if(interrupt_flag & LEUART_IF_TXBL){
+      uint32_t path_start = PROF_PATH_ENTER();
+      TXBL_IRQ(&ctx->write);
+      PROF_PATH_EXIT(PROF_PATH_TXBL, path_start);
+    }
+  if(interrupt_flag & LEUART_IF_TXC){
+      TXC_IRQ(&ctx->write);
+    }
+
+
+
+  if(interrupt_flag & LEUART_IF_STARTF){
+      STARTFRAME_HANDLER(&ctx->read);
+    }
+  if(interrupt_flag & LEUART_IF_RXDATAV){
+      uint32_t path_start = PROF_PATH_ENTER();
+      RXDATAV_HANDLER(&ctx->read);
+      PROF_PATH_EXIT(PROF_PATH_RXDATAV, path_start);
+    }
+
+  if(interrupt_flag & LEUART_IF_SIGF){
+      SIGFRAME_HANDLER(&ctx->read);
+    }
+
+  if(ctx->write.current_state != tx_state){
+      TRACE_LEUART(TRACE_T_LEUART_TX, ctx->write.current_state);
+  }
+  if(ctx->read.current_read_state != rx_state){
+      TRACE_LEUART(TRACE_T_LEUART_RX, ctx->read.current_read_state);
+  }
+}
 
 
 
@@ -83,9 +170,23 @@ static void RXDATAV_HANDLER(LEUART_READ_SM*leuart0_SM_READ);
  * Contains info for the desired configuration of the LEUART peripheral.
  ******************************************************************************/
 void leuart_open(LEUART_TypeDef * leuart, LEUART_OPEN_STRUCT *leuart_settings){
+  LEUART_CTX *ctx = leuart_ctx_get(leuart);
+
+  // the interrupt handler finds the peripheral through ctx, set it up before any IRQ can fire
+  ctx->read.leuart_read = leuart;
+  ctx->write.leuart = leuart;
+  ctx->read.leuart0_read_cb = leuart_settings->rx_done_evt;
+  ctx->read.current_read_state = STARTFRAME;
+  ctx->read.str_length = 0;
+
   if(leuart == LEUART0) {
-        CMU_ClockEnable(cmuClock_LEUART0, true);
+        clock_request(cmuClock_LEUART0); // kept for good, the HM-18 can send at any time
     }
+#if LEUART_COUNT > 1
+  if(leuart == LEUART1) {
+        clock_request(cmuClock_LEUART1);
+    }
+#endif
 
     leuart->STARTFRAME = true;
 
@@ -107,10 +208,13 @@ void leuart_open(LEUART_TypeDef * leuart, LEUART_OPEN_STRUCT *leuart_settings){
     leuart_values.stopbits = leuart_settings->stopbits;
 
     LEUART_Init(leuart, &leuart_values);
+    ctx->char_us = (10 * 1000000) / leuart_settings->baudrate; //start + 8 data + stop bits
+    sleep_deadline_register(SLEEP_CLIENT_LEUART_TX, leuart_next_deadline_us);
 
     while(leuart->SYNCBUSY);
     leuart->ROUTELOC0 = leuart_settings->tx_loc | leuart_settings->rx_loc;
-    leuart->ROUTEPEN = (leuart_settings->tx_en * LEUART_ROUTEPEN_TXPEN) | (leuart_settings->rx_en * LEUART_ROUTEPEN_RXPEN);
+    ctx->routepen = (leuart_settings->tx_en * LEUART_ROUTEPEN_TXPEN) | (leuart_settings->rx_en * LEUART_ROUTEPEN_RXPEN);
+    leuart->ROUTEPEN = ctx->routepen;
 
     leuart->CMD |= LEUART_CMD_CLEARRX;
     leuart->CMD |= LEUART_CMD_CLEARTX;
@@ -120,7 +224,11 @@ void leuart_open(LEUART_TypeDef * leuart, LEUART_OPEN_STRUCT *leuart_settings){
     EFM_ASSERT((leuart->STATUS & LEUART_STATUS_TXENS));
     EFM_ASSERT((leuart->STATUS & LEUART_STATUS_RXENS));
 
+#if LEUART_COUNT > 1
+    NVIC_EnableIRQ((leuart == LEUART1) ? LEUART1_IRQn : LEUART0_IRQn);
+#else
     NVIC_EnableIRQ(LEUART0_IRQn);
+#endif
     leuart-> IFC |= IFC_CLR;
     leuart->IEN |= LEUART_IEN_STARTF;
 
@@ -128,23 +236,15 @@ void leuart_open(LEUART_TypeDef * leuart, LEUART_OPEN_STRUCT *leuart_settings){
     leuart->CTRL |= LEUART_CTRL_SFUBRX;
 
     while(leuart->SYNCBUSY);
-    leuart0_SM_READ.leuart_read = leuart;
-
-    leuart0_SM_READ.leuart0_read_cb = BLE_TX_DONE_CB;
-    leuart0_SM_READ.leuart0_read_cb = rx_done_evt;
-
-
-    leuart0_SM_READ.leuart_read->STARTFRAME = STARTF_CHR;
-    leuart0_SM_READ.leuart_read->SIGFRAME = SIGF_CHR;
+    leuart->STARTFRAME = STARTF_CHR;
+    leuart->SIGFRAME = SIGF_CHR;
 
     leuart->CMD |= LEUART_CMD_RXBLOCKEN;
 
     while(leuart->SYNCBUSY);
     LEUART_Enable(leuart, leuartEnable);
 
-    leuart0_SM_READ.current_read_state = STARTFRAME;
-    leuart0_SM_READ.str_length = 0;
-    leuart_rx_tdd();
+    leuart_rx_tdd(leuart);
 }
 
 /***************************************************************************//**
@@ -167,73 +267,107 @@ void leuart_open(LEUART_TypeDef * leuart, LEUART_OPEN_STRUCT *leuart_settings){
  ******************************************************************************/
 void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len, uint32_t leuart_cb)
 {
-    while(leuart0_SM.busy);
+    LEUART_WRITE_SM *write_sm = &leuart_ctx_get(leuart)->write;
+
+    while(write_sm->busy);
 
     CORE_DECLARE_IRQ_STATE;
     CORE_ENTER_CRITICAL();
 
-    leuart0_SM.current_state = STRING_INIT;
-    leuart0_SM.leuart = leuart;
+    write_sm->current_state = STRING_INIT;
+    write_sm->leuart = leuart;
 
 
-    strcpy(leuart0_SM.data,string);
+    EFM_ASSERT(string_len <= sizeof(write_sm->data));
+    memcpy(write_sm->data, string, string_len); //binary safe, compressed frames may hold 0
 
-    leuart0_SM.data_sent = 0;
-    leuart0_SM.str_length = string_len;
-    leuart0_SM.leuart0_write_cb = leuart_cb;
-    leuart0_SM.busy = true;
-    sleep_block_mode(LEUART_TX_EM);
+    write_sm->data_sent = 0;
+    write_sm->str_length = string_len;
+    write_sm->leuart0_write_cb = leuart_cb;
+    write_sm->busy = true;
+    sleep_block_mode(SLEEP_CLIENT_LEUART_TX, LEUART_TX_EM);
 
-    leuart0_SM.leuart->IEN |= LEUART_IEN_TXBL;
+    write_sm->leuart->IEN |= LEUART_IEN_TXBL;
     CORE_EXIT_CRITICAL();
 }
 
 /***************************************************************************//**
  * @brief
- * Reads whether SM Read is busy currently.
+ * Reads whether the write state machine is busy currently.
  * @details
- * Used for TDD and development for checking busy bit. Returns value of static LEUART_READ_SM struct.
- *
+ * Used for TDD and development for checking busy bit. Returns value of the instance's LEUART_WRITE_SM struct.
  *
+ * @param[in] leuart
+ * Address of the leuart peripheral to check
  ******************************************************************************/
-bool leuart_tx_busy()
+bool leuart_tx_busy(LEUART_TypeDef *leuart)
 {
-  return leuart0_SM_READ.read_busy;
+  return leuart_ctx_get(leuart)->write.busy;
 }
 
 /***************************************************************************//**
  * @brief
- *IRQhandler for LEUART0 peripheral.
+ * Hands the LEUART pins to another peripheral and takes them back.
  * @details
- * Handles any interrupts triggered by the LEUART peripheral. Includes interrupts triggered for read and write operations, as well as completion of operations.
- *@note
- * TXC should only occur once transmission is fully complete. TXBL should occur once per character transmission. Read operations use STARFRAME,RXDATAV,SIGFRAME
+ * While released the receiver is off, so whatever the other peripheral exchanges on the
+ * pins does not end up in the read state machine. Taking the pins back clears the receive
+ * buffer and re-enables the receiver, the read state machine resumes where it was.
+ * @note
+ * Must not be called while a transmission is in progress.
+ *
+ * @param[in] leuart
+ * Address of the leuart peripheral
+ *
+ * @param[in] enable
+ * true to route the pins to the LEUART again, false to release them
  ******************************************************************************/
-void LEUART0_IRQHandler(void)
+void leuart_pins(LEUART_TypeDef *leuart, bool enable)
 {
-  uint32_t interrupt_flag = LEUART0->IF & LEUART0->IEN;
-  LEUART0->IFC = interrupt_flag;
-
-  if(interrupt_flag & LEUART_IF_TXBL){
-      TXBL_IRQ(&leuart0_SM);
-    }
-  if(interrupt_flag & LEUART_IF_TXC){
-      TXC_IRQ(&leuart0_SM);
-    }
+  LEUART_CTX *ctx = leuart_ctx_get(leuart);
 
+  EFM_ASSERT(!ctx->write.busy);
 
+  if(enable){
+      leuart->ROUTEPEN = ctx->routepen;
+      leuart->CMD = LEUART_CMD_CLEARRX | LEUART_CMD_RXEN;
+  }else{
+      leuart->CMD = LEUART_CMD_RXDIS;
+      leuart->ROUTEPEN = 0;
+  }
+  while(leuart->SYNCBUSY);
+}
 
-  if(interrupt_flag & LEUART_IF_STARTF){
-      STARTFRAME_HANDLER(&leuart0_SM_READ);
-    }
-  if(interrupt_flag & LEUART_IF_RXDATAV){
-      RXDATAV_HANDLER(&leuart0_SM_READ);
-    }
+/***************************************************************************//**
+ * @brief
+ *IRQhandler for LEUART0 peripheral.
+ * @details
+ * Runs the interrupt handling for the LEUART0 driver state, see leuart_irq().
+ ******************************************************************************/
+void LEUART0_IRQHandler(void)
+{
+  uint32_t prof_start = PROF_ISR_ENTER();
+  uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_LEUART0);
+  leuart_irq(&leuart_ctx[0]);
+  TRACE_ISR_EXIT(TRACE_ISR_LEUART0, trace_start);
+  PROF_ISR_EXIT(PROF_ISR_LEUART0, prof_start);
+}
 
-  if(interrupt_flag & LEUART_IF_SIGF){
-      SIGFRAME_HANDLER(&leuart0_SM_READ);
-    }
+#if LEUART_COUNT > 1
+/***************************************************************************//**
+ * @brief
+ *IRQhandler for LEUART1 peripheral.
+ * @details
+ * Runs the interrupt handling for the LEUART1 driver state, see leuart_irq().
+ ******************************************************************************/
+void LEUART1_IRQHandler(void)
+{
+  uint32_t prof_start = PROF_ISR_ENTER();
+  uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_LEUART1);
+  leuart_irq(&leuart_ctx[1]);
+  TRACE_ISR_EXIT(TRACE_ISR_LEUART1, trace_start);
+  PROF_ISR_EXIT(PROF_ISR_LEUART1, prof_start);
 }
+#endif
 
 /***************************************************************************//**
  * @brief
@@ -256,9 +390,9 @@ void TXBL_IRQ(LEUART_WRITE_SM *LEUART_SM){
           LEUART_SM->data_sent++;
       }
       else{
-          LEUART0->IEN &= ~LEUART_IEN_TXBL;
-          LEUART0->IFC |= LEUART_IEN_TXC;
-          LEUART0->IEN |= LEUART_IEN_TXC;
+          LEUART_SM->leuart->IEN &= ~LEUART_IEN_TXBL;
+          LEUART_SM->leuart->IFC |= LEUART_IEN_TXC;
+          LEUART_SM->leuart->IEN |= LEUART_IEN_TXC;
 
           LEUART_SM->current_state = end;
       }
@@ -282,7 +416,7 @@ void TXC_IRQ(LEUART_WRITE_SM *LEUART_SM){
     case end:
       LEUART_SM->leuart->IEN &= ~(LEUART_IEN_TXC);
 
-      sleep_unblock_mode(LEUART_TX_EM);
+      sleep_unblock_mode(SLEEP_CLIENT_LEUART_TX, LEUART_TX_EM);
       LEUART_SM->busy = false;
 
       add_scheduled_event(LEUART_SM->leuart0_write_cb);
@@ -299,6 +433,8 @@ void TXC_IRQ(LEUART_WRITE_SM *LEUART_SM){
  * @details
  * Blocks data reception, sets initial strlen, and data for RXDATA.
  * Enables SIGFRAME and RXDATAV interrupts.
+ * A start frame inside an open frame restarts it, the partial frame is dropped and
+ * the start character is left for the RXDATAV interrupt raised with it.
  *
  * @param[in] LEUART_SM
  * Input state machine struct for LEUART_WRITE operation
@@ -318,6 +454,9 @@ static void STARTFRAME_HANDLER(LEUART_READ_SM *LEUART_SM){
       LEUART_SM->read_str[LEUART_SM->str_length] = LEUART_SM->leuart_read->RXDATA;
       LEUART_SM->str_length++;
        break;
+    case RXDATAV:
+      LEUART_SM->str_length = 0;
+      break;
     default:
       EFM_ASSERT(false);
       break;
@@ -352,7 +491,7 @@ static void SIGFRAME_HANDLER(LEUART_READ_SM *LEUART_SM){
 
 
       LEUART_SM->current_read_state = STARTFRAME;
-      add_scheduled_event(BLE_TX_DONE_CB);
+      add_scheduled_event(LEUART_SM->leuart0_read_cb);
       break;
     default:
       EFM_ASSERT(false);
@@ -375,8 +514,21 @@ static void RXDATAV_HANDLER(LEUART_READ_SM *LEUART_SM)
   switch(LEUART_SM->current_read_state)
   {
     case RXDATAV:
-      LEUART_SM->read_str[LEUART_SM->str_length] = LEUART_SM->leuart_read->RXDATA;
-      LEUART_SM->str_length++;
+      if(LEUART_SM->str_length < (sizeof(LEUART_SM->read_str) - 1)){
+          LEUART_SM->read_str[LEUART_SM->str_length] = LEUART_SM->leuart_read->RXDATA;
+          LEUART_SM->str_length++;
+      }else{
+          (void)LEUART_SM->leuart_read->RXDATA; //drop byte, frame longer than the buffer
+      }
+      break;
+    case RAW_RX:
+      if(LEUART_SM->str_length < (sizeof(LEUART_SM->read_str) - 1)){
+          LEUART_SM->read_str[LEUART_SM->str_length] = LEUART_SM->leuart_read->RXDATA;
+          LEUART_SM->str_length++;
+      }else{
+          (void)LEUART_SM->leuart_read->RXDATA; //drop byte, consumer has fallen behind
+      }
+      add_scheduled_event(LEUART_SM->raw_rx_evt);
       break;
     default:
       EFM_ASSERT(false);
@@ -390,13 +542,106 @@ static void RXDATAV_HANDLER(LEUART_READ_SM *LEUART_SM)
  * @details
  * Used for app.C callback function for RXdata. Allows data to be read outside of private file
  *
+ * @param[in] leuart
+ * Address of the leuart peripheral that received the frame
+ *
  * @param[in] *out_str
  * Input string to return data to, being read from private location.
  *
  ******************************************************************************/
-void received_str(char * out_str)
+void received_str(LEUART_TypeDef *leuart, char * out_str)
 {
-  strcpy(out_str, leuart0_SM_READ.read_str);
+  strcpy(out_str, leuart_ctx_get(leuart)->read.read_str);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Switches the read state machine between framed and raw reception.
+ * @details
+ * Raw mode disables RX blocking and the STARTF interrupt so that unframed
+ * replies, such as the HM-18 AT command responses, are buffered byte by byte
+ * through RXDATAV. Each byte received schedules rx_evt. Disabling raw mode
+ * re-enables RX blocking and returns the state machine to STARTFRAME.
+ * @note
+ * A frame being received when raw mode is entered is dropped, the phone can send one at
+ * any time. Its remaining bytes end up in the raw buffer, the reader has to expect them.
+ *
+ * @param[in] leuart
+ * Address of leuart peripheral whose reception mode is changed
+ *
+ * @param[in] enable
+ * true to enter raw reception, false to return to framed reception
+ *
+ * @param[in] rx_evt
+ * Event scheduled for every byte received while in raw mode
+ ******************************************************************************/
+void leuart_raw_rx(LEUART_TypeDef *leuart, bool enable, uint32_t rx_evt)
+{
+  LEUART_READ_SM *read_sm = &leuart_ctx_get(leuart)->read;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  if(enable){
+      // STARTFRAME or RXDATAV, a partial frame goes with the clear below and SIGF disabled
+      EFM_ASSERT(read_sm->current_read_state != RAW_RX);
+      read_sm->raw_rx_evt = rx_evt;
+      read_sm->str_length = 0;
+      read_sm->current_read_state = RAW_RX;
+
+      leuart->IEN &= ~(LEUART_IEN_STARTF | LEUART_IEN_SIGF);
+      leuart->CMD = LEUART_CMD_CLEARRX | LEUART_CMD_RXBLOCKDIS;
+      leuart->IFC = LEUART_IF_RXDATAV | LEUART_IF_STARTF | LEUART_IF_SIGF;
+      leuart->IEN |= LEUART_IEN_RXDATAV;
+  }else{
+      EFM_ASSERT(read_sm->current_read_state == RAW_RX);
+      leuart->IEN &= ~LEUART_IEN_RXDATAV;
+      leuart->CMD = LEUART_CMD_RXBLOCKEN | LEUART_CMD_CLEARRX;
+      leuart->IFC = LEUART_IF_STARTF | LEUART_IF_SIGF;
+      leuart->IEN |= LEUART_IEN_STARTF;
+
+      read_sm->str_length = 0;
+      read_sm->current_read_state = STARTFRAME;
+  }
+  CORE_EXIT_CRITICAL();
+  while(leuart->SYNCBUSY);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Drains the bytes buffered while the read state machine is in raw mode.
+ * @details
+ * Copies at most max_len bytes into out_str, then empties the raw buffer.
+ * out_str is not null terminated.
+ *
+ * @param[in] leuart
+ * Address of the leuart peripheral in raw mode
+ *
+ * @param[in] out_str
+ * Destination for the received bytes
+ *
+ * @param[in] max_len
+ * Size of out_str
+ *
+ * @return
+ * Number of bytes copied into out_str
+ ******************************************************************************/
+uint32_t leuart_raw_read(LEUART_TypeDef *leuart, char *out_str, uint32_t max_len)
+{
+  LEUART_READ_SM *read_sm = &leuart_ctx_get(leuart)->read;
+  uint32_t length;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  length = read_sm->str_length;
+  if(length > max_len){
+      length = max_len;
+  }
+  memcpy(out_str, read_sm->read_str, length);
+  read_sm->str_length = 0;
+  CORE_EXIT_CRITICAL();
+
+  return length;
 }
 
 
@@ -532,35 +777,37 @@ uint8_t leuart_app_receive_byte(LEUART_TypeDef *leuart){
  * as startframe and sigframe characters, determines if correct interrupts are being raised
  * for read operations..
  *
+ * @param[in] leuart
+ * Address of the leuart peripheral to test, looped back on itself for the test
  ******************************************************************************/
-void leuart_rx_tdd()
+void leuart_rx_tdd(LEUART_TypeDef *leuart)
 {
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
 
-  LEUART0->CTRL |= LEUART_CTRL_LOOPBK;
+  leuart->CTRL |= LEUART_CTRL_LOOPBK;
 
-  while(LEUART0->SYNCBUSY);
-  uint32_t  startframe = LEUART0->STARTFRAME;
-  uint32_t  sigframe = LEUART0 -> SIGFRAME;
+  while(leuart->SYNCBUSY);
+  uint32_t  startframe = leuart->STARTFRAME;
+  uint32_t  sigframe = leuart -> SIGFRAME;
 
-  LEUART0->TXDATA = ~startframe;
+  leuart->TXDATA = ~startframe;
   timer_delay(Tdelay);
 
-  EFM_ASSERT(!(LEUART0->IF & LEUART_IF_RXDATAV));
-  LEUART0->TXDATA = startframe;
+  EFM_ASSERT(!(leuart->IF & LEUART_IF_RXDATAV));
+  leuart->TXDATA = startframe;
   timer_delay(Tdelay);
 
-  EFM_ASSERT(LEUART0->IF & LEUART_IF_RXDATAV);
-  EFM_ASSERT(startframe == LEUART0->RXDATA);
-  LEUART0->TXDATA = sigframe;
+  EFM_ASSERT(leuart->IF & LEUART_IF_RXDATAV);
+  EFM_ASSERT(startframe == leuart->RXDATA);
+  leuart->TXDATA = sigframe;
   timer_delay(Tdelay);
-  EFM_ASSERT(LEUART0->IF & LEUART_IF_SIGF);
-  EFM_ASSERT(sigframe == LEUART0->RXDATA);
+  EFM_ASSERT(leuart->IF & LEUART_IF_SIGF);
+  EFM_ASSERT(sigframe == leuart->RXDATA);
 
-  LEUART0->CMD |= LEUART_CMD_RXBLOCKEN;
-  LEUART0->IFC |= LEUART_IF_STARTF | LEUART_IF_SIGF;
-  while(LEUART0->SYNCBUSY);
+  leuart->CMD |= LEUART_CMD_RXBLOCKEN;
+  leuart->IFC |= LEUART_IF_STARTF | LEUART_IF_SIGF;
+  while(leuart->SYNCBUSY);
 
   CORE_EXIT_CRITICAL();
 
@@ -572,31 +819,31 @@ void leuart_rx_tdd()
   strcat(tx_str, "abc");
 
   uint32_t str_length = strlen(tx_str);
-  tx_str[str_length] = LEUART0->STARTFRAME;
+  tx_str[str_length] = leuart->STARTFRAME;
   tx_str[str_length+1] = 0;
   strcat(tx_str,test_str);
   str_length = strlen(tx_str);
-  tx_str[str_length] = LEUART0->SIGFRAME;
+  tx_str[str_length] = leuart->SIGFRAME;
   tx_str[str_length+1] = 0;
   strcat(tx_str, "def");
-  expected_result[0] = LEUART0->STARTFRAME;
+  expected_result[0] = leuart->STARTFRAME;
   expected_result[1] = 0;
   strcat(expected_result, test_str);
   str_length = strlen(expected_result);
 
 
-  expected_result[str_length] = LEUART0->SIGFRAME;
+  expected_result[str_length] = leuart->SIGFRAME;
   expected_result[str_length+1] = 0;
-  leuart_start(LEUART0, tx_str, strlen(tx_str), NULL_CB);
+  leuart_start(leuart, tx_str, strlen(tx_str), NULL_CB);
 
-  while(leuart_tx_busy());
+  while(leuart_tx_busy(leuart));
   timer_delay(TdelayLong);
 
   char final_str[20];
-  strcpy(final_str, leuart0_SM_READ.read_str);
+  received_str(leuart, final_str);
 
   EFM_ASSERT(!strcmp(final_str, expected_result));
-  EFM_ASSERT(LEUART0->STATUS & LEUART_STATUS_RXENS);
+  EFM_ASSERT(leuart->STATUS & LEUART_STATUS_RXENS);
 
-  LEUART0->CTRL &= ~LEUART_CTRL_LOOPBK;
+  leuart->CTRL &= ~LEUART_CTRL_LOOPBK;
 }
@@ -0,0 +1,278 @@
+/**
+ * @file log.c
+ * @brief Deferred binary logging
+ *Responsible for the record ring behind the LOG_ macros and for draining it over BLE, tools/logfmt.py formats the records.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "log.h"
+#include "ble.h"
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+extern const char __start_logstr[];   // made by the linker for the "logstr" section
+
+static uint8_t log_ring[LOG_RING_BYTES];
+static uint32_t log_head;             // bytes ever written, the index is head % LOG_RING_BYTES
+static uint32_t log_tail;             // bytes ever drained
+static uint32_t log_last_tick;        // tick of the newest record, records store the difference
+static uint32_t log_tail_tick;        // tick of the last record drained
+static uint32_t log_drops;
+static uint32_t log_drops_sent;
+static bool log_pending;              // drain_evt scheduled or a frame on its way
+static uint32_t log_drain_evt;
+static uint32_t log_room_evt;         // scheduled once the next frame has left the ring
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void log_ring_put(const uint8_t *data, uint32_t len);
+static uint8_t log_ring_at(uint32_t pos);
+
+/***************************************************************************//**
+ * @brief
+ * Copies bytes in at the head, the caller has checked there is room.
+ ******************************************************************************/
+static void log_ring_put(const uint8_t *data, uint32_t len){
+  for(uint32_t i = 0; i < len; i++){
+      log_ring[(log_head + i) & (LOG_RING_BYTES - 1)] = data[i];
+  }
+  log_head += len;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the byte at a position of the ring.
+ ******************************************************************************/
+static uint8_t log_ring_at(uint32_t pos){
+  return log_ring[pos & (LOG_RING_BYTES - 1)];
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Starts the logger.
+ *
+ * @details
+ * Records made before this are kept and go out with the first drain.
+ *
+ * @param[in] drain_evt
+ * Event whose handler calls log_drain_cb(), scheduled when records are waiting
+ ******************************************************************************/
+void log_open(uint32_t drain_evt){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  log_drain_evt = drain_evt;
+  if((log_head != log_tail) && !log_pending){
+      log_pending = true;
+      add_scheduled_event(log_drain_evt);
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts a record for a log site, called by LOG_EMIT.
+ ******************************************************************************/
+void log_begin(LOG_REC *rec, const char *fmt){
+  rec->id = (uint16_t)(fmt - __start_logstr);
+  rec->len = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds an integer argument of up to 32 bits, little endian.
+ ******************************************************************************/
+void log_put_u32(LOG_REC *rec, uint32_t value){
+  if(rec->len + sizeof(value) > LOG_REC_MAX) return;
+  memcpy(&rec->args[rec->len], &value, sizeof(value));
+  rec->len += sizeof(value);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds a 64 bit integer argument, little endian.
+ ******************************************************************************/
+void log_put_u64(LOG_REC *rec, uint64_t value){
+  if(rec->len + sizeof(value) > LOG_REC_MAX) return;
+  memcpy(&rec->args[rec->len], &value, sizeof(value));
+  rec->len += sizeof(value);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds a floating point argument as an IEEE single.
+ ******************************************************************************/
+void log_put_f32(LOG_REC *rec, float value){
+  if(rec->len + sizeof(value) > LOG_REC_MAX) return;
+  memcpy(&rec->args[rec->len], &value, sizeof(value));
+  rec->len += sizeof(value);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds a string argument as a length byte and up to LOG_STR_MAX characters.
+ ******************************************************************************/
+void log_put_str(LOG_REC *rec, const char *str){
+  uint32_t n = 0;
+
+  while(str[n] && (n < LOG_STR_MAX)) n++;
+  if(rec->len + 1 + n > LOG_REC_MAX) return;
+  rec->args[rec->len] = (uint8_t)n;
+  memcpy(&rec->args[rec->len + 1], str, n);
+  rec->len += 1 + n;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Puts a finished record in the ring, safe from any interrupt level.
+ *
+ * @details
+ * Ring layout of a record: length of the rest, format id, sleeptimer ticks since the
+ * previous record as a varint and the arguments. The tick is taken inside the critical
+ * section so the differences follow ring order. A record that does not fit is dropped
+ * and counted, the next frame reports the count.
+ ******************************************************************************/
+void log_commit(LOG_REC *rec){
+  uint8_t hdr[LOG_REC_HDR + LOG_TICK_MAX];
+  uint32_t hdr_len = LOG_REC_HDR;
+  uint32_t tick, delta;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  tick = sl_sleeptimer_get_tick_count();
+  delta = tick - log_last_tick;
+  do{
+      hdr[hdr_len++] = (uint8_t)((delta & 0x7F) | ((delta > 0x7F) ? 0x80 : 0));
+      delta >>= 7;
+  }while(delta);
+
+  if((log_head - log_tail) + hdr_len + rec->len > LOG_RING_BYTES){
+      log_drops++;
+  }else{
+      hdr[0] = (uint8_t)(hdr_len - 1 + rec->len);
+      hdr[1] = (uint8_t)(rec->id & 0xFF);
+      hdr[2] = (uint8_t)(rec->id >> 8);
+      log_ring_put(hdr, hdr_len);
+      log_ring_put(rec->args, rec->len);
+      log_last_tick = tick;
+      if(!log_pending && log_drain_evt){
+          log_pending = true;
+          add_scheduled_event(log_drain_evt);
+      }
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the number of records dropped on a full ring since boot.
+ ******************************************************************************/
+uint32_t log_dropped(void){
+  return log_drops;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the free bytes of the ring, a record takes at most LOG_REC_ROOM.
+ ******************************************************************************/
+uint32_t log_room(void){
+  uint32_t room;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  room = LOG_RING_BYTES - (log_head - log_tail);
+  CORE_EXIT_CRITICAL();
+  return room;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Schedules an event once, after the next drain has made room in the ring.
+ *
+ * @details
+ * For a burst of records larger than the ring, such as a report logging a record per
+ * channel: the producer logs while log_room() allows and continues from this event.
+ *
+ * @param[in] room_evt
+ * Event to schedule, it replaces one not yet scheduled
+ ******************************************************************************/
+void log_room_event(uint32_t room_evt){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  log_room_evt = room_evt;
+  if(!log_pending){
+      // nothing left to drain, the ring is as empty as it gets
+      add_scheduled_event(log_room_evt);
+      log_room_evt = 0;
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends the next frame of records, the handler of the drain event.
+ *
+ * @details
+ * A frame is 'G', the number of record bytes, the records dropped since the last frame
+ * (saturated at 255), the absolute tick of the record before the first in the frame, little
+ * endian, then whole records. The base tick lets the host keep time across a lost frame.
+ * The event chains itself through the frame's done event until the ring is empty.
+ ******************************************************************************/
+void log_drain_cb(void){
+  uint8_t frame[LOG_FRAME_HDR + LOG_FRAME_MAX];
+  uint32_t base = log_tail_tick;
+  uint32_t drops;
+  uint32_t room_evt;
+  uint32_t n = 0;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  while(log_tail + n != log_head){
+      uint32_t rec_len = 1 + log_ring_at(log_tail + n);
+      uint32_t delta = 0;
+
+      if(n + rec_len > LOG_FRAME_MAX) break;
+      for(uint32_t i = 0; i < rec_len; i++){
+          frame[LOG_FRAME_HDR + n + i] = log_ring_at(log_tail + n + i);
+      }
+      for(uint32_t i = 0; i < LOG_TICK_MAX; i++){
+          uint8_t b = frame[LOG_FRAME_HDR + n + LOG_REC_HDR + i];
+          delta |= (uint32_t)(b & 0x7F) << (7 * i);
+          if(!(b & 0x80)) break;
+      }
+      log_tail_tick += delta;
+      n += rec_len;
+  }
+  log_tail += n;
+  if(n == 0){
+      log_pending = false;
+  }
+  drops = log_drops - log_drops_sent;
+  if(n) log_drops_sent = log_drops;
+  room_evt = log_room_evt;
+  log_room_evt = 0;
+  CORE_EXIT_CRITICAL();
+
+  if(room_evt) add_scheduled_event(room_evt);
+  if(n == 0) return;
+
+  frame[0] = 'G';
+  frame[1] = (uint8_t)n;
+  frame[2] = (uint8_t)((drops > 0xFF) ? 0xFF : drops);
+  memcpy(&frame[3], &base, sizeof(base));
+  ble_write_bytes(frame, LOG_FRAME_HDR + n, log_drain_evt);
+}
@@ -0,0 +1,300 @@
+/**
+ * @file profiler.c
+ * @brief Energy mode residency and ISR duration profiler
+ *Responsible for aggregating sleep and interrupt durations into fixed size log2 histograms.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <string.h>
+
+#include "profiler.h"
+
+#ifdef PROF_HOST
+#define CORE_DECLARE_IRQ_STATE
+#define CORE_ENTER_CRITICAL()
+#define CORE_EXIT_CRITICAL()
+#define EFM_ASSERT(x) ((void)(x))
+#else
+#include "em_assert.h"
+#endif
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#ifdef PROF_HOST
+uint32_t prof_host_cycles;
+uint32_t prof_host_ticks;
+#endif
+volatile uint32_t prof_excluded;
+
+static PROF_HIST prof_hists[PROF_CHANNELS];
+
+static const uint32_t prof_baseline[PROF_CHANNELS] = PROF_BASELINE;
+
+static const char *const prof_names[PROF_CHANNELS] = {
+  "EM1",
+  "EM2",
+  "EM3",
+  "LEUART0",
+  "LEUART1",
+  "I2C0",
+  "I2C1",
+  "LETIMER0",
+  "TXBL",
+  "RXDATAV",
+  "I2CACK",
+  "I2CRX",
+  "SCHED"
+};
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint32_t prof_hist_median(const PROF_HIST *hist);
+
+/***************************************************************************//**
+ * @brief
+ *Estimates the median of a histogram.
+ *
+ * @details
+ *Finds the bin holding the middle sample and interpolates linearly across it. The result
+ *is clamped to the exact min and max. Saturated bins make the estimate coarser.
+ ******************************************************************************/
+static uint32_t prof_hist_median(const PROF_HIST *hist) {
+  uint32_t total = 0, target, seen = 0;
+  uint32_t low, median = 0;
+
+  for (int i = 0; i < PROF_BINS; i++) {
+    total += hist->bins[i];
+  }
+  if (total == 0) return 0;
+  target = (total + 1) / 2;
+
+  for (int i = 0; i < PROF_BINS; i++) {
+    if (seen + hist->bins[i] >= target) {
+      low = i ? (1UL << (i - 1)) : 0;
+      median = low + (uint32_t)(((uint64_t)low * (target - seen - 1)) / hist->bins[i]);
+      break;
+    }
+    seen += hist->bins[i];
+  }
+  if (median < hist->min) median = hist->min;
+  if (median > hist->max) median = hist->max;
+  return median;
+}
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *Starts the DWT cycle counter and clears all histograms.
+ *
+ * @details
+ *Trace must be enabled in the debug block for the DWT to count. The counter wraps every
+ *2^32 cycles, which is far longer than any ISR.
+ *
+ ******************************************************************************/
+void prof_open(void) {
+#ifndef PROF_HOST
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  prof_reset();
+}
+
+/***************************************************************************//**
+ * @brief
+ *Clears all histograms.
+ ******************************************************************************/
+void prof_reset(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  memset(prof_hists, 0, sizeof(prof_hists));
+  for (int i = 0; i < PROF_CHANNELS; i++) {
+    prof_hists[i].min = UINT32_MAX;
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *Adds one duration to a channel's histogram.
+ *
+ * @details
+ *The bin is the bit length of the duration, so bin 0 holds zero length events and bin n
+ *holds durations from 2^(n-1) to 2^n - 1. Bin counts saturate instead of wrapping.
+ *
+ * @note
+ *Safe to call from interrupt context.
+ *
+ * @param[in] channel
+ *Histogram to update.
+ *
+ * @param[in] duration
+ *Duration in the channel's unit, cycles for ISRs and sleeptimer ticks for sleeps.
+ ******************************************************************************/
+void prof_record(PROF_CHANNEL channel, uint32_t duration) {
+  uint32_t bin = duration ? (32 - __builtin_clz(duration)) : 0;
+  PROF_HIST *hist = &prof_hists[channel];
+
+  if (bin >= PROF_BINS) {
+    bin = PROF_BINS - 1;
+  }
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if (hist->bins[bin] != UINT16_MAX) {
+    hist->bins[bin]++;
+  }
+  hist->count++;
+  hist->total += duration;
+  if (duration > hist->max) {
+    hist->max = duration;
+  }
+  if (duration < hist->min) {
+    hist->min = duration;
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *Adds one duration to a channel and leaves it out of the measurement around it.
+ *
+ * @details
+ *The duration is added to prof_excluded in the same critical section, so the ISR or path
+ *that this one ran inside sees its clock stand still for it. Durations are taken on
+ *PROF_OWN_CYCLES(), so a span excluded inside this one is not excluded twice.
+ *
+ * @note
+ *Safe to call from interrupt context.
+ ******************************************************************************/
+void prof_record_excluded(PROF_CHANNEL channel, uint32_t duration) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  prof_record(channel, duration);
+  prof_excluded += duration;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns the histogram of a channel.
+ ******************************************************************************/
+const PROF_HIST *prof_hist(PROF_CHANNEL channel) {
+  EFM_ASSERT(channel < PROF_CHANNELS);
+  return &prof_hists[channel];
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns a printable name for a channel.
+ ******************************************************************************/
+const char *prof_channel_name(PROF_CHANNEL channel) {
+  EFM_ASSERT(channel < PROF_CHANNELS);
+  return prof_names[channel];
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns the estimated median duration of a channel, 0 when it has no samples.
+ ******************************************************************************/
+uint32_t prof_median(PROF_CHANNEL channel) {
+  PROF_HIST hist;
+
+  EFM_ASSERT(channel < PROF_CHANNELS);
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  hist = prof_hists[channel];
+  CORE_EXIT_CRITICAL();
+  return prof_hist_median(&hist);
+}
+
+/***************************************************************************//**
+ * @brief
+ *Compares a channel's median against the stored baseline.
+ *
+ * @return
+ *true if the channel has a baseline and samples, and its median exceeds the baseline by
+ *more than PROF_REGRESS_PCT percent.
+ ******************************************************************************/
+bool prof_regressed(PROF_CHANNEL channel) {
+  uint32_t baseline;
+
+  EFM_ASSERT(channel < PROF_CHANNELS);
+  baseline = prof_baseline[channel];
+  if (baseline == 0) return false;
+  return (uint64_t)prof_median(channel) * 100 > (uint64_t)baseline * (100 + PROF_REGRESS_PCT);
+}
+
+/***************************************************************************//**
+ * @brief
+ *Formats a channel's histogram as a single line for the BLE link.
+ *
+ * @details
+ *The line is "<name> n:<count> min:<min> med:<median> max:<max> @<first>:<c>,<c>,..." where
+ *the counts run from the first to the last non empty bin and @first is the bin index of the
+ *first count. A trailing " REG" marks a regression against the stored baseline.
+ *
+ * @param[in] channel
+ *Histogram to format.
+ *
+ * @param[in] out_str
+ *Destination string.
+ *
+ * @param[in] max_len
+ *Size of out_str.
+ *
+ * @return
+ *false if the line had to be truncated to fit max_len.
+ ******************************************************************************/
+bool prof_format(PROF_CHANNEL channel, char *out_str, uint32_t max_len) {
+  PROF_HIST hist;
+  int first = -1, last = -1;
+  int length;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  hist = prof_hists[channel];
+  CORE_EXIT_CRITICAL();
+
+  for (int i = 0; i < PROF_BINS; i++) {
+    if (hist.bins[i]) {
+      if (first < 0) first = i;
+      last = i;
+    }
+  }
+
+  length = snprintf(out_str, max_len, "%s n:%lu min:%lu med:%lu max:%lu", prof_names[channel],
+                    (unsigned long)hist.count, (unsigned long)(hist.count ? hist.min : 0),
+                    (unsigned long)prof_hist_median(&hist), (unsigned long)hist.max);
+  for (int i = first; (i >= 0) && (i <= last); i++) {
+    if (length >= (int)max_len) break;
+    if (i == first) {
+      length += snprintf(&out_str[length], max_len - length, " @%d:%u", i, hist.bins[i]);
+    } else {
+      length += snprintf(&out_str[length], max_len - length, ",%u", hist.bins[i]);
+    }
+  }
+  if (prof_regressed(channel) && (length < (int)max_len)) {
+    length += snprintf(&out_str[length], max_len - length, " REG");
+  }
+  if (length < (int)max_len - 1) {
+    out_str[length++] = '\n';
+    out_str[length] = 0;
+    return true;
+  }
+  return false;
+}
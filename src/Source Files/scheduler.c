@@ -16,6 +16,12 @@
 //*******************
 
 static unsigned int event_scheduled;
+
+#define EVENT_HANDLER(event, handler) handler,
+static void (* const event_handlers[SCHEDULER_EVENT_COUNT])(void) = {
+  SCHEDULER_EVENT_LIST(EVENT_HANDLER)
+};
+#undef EVENT_HANDLER
 /***************************************************************************//**
  * @brief
  * scheduler_open() is used to set initial event_scheduled state.
@@ -48,10 +54,17 @@ void scheduler_open(void) {
  * event is a uint32_t type input. This is OR'd with event_scheduled
  ******************************************************************************/
 void add_scheduled_event(uint32_t event) {
+  uint32_t path_start = PROF_PATH_ENTER();
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
   event_scheduled |= event;
   CORE_EXIT_CRITICAL();
+  if(TRACE_ON(TRACE_CAT_EVENT)){
+      for(uint32_t bits = event; bits; bits &= bits - 1){
+          TRACE_EVT_POST(__builtin_ctz(bits));
+      }
+  }
+  PROF_PATH_EXIT_EXCLUDED(PROF_PATH_SCHED_ADD, path_start);
   return;
 }
 /***************************************************************************//**
@@ -90,3 +103,38 @@ void remove_scheduled_event(uint32_t event) {
 uint32_t get_scheduled_events(void) {
   return event_scheduled; //return state of private variable
 }
+/***************************************************************************//**
+ * @brief
+ *Runs the handler of the highest priority pending event.
+ *
+ * @details
+ *The event is removed before its handler runs, so the handler may schedule it again.
+ *Priority is the order of SCHEDULER_EVENT_LIST, which is also the bit order, so the lowest
+ *set bit is the event to run and its bit number indexes the handler table built from the
+ *same list. One event is handled per call so an event raised meanwhile by an ISR with a
+ *higher priority goes next.
+ *
+ * @note
+ *Called from the main loop after it wakes up, does nothing when no event is pending.
+ ******************************************************************************/
+void scheduler_dispatch(void) {
+  uint32_t events = event_scheduled;
+  uint32_t id;
+  uint32_t trace_start;
+
+  if(!events) return;
+  id = __builtin_ctz(events);
+  EFM_ASSERT(id < SCHEDULER_EVENT_COUNT);
+  remove_scheduled_event(1UL << id);
+  TRACE_EVT_RUN(id);
+  trace_start = TRACE_CYCLES();
+  event_handlers[id]();
+  TRACE_EVT_DONE(id, trace_start);
+}
+/***************************************************************************//**
+ * @brief
+ *Handler for events that only wake the main loop, such as the end of a ble_write().
+ ******************************************************************************/
+void scheduler_discard(void) {
+  return;
+}
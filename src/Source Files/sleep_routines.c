@@ -4,6 +4,8 @@
  * @date 10/17/2021
  * @brief sleep routines
  *Responsible for handling sleep routines, sleep routine blocking, unblocking, and setup.
+ *Blocks are held per client so that an unmatched unblock is caught, and the time spent in each
+ *energy mode as well as the time each client kept the chip out of a deeper mode is accounted.
  */
 
 /**************************************************************************
@@ -45,50 +47,128 @@
 
 //private variables
 static int lowest_energy_mode[MAX_ENERGY_MODES];
+static SLEEP_CLIENT_STATS sleep_clients[SLEEP_CLIENT_COUNT];
+static uint64_t em_ticks[MAX_ENERGY_MODES];
+static uint32_t last_wake_tick;
+static SLEEP_DEADLINE_FN sleep_deadlines[SLEEP_CLIENT_COUNT];
+
+/* Default costs for this board at 3.3 V on DCDC with the core at CMU_HFRCO_LOW, datasheet
+ * typicals for the powers. The EM2 and EM3 wake up includes raising the EM23 voltage back
+ * to the EM01 level, and their switch energy covers the DCDC moving between its low noise
+ * and low power modes. With these EM2 only beats EM1 for deadlines over about 127 us:
+ *   EM1  700 * (d - 2) + 1600 * 2            = 700 d + 1800 pJ
+ *   EM2  8 * (d - 31) + 1600 * 31 + 40000    = 8 d + 89352 pJ
+ * EM0 is never selected as a sleep mode, its entry only keeps the table indexed by EM. */
+static const SLEEP_EM_COST sleep_default_costs[MAX_ENERGY_MODES] = {
+  { SLEEP_ACTIVE_UW,  0,  0 },    // EM0
+  { 700,              2,  0 },    // EM1, core clock gated
+  { 8,                31, 40 },   // EM2, LFXO and RTCC running
+  { 7,                31, 40 },   // EM3, ULFRCO only
+  { 0,                UINT32_MAX, 0 }  // EM4, not used by enter_sleep()
+};
+static const SLEEP_EM_COST *sleep_costs = sleep_default_costs;
+
+static const char *const sleep_client_names[SLEEP_CLIENT_COUNT] = {
+  "APP",
+  "LETIMER",
+  "LEUART_TX",
+  "I2C0",
+  "I2C1",
+  "RGB",
+  "CMU"
+};
+
+//private functions
+static void sleep_account(uint32_t EM, uint32_t sleep_tick, uint32_t wake_tick);
 
 /***************************************************************************//**
  * @brief
- *Enters sleep energy mode - dependent on the first non-zero array element stored in lowest_energy_mode[]
+ *Adds a completed sleep period to the residency and client hold counters.
  *
  * @details
- *Will decrease energy mode to sleep, depending on current mode. No changes if already in sleep mode.
+ *Time since the previous wake up is counted as EM0, the sleep itself against EM. When the sleep
+ *was shallower than EM3, every client holding a block on the next deeper mode is charged for it,
+ *those are the clients that kept the chip out of that mode.
  *
  * @note
- *Atomic operations occur if energy mode is not currently in sleep mode.
+ *Called with interrupts disabled from enter_sleep().
  *
+ * @param[in] EM
+ *Energy mode that was entered.
+ *
+ * @param[in] sleep_tick
+ *Sleeptimer tick count right before entering EM.
+ *
+ * @param[in] wake_tick
+ *Sleeptimer tick count right after waking up.
  ******************************************************************************/
-void enter_sleep(void) {
-  if (lowest_energy_mode[EM0] > 0) {
-    return;
-  }
+static void sleep_account(uint32_t EM, uint32_t sleep_tick, uint32_t wake_tick) {
+  uint32_t slept = wake_tick - sleep_tick;
 
-  else if(lowest_energy_mode[EM1] > 0) {
-    return;
-  }
+  em_ticks[EM0] += sleep_tick - last_wake_tick;
+  em_ticks[EM] += slept;
+  last_wake_tick = wake_tick;
 
-  else if (lowest_energy_mode[EM2] > 0) {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    EMU_EnterEM1();
-    CORE_EXIT_CRITICAL();
-    return;
+  if (EM < EM3) {
+    for (int i = 0; i < SLEEP_CLIENT_COUNT; i++) {
+      if (sleep_clients[i].blocks[EM + 1] > 0) {
+        sleep_clients[i].hold_ticks += slept;
+      }
+    }
   }
+}
+
+/***************************************************************************//**
+ * @brief
+ *Enters the deepest energy mode allowed by the blocks currently held, at most EM3.
+ *
+ * @details
+ *Stays in EM0 if EM0 or EM1 is blocked. With SLEEP_PREDICTIVE a shallower mode is used when the
+ *next known deadline is too close for the deeper mode's wake up cost to pay off. The time asleep
+ *is measured with the sleeptimer tick count and accounted per energy mode and per blocking client.
+ *
+ * @note
+ *Atomic operations occur while entering the energy mode, interrupts are serviced after waking.
+ *
+ ******************************************************************************/
+void enter_sleep(void) {
+  uint32_t blocked = current_block_energy_mode();
+  uint32_t EM;
+  uint32_t sleep_tick, wake_tick;
 
-  else if (lowest_energy_mode[EM3] > 0) {\
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    EMU_EnterEM2(true);
-    CORE_EXIT_CRITICAL();
+  if (blocked <= EM1) {
     return;
   }
+  EM = blocked - 1;
+  if (EM > EM3) {
+    EM = EM3;
+  }
+#ifdef SLEEP_PREDICTIVE
+  EM = sleep_select_mode(EM, sleep_next_deadline_us());
+#endif
 
-  else {
-    CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    EMU_EnterEM3(true);
-    CORE_EXIT_CRITICAL();
-    return;
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  sleep_tick = sl_sleeptimer_get_tick_count();
+  TRACE_SLEEP(TRACE_T_SLEEP_ENTER, EM);
+  switch (EM) {
+    case EM1:
+      EMU_EnterEM1();
+      break;
+    case EM2:
+      EMU_EnterEM2(true);
+      break;
+    default:
+      EMU_EnterEM3(true);
+      break;
   }
+  wake_tick = sl_sleeptimer_get_tick_count();
+  TRACE_SLEEP(TRACE_T_SLEEP_EXIT, EM);
+  sleep_account(EM, sleep_tick, wake_tick);
+#ifdef PROF_ENABLE
+  prof_record(PROF_SLEEP_EM1 + (EM - EM1), wake_tick - sleep_tick);
+#endif
+  CORE_EXIT_CRITICAL();
 }
 
 /***************************************************************************//**
@@ -116,48 +196,69 @@ uint32_t current_block_energy_mode(void) {
 }
 /***************************************************************************//**
  * @brief
- *Releases processor from sleep mode.
+ *Releases a block on an energy mode held by client.
  *
  * @details
- *The energy mode specified by EM will change the energy state to be no longer active.
+ *Decrements the client's block count on EM and the total for EM. An unblock without a matching
+ *block from the same client is an underflow: it is counted against the client and ignored, so one
+ *module can no longer cancel a block held by another.
  *
  * @note
- *Decrements lowest_energy_mode[EM] by 1. An assert is also used for verification.
+ *An assert is also used for verification of underflows.
+ *
+ * @param[in] client
+ *Client releasing the block.
  *
  * @param[in] EM
  *input of 0 to 4, determines state not to unblock.
  ******************************************************************************/
-void sleep_unblock_mode(uint32_t EM) {
+void sleep_unblock_mode(SLEEP_CLIENT client, uint32_t EM) {
+  bool underflow = false;
+
+  EFM_ASSERT((client < SLEEP_CLIENT_COUNT) && (EM < MAX_ENERGY_MODES));
+
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
 
-  lowest_energy_mode[EM] = lowest_energy_mode[EM] -1 ;
+  if (sleep_clients[client].blocks[EM] == 0) {
+    sleep_clients[client].underflows++;
+    underflow = true;
+  } else {
+    sleep_clients[client].blocks[EM]--;
+    lowest_energy_mode[EM] = lowest_energy_mode[EM] - 1;
+  }
 
   CORE_EXIT_CRITICAL();
-  EFM_ASSERT(lowest_energy_mode[EM] >= 0);
+  EFM_ASSERT(!underflow);
   return;
 }
 /***************************************************************************//**
  * @brief
- *Prevents gecko from going into an energy state, specified by EM
+ *Prevents gecko from going into an energy state, specified by EM, on behalf of client.
  *
  * @details
- *Incrents lowest_energy_mode[EM] by 1.
+ *Increments the client's block count on EM and the total for EM.
  *
  * @note
  *Atomic operation occurs here, and an assert also exists. Beware of this if issues are found.
  *
+ * @param[in] client
+ *Client holding the block.
+ *
  * @param[in] EM
  *input of energy mode to block.
  ******************************************************************************/
-void sleep_block_mode(uint32_t EM) {
+void sleep_block_mode(SLEEP_CLIENT client, uint32_t EM) {
+  EFM_ASSERT((client < SLEEP_CLIENT_COUNT) && (EM < MAX_ENERGY_MODES));
+
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
 
+  sleep_clients[client].blocks[EM]++;
   lowest_energy_mode[EM] = lowest_energy_mode[EM] + 1 ;
 
   CORE_EXIT_CRITICAL();
-  EFM_ASSERT(lowest_energy_mode[EM] < 5);
+  EFM_ASSERT(sleep_clients[client].blocks[EM] <= SLEEP_MAX_CLIENT_BLOCKS);
   return;
 }
 
@@ -166,10 +267,11 @@ void sleep_block_mode(uint32_t EM) {
  *Initial setup for energy modes and sleep states
  *
  * @details
- *Sets all elements of lowest_energy_mode[] to 0.
+ *Sets all elements of lowest_energy_mode[] to 0 and clears the client and residency statistics.
  *
  * @note
- *Atomic operations performed when performing initial setup.
+ *Atomic operations performed when performing initial setup. sl_sleeptimer_init() must have
+ *run, EM0 residency is counted from the tick read here.
  *
  ******************************************************************************/
 void sleep_open(void) {
@@ -177,7 +279,152 @@ void sleep_open(void) {
   CORE_ENTER_CRITICAL();
   for (int j=0; j < MAX_ENERGY_MODES; j++) {
       lowest_energy_mode[j] = 0;
+      em_ticks[j] = 0;
   }
+  for (int j=0; j < SLEEP_CLIENT_COUNT; j++) {
+      sleep_clients[j] = (SLEEP_CLIENT_STATS){0};
+      sleep_deadlines[j] = NULL;
+  }
+  last_wake_tick = sl_sleeptimer_get_tick_count();
   CORE_EXIT_CRITICAL();
   return;
 }
+
+/***************************************************************************//**
+ * @brief
+ *Returns the total time spent in an energy mode since sleep_open().
+ *
+ * @param[in] EM
+ *Energy mode to report, EM0 is the time spent awake between sleeps.
+ *
+ * @return
+ *Sleeptimer ticks spent in EM.
+ ******************************************************************************/
+uint64_t sleep_em_ticks(uint32_t EM) {
+  uint64_t ticks;
+
+  EFM_ASSERT(EM < MAX_ENERGY_MODES);
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  ticks = em_ticks[EM];
+  CORE_EXIT_CRITICAL();
+  return ticks;
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns the block, underflow and hold time statistics of a client.
+ *
+ * @note
+ *The statistics keep changing from interrupt context; read them in a critical section when
+ *a consistent snapshot is needed.
+ ******************************************************************************/
+const SLEEP_CLIENT_STATS *sleep_client_stats(SLEEP_CLIENT client) {
+  EFM_ASSERT(client < SLEEP_CLIENT_COUNT);
+  return &sleep_clients[client];
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns a printable name for a client.
+ ******************************************************************************/
+const char *sleep_client_name(SLEEP_CLIENT client) {
+  EFM_ASSERT(client < SLEEP_CLIENT_COUNT);
+  return sleep_client_names[client];
+}
+
+/***************************************************************************//**
+ * @brief
+ *Registers a function reporting when a client expects its next interrupt.
+ *
+ * @details
+ *The function is called from enter_sleep() with interrupts disabled and must only read
+ *registers or state, returning SLEEP_DEADLINE_NONE when the client has nothing scheduled.
+ *
+ * @param[in] client
+ *Client the deadline belongs to.
+ *
+ * @param[in] next_deadline_us
+ *Function returning the time until the client's next interrupt in us, or NULL to remove it.
+ ******************************************************************************/
+void sleep_deadline_register(SLEEP_CLIENT client, SLEEP_DEADLINE_FN next_deadline_us) {
+  EFM_ASSERT(client < SLEEP_CLIENT_COUNT);
+  sleep_deadlines[client] = next_deadline_us;
+}
+
+/***************************************************************************//**
+ * @brief
+ *Replaces the per energy mode cost table used by sleep_select_mode().
+ *
+ * @param[in] costs
+ *Table of MAX_ENERGY_MODES entries indexed by EM, or NULL to restore the defaults.
+ ******************************************************************************/
+void sleep_em_costs_set(const SLEEP_EM_COST *costs) {
+  sleep_costs = costs ? costs : sleep_default_costs;
+}
+
+/***************************************************************************//**
+ * @brief
+ *Returns the earliest deadline reported by the registered clients.
+ *
+ * @return
+ *Time in us until the next known interrupt, SLEEP_DEADLINE_NONE if none is known.
+ ******************************************************************************/
+uint32_t sleep_next_deadline_us(void) {
+  uint32_t deadline = SLEEP_DEADLINE_NONE;
+
+  for (int i = 0; i < SLEEP_CLIENT_COUNT; i++) {
+    if (sleep_deadlines[i]) {
+      uint32_t client_deadline = sleep_deadlines[i]();
+      if (client_deadline < deadline) {
+        deadline = client_deadline;
+      }
+    }
+  }
+  return deadline;
+}
+
+/***************************************************************************//**
+ * @brief
+ *Picks the energy mode that costs the least energy until the next deadline.
+ *
+ * @details
+ *For each mode from EM1 to deepest_EM the energy is the sleep power over the time left after
+ *waking, plus the wake up time at SLEEP_ACTIVE_UW and the switch energy. Modes whose wake up latency is longer than
+ *the deadline are skipped since they would service it late. Without a known deadline the
+ *deepest allowed mode always wins.
+ *
+ * @param[in] deepest_EM
+ *Deepest mode allowed by the blocks, EM1 to EM3.
+ *
+ * @param[in] deadline_us
+ *Time until the next interrupt, SLEEP_DEADLINE_NONE if unknown.
+ *
+ * @return
+ *Energy mode to enter.
+ ******************************************************************************/
+uint32_t sleep_select_mode(uint32_t deepest_EM, uint32_t deadline_us) {
+  uint32_t best_EM = EM1;
+  uint64_t best_pj = UINT64_MAX;
+
+  if (deadline_us == SLEEP_DEADLINE_NONE) {
+    return deepest_EM;
+  }
+
+  for (uint32_t EM = EM1; EM <= deepest_EM; EM++) {
+    const SLEEP_EM_COST *cost = &sleep_costs[EM];
+    uint64_t energy_pj;
+
+    if (cost->wakeup_us > deadline_us) {
+      continue;
+    }
+    energy_pj = (uint64_t)cost->power_uw * (deadline_us - cost->wakeup_us)
+              + (uint64_t)SLEEP_ACTIVE_UW * cost->wakeup_us
+              + (uint64_t)cost->switch_nj * 1000;
+    if (energy_pj <= best_pj) {
+      best_pj = energy_pj;
+      best_EM = EM;
+    }
+  }
+  return best_EM;
+}
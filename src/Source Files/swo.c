@@ -0,0 +1,153 @@
+/**
+ * @file swo.c
+ * @brief ITM and DWT streaming over the SWO pin
+ *Responsible for the SWO setup at boot, PC sampling, DWT event counters and the stimulus ports, tools/swo_profile.py decodes the stream.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "swo.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SWO_ITM_UNLOCK      0xC5ACCE55
+#define SWO_TPI_NRZ         2         // SPPR, asynchronous NRZ, the UART like SWO encoding
+#define SWO_TPI_NO_FORMAT   0x100     // FFCR, continuous mode with the formatter bypassed
+#define SWO_TRACE_BUS_ID    1
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static bool swo_on;
+static uint32_t swo_drops;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Routes SWO to its pin and starts the ITM and DWT streams.
+ *
+ * @details
+ * The TPIU runs from AUXHFRCO, so the baud rate and the ITM timestamps do not move when
+ * cmu.c changes the core clock. Streams sent:
+ *  - periodic PC samples every SWO_PC_POSTPRESET + 1 taps of 1024 cycles, a sleep packet
+ *    instead while the core sleeps in EM1
+ *  - exception entry, exit and return packets for every interrupt
+ *  - DWT event counter wraps for SWO_DWT_EVENTS
+ *  - local timestamps after each packet and a sync packet about every 2^24 cycles
+ *  - the stimulus ports SWO_PORT_TEXT and SWO_PORT_TRACE
+ * All of it comes from hardware except the stimulus ports, so the only cost to the code
+ * being profiled is the odd stall on a busy bus.
+ *
+ * Nothing is started unless a debugger has set C_DEBUGEN, so a board in the field does
+ * not keep AUXHFRCO and the SWO pin running for a stream nobody reads. A debugger
+ * attached after boot needs a reset to get the stream.
+ *
+ * @note
+ * The debug clock stops in EM2 and EM3 unless a debug adapter holds it on, so the stream
+ * pauses there. Sleep time is in the trace records and the profiler.
+ ******************************************************************************/
+void swo_open(void){
+#ifdef SWO_ENABLE
+  if(!(CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk)) return;
+
+  CMU_ClockEnable(cmuClock_GPIO, true);
+  CMU_OscillatorEnable(cmuOsc_AUXHFRCO, true, true);
+
+  GPIO->ROUTELOC0 = (GPIO->ROUTELOC0 & ~_GPIO_ROUTELOC0_SWVLOC_MASK) | SWO_ROUTE;
+  GPIO->ROUTEPEN |= GPIO_ROUTEPEN_SWVPEN;
+  GPIO_PinModeSet(SWO_PORT, SWO_PIN, gpioModePushPull, 0);
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  ITM->LAR = SWO_ITM_UNLOCK;
+  ITM->TCR = 0;
+  ITM->TER = 0;
+
+  TPI->SPPR = SWO_TPI_NRZ;
+  TPI->ACPR = SWO_ACPR;
+  TPI->FFCR = SWO_TPI_NO_FORMAT;
+
+  // CYCCNTENA stays on, the profiler and the trace hooks count cycles with it
+  DWT->CPICNT = 0;
+  DWT->EXCCNT = 0;
+  DWT->SLEEPCNT = 0;
+  DWT->LSUCNT = 0;
+  DWT->FOLDCNT = 0;
+  DWT->CTRL = DWT_CTRL_CYCCNTENA_Msk
+              | (SWO_PC_POSTPRESET << DWT_CTRL_POSTPRESET_Pos)
+              | (SWO_PC_POSTPRESET << DWT_CTRL_POSTINIT_Pos)
+              | DWT_CTRL_CYCTAP_Msk
+              | (1UL << DWT_CTRL_SYNCTAP_Pos)
+              | DWT_CTRL_PCSAMPLENA_Msk
+              | DWT_CTRL_EXCTRCENA_Msk
+              | SWO_DWT_EVENTS;
+
+  ITM->TCR = (SWO_TRACE_BUS_ID << ITM_TCR_TraceBusID_Pos) | ITM_TCR_SWOENA_Msk | ITM_TCR_DWTENA_Msk
+             | ITM_TCR_SYNCENA_Msk | ITM_TCR_TSENA_Msk | ITM_TCR_ITMENA_Msk;
+  ITM->TER = (1UL << SWO_PORT_TEXT) | (1UL << SWO_PORT_TRACE);
+  swo_on = true;
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether swo_open() started the stream.
+ ******************************************************************************/
+bool swo_enabled(void){
+  return swo_on;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Writes one word to a stimulus port without waiting, safe from any interrupt level.
+ *
+ * @details
+ * A word that finds the port FIFO full is dropped and counted rather than stalling an ISR
+ * for the 60 us a packet takes at SWO_ACPR. One word is one ITM packet, so a write that
+ * races another from a higher priority ISR can be dropped but never mixed with it.
+ *
+ * @return
+ * false if the word was dropped
+ ******************************************************************************/
+bool swo_put(uint32_t port, uint32_t word){
+  if(!swo_on) return false;
+  if(ITM->PORT[port].u32 == 0){
+      swo_drops++;      // not atomic, a lost count under contention is harmless
+      return false;
+  }
+  ITM->PORT[port].u32 = word;
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends a text line on SWO_PORT_TEXT, waiting for the port between bytes.
+ *
+ * @note
+ * For diagnostics from the main loop that should not take up the BLE link. Not for ISRs,
+ * a line holds the core for about 25 us per character.
+ ******************************************************************************/
+void swo_puts(const char *str){
+  if(!swo_on) return;
+  while(*str){
+      while(ITM->PORT[SWO_PORT_TEXT].u32 == 0);
+      ITM->PORT[SWO_PORT_TEXT].u8 = (uint8_t)*str++;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the number of stimulus words dropped on a full FIFO since boot.
+ ******************************************************************************/
+uint32_t swo_dropped(void){
+  return swo_drops;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file task.c
+ * @brief Cooperative task support for the event scheduler
+ *Responsible for starting tasks and waking them after AWAIT_TIMEOUT.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "task.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static TASK *task_sleeping[TASK_SLEEPERS];
+static sl_sleeptimer_timer_handle_t task_timer;     // one timer serves every sleeping task
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void task_timer_arm(void);
+static void task_timer_expired(sl_sleeptimer_timer_handle_t *handle, void *data);
+
+/***************************************************************************//**
+ * @brief
+ * Points the task timer at the earliest wake tick, called inside a critical section.
+ ******************************************************************************/
+static void task_timer_arm(void){
+  uint32_t now = sl_sleeptimer_get_tick_count();
+  uint32_t ticks = UINT32_MAX;
+
+  for(int i = 0; i < TASK_SLEEPERS; i++){
+      if(task_sleeping[i]){
+          int32_t left = (int32_t)(task_sleeping[i]->wake_tick - now);
+          if(left < 1) left = 1;
+          if((uint32_t)left < ticks) ticks = (uint32_t)left;
+      }
+  }
+
+  sl_sleeptimer_stop_timer(&task_timer);
+  if(ticks != UINT32_MAX){
+      sl_sleeptimer_start_timer(&task_timer, ticks, task_timer_expired, NULL, 0, 0);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sleeptimer callback, runs in the RTCC interrupt.
+ *
+ * @details
+ * Schedules the event of every task whose wake tick has passed, the task itself then
+ * resumes from the main loop.
+ ******************************************************************************/
+static void task_timer_expired(sl_sleeptimer_timer_handle_t *handle, void *data){
+  uint32_t now = sl_sleeptimer_get_tick_count();
+  (void)handle;
+  (void)data;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  for(int i = 0; i < TASK_SLEEPERS; i++){
+      if(task_sleeping[i] && ((int32_t)(now - task_sleeping[i]->wake_tick) >= 0)){
+          add_scheduled_event(task_sleeping[i]->event);
+          task_sleeping[i] = NULL;
+      }
+  }
+  task_timer_arm();
+  CORE_EXIT_CRITICAL();
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Runs a task from its beginning.
+ *
+ * @details
+ * The task's first step runs when the scheduler dispatches its event, not from here.
+ *
+ * @param[in] task
+ * Task to start, also restarts one that has finished
+ ******************************************************************************/
+void task_start(TASK *task){
+  task->lc = 0;
+  add_scheduled_event(task->event);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Schedules a task's event after a delay, used by AWAIT_TIMEOUT.
+ *
+ * @details
+ * Instead of a sleeptimer handle per task, the sleeping tasks share one timer that is
+ * always set to the earliest wake tick, so a task needs only its wake tick.
+ *
+ * @note
+ * sl_sleeptimer_init() must have run.
+ *
+ * @param[in] task
+ * Task to wake
+ *
+ * @param[in] ms
+ * Delay in ms
+ ******************************************************************************/
+void task_sleep(TASK *task, uint32_t ms){
+  uint32_t ticks;
+  int free_slot = -1;
+  sl_status_t status = sl_sleeptimer_ms32_to_tick(ms, &ticks);
+
+  EFM_ASSERT(status == SL_STATUS_OK);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  task->wake_tick = sl_sleeptimer_get_tick_count() + ticks;
+  for(int i = 0; i < TASK_SLEEPERS; i++){
+      if(task_sleeping[i] == task){
+          free_slot = i;
+          break;
+      }
+      if((task_sleeping[i] == NULL) && (free_slot < 0)) free_slot = i;
+  }
+  EFM_ASSERT(free_slot >= 0);
+  task_sleeping[free_slot] = task;
+  task_timer_arm();
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Takes a task off the sleeping list, used by AWAIT_TIMEOUT when the task resumes.
+ *
+ * @details
+ * After a timeout the timer callback has already done this. After an early wake the slot
+ * would otherwise stay armed and schedule the task's event once more at the old wake tick,
+ * resuming it from whatever it awaits by then.
+ *
+ * @param[in] task
+ * Task that no longer waits for its wake tick
+ ******************************************************************************/
+void task_sleep_cancel(TASK *task){
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  for(int i = 0; i < TASK_SLEEPERS; i++){
+      if(task_sleeping[i] == task){
+          task_sleeping[i] = NULL;
+          task_timer_arm();
+          break;
+      }
+  }
+  CORE_EXIT_CRITICAL();
+}
@@ -0,0 +1,150 @@
+/**
+ * @file timestamp.c
+ * @brief 64 bit monotonic time on the sleeptimer
+ *Responsible for extending the RTCC backed sleeptimer count to 64 bits and for the wall time offset set by the phone.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "timestamp.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static uint32_t ts_high;            // counter wraps seen
+static uint32_t ts_last;            // count at the last ts_now(), to spot a wrap
+static uint32_t ts_freq;            // sleeptimer ticks per second
+static int64_t ts_offset_ms;        // wall time minus ts_now_ms(), valid once ts_is_synced
+static bool ts_is_synced;
+static sl_sleeptimer_timer_handle_t ts_keepalive;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void ts_keepalive_cb(sl_sleeptimer_timer_handle_t *handle, void *data);
+
+/***************************************************************************//**
+ * @brief
+ * Periodic sleeptimer callback, makes sure the count is sampled between two wraps.
+ ******************************************************************************/
+static void ts_keepalive_cb(sl_sleeptimer_timer_handle_t *handle, void *data){
+  (void)handle;
+  (void)data;
+  ts_now();
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Starts the timestamp service.
+ *
+ * @details
+ * A wrap of the 32 bit count is detected by ts_now() seeing a smaller count than the last
+ * time, which only works if it runs at least once per wrap. A periodic sleeptimer does
+ * that every TS_KEEPALIVE_TICKS, no HF clock runs for it beyond the wakeup.
+ *
+ * @note
+ * sl_sleeptimer_init() must have run.
+ ******************************************************************************/
+void ts_open(void){
+  sl_status_t status;
+
+  ts_freq = sl_sleeptimer_get_timer_frequency();
+  ts_last = sl_sleeptimer_get_tick_count();
+  ts_high = 0;
+  ts_is_synced = false;
+
+  status = sl_sleeptimer_start_periodic_timer(&ts_keepalive, TS_KEEPALIVE_TICKS, ts_keepalive_cb, NULL, 0, 0);
+  EFM_ASSERT(status == SL_STATUS_OK);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns sleeptimer ticks since boot, safe from interrupts.
+ *
+ * @details
+ * A read of the RTCC count plus a compare, so it is cheap enough to stamp every sample
+ * and trace entry. Never goes backwards.
+ ******************************************************************************/
+uint64_t ts_now(void){
+  uint32_t tick;
+  uint64_t now;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  tick = sl_sleeptimer_get_tick_count();
+  if(tick < ts_last){
+      ts_high++;
+  }
+  ts_last = tick;
+  now = ((uint64_t)ts_high << 32) | tick;
+  CORE_EXIT_CRITICAL();
+
+  return now;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Converts ticks from ts_now() to ms. ticks * 1000 only overflows after some 17000 years
+ * at 32768 Hz.
+ ******************************************************************************/
+uint64_t ts_ticks_to_ms(uint64_t ticks){
+  return (ticks * 1000) / ts_freq;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns ms since boot.
+ ******************************************************************************/
+uint64_t ts_now_ms(void){
+  return ts_ticks_to_ms(ts_now());
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sets the wall time, sent by the phone with "#T<ms>!".
+ *
+ * @details
+ * Only an offset to the monotonic time is kept, so ts_now() is never stepped and time
+ * differences stay valid across a sync. The link delay is not compensated, with the HM-18
+ * it is in the tens of ms.
+ *
+ * @param[in] wall_ms
+ * Wall time in ms, Unix time for the phone app
+ ******************************************************************************/
+void ts_sync(uint64_t wall_ms){
+  int64_t offset = (int64_t)wall_ms - (int64_t)ts_now_ms();
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  ts_offset_ms = offset;
+  ts_is_synced = true;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether ts_sync() has been called since boot.
+ ******************************************************************************/
+bool ts_synced(void){
+  return ts_is_synced;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the wall time in ms, or ms since boot before the first ts_sync().
+ ******************************************************************************/
+uint64_t ts_wall_ms(void){
+  uint64_t now = ts_now_ms();
+
+  return ts_is_synced ? (uint64_t)((int64_t)now + ts_offset_ms) : now;
+}
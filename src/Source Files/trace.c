@@ -0,0 +1,231 @@
+/**
+ * @file trace.c
+ * @brief Always on binary trace of ISRs, scheduler events, sleep and driver states
+ *Responsible for the lock free record ring and for dumping it over BLE, tools/trace2chrome.py turns a dump into a Chrome trace.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+#include "ble.h"
+#include "cmu.h"
+#include "swo.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static TRACE_REC trace_ring[TRACE_RECORDS];
+static volatile uint32_t trace_head;        // records ever reserved, the slot is head % TRACE_RECORDS
+static volatile bool trace_paused;
+
+static struct {
+  bool      active;
+  bool      meta_sent;
+  uint32_t  next;           // sequence number of the next record to send
+  uint32_t  end;            // head when the dump started
+  uint32_t  sent;
+  uint32_t  chunk_evt;
+} trace_dump;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void trace_freq_changed(uint32_t hf_hz);
+
+/***************************************************************************//**
+ * @brief
+ * Records a core clock change so the host can turn cycle counts into time.
+ ******************************************************************************/
+static void trace_freq_changed(uint32_t hf_hz){
+  if(TRACE_ON(TRACE_CAT_CLOCK)){
+      trace_put(TRACE_T_CLOCK, 0, (uint16_t)(hf_hz / 1000000));
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Starts tracing.
+ *
+ * @details
+ * Starts the DWT cycle counter in case the profiler is compiled out and records the
+ * current core clock.
+ *
+ * @note
+ * Hooks that fire before trace_open() are recorded as well, with cycle counts of 0.
+ ******************************************************************************/
+void trace_open(void){
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  clock_freq_register(trace_freq_changed);
+  trace_freq_changed(CMU_ClockFreqGet(cmuClock_CORE));
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds a record, safe from any interrupt level.
+ *
+ * @details
+ * The slot is claimed with LDREX/STREX on the head, so interrupts are never masked and an
+ * ISR that preempts a writer simply claims the next slot. The oldest records are
+ * overwritten. Records are dropped while a dump is running so it reads a stable ring.
+ * Each record also goes out on SWO_PORT_TRACE as one word, type, id, then arg from the low
+ * byte up, timed by the ITM timestamps instead of the tick.
+ ******************************************************************************/
+void trace_put(TRACE_TYPE type, uint8_t id, uint16_t arg){
+  uint32_t head;
+  TRACE_REC *rec;
+
+  swo_put(SWO_PORT_TRACE, (uint32_t)type | ((uint32_t)id << 8) | ((uint32_t)arg << 16));
+  if(trace_paused) return;
+  do{
+      head = __LDREXW((volatile uint32_t *)&trace_head);
+  }while(__STREXW(head + 1, (volatile uint32_t *)&trace_head));
+
+  rec = &trace_ring[head & (TRACE_RECORDS - 1)];
+  rec->tick = sl_sleeptimer_get_tick_count();
+  rec->type = (uint8_t)type;
+  rec->id = id;
+  rec->arg = arg;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Adds an exit or done record carrying the cycles since start, saturated to 16 bits.
+ *
+ * @details
+ * The host falls back to the tick difference to the matching enter record for anything
+ * that took 0xFFFF cycles or more.
+ ******************************************************************************/
+void trace_put_cycles(TRACE_TYPE type, uint8_t id, uint32_t start){
+  uint32_t cycles = DWT->CYCCNT - start;
+
+  trace_put(type, id, (cycles > 0xFFFF) ? 0xFFFF : (uint16_t)cycles);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Copies records out of the ring.
+ *
+ * @param[in] from
+ * Sequence number of the first record, at least trace_written() - TRACE_RECORDS
+ *
+ * @return
+ * Number of records copied
+ ******************************************************************************/
+uint32_t trace_read(uint32_t from, TRACE_REC *out, uint32_t max){
+  uint32_t n = 0;
+
+  while((n < max) && (from + n != trace_head)){
+      out[n] = trace_ring[(from + n) & (TRACE_RECORDS - 1)];
+      n++;
+  }
+  return n;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns the number of records written since boot, the sequence number of the next one.
+ ******************************************************************************/
+uint32_t trace_written(void){
+  return trace_head;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Stops or resumes recording, for a reader that needs the ring to hold still.
+ ******************************************************************************/
+void trace_pause(bool pause){
+  trace_paused = pause;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Starts sending the ring over BLE, requested with "#X!".
+ *
+ * @details
+ * Recording pauses until the dump is over, so the dump shows what led up to the request
+ * and not the dump itself. Sent as one meta frame, then frames of up to
+ * TRACE_FRAME_RECORDS records, then the line "X end n:<records>".
+ *
+ * @param[in] chunk_evt
+ * Event whose handler calls trace_dump_cb(), scheduled once per frame
+ *
+ * @return
+ * false if a dump is already running
+ ******************************************************************************/
+bool trace_dump_start(uint32_t chunk_evt){
+  if(trace_dump.active) return false;
+
+  trace_pause(true);
+  trace_dump.active = true;
+  trace_dump.meta_sent = false;
+  trace_dump.end = trace_head;
+  trace_dump.next = (trace_dump.end > TRACE_RECORDS) ? trace_dump.end - TRACE_RECORDS : 0;
+  trace_dump.sent = 0;
+  trace_dump.chunk_evt = chunk_evt;
+  add_scheduled_event(chunk_evt);
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends the next dump frame.
+ *
+ * @details
+ * The meta frame is 'X', 0, then little endian the sleeptimer frequency and the core
+ * clock in Hz, the records written since boot and the records that follow. A record frame
+ * is 'X', the record count and the records as laid out in TRACE_REC.
+ ******************************************************************************/
+void trace_dump_cb(void){
+  uint8_t frame[TRACE_FRAME_HDR + (TRACE_FRAME_RECORDS * sizeof(TRACE_REC))];
+  TRACE_REC recs[TRACE_FRAME_RECORDS];  // frame + 2 is not aligned for a record
+  uint32_t meta[4];
+  uint32_t n;
+
+  if(!trace_dump.active) return;
+
+  frame[0] = 'X';
+  if(!trace_dump.meta_sent){
+      meta[0] = sl_sleeptimer_get_timer_frequency();
+      meta[1] = CMU_ClockFreqGet(cmuClock_CORE);
+      meta[2] = trace_dump.end;
+      meta[3] = trace_dump.end - trace_dump.next;
+      frame[1] = 0;
+      memcpy(&frame[TRACE_FRAME_HDR], meta, sizeof(meta));
+      trace_dump.meta_sent = true;
+      ble_write_bytes(frame, TRACE_FRAME_HDR + sizeof(meta), trace_dump.chunk_evt);
+      return;
+  }
+
+  n = trace_dump.end - trace_dump.next;
+  if(n > TRACE_FRAME_RECORDS) n = TRACE_FRAME_RECORDS;
+  if(n == 0){
+      char line[32];
+      trace_dump.active = false;
+      trace_pause(false);
+      snprintf(line, sizeof(line), "X end n:%lu\n", (unsigned long)trace_dump.sent);
+      ble_write(line);
+      return;
+  }
+
+  n = trace_read(trace_dump.next, recs, n);
+  memcpy(&frame[TRACE_FRAME_HDR], recs, n * sizeof(TRACE_REC));
+  frame[1] = (uint8_t)n;
+  trace_dump.next += n;
+  trace_dump.sent += n;
+  ble_write_bytes(frame, TRACE_FRAME_HDR + (n * sizeof(TRACE_REC)), trace_dump.chunk_evt);
+}
@@ -0,0 +1,326 @@
+/**
+ * @file usart.c
+ * @brief High speed UART transport on USART0
+ *Responsible for LDMA driven transmission and interrupt driven frame reception at rates the LEUART can not reach.
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "usart.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static USART_CTX usart0_ctx;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void usart_rx_byte(USART_CTX *ctx, char c);
+
+/***************************************************************************//**
+ * @brief
+ * Runs one received byte through the frame matcher, called from the RX interrupt.
+ *
+ * @details
+ * Does in software what the LEUART START and SIG frame hardware does: bytes before the start
+ * character are dropped, the frame is kept including both markers and is copied to read_str
+ * once the signal character arrives. A frame longer than the buffer is dropped.
+ ******************************************************************************/
+static void usart_rx_byte(USART_CTX *ctx, char c){
+  switch(ctx->rx_state){
+    case USART_RX_START:
+      if(c == ctx->startframe){
+          ctx->rx_str[0] = c;
+          ctx->rx_length = 1;
+          ctx->rx_state = USART_RX_FRAME;
+      }
+      break;
+
+    case USART_RX_FRAME:
+      if(ctx->rx_length >= USART_STR_LEN - 1){
+          ctx->rx_state = USART_RX_START;
+          break;
+      }
+      ctx->rx_str[ctx->rx_length++] = c;
+      if(c == ctx->sigframe){
+          ctx->rx_str[ctx->rx_length] = 0;
+          memcpy(ctx->read_str, ctx->rx_str, ctx->rx_length + 1);
+          ctx->rx_state = USART_RX_START;
+          add_scheduled_event(ctx->rx_done_evt);
+      }
+      break;
+
+    case USART_RX_RAW:
+      if(ctx->rx_length < USART_STR_LEN){
+          ctx->rx_str[ctx->rx_length++] = c;
+      }
+      add_scheduled_event(ctx->raw_rx_evt);
+      break;
+
+    case USART_RX_IDLE:
+    default:
+      break;
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ * Configures USART0 for asynchronous operation and routes it to the given pins.
+ *
+ * @details
+ * The USART clock stays requested until usart_close(). It hangs off HFPER, so EM2 is blocked
+ * for as long as the USART is open, which is the price of the higher rate. The node is a
+ * freq_lock clock, so the HFRCO band and with it the baud divider set here stay put until
+ * usart_close(), boosts requested meanwhile wait. Transmission uses LDMA_CH_USART0_TX.
+ *
+ * @note
+ * The pins must not be routed to another peripheral at the same time.
+ *
+ * @param[in] usart
+ * USART0, the only instance this driver handles
+ *
+ * @param[in] usart_settings
+ * Baud rate, routing and receive framing
+ ******************************************************************************/
+void usart_open(USART_TypeDef *usart, USART_OPEN_STRUCT *usart_settings){
+  USART_InitAsync_TypeDef usart_init = USART_INITASYNC_DEFAULT;
+  USART_CTX *ctx = &usart0_ctx;
+
+  EFM_ASSERT(usart == USART0);
+  EFM_ASSERT(ctx->usart == NULL);
+
+  clock_request(cmuClock_USART0);
+  ldma_open();
+  ldma_done_event(LDMA_CH_USART0_TX, 0);    // completion is taken from TXC instead
+
+  usart_init.enable = usartDisable;
+  usart_init.baudrate = usart_settings->baudrate;
+  USART_InitAsync(usart, &usart_init);
+
+  ctx->baudrate = usart_settings->baudrate;
+  ctx->startframe = usart_settings->startframe;
+  ctx->sigframe = usart_settings->sigframe;
+  ctx->rx_done_evt = usart_settings->rx_done_evt;
+  ctx->rx_state = USART_RX_START;
+  ctx->rx_length = 0;
+  ctx->read_str[0] = 0;
+  ctx->tx_busy = false;
+  ctx->routepen = (usart_settings->tx_pin_en * USART_ROUTEPEN_TXPEN) | (usart_settings->rx_pin_en * USART_ROUTEPEN_RXPEN);
+
+  usart->ROUTELOC0 = usart_settings->tx_loc | usart_settings->rx_loc;
+  usart->ROUTEPEN = ctx->routepen;
+  usart->CMD = USART_CMD_CLEARRX | USART_CMD_CLEARTX;
+  usart->IFC = USART_IF_RXDATAV | USART_IF_TXC;
+  usart->IEN = USART_IEN_RXDATAV;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  ctx->usart = usart;
+  CORE_EXIT_CRITICAL();
+
+  NVIC_ClearPendingIRQ(USART0_RX_IRQn);
+  NVIC_ClearPendingIRQ(USART0_TX_IRQn);
+  NVIC_EnableIRQ(USART0_RX_IRQn);
+  NVIC_EnableIRQ(USART0_TX_IRQn);
+  USART_Enable(usart, usartEnable);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Releases the pins and the USART clock, which allows EM2 again.
+ *
+ * @note
+ * Waits for a transmission in progress to finish.
+ *
+ * @param[in] usart
+ * USART opened with usart_open()
+ ******************************************************************************/
+void usart_close(USART_TypeDef *usart){
+  USART_CTX *ctx = &usart0_ctx;
+
+  EFM_ASSERT(usart == ctx->usart);
+  while(ctx->tx_busy);
+
+  NVIC_DisableIRQ(USART0_RX_IRQn);
+  NVIC_DisableIRQ(USART0_TX_IRQn);
+  USART_Enable(usart, usartDisable);
+  usart->IEN = 0;
+  usart->ROUTEPEN = 0;
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  ctx->usart = NULL;
+  ctx->rx_state = USART_RX_IDLE;
+  CORE_EXIT_CRITICAL();
+
+  clock_release(cmuClock_USART0);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Sends a buffer with the LDMA.
+ *
+ * @details
+ * The data is copied first so the caller's buffer may be reused right away. The LDMA feeds
+ * TXDATA on TXBL, so the core only takes the TXC interrupt at the end. Waits for the
+ * previous transmission like leuart_start() does.
+ *
+ * @param[in] usart
+ * USART opened with usart_open()
+ *
+ * @param[in] string
+ * Bytes to send, may contain 0
+ *
+ * @param[in] string_len
+ * Number of bytes, at most USART_STR_LEN
+ *
+ * @param[in] done_evt
+ * Event scheduled when the last byte has left the shift register
+ ******************************************************************************/
+void usart_start(USART_TypeDef *usart, char *string, uint32_t string_len, uint32_t done_evt){
+  USART_CTX *ctx = &usart0_ctx;
+  LDMA_TransferCfg_t cfg = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_USART0_TXBL);
+  static LDMA_Descriptor_t desc;
+
+  EFM_ASSERT(usart == ctx->usart);
+  EFM_ASSERT((string_len > 0) && (string_len <= sizeof(ctx->tx_data)));
+  while(ctx->tx_busy);
+
+  memcpy(ctx->tx_data, string, string_len);
+  ctx->tx_done_evt = done_evt;
+  ctx->tx_busy = true;
+
+  desc = (LDMA_Descriptor_t)LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(ctx->tx_data, &usart->TXDATA, string_len);
+  usart->IFC = USART_IF_TXC;
+  usart->IEN |= USART_IEN_TXC;
+  LDMA_StartTransfer(LDMA_CH_USART0_TX, &cfg, &desc);
+}
+
+/***************************************************************************//**
+ * @brief
+ * Returns whether a transmission is in progress.
+ ******************************************************************************/
+bool usart_tx_busy(USART_TypeDef *usart){
+  EFM_ASSERT(usart == USART0);
+  return usart0_ctx.tx_busy;
+}
+
+/***************************************************************************//**
+ * @brief
+ * Copies the last complete frame, the USART counterpart of received_str().
+ *
+ * @param[out] out_str
+ * At least USART_STR_LEN characters
+ ******************************************************************************/
+void usart_received_str(USART_TypeDef *usart, char *out_str){
+  EFM_ASSERT(usart == USART0);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  strcpy(out_str, usart0_ctx.read_str);
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Switches reception between frames and raw bytes, as leuart_raw_rx() does.
+ *
+ * @param[in] enable
+ * true to buffer every byte, false to return to frame matching
+ *
+ * @param[in] rx_evt
+ * Event scheduled for every byte received in raw mode
+ ******************************************************************************/
+void usart_raw_rx(USART_TypeDef *usart, bool enable, uint32_t rx_evt){
+  USART_CTX *ctx = &usart0_ctx;
+
+  EFM_ASSERT(usart == ctx->usart);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  usart->CMD = USART_CMD_CLEARRX;
+  ctx->rx_length = 0;
+  if(enable){
+      ctx->raw_rx_evt = rx_evt;
+      ctx->rx_state = USART_RX_RAW;
+  }else{
+      ctx->rx_state = USART_RX_START;
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ * Drains the bytes buffered in raw mode, as leuart_raw_read() does.
+ *
+ * @return
+ * Number of bytes copied into out_str, which is not null terminated
+ ******************************************************************************/
+uint32_t usart_raw_read(USART_TypeDef *usart, char *out_str, uint32_t max_len){
+  USART_CTX *ctx = &usart0_ctx;
+  uint32_t length;
+
+  EFM_ASSERT(usart == USART0);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  length = (ctx->rx_state == USART_RX_RAW) ? ctx->rx_length : 0;
+  if(length > max_len){
+      length = max_len;
+  }
+  memcpy(out_str, ctx->rx_str, length);
+  ctx->rx_length = 0;
+  CORE_EXIT_CRITICAL();
+
+  return length;
+}
+
+/***************************************************************************//**
+ * @brief
+ * IRQ handler for USART0 reception.
+ *
+ * @details
+ * Reading RXDATA clears RXDATAV, the FIFO is emptied in one go.
+ ******************************************************************************/
+void USART0_RX_IRQHandler(void){
+  uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_USART0_RX);
+
+  while(USART0->STATUS & USART_STATUS_RXDATAV){
+      usart_rx_byte(&usart0_ctx, (char)USART0->RXDATA);
+  }
+  TRACE_ISR_EXIT(TRACE_ISR_USART0_RX, trace_start);
+}
+
+/***************************************************************************//**
+ * @brief
+ * IRQ handler for USART0 transmission.
+ *
+ * @details
+ * TXC can only be set between two bytes if the LDMA falls a whole character behind, so it
+ * only ends the transmission once the channel is done as well.
+ ******************************************************************************/
+void USART0_TX_IRQHandler(void){
+  uint32_t trace_start = TRACE_ISR_ENTER(TRACE_ISR_USART0_TX);
+  uint32_t int_flag = USART0->IF & USART0->IEN & USART_IF_TXC;
+  USART0->IFC = int_flag;
+
+  if(int_flag && LDMA_TransferDone(LDMA_CH_USART0_TX)){
+      USART0->IEN &= ~USART_IEN_TXC;
+      usart0_ctx.tx_busy = false;
+      add_scheduled_event(usart0_ctx.tx_done_evt);
+  }
+  TRACE_ISR_EXIT(TRACE_ISR_USART0_TX, trace_start);
+}
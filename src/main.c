@@ -55,38 +55,6 @@ int main(void)
           enter_sleep();
           CORE_EXIT_CRITICAL();
       }
-
-
-
-          if(get_scheduled_events() & LETIMER0_UF_CB) {
-              remove_scheduled_event(get_scheduled_events());
-              scheduled_letimer0_uf_cb();
-
-          }
-
-          if(get_scheduled_events() & LETIMER0_COMP0_CB) {
-              remove_scheduled_event(get_scheduled_events());
-              scheduled_letimer0_comp0_cb();
-          }
-
-          if(get_scheduled_events() & LETIMER0_COMP1_CB) {
-              remove_scheduled_event(get_scheduled_events());
-              scheduled_letimer0_comp1_cb();
-          }
-          if(get_scheduled_events() &  SI1133_CB) {
-              remove_scheduled_event(SI1133_CB);
-
-              scheduled_si1133_read_cb();
-          }
-          if(get_scheduled_events() &  BOOT_UP_CB) {
-              remove_scheduled_event(BOOT_UP_CB);
-
-              scheduled_boot_up_cb();
-          }
-          if(get_scheduled_events() &  BLE_TX_DONE_CB) {
-              remove_scheduled_event(BLE_TX_DONE_CB);
-              BLE_RX_cb();
-          }
-
+      scheduler_dispatch();
   }
 }
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Formats the deferred log records (log.h) received over BLE.
+
+The input is the raw byte stream received from the HM-18, as saved by the phone or a
+serial terminal. 'G' frames are picked out of it by their CRC, everything else is
+skipped. Format strings come from the "logstr" section of the firmware image, so the
+ELF has to be the one running on the board.
+
+    python3 tools/logfmt.py capture.bin --elf build/app.axf
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_HDR = 7           # LOG_FRAME_HDR
+CRC_BYTES = 2           # BLE_CRC_BYTES
+REC_HDR = 3             # record length, format id
+SEP = "\x1f"            # LOG_SEP
+SECTION = "logstr"
+TICK_HZ = 32768
+
+LEVELS = {"T": 0, "D": 1, "I": 2, "W": 3, "E": 4}
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGaAp%])")
+
+
+def crc16_x25(data):
+    """CRC-16/X-25, the checksum ble_write_bytes() appends."""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc ^ 0xFFFF
+
+
+def elf_section(path, name):
+    """Returns the contents of a section of a little endian ELF, 64 bit for host builds."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] not in (1, 2) or elf[5] != 1:
+        sys.exit("%s is not a little endian ELF" % path)
+    if elf[4] == 1:
+        shoff, = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+        layout = "<10I"
+    else:
+        shoff, = struct.unpack_from("<Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+        layout = "<IIQQQQIIQQ"
+
+    def header(k):
+        return struct.unpack_from(layout, elf, shoff + k * shentsize)
+
+    names_off = header(shstrndx)[4]
+    for k in range(shnum):
+        sh = header(k)
+        start = names_off + sh[0]
+        label = elf[start:elf.index(b"\0", start)].decode()
+        if label == name:
+            return elf[sh[4]:sh[4] + sh[5]]
+    sys.exit("%s has no %s section, no log sites are compiled in" % (path, name))
+
+
+def site(table, ident):
+    """Returns (level, place, format) of the string at offset ident."""
+    end = table.find(b"\0", ident)
+    if ident >= len(table) or end < 0:
+        return None
+    parts = table[ident:end].decode("utf-8", "replace").split(SEP, 2)
+    if len(parts) != 3:
+        return None
+    level, place, fmt = parts
+    file_name, _, line = place.rpartition(":")
+    return level, "%s:%s" % (os.path.basename(file_name), line), fmt
+
+
+def render(fmt, args):
+    """Formats the raw argument bytes the way printf would have on the target."""
+    out, pos, last = [], 0, 0
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, length, conv = m.group(1), m.group(2) or "", m.group(3)
+        if conv == "%":
+            out.append("%")
+            continue
+        if conv == "s":
+            if pos >= len(args):
+                out.append("<?>")
+                break
+            n = args[pos]
+            text = args[pos + 1:pos + 1 + n].decode("latin-1")
+            pos += 1 + n
+            out.append(("%" + flags + "s") % text)
+            continue
+        size = 8 if length == "ll" and conv not in "fFeEgGaA" else 4
+        if pos + size > len(args):
+            out.append("<?>")
+            break
+        raw = args[pos:pos + size]
+        pos += size
+        if conv in "fFeEgGaA":
+            value = struct.unpack("<f", raw)[0]
+            out.append(value.hex() if conv in "aA" else ("%" + flags + conv) % value)
+        elif conv in "di":
+            value = struct.unpack("<q" if size == 8 else "<i", raw)[0]
+            out.append(("%" + flags + "d") % value)
+        elif conv == "c":
+            out.append(chr(raw[0]))
+        elif conv == "p":
+            out.append("0x%08x" % struct.unpack("<I", raw)[0])
+        else:
+            value = struct.unpack("<Q" if size == 8 else "<I", raw)[0]
+            out.append(("%" + flags + ("d" if conv == "u" else conv)) % value)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def parse_frames(data):
+    """Yields (dropped, base_tick, records) of each 'G' frame with a good CRC."""
+    i = 0
+    while i + FRAME_HDR + CRC_BYTES <= len(data):
+        if data[i] != ord("G"):
+            i += 1
+            continue
+        end = i + FRAME_HDR + data[i + 1]
+        if end + CRC_BYTES > len(data):
+            i += 1
+            continue
+        crc = data[end] | (data[end + 1] << 8)
+        if crc != crc16_x25(data[i:end]):
+            i += 1
+            continue
+        dropped = data[i + 2]
+        base, = struct.unpack_from("<I", data, i + 3)
+        yield dropped, base, data[i + FRAME_HDR:end]
+        i = end + CRC_BYTES
+
+
+def records(body):
+    """Yields (ticks since the previous record, format id, argument bytes)."""
+    k = 0
+    while k < len(body):
+        end = k + 1 + body[k]
+        ident = body[k + 1] | (body[k + 2] << 8)
+        delta, shift, j = 0, 0, k + REC_HDR
+        while j < end:
+            delta |= (body[j] & 0x7F) << shift
+            shift += 7
+            j += 1
+            if body[j - 1] & 0x80 == 0:
+                break
+        yield delta, ident, body[j:end]
+        k = end
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("capture", help="raw bytes received from the board, - for stdin")
+    ap.add_argument("--elf", required=True, help="firmware image with the logstr section")
+    ap.add_argument("--level", default="T", choices=list(LEVELS), help="lowest level shown")
+    ap.add_argument("--tick-hz", type=float, default=TICK_HZ, help="sleeptimer frequency")
+    args = ap.parse_args()
+
+    if args.capture == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+    table = elf_section(args.elf, SECTION)
+    lowest = LEVELS[args.level]
+
+    for dropped, base, body in parse_frames(data):
+        if dropped:
+            print("-- %s%d records dropped on the board" % (">=" if dropped == 255 else "", dropped))
+        tick = base
+        for delta, ident, raw in records(body):
+            tick = (tick + delta) & 0xFFFFFFFF
+            found = site(table, ident)
+            stamp = "%10.3f" % (tick / args.tick_hz)
+            if found is None:
+                print("%s ? unknown format id %d, is the ELF the one on the board?" % (stamp, ident))
+                continue
+            level, place, fmt = found
+            if LEVELS.get(level, 0) < lowest:
+                continue
+            print("%s %s %-14s %s" % (stamp, level, place, render(fmt, raw)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,325 @@
+#!/usr/bin/env python3
+"""Builds a flat profile from a recorded SWO stream.
+
+The input is the raw ITM byte stream set up by swo_open(), for example from
+    openocd ... -c "tpiu config internal swo.bin uart off 19000000 863636"
+or the J-Link SWO viewer's binary output. The report has four parts:
+
+  - PC samples per function, with the share of sleep samples
+  - time per interrupt from the exception trace and ITM timestamps
+  - scheduler event and ISR durations from the trace records on stimulus port 1
+  - DWT event counter totals
+
+Without --elf or --syms the PC samples are listed by address.
+
+    python3 tools/swo_profile.py swo.bin --elf build/app.axf
+"""
+
+import argparse
+import collections
+import bisect
+import os
+import re
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+EVENTS_H = os.path.join(HERE, "..", "src", "Header Files", "events.h")
+
+PORT_TEXT = 0           # SWO_PORT_TEXT
+PORT_TRACE = 1          # SWO_PORT_TRACE
+TS_HZ = 19000000        # ITM timestamps count the AUXHFRCO with SWOENA set
+SATURATED = 0xFFFF
+
+# TRACE_TYPE, the subset with a cycle count in arg
+T_ISR_EXIT, T_EVT_DONE, T_CLOCK = 1, 4, 10
+TRACE_ISR_NAMES = ["LETIMER0", "LEUART0", "I2C0", "I2C1", "USART0_RX", "USART0_TX", "LEUART1"]
+
+# Exception numbers, 16 + IRQn from the EFR32MG12P IRQn_Type
+EXCEPTIONS = {
+    2: "NMI", 3: "HardFault", 4: "MemManage", 5: "BusFault", 6: "UsageFault",
+    11: "SVCall", 12: "DebugMon", 14: "PendSV", 15: "SysTick",
+    16 + 0: "EMU", 16 + 9: "LDMA", 16 + 10: "GPIO_EVEN", 16 + 11: "TIMER0",
+    16 + 12: "USART0_RX", 16 + 13: "USART0_TX", 16 + 17: "I2C0", 16 + 18: "GPIO_ODD",
+    16 + 19: "TIMER1", 16 + 22: "LEUART0", 16 + 24: "CMU", 16 + 25: "MSC",
+    16 + 27: "LETIMER0", 16 + 30: "RTCC", 16 + 32: "CRYOTIMER", 16 + 42: "I2C1",
+}
+
+# Bits of a DWT event counter packet, each a wrap of the 8 bit counter
+DWT_COUNTERS = ["CPI", "EXC", "SLEEP", "LSU", "FOLD", "POST"]
+
+
+def event_names(path):
+    try:
+        with open(path) as f:
+            text = f.read()
+    except OSError:
+        return []
+    body = text.split("SCHEDULER_EVENT_LIST(X)", 1)[-1].split("\n\n", 1)[0]
+    return re.findall(r"X\((\w+),", body)
+
+
+def parse_itm(data):
+    """Yields (kind, value) for each ITM packet.
+
+    kinds: "sw" (port, bytes), "dwt" (id, bytes), "ts" (delta), "overflow", "sync".
+    Bytes that do not start a known packet are skipped one at a time, which gets back in
+    step by the next sync or sooner.
+    """
+    i, n = 0, len(data)
+    while i < n:
+        h = data[i]
+        if h == 0x00:
+            j = i
+            while j < n and data[j] == 0x00:
+                j += 1
+            if j < n and data[j] == 0x80 and j - i >= 5:
+                yield "sync", None
+                i = j + 1
+            else:
+                i = j
+            continue
+        if h == 0x70:
+            yield "overflow", None
+            i += 1
+            continue
+        if h & 0x0F == 0:
+            # local timestamp, format 2 carries the value in the header
+            if h & 0xC0 == 0x80:
+                # only ends a sync, a stray one is not the header of a timestamp
+                i += 1
+                continue
+            if h & 0x80 == 0:
+                yield "ts", (h >> 4) & 0x07
+                i += 1
+                continue
+            value, shift, j = 0, 0, i + 1
+            while j < n and j - i <= 4:
+                value |= (data[j] & 0x7F) << shift
+                shift += 7
+                j += 1
+                if data[j - 1] & 0x80 == 0:
+                    break
+            yield "ts", value
+            i = j
+            continue
+        if h in (0x94, 0xB4) or h & 0x0B == 0x08:
+            # global timestamp or extension, not used here
+            j = i + 1
+            if h & 0x80:
+                while j < n and data[j] & 0x80:
+                    j += 1
+                j += 1
+            i = j
+            continue
+        size = {1: 1, 2: 2, 3: 4}.get(h & 0x03)
+        if size is None or i + 1 + size > n:
+            i += 1
+            continue
+        payload = data[i + 1:i + 1 + size]
+        address = h >> 3
+        yield ("dwt" if h & 0x04 else "sw"), (address, payload)
+        i += 1 + size
+
+
+class Symbols:
+    def __init__(self, lines):
+        entries = []
+        for line in lines:
+            parts = line.split()
+            if len(parts) < 4 or parts[2] not in "tTwW":
+                continue
+            try:
+                entries.append((int(parts[0], 16) & ~1, int(parts[1], 16), parts[3]))
+            except ValueError:
+                continue
+        entries.sort()
+        self.starts = [e[0] for e in entries]
+        self.entries = entries
+
+    def lookup(self, pc):
+        k = bisect.bisect_right(self.starts, pc) - 1
+        if k >= 0:
+            start, size, label = self.entries[k]
+            if pc < start + max(size, 2):
+                return label
+        return "0x%08x" % pc
+
+    @classmethod
+    def from_elf(cls, path, nm):
+        out = subprocess.run([nm, "-n", "-S", "--defined-only", path], check=True,
+                             capture_output=True, text=True).stdout
+        return cls(out.splitlines())
+
+
+class Profile:
+    def __init__(self, events, ts_hz):
+        self.events = events
+        self.ts_hz = ts_hz
+        self.pcs = collections.Counter()
+        self.sleep_samples = 0
+        self.counters = collections.Counter()
+        self.overflows = 0
+        self.text = bytearray()
+        self.exc_time = collections.Counter()     # exception number -> timestamp ticks
+        self.exc_count = collections.Counter()
+        self.exc_max = collections.Counter()
+        self.rec_cycles = collections.defaultdict(list)
+        self.mhz = None
+        # exception trace state
+        self.now = 0
+        self.stack = [0]                # active exception numbers, 0 is thread mode
+        self.since = None               # timestamp the top of the stack became active
+        self.entered = {}               # exception number -> timestamp of its entry
+        self.pending_exc = []           # packets waiting for the timestamp that follows
+
+    def feed(self, packets):
+        for kind, value in packets:
+            if kind == "ts":
+                self.now += value
+                for packet in self.pending_exc:
+                    self.exception(*packet)
+                self.pending_exc = []
+            elif kind == "overflow":
+                self.overflows += 1
+                self.stack, self.since, self.entered = [0], None, {}
+            elif kind == "sw":
+                self.software(*value)
+            elif kind == "dwt":
+                self.hardware(*value)
+
+    def software(self, port, payload):
+        if port == PORT_TEXT:
+            self.text.extend(payload)
+        elif port == PORT_TRACE and len(payload) == 4:
+            rtype, rid, arg = payload[0], payload[1], payload[2] | (payload[3] << 8)
+            if rtype == T_CLOCK:
+                self.mhz = arg
+            elif rtype == T_ISR_EXIT:
+                label = TRACE_ISR_NAMES[rid] if rid < len(TRACE_ISR_NAMES) else "ISR%d" % rid
+                self.rec_cycles["isr " + label].append(arg)
+            elif rtype == T_EVT_DONE:
+                label = self.events[rid] if rid < len(self.events) else "EVT%d" % rid
+                self.rec_cycles["event " + label].append(arg)
+
+    def hardware(self, ident, payload):
+        if ident == 0 and len(payload) == 1:
+            for bit, label in enumerate(DWT_COUNTERS):
+                if payload[0] & (1 << bit):
+                    self.counters[label] += 256
+        elif ident == 1 and len(payload) == 2:
+            number = payload[0] | ((payload[1] & 0x01) << 8)
+            function = (payload[1] >> 4) & 0x03
+            # the local timestamp that dates this packet follows it
+            self.pending_exc.append((number, function))
+        elif ident == 2:
+            if len(payload) == 4:
+                self.pcs[int.from_bytes(payload, "little")] += 1
+            elif len(payload) == 1 and payload[0] == 0:
+                self.sleep_samples += 1
+
+    def exception(self, number, function):
+        now = self.now
+        if self.since is not None and self.stack[-1]:
+            self.exc_time[self.stack[-1]] += now - self.since
+        self.since = now
+        if function == 1:               # entry
+            self.stack.append(number)
+            self.entered[number] = now
+            self.exc_count[number] += 1
+        elif function == 2:             # exit
+            if number in self.stack:
+                while self.stack[-1] != number:
+                    self.stack.pop()
+                self.stack.pop()
+            if not self.stack:
+                self.stack = [0]
+            start = self.entered.pop(number, None)
+            if start is not None:
+                self.exc_max[number] = max(self.exc_max[number], now - start)
+        elif function == 3:             # return to number
+            while len(self.stack) > 1 and self.stack[-1] != number:
+                self.stack.pop()
+
+    def report(self, symbols, out, top):
+        total = sum(self.pcs.values()) + self.sleep_samples
+        print("PC samples: %d, %d asleep in EM1" % (total, self.sleep_samples), file=out)
+        funcs = collections.Counter()
+        for pc, count in self.pcs.items():
+            funcs[symbols.lookup(pc) if symbols else "0x%08x" % pc] += count
+        if self.sleep_samples:
+            funcs["(sleep)"] = self.sleep_samples
+        print("  %6s %8s  %s" % ("%", "samples", "function"), file=out)
+        for label, count in funcs.most_common(top):
+            print("  %6.2f %8d  %s" % (100.0 * count / total, count, label), file=out)
+
+        if self.exc_count:
+            print("\nInterrupts, exception trace at %.1f MHz timestamps" % (self.ts_hz / 1e6),
+                  file=out)
+            print("  %-12s %8s %12s %10s %10s" % ("exception", "count", "total us", "avg us",
+                                                  "max us"), file=out)
+            scale = 1e6 / self.ts_hz
+            for number, ticks in sorted(self.exc_time.items(), key=lambda kv: -kv[1]):
+                count = self.exc_count[number]
+                label = EXCEPTIONS.get(number, "IRQ%d" % (number - 16))
+                print("  %-12s %8d %12.1f %10.2f %10.2f" % (
+                    label, count, ticks * scale, ticks * scale / max(count, 1),
+                    self.exc_max[number] * scale), file=out)
+
+        if self.rec_cycles:
+            print("\nTrace records, cycles%s" % (" at %d MHz" % self.mhz if self.mhz else ""),
+                  file=out)
+            print("  %-28s %8s %10s %8s %8s %s" % ("record", "count", "total", "avg", "max",
+                                                  "over"), file=out)
+            for label, cycles in sorted(self.rec_cycles.items(), key=lambda kv: -sum(kv[1])):
+                timed = [c for c in cycles if c != SATURATED]
+                over = len(cycles) - len(timed)
+                print("  %-28s %8d %10d %8d %8d %d" % (
+                    label, len(cycles), sum(timed), sum(timed) // max(len(timed), 1),
+                    max(timed, default=0), over), file=out)
+
+        if self.counters:
+            print("\nDWT counters, counted in steps of 256", file=out)
+            for label in DWT_COUNTERS:
+                if self.counters[label]:
+                    print("  %-6s %d" % (label, self.counters[label]), file=out)
+
+        if self.overflows:
+            print("\nITM overflows: %d, packets were lost" % self.overflows, file=out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("capture", help="raw SWO bytes, - for stdin")
+    ap.add_argument("--elf", help="firmware image for PC to function lookup")
+    ap.add_argument("--nm", default="arm-none-eabi-nm", help="nm used with --elf")
+    ap.add_argument("--syms", help="saved output of nm -n -S instead of --elf")
+    ap.add_argument("--events", default=EVENTS_H, help="events.h for event names")
+    ap.add_argument("--ts-hz", type=float, default=TS_HZ, help="ITM timestamp clock")
+    ap.add_argument("--top", type=int, default=25, help="functions to list")
+    ap.add_argument("--text", action="store_true", help="also print the port 0 text")
+    args = ap.parse_args()
+
+    if args.capture == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+
+    symbols = None
+    if args.elf:
+        symbols = Symbols.from_elf(args.elf, args.nm)
+    elif args.syms:
+        with open(args.syms) as f:
+            symbols = Symbols(f.read().splitlines())
+
+    profile = Profile(event_names(args.events), args.ts_hz)
+    profile.feed(parse_itm(data))
+    profile.report(symbols, sys.stdout, args.top)
+    if args.text and profile.text:
+        print("\nPort %d text:" % PORT_TEXT)
+        sys.stdout.write(profile.text.decode("ascii", "replace"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""Converts a trace dump ("#X!") into Chrome trace JSON.
+
+The input is the raw byte stream received from the HM-18 while the dump ran, as saved
+by the phone or a serial terminal. Other frames and text lines in the capture are
+skipped. Open the output in chrome://tracing or https://ui.perfetto.dev.
+
+    python3 tools/trace2chrome.py capture.bin -o trace.json
+
+Record layout and numbering follow src/Header Files/trace.h. Event names are read from
+the SCHEDULER_EVENT_LIST in events.h, so they follow the firmware without edits here.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+EVENTS_H = os.path.join(HERE, "..", "src", "Header Files", "events.h")
+
+FRAME_HDR = 2           # TRACE_FRAME_HDR
+REC_SIZE = 8            # sizeof(TRACE_REC)
+META_SIZE = 16          # four uint32_t
+CRC_BYTES = 2           # BLE_CRC_BYTES
+SATURATED = 0xFFFF      # cycle count of a record that took longer
+CORE_MHZ = 7.0          # CMU_HFRCO_LOW, the core clock between boosts
+
+# TRACE_TYPE
+(T_ISR_ENTER, T_ISR_EXIT, T_EVT_POST, T_EVT_RUN, T_EVT_DONE, T_SLEEP_ENTER,
+ T_SLEEP_EXIT, T_I2C_STATE, T_LEUART_TX, T_LEUART_RX, T_CLOCK) = range(11)
+
+ISR_NAMES = ["LETIMER0", "LEUART0", "I2C0", "I2C1", "USART0_RX", "USART0_TX", "LEUART1"]
+I2C_STATES = ["init_write", "write_data", "init_read", "read_data", "rec_data",
+              "stop_retry", "end_process"]
+I2C_STATUS = ["OK", "NACK", "ARBLOST", "BUSERR", "TIMEOUT", "STUCK", "FULL"]
+LEUART_TX_STATES = ["STRING_INIT", "write_op", "end"]
+LEUART_RX_STATES = ["STARTFRAME", "RXDATAV", "SIGFRAME", "RAW_RX"]
+
+# Chrome trace thread ids
+TID_ISR, TID_MAIN, TID_POST, TID_SLEEP, TID_I2C, TID_LEUART = 1, 2, 3, 4, 10, 20
+
+
+def crc16_x25(data):
+    """CRC-16/X-25, the checksum ble_write_bytes() appends."""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc ^ 0xFFFF
+
+
+def event_names(path):
+    try:
+        with open(path) as f:
+            text = f.read()
+    except OSError:
+        return []
+    body = text.split("SCHEDULER_EVENT_LIST(X)", 1)[-1].split("\n\n", 1)[0]
+    return re.findall(r"X\((\w+),", body)
+
+
+def name(table, index, prefix):
+    return table[index] if index < len(table) else "%s%d" % (prefix, index)
+
+
+def parse_frames(data):
+    """Yields ("meta", (tick_hz, core_hz, written, count)) and ("recs", [records])."""
+    i = 0
+    while i + FRAME_HDR + CRC_BYTES <= len(data):
+        if data[i] != ord("X"):
+            i += 1
+            continue
+        count = data[i + 1]
+        payload = META_SIZE if count == 0 else count * REC_SIZE
+        end = i + FRAME_HDR + payload
+        if end + CRC_BYTES > len(data):
+            i += 1
+            continue
+        crc = data[end] | (data[end + 1] << 8)
+        if crc != crc16_x25(data[i:end]):
+            i += 1
+            continue
+        body = data[i + FRAME_HDR:end]
+        if count == 0:
+            yield "meta", struct.unpack("<4I", body)
+        else:
+            yield "recs", [struct.unpack_from("<IBBH", body, k * REC_SIZE) for k in range(count)]
+        i = end + CRC_BYTES
+
+
+def split_dumps(data):
+    """Groups the records that follow each meta frame."""
+    dumps = []
+    for kind, value in parse_frames(data):
+        if kind == "meta":
+            dumps.append({"meta": value, "recs": []})
+        elif dumps:
+            dumps[-1]["recs"].extend(value)
+    return dumps
+
+
+class Converter:
+    def __init__(self, events, pid, core_mhz=CORE_MHZ):
+        self.events = events
+        self.core_mhz = core_mhz
+        self.pid = pid
+        self.out = []
+        self.states = {}        # tid -> (label, start) of the state span still open
+
+    def emit(self, **kw):
+        kw.setdefault("pid", self.pid)
+        self.out.append(kw)
+
+    def span(self, tid, label, ts, dur, cat):
+        self.emit(name=label, ph="X", ts=ts, dur=max(dur, 0.0), tid=tid, cat=cat)
+
+    def convert(self, dump):
+        tick_hz, core_hz, written, count = dump["meta"]
+        # The clock of the records older than the first T_CLOCK went with the records the
+        # ring overwrote. The meta frame's clock is the one at dump time, usually boosted,
+        # so assume the resting clock until a T_CLOCK says otherwise.
+        mhz = self.core_mhz
+
+        open_isr, open_evt, open_sleep = {}, {}, {}
+        last_tick, wraps = None, 0
+        t0, ts = None, 0.0
+
+        def timed_end(stack, key, ts, cycles):
+            begin = stack.pop(key, None)
+            if cycles != SATURATED and mhz > 0:
+                return ts - cycles / mhz
+            return begin if begin is not None else ts
+
+        for tick, rtype, rid, arg in dump["recs"]:
+            if last_tick is not None and tick < last_tick and last_tick - tick > (1 << 31):
+                wraps += 1
+            last_tick = tick
+            t = (tick + (wraps << 32)) * 1e6 / tick_hz
+            if t0 is None:
+                t0 = t
+            ts = t - t0
+
+            if rtype == T_ISR_ENTER:
+                open_isr[rid] = ts
+            elif rtype == T_ISR_EXIT:
+                start = timed_end(open_isr, rid, ts, arg)
+                self.span(TID_ISR, name(ISR_NAMES, rid, "ISR"), start, ts - start, "isr")
+            elif rtype == T_EVT_POST:
+                self.emit(name="post " + name(self.events, rid, "EVT"), ph="i", s="t",
+                          ts=ts, tid=TID_POST, cat="event")
+            elif rtype == T_EVT_RUN:
+                open_evt[rid] = ts
+            elif rtype == T_EVT_DONE:
+                start = timed_end(open_evt, rid, ts, arg)
+                self.span(TID_MAIN, name(self.events, rid, "EVT"), start, ts - start, "event")
+            elif rtype == T_SLEEP_ENTER:
+                open_sleep[rid] = ts
+            elif rtype == T_SLEEP_EXIT:
+                start = open_sleep.pop(rid, ts)
+                self.span(TID_SLEEP, "EM%d" % rid, start, ts - start, "sleep")
+            elif rtype == T_I2C_STATE:
+                tid = TID_I2C + rid
+                if arg >= 0x100:
+                    self.close_state(tid, ts)
+                    self.emit(name="I2C%d %s" % (rid, name(I2C_STATUS, arg - 0x100, "status")),
+                              ph="i", s="t", ts=ts, tid=tid, cat="i2c")
+                else:
+                    self.open_state(tid, "I2C%d %s" % (rid, name(I2C_STATES, arg, "state")), ts)
+            elif rtype == T_LEUART_TX:
+                self.open_state(TID_LEUART, "TX " + name(LEUART_TX_STATES, arg, "state"), ts)
+            elif rtype == T_LEUART_RX:
+                self.open_state(TID_LEUART + 1, "RX " + name(LEUART_RX_STATES, arg, "state"), ts)
+            elif rtype == T_CLOCK:
+                mhz = float(arg)
+                self.emit(name="core MHz", ph="C", ts=ts, tid=TID_MAIN, args={"MHz": arg})
+
+        for tid in list(self.states):
+            self.close_state(tid, ts)
+
+        for tid, label in [(TID_ISR, "ISRs"), (TID_MAIN, "main loop"), (TID_POST, "event posts"),
+                           (TID_SLEEP, "sleep"), (TID_I2C, "I2C0"), (TID_I2C + 1, "I2C1"),
+                           (TID_LEUART, "LEUART TX"), (TID_LEUART + 1, "LEUART RX")]:
+            self.emit(name="thread_name", ph="M", tid=tid, args={"name": label})
+        self.emit(name="process_name", ph="M", tid=0,
+                  args={"name": "dump %d: %d of %d records" % (self.pid, count, written)})
+
+    def open_state(self, tid, label, ts):
+        self.close_state(tid, ts)
+        self.states[tid] = (label, ts)
+
+    def close_state(self, tid, ts):
+        if tid in self.states:
+            label, start = self.states.pop(tid)
+            self.span(tid, label, start, ts - start, "state")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("capture", help="raw bytes received during the dump")
+    ap.add_argument("-o", "--output", help="JSON file, stdout if omitted")
+    ap.add_argument("--events", default=EVENTS_H, help="events.h for event names")
+    ap.add_argument("--last", action="store_true", help="only convert the last dump")
+    ap.add_argument("--core-mhz", type=float, default=CORE_MHZ,
+                    help="core clock assumed before the first clock record")
+    args = ap.parse_args()
+
+    with open(args.capture, "rb") as f:
+        dumps = split_dumps(f.read())
+    if not dumps:
+        sys.exit("no trace dump found in %s" % args.capture)
+    if args.last:
+        dumps = dumps[-1:]
+
+    events = event_names(args.events)
+    trace = []
+    for pid, dump in enumerate(dumps, 1):
+        conv = Converter(events, pid, args.core_mhz)
+        conv.convert(dump)
+        trace.extend(conv.out)
+
+    text = json.dumps({"traceEvents": trace, "displayTimeUnit": "ms"}, indent=1)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()